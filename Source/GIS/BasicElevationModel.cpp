@@ -3,8 +3,25 @@
 #include <unordered_set>
 #include <thread>
 #include <mutex>
-#include <future>
 #include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <type_traits>
+
+namespace
+{
+
+	/**
+	 * Elevation tile cache budget in megabytes, unless the config sets ElevationTileCacheSize
+	 */
+	const int DEFAULT_TILE_CACHE_SIZE = 256;
+
+	/**
+	 * Upper bound of the tiles of the level whose pyramid extremes are kept resident
+	 */
+	const size_t MAX_PYRAMID_EXTREMES_TILES = 1 << 20;
+
+}
 
 GIS::BasicElevationModel::BasicElevationModel(ElevationConfig config)
 	: levelSet_( config )
@@ -17,10 +34,24 @@ GIS::BasicElevationModel::BasicElevationModel(ElevationConfig config)
 	config.GetValue(ConfigKey::ELEVATION_MIN, &elevationMinMax_.first );
 	config.GetValue(ConfigKey::ELEVATION_MAX, &elevationMinMax_.second);
 	
-	if (std::string extremeElevationFilename; config.GetValue(ConfigKey::ELEVATION_EXTREMES_FILE, &extremeElevationFilename))
+	// A pyramid holds the tiles and their extremes, the tile directories and the extremes file are then not read
+	if (std::string pyramidFilename; config.GetValue(ConfigKey::ELEVATION_PYRAMID_FILE, &pyramidFilename) && pyramid_.Open(pyramidFilename))
+	{
+		LoadPyramidExtremes();
+	}
+	else if (std::string extremeElevationFilename; config.GetValue(ConfigKey::ELEVATION_EXTREMES_FILE, &extremeElevationFilename))
 	{
 		LoadExtremeElevations( extremeElevationFilename );
 	}
+
+	int cacheSize = DEFAULT_TILE_CACHE_SIZE;
+	config.GetValue(ConfigKey::ELEVATION_TILE_CACHE_SIZE, &cacheSize);
+	memoryCache_.SetCapacity(static_cast<size_t>(std::max(cacheSize, 1)) << 20);
+
+	// Tile loads are IO bound, a few threads keep the disk busy without competing with the renderer
+	unsigned threadCount = std::clamp( std::thread::hardware_concurrency() / 2, 1u, 4u );
+	tileLoader_ = std::make_unique<TileLoader<ElevationTile>>(
+		[this](const TileKey & tileKey) { return LoadTile(tileKey); }, threadCount );
 }
 
 void GIS::BasicElevationModel::SetDetailHint(float detailHint) 
@@ -28,17 +59,9 @@ void GIS::BasicElevationModel::SetDetailHint(float detailHint)
 	detailHint_ = detailHint;
 }
 
-auto GIS::BasicElevationModel::GetElevations(const Sector & requestedSector, const LevelSet & levelSet, int targetLevelNumber) -> std::shared_ptr<Elevations>
+auto GIS::BasicElevationModel::GetElevations(const Sector & requestedSector, const LevelSet & levelSet, int targetLevelNumber,
+	bool requestMissing) -> std::shared_ptr<Elevations>
 {
-	while (loadedTileTasks_.size())
-	{
-		if (loadedTileTasks_.front()._Is_ready()) {
-			auto task = std::move( loadedTileTasks_.front() );
-			loadedTileTasks_.pop();
-			AddTile(task.get());
-		}
-	}
-
 	Sector sector;
 	requestedSector.Intersect(levelSet.GetSector(), &sector);
 	auto & targetLevel = levelSet.GetLevel(targetLevelNumber);
@@ -51,52 +74,51 @@ auto GIS::BasicElevationModel::GetElevations(const Sector & requestedSector, con
 	
 	Elevations::Tiles tiles;
 
-	std::unordered_set<TileKey> requested;
-	bool missLevelZeroTiles = false, missTargetTile = false;
+	std::vector<TileKey> missingTiles;
+	bool missLevelZeroTiles = false;
 	for (int row = seRow; row <= nwRow; ++row) 
 	{
 		for (int col = nwCol; col <= seCol; ++col) 
 		{
+			++lookupStatistics_.lookups;
 			TileKey key{ targetLevelNumber, row, col, targetLevel.GetCacheName() };
 			auto tile = GetTileFromMemory(key);
 			if (tile) {
 				tiles.insert(tile);
 				continue;
 			}
-			RequestTile(key);
-			continue;
 
-			TileKey fallbackKey, fallbackRequest;
+			// Never wait for the load, answer from the finest resident ancestor until the tile arrives
+			if (requestMissing)
+				RequestTile(key);
+			missingTiles.push_back(key);
 
-			// Fall back
 			int fallbackRow = row;
 			int fallbackCol = col;
 			for (int fallbackLevelNumber = key.GetLevelNumber() - 1; fallbackLevelNumber >= 0; --fallbackLevelNumber)
 			{
 				fallbackCol /= 2;
 				fallbackRow /= 2;
-				fallbackKey = TileKey(fallbackLevelNumber, fallbackRow, fallbackCol, levelSet.GetLevel(fallbackLevelNumber).GetCacheName());
+				TileKey fallbackKey(fallbackLevelNumber, fallbackRow, fallbackCol, levelSet.GetLevel(fallbackLevelNumber).GetCacheName());
 				tile = GetTileFromMemory(fallbackKey);
 				if (tile) {
 					tiles.insert(tile);
 					break;
 				}
-				else {
-					if (fallbackLevelNumber == 0)
-						missLevelZeroTiles = true;
-					fallbackRequest = fallbackKey;
-				}
 			}
-			if (fallbackRequest.GetCacheName().size()) {
-				if (requested.insert(fallbackRequest).second) {
-					RequestTile(fallbackKey);
-				}
+			if (tile) {
+				++lookupStatistics_.fallbackLookups;
+			}
+			else {
+				++lookupStatistics_.missingLookups;
+				missLevelZeroTiles = true;
 			}
 		}
 
 	}
 
 	std::shared_ptr<Elevations> elevations{ new Elevations { *this } };
+	elevations->SetMissingTiles(std::move(missingTiles));
 
 	if (missLevelZeroTiles || tiles.empty()) {
 		elevations->SetTexelSize(FLT_MAX);
@@ -135,14 +157,8 @@ void GIS::BasicElevationModel::LoadAllLevelZeroTiles()
 
 	}
 
-	while (loadedTileTasks_.size())
-	{
-		auto task = std::move(loadedTileTasks_.front());
-		task.wait();
-		loadedTileTasks_.pop();
-		AddTile(task.get());
-	}
-
+	tileLoader_->WaitIdle();
+	Update();
 }
 
 std::pair<float, float> GIS::BasicElevationModel::GetExtremeElevations(const Sector & sector) {
@@ -184,12 +200,12 @@ std::pair<float, float> GIS::BasicElevationModel::GetMaxMinElevation() const noe
 	return elevationMinMax_;
 }
 
-std::vector<float> GIS::BasicElevationModel::GetElevations(const Sector & sector, std::vector<LatLon> const & latlons, float targetResolution, bool mapMissingData)
+std::vector<float> GIS::BasicElevationModel::GetElevations(const Sector & sector, std::vector<LatLon> const & latlons, float targetResolution, bool mapMissingData,
+	std::vector<TileKey> * missingTiles)
 {
 	std::vector<float> result;
 	result.reserve(latlons.size());
-	Level & level = levelSet_.GetTargetLevel(targetResolution);
-	auto elevation = GetElevations(sector, levelSet_, level.GetLevelNumber());
+	auto elevation = GetElevations(sector, targetResolution);
 	for (auto latlon : latlons) 
 	{
 		auto elev = elevation->GetElevation(latlon);
@@ -201,9 +217,17 @@ std::vector<float> GIS::BasicElevationModel::GetElevations(const Sector & sector
 			result.push_back(missingSignalRep_);
 		}
 	}
+	if (missingTiles)
+		*missingTiles = elevation->GetMissingTiles();
 	return result;
 }
 
+auto GIS::BasicElevationModel::GetElevations(const Sector & sector, float targetResolution, bool requestMissing) -> ElevationsPtr
+{
+	Level & level = levelSet_.GetTargetLevel(targetResolution);
+	return GetElevations(sector, levelSet_, level.GetLevelNumber(), requestMissing);
+}
+
 bool GIS::BasicElevationModel::IsContain(const Angle & latitude, const Angle & longitude) const noexcept
 {
 	return levelSet_.GetSector().IsContain(latitude, longitude);
@@ -271,7 +295,7 @@ std::pair<float, float> GIS::BasicElevationModel::ComputeExtrameElevations(const
 		for (int col = minCol; col <= maxCol; ++col) {
 			int index = 2 * (row * nCols + col);
 			float a = extremes_[index];
-			float b = extremes_[index];
+			float b = extremes_[index + 1];
 			if (abs( a - GetMissingDataSignal() ) < 0.00001f ) {
 				a = missingSignalRep_;
 			}
@@ -291,101 +315,111 @@ std::pair<float, float> GIS::BasicElevationModel::ComputeExtrameElevations(const
 
 auto GIS::BasicElevationModel::GetTileFromMemory(const TileKey & key) const noexcept -> std::shared_ptr<ElevationTile>
 {
-	if (key.GetLevelNumber() == 0)
-	{
-		auto tileIter = levelZeroTiles_.find(key);
-		return (tileIter != levelZeroTiles_.end()) ? tileIter->second : std::shared_ptr<ElevationTile>{};
+	return memoryCache_.Get(key);
+}
+
+namespace 
+{
+
+	template <typename T>
+	void EndSwap(T *data) {
+		static_assert(std::is_pod<T>::value, "T must be a POD type");
+		auto byteData = reinterpret_cast<uint8_t*>(data);
+		std::reverse(byteData, byteData + sizeof(T));
 	}
-	else
+
+}
+
+void GIS::BasicElevationModel::RequestTile(const TileKey & tileKey) 
+{
+	if (!requestingTiles_.Insert(tileKey))
 	{
-		return memoryCache_.Get(key);
+		// Keep a request that is still queued alive for the current pass
+		tileLoader_->Renew(tileKey, requestPass_);
+		return;
 	}
+
+	auto & level = levelSet_.GetLevel(tileKey.GetLevelNumber());
+	auto delta = level.GetTileDelta();
+	auto lat = Tile::ComputeRowLatitude(tileKey.GetRow(), delta.GetLatitude(), tileOrigin_.GetLatitude());
+	auto lon = Tile::ComputeColLongitude(tileKey.GetCol(), delta.GetLongitude(), tileOrigin_.GetLongitude());
+	LatLon center{ lat + delta.GetLatitude() / 2.0f, lon + delta.GetLongitude() / 2.0f };
+	tileLoader_->Request(tileKey, center, requestPass_);
 }
 
-namespace 
+auto GIS::BasicElevationModel::LoadTile(const TileKey & tileKey) -> std::shared_ptr<ElevationTile>
 {
+	auto & level = levelSet_.GetLevel(tileKey.GetLevelNumber());
+	auto path = modelPath_ + "/" + level.GetPath() + "/" + tileKey.GetPathInLevel() + level.GetFormatSuffix();
 
-	bool FileExists(const std::string & fileName) 
+	std::vector<float> elevationData;
+	if (pyramid_.IsOpen())
 	{
-		std::ifstream input{ fileName };
-		return input.good();
+		if (!pyramid_.ReadTile(tileKey.GetLevelNumber(), tileKey.GetRow(), tileKey.GetCol(), elevationData))
+			return {};
 	}
+	else if (!ReadRawElevationFile(path, dataType_, byteOrder_, elevationData))
+		return {};
+	auto tile = CreateTile(tileKey);
+	tile->SetElevationData(std::move(elevationData));
+	return tile;
+}
 
-	template <typename T>
-	std::vector<T> ReadDataFromFile(const std::string & filename)
+void GIS::BasicElevationModel::BeginRequestPass(const LatLon & eye)
+{
+	tileLoader_->SetEyePosition(eye);
+	++requestPass_;
+	for (auto & tileKey : tileLoader_->CancelOlderThan(requestPass_ - 1))
+		requestingTiles_.Remove(tileKey);
+}
+
+bool GIS::BasicElevationModel::Update()
+{
+	std::vector<TileLoader<ElevationTile>::LoadedTile> loaded;
+	tileLoader_->TakeLoaded(loaded);
+	bool added = false;
+	// Missing tiles stay in requestingTiles_, so they are not read again
+	for (auto & loadedTile : loaded)
 	{
-		std::vector<T> result;
-		std::ifstream input{ filename, std::ios::binary };
-		if (input.is_open()) 
+		if (loadedTile.second)
 		{
-			input.seekg(0, std::ios::end);
-			auto sz = input.tellg() / sizeof(T);
-			result.resize( sz );
-			input.seekg(0, std::ios::beg);
-			input.read(reinterpret_cast<char*>(&result[0]), sz);
-			input.close();
+			AddTile(loadedTile.second);
+			added = true;
 		}
-		return result;
 	}
+	if (added)
+		++tileGeneration_;
+	memoryCache_.Trim();
+	return added;
+}
 
-	template <typename T>
-	std::vector<float> ConvertElevationData(std::vector<T> & source)
+void GIS::BasicElevationModel::RequestTiles(const std::vector<TileKey> & tileKeys)
+{
+	for (auto & tileKey : tileKeys)
 	{
-		std::vector<float> result;
-		result.reserve(source.size());
-		std::transform(source.begin(), source.end(), std::back_inserter(result),
-			[](const T & sour) -> float
-			{
-				return static_cast<float>( sour);
-			}
-		);
-		return result;
+		if (!GetTileFromMemory(tileKey))
+			RequestTile(tileKey);
 	}
-
 }
 
-void GIS::BasicElevationModel::RequestTile(const TileKey & tileKey) 
+bool GIS::BasicElevationModel::IsAnyTileResident(const std::vector<TileKey> & tileKeys) const
 {
-	if (!requestingTiles_.Insert(tileKey))
-		return;
-
-	auto requestTileTask = [this, tileKey]() -> std::shared_ptr<ElevationTile>
+	for (auto & tileKey : tileKeys)
 	{
-		auto & level = levelSet_.GetLevel(tileKey.GetLevelNumber());
-		auto path = modelPath_ + "/" + level.GetPath() + "/" + tileKey.GetPathInLevel() + level.GetFormatSuffix();
+		if (memoryCache_.Exists(tileKey))
+			return true;
+	}
+	return false;
+}
 
-		if (!FileExists(path)) 
-		{
-			return {};
-		}
-		std::vector<float> elevationData;
-		switch (dataType_) 
-		{
-		case DataType::Int16:
-			elevationData = ConvertElevationData( ReadDataFromFile<int16_t>(path) );
-			break;
-		case DataType::Int32:
-			elevationData = ConvertElevationData(ReadDataFromFile<int32_t>(path));
-			break;
-		case DataType::Float32:
-			elevationData = ReadDataFromFile<float>(path);
-			break;
-		case DataType::Float64:
-			elevationData = ConvertElevationData(ReadDataFromFile<double>(path));
-			break;
-		default:
-			throw std::runtime_error{ "Not implement" };
-		}
-		if (byteOrder_ != ByteOrder::LittleEndian)
-			throw std::runtime_error{ "Not implement" };
-		auto tile = CreateTile(tileKey);
-		auto tileKeyLevelNumber = tileKey.GetLevelNumber();
-		auto levelNumber = tile->GetLevelNumber();
-		tile->SetElevationData(std::move( elevationData) );
-		return tile;
-	};
-	requestTileTask();
-	loadedTileTasks_.push( std::async(std::launch::async | std::launch::deferred, requestTileTask ) );
+size_t GIS::BasicElevationModel::GetPendingTileCount() const
+{
+	return tileLoader_->GetQueuedCount() + tileLoader_->GetActiveCount();
+}
+
+GIS::MemoryCacheStatistics GIS::BasicElevationModel::GetCacheStatistics() const
+{
+	return memoryCache_.GetStatistics();
 }
 
 auto GIS::BasicElevationModel::CreateTile(const TileKey & tileKey) -> std::shared_ptr<ElevationTile>
@@ -404,55 +438,74 @@ void GIS::BasicElevationModel::AddTile(const std::shared_ptr<ElevationTile>& til
 		return;
 	auto levelNumber = tile->GetLevelNumber();
 	TileKey k{ levelNumber, tile->GetRow(), tile->GetCol(), levelSet_.GetLevel(levelNumber).GetCacheName() };
-	if (0 == levelNumber ) 
-	{
-		levelZeroTiles_[k] = tile;
-	}
-	else
-	{
-		memoryCache_.Put(k, tile);
-	}
+	// Level zero is the fallback of every lookup, keep it resident
+	memoryCache_.Put(k, tile, tile->GetSizeInBytes(), 0 == levelNumber);
 	requestingTiles_.Remove(k);
 }
 
-namespace {
-
-	template <typename T>
-	void EndSwap(T *data) {
-		static_assert(std::is_pod<T>::value, "T must be a POD type");
-		auto byteData = reinterpret_cast<uint8_t*>(data);
-		std::reverse(byteData, byteData + sizeof(T));
-	}
-
-}
-
 void GIS::BasicElevationModel::LoadExtremeElevations(const std::string & filename) {
-	std::ifstream input{ filename, std::ios::binary };
-	if (!input.is_open())
-		return;
-	input.seekg(0, std::ios::end);
-	std::size_t elementCount = input.tellg();
-	extremes_.clear();
-	extremes_.reserve(elementCount);
-	input.seekg(0, std::ios::beg);
 	auto nameComponent = filename.substr( 0, filename.find_last_of('.') );
 	auto levelNumberString = nameComponent.substr( nameComponent.find_last_of('_') + 1 );
 	try {
 		extremeLevel_ = std::stoi(levelNumberString);
-		do {
-			uint16_t elevation;
-			if (input.read(reinterpret_cast<char*>(&elevation), sizeof(elevation))) {
-				EndSwap(&elevation);
-				extremes_.push_back(elevation);
-			}
-			else {
-				break;
-			}
-		} while (true);
 	}
 	catch (...) {
 		return;
 	}
+
+	// Big endian 16 bit min max pairs, read in one go
+	std::vector<int16_t> data;
+	std::FILE * file = std::fopen(filename.c_str(), "rb");
+	if (!file)
+		return;
+	std::fseek(file, 0, SEEK_END);
+	long byteSize = std::ftell(file);
+	std::fseek(file, 0, SEEK_SET);
+	data.resize(std::max(byteSize, 0L) / sizeof(int16_t));
+	data.resize(std::fread(data.data(), sizeof(int16_t), data.size(), file));
+	std::fclose(file);
+
+	extremes_.clear();
+	extremes_.reserve(data.size());
+	for (auto elevation : data) {
+		EndSwap(&elevation);
+		extremes_.push_back(elevation);
+	}
+}
+
+void GIS::BasicElevationModel::LoadPyramidExtremes()
+{
+	// The finest level whose global grid of extremes stays small enough to keep resident
+	extremeLevel_ = -1;
+	for (uint32_t levelNumber = 0; levelNumber < levelSet_.GetLevelCount(); ++levelNumber)
+	{
+		LatLon delta = levelSet_.GetLevel(levelNumber).GetTileDelta();
+		int nRows = Tile::ComputeRow(delta.GetLatitude(), Angle::FromDegrees(90), Angle::FromDegrees(-90)) + 1;
+		int nCols = Tile::ComputeCol(delta.GetLongitude(), Angle::FromDegrees(180), Angle::FromDegrees(-180)) + 1;
+		if (size_t(nRows) * nCols > MAX_PYRAMID_EXTREMES_TILES)
+			break;
+		if (pyramid_.GetLevel(levelNumber))
+			extremeLevel_ = levelNumber;
+	}
+	if (extremeLevel_ < 0)
+		return;
+
+	LatLon delta = levelSet_.GetLevel(extremeLevel_).GetTileDelta();
+	int nRows = Tile::ComputeRow(delta.GetLatitude(), Angle::FromDegrees(90), Angle::FromDegrees(-90)) + 1;
+	int nCols = Tile::ComputeCol(delta.GetLongitude(), Angle::FromDegrees(180), Angle::FromDegrees(-180)) + 1;
+	extremes_.assign(2 * size_t(nRows) * nCols, GetMissingDataSignal());
+	for (int row = 0; row < nRows; ++row)
+	{
+		for (int col = 0; col < nCols; ++col)
+		{
+			if (auto tile = pyramid_.FindTile(extremeLevel_, row, col))
+			{
+				size_t index = 2 * (size_t(row) * nCols + col);
+				extremes_[index] = tile->minElevation;
+				extremes_[index + 1] = tile->maxElevation;
+			}
+		}
+	}
 }
 
 float GIS::BasicElevationModel::ElevationTile::LookUpElevation(const Angle & latitude, const Angle & longitude) const noexcept
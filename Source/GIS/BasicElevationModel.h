@@ -9,12 +9,12 @@
 #include "MemoryCache.h"
 #include "MutexMap.h"
 #include "MutexSet.h"
+#include "TileLoader.h"
+#include "ElevationPyramid.h"
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <set>
-#include <queue>
-#include <future>
 #include <iostream>
 
 namespace GIS 
@@ -45,6 +45,11 @@ namespace GIS
 				return elevationData_;
 			}
 
+			size_t GetSizeInBytes() const noexcept
+			{
+				return sizeof(*this) + elevationData_.capacity() * sizeof(float);
+			}
+
 			float LookUpElevation(const Angle & latitude, const Angle & longitude) const noexcept;
 
 		private:
@@ -64,7 +69,12 @@ namespace GIS
 			{
 				bool operator ()(const std::shared_ptr<ElevationTile> & lhs, const std::shared_ptr<ElevationTile> & rhs) const 
 				{
-					return(lhs->GetLevelNumber() > rhs->GetLevelNumber());
+					// Finest level first, several tiles of one level are kept apart by their position
+					if (lhs->GetLevelNumber() != rhs->GetLevelNumber())
+						return lhs->GetLevelNumber() > rhs->GetLevelNumber();
+					if (lhs->GetRow() != rhs->GetRow())
+						return lhs->GetRow() < rhs->GetRow();
+					return lhs->GetCol() < rhs->GetCol();
 				}
 			};
 
@@ -97,6 +107,19 @@ namespace GIS
 				return texelSize_;
 			}
 
+			void SetMissingTiles(std::vector<TileKey> && missingTiles)
+			{
+				missingTiles_ = std::move(missingTiles);
+			}
+
+			/**
+			 * Target level tiles that were not resident, their area is answered from coarser levels
+			 */
+			const std::vector<TileKey> & GetMissingTiles() const noexcept
+			{
+				return missingTiles_;
+			}
+
 			float GetElevation(const LatLon & latLon) const noexcept 
 			{
 				if (auto tile = GetContainTile(latLon)) {
@@ -144,6 +167,81 @@ namespace GIS
 				return 0;
 			}
 
+			/**
+			 * Sample a row of elevations of one latitude, like GetElevation. Consecutive samples mostly fall
+			 * into the same tile, so a tile of the finest level is kept until a sample leaves it. A coarser
+			 * fallback tile may be overlapped by finer tiles further along the row, so it is looked up per sample,
+			 * its row terms are only recomputed when the lookup gives another tile
+			 */
+			void GetElevationRow(const Angle & latitude, const Angle * longitudes, size_t count, float * result) const noexcept
+			{
+				auto missingSignal = model_.GetMissingDataSignal();
+				const ElevationTile * tile = nullptr;
+				bool tileIsFinest = false;
+				uint32_t finestLevelNumber = tiles_.empty() ? 0 : (*tiles_.begin())->GetLevelNumber();
+				const float * upperRow = nullptr;
+				const float * lowerRow = nullptr;
+				int tileWidth = 0;
+				bool hasLowerRow = false;
+				float sectorDeltaLon = 0;
+				float minLongitude = 0;
+				float dw = 0;
+				float ssLat = 0;
+				for (size_t n = 0; n < count; ++n)
+				{
+					if (!tile || !tileIsFinest || !tile->GetSector().IsContain(latitude, longitudes[n]))
+					{
+						auto containTile = GetContainTile(LatLon{ latitude, longitudes[n] });
+						if (!containTile)
+						{
+							tile = nullptr;
+							result[n] = 0;
+							continue;
+						}
+						if (containTile.get() != tile)
+						{
+							tile = containTile.get();
+							tileIsFinest = tile->GetLevelNumber() == finestLevelNumber;
+
+							auto & sector = tile->GetSector();
+							auto & level = model_.GetLevelSet().GetLevel(tile->GetLevelNumber());
+							tileWidth = level.GetTileWidth();
+							int tileHeight = level.GetTileHeight();
+							float sectorDeltaLat = sector.GetDeltaLat().GetRadians();
+							sectorDeltaLon = sector.GetDeltaLon().GetRadians();
+							minLongitude = sector.GetMinLongitude().GetRadians();
+							float dLat = sector.GetMaxLatitude().GetRadians() - latitude.GetRadians();
+							int j = static_cast<int>((tileHeight - 1) * (dLat / sectorDeltaLat));
+							float dh = sectorDeltaLat / (tileHeight - 1);
+							dw = sectorDeltaLon / (tileWidth - 1);
+							ssLat = (dLat - j * dh) / dh;
+							upperRow = tile->GetElevationData().data() + j * tileWidth;
+							hasLowerRow = j < tileHeight - 1;
+							lowerRow = hasLowerRow ? upperRow + tileWidth : upperRow;
+						}
+					}
+
+					float dLon = longitudes[n].GetRadians() - minLongitude;
+					int i = static_cast<int>((tileWidth - 1) * (dLon / sectorDeltaLon));
+					float eLeft = upperRow[i];
+					float eRight = i < (tileWidth - 1) ? upperRow[i + 1] : eLeft;
+					if (abs(missingSignal - eLeft) < 0.00001 || abs(missingSignal - eRight) < 0.00001)
+					{
+						result[n] = missingSignal;
+						continue;
+					}
+					float ssLon = (dLon - i * dw) / dw;
+					float eTop = eLeft + ssLon * (eRight - eLeft);
+					if (hasLowerRow && i < tileWidth - 1)
+					{
+						eLeft = lowerRow[i];
+						eRight = lowerRow[i + 1];
+					}
+					float eBot = eLeft + ssLon * (eRight - eLeft);
+					result[n] = eTop + ssLat * (eBot - eTop);
+				}
+			}
+
 		private:
 
 			std::shared_ptr<ElevationTile> GetContainTile( const LatLon & latLon ) const noexcept
@@ -162,17 +260,49 @@ namespace GIS
 
 			Tiles tiles_;
 
+			std::vector<TileKey> missingTiles_;
+
 			BasicElevationModel & model_;
 
 		};
 
 	public:
 
+		/**
+		 * Elevations of a sector, read only and safe to sample from any thread while the model is not updated
+		 */
+		using ElevationsPtr = std::shared_ptr<const Elevations>;
+
+		/**
+		 * Counters of the tile lookups of GetElevations
+		 */
+		struct LookupStatistics
+		{
+			/**
+			 * Target level tiles looked up
+			 */
+			uint64_t lookups = 0;
+
+			/**
+			 * Lookups answered from a coarser resident level
+			 */
+			uint64_t fallbackLookups = 0;
+
+			/**
+			 * Lookups without any resident level
+			 */
+			uint64_t missingLookups = 0;
+		};
+
         BasicElevationModel(ElevationConfig config);
 
 		void SetDetailHint(float detailHint);
 
-		std::shared_ptr<Elevations> GetElevations(const Sector & requestedSector, const LevelSet & levelSet, int targetLevelNumber);
+		/**
+		 * @param[in] requestMissing whether tiles that are not resident are requested, otherwise only resident tiles are used
+		 */
+		std::shared_ptr<Elevations> GetElevations(const Sector & requestedSector, const LevelSet & levelSet, int targetLevelNumber,
+			bool requestMissing = true);
 
 		const LevelSet & GetLevelSet() const noexcept
 		{
@@ -212,8 +342,17 @@ namespace GIS
 
 		/**
 		 * ȡһ߶
+		 * Never blocks, tiles that are not resident are requested and answered from coarser levels.
+		 * @param[out] missingTiles the target level tiles that were not resident, if not null
+		 */
+		std::vector<float> GetElevations(const Sector & sector, std::vector<LatLon> const & latlons, float targetResolution, bool mapMissingData,
+			std::vector<TileKey> * missingTiles = nullptr);
+
+		/**
+		 * @overload
+		 * Get the elevations of a sector at the level matching 'targetResolution', for sampling them later
 		 */
-		std::vector<float> GetElevations(const Sector & sector, std::vector<LatLon> const & latlons, float targetResolution, bool mapMissingData);
+		ElevationsPtr GetElevations(const Sector & sector, float targetResolution, bool requestMissing = true);
 
 		/**
 		 * жĳγǷڵǰģͷΧ
@@ -227,6 +366,51 @@ namespace GIS
 
 		float GetMissingDataReplacement() const noexcept;
 
+		/**
+		 * Start a new pass of tile requests, e.g. a tessellation. Queued requests that were not
+		 * renewed since the previous pass are cancelled, the others are ordered by their distance to 'eye'
+		 */
+		void BeginRequestPass(const LatLon & eye);
+
+		/**
+		 * Add the tiles loaded in the background since the last call, call once per frame from the main thread
+		 * @return whether tiles were added
+		 */
+		bool Update();
+
+		/**
+		 * Renew the requests of tiles reported missing by GetElevations, for the current request pass
+		 */
+		void RequestTiles(const std::vector<TileKey> & tileKeys);
+
+		/**
+		 * Whether any of 'tileKeys' has been loaded, without touching the cache order or counters
+		 */
+		bool IsAnyTileResident(const std::vector<TileKey> & tileKeys) const;
+
+		/**
+		 * Get a counter that changes whenever tiles are added, data built from coarser levels is stale once it changed
+		 */
+		uint64_t GetTileGeneration() const noexcept
+		{
+			return tileGeneration_;
+		}
+
+		const LookupStatistics & GetLookupStatistics() const noexcept
+		{
+			return lookupStatistics_;
+		}
+
+		/**
+		 * Get the amount of tiles queued or loading
+		 */
+		size_t GetPendingTileCount() const;
+
+		/**
+		 * Get the hit, miss and eviction counters of the tile cache
+		 */
+		MemoryCacheStatistics GetCacheStatistics() const;
+
 	private:
 
 		std::pair<float, float> ComputeExtrameElevations(const Sector & sector) const noexcept;
@@ -237,17 +421,28 @@ namespace GIS
 
 		std::shared_ptr<ElevationTile> CreateTile(const TileKey & tileKey);
 
+		/**
+		 * Read a tile from disk, runs on the loader threads
+		 */
+		std::shared_ptr<ElevationTile> LoadTile(const TileKey & tileKey);
+
 		void AddTile(const std::shared_ptr<ElevationTile> & tile);
 
 		void LoadExtremeElevations( const std::string & filename );
 
+		/**
+		 * Fill the extremes from the per tile extremes of the pyramid
+		 */
+		void LoadPyramidExtremes();
+
 		float GetUnmappedElevation(const Angle & latitude, const Angle & longitude) const noexcept;
 
     private:
 
-        std::unordered_map<TileKey, std::shared_ptr<ElevationTile>> levelZeroTiles_;
-
-		MemoryCache<ElevationTile> memoryCache_;
+		/**
+		 * Loaded tiles, level zero tiles are pinned
+		 */
+		MemoryCache<TileKey, ElevationTile> memoryCache_;
 
 		LevelSet levelSet_;
 
@@ -267,8 +462,6 @@ namespace GIS
 
 		LatLon tileOrigin_;
 
-		std::queue<std::future<std::shared_ptr<ElevationTile>>> loadedTileTasks_;
-
 		std::pair<float, float> elevationMinMax_;
 
 		std::vector<float> extremes_;
@@ -280,6 +473,22 @@ namespace GIS
 		 */
 		std::unordered_map<SectorKey, std::pair<float, float>> m_ExtremesCache;
 
+		/**
+		 * Tiles are read from the pyramid instead of the tile directories when it is open
+		 */
+		ElevationPyramid pyramid_;
+
+		uint64_t requestPass_ = 0;
+
+		uint64_t tileGeneration_ = 0;
+
+		LookupStatistics lookupStatistics_;
+
+		/**
+		 * Declared last, so the loader threads stop before the members they read are destroyed
+		 */
+		std::unique_ptr<TileLoader<ElevationTile>> tileLoader_;
+
     };
 
 }
\ No newline at end of file
@@ -1,5 +1,4 @@
 #include "DrawableTile.h"
-#include "GeometryTile.h"
 #include <Urho3D/Scene/Node.h>
 #include <Urho3D/Graphics/Geometry.h>
 #include <Urho3D/Graphics/Material.h>
@@ -26,7 +25,9 @@ void GIS::DrawableTile::ProcessRayQuery(const Urho3D::RayOctreeQuery & query, Ur
 
 void GIS::DrawableTile::UpdateBatches(const Urho3D::FrameInfo & frame)
 {
-	Drawable::batches_[0].worldTransform_ = Drawable::node_ ? &Drawable::node_->GetWorldTransform() : nullptr;
+	auto worldTransform = Drawable::node_ ? &Drawable::node_->GetWorldTransform() : nullptr;
+	for (unsigned i = 0; i < Drawable::batches_.Size(); ++i)
+		Drawable::batches_[i].worldTransform_ = worldTransform;
 }
 
 void GIS::DrawableTile::SetGeometry(Urho3D::Geometry *geometry)
@@ -42,6 +43,23 @@ void GIS::DrawableTile::SetGeometry(Urho3D::Geometry *geometry)
 	Drawable::batches_[0].geometryType_ = Urho3D::GeometryType::GEOM_STATIC;
 }
 
+void GIS::DrawableTile::SetGeometries(const std::vector<Urho3D::Geometry*> & geometries)
+{
+	Urho3D::SharedPtr<Urho3D::Material> material;
+	if (Drawable::batches_.Size())
+		material = Drawable::batches_[0].material_;
+	geometry_ = geometries.empty() ? nullptr : geometries.front();
+	Drawable::batches_.Resize(static_cast<unsigned>(geometries.size()));
+	for (unsigned i = 0; i < Drawable::batches_.Size(); ++i)
+	{
+		auto & batch = Drawable::batches_[i];
+		batch.worldTransform_ = Drawable::node_ ? &Drawable::node_->GetWorldTransform() : nullptr;
+		batch.geometry_ = geometries[i];
+		batch.geometryType_ = Urho3D::GeometryType::GEOM_STATIC;
+		batch.material_ = material;
+	}
+}
+
 void GIS::DrawableTile::SetMatarial(Urho3D::Material *material) 
 {
 	if( 0 != Drawable::batches_.Size() ) 
@@ -50,9 +68,9 @@ void GIS::DrawableTile::SetMatarial(Urho3D::Material *material)
 	}
 }
 
-GIS::GeometryTile *GIS::DrawableTile::GetGeometry() const noexcept
+Urho3D::Geometry *GIS::DrawableTile::GetGeometry() const noexcept
 {
-	return static_cast<GeometryTile*>( Drawable::batches_[0].geometry_ );
+	return Drawable::batches_.Size() ? Drawable::batches_[0].geometry_ : nullptr;
 }
 	
 void GIS::DrawableTile::RegisterObject(Urho3D::Context *context)
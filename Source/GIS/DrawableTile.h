@@ -6,8 +6,6 @@
 namespace GIS 
 {
 
-	class GeometryTile;
-
 	/**
 	 * RectTile
 	 */
@@ -32,6 +30,11 @@ namespace GIS
 		 */
 		void SetGeometry(Urho3D::Geometry *geometry);
 
+		/**
+		 * Set one batch per geometry, the material of the first batch is kept for all of them
+		 */
+		void SetGeometries(const std::vector<Urho3D::Geometry*> & geometries);
+
 		/**
 		 * ò
 		 */
@@ -40,7 +43,7 @@ namespace GIS
 		/**
 		 * ȡGeometry
 		 */
-		GeometryTile *GetGeometry() const noexcept;
+		Urho3D::Geometry *GetGeometry() const noexcept;
 
 		/**
 		 * bounding box
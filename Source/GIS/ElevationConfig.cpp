@@ -112,6 +112,15 @@ namespace GIS {
 		// Parse elevation extreme
 		ParseResult ParseElevationExtreme(XMLNode *node);
 
+		// Parse elevation tile cache size, in megabytes
+		ParseResult ParseElevationTileCacheSize(XMLNode *node);
+
+		// Parse sector geometry cache size, in megabytes
+		ParseResult ParseSectorGeometryCacheSize(XMLNode *node);
+
+		// Parse the single file elevation pyramid built by ElevationPyramidBuilder
+		ParseResult ParseElevationPyramid(XMLNode *node);
+
 		bool GetParser(const std::string & xmlNodeName, ParseFunction & function)
 		{
 			using NodeName = std::string;
@@ -130,7 +139,10 @@ namespace GIS {
 				std::make_pair("FormatSuffix", ParseFormatSuffix ),
 				std::make_pair("ImageFormat", ParseImageFormat ),
 				std::make_pair("TileOrigin", ParseTileOrigin ),
-				std::make_pair("ExtremeElevations", ParseElevationExtreme )
+				std::make_pair("ExtremeElevations", ParseElevationExtreme ),
+				std::make_pair("ElevationTileCacheSize", ParseElevationTileCacheSize ),
+				std::make_pair("SectorGeometryCacheSize", ParseSectorGeometryCacheSize ),
+				std::make_pair("ElevationPyramid", ParseElevationPyramid )
 			};
 			auto findResult = map.find(xmlNodeName);
 			if (findResult != map.end())
@@ -343,6 +355,27 @@ namespace GIS {
 			return result;
 		} 
 
+		ParseResult ParseElevationTileCacheSize(XMLNode *node)
+		{
+			ParseResult result;
+			result.array.Add(ConfigKey::ELEVATION_TILE_CACHE_SIZE, std::stoi(node->value()));
+			return result;
+		}
+
+		ParseResult ParseSectorGeometryCacheSize(XMLNode *node)
+		{
+			ParseResult result;
+			result.array.Add(ConfigKey::SECTOR_GEOMETRY_CACHE_SIZE, std::stoi(node->value()));
+			return result;
+		}
+
+		ParseResult ParseElevationPyramid(XMLNode *node)
+		{
+			ParseResult result;
+			result.array.Add(ConfigKey::ELEVATION_PYRAMID_FILE, std::string{ node->value() });
+			return result;
+		}
+
 	}
 
 }
@@ -109,6 +109,7 @@ namespace GIS
 		const std::string ELEVATION_MODEL = "gov.nasa.worldwind.avkey.ElevationModel";
 		const std::string ELEVATION_MODEL_FACTORY = "gov.nasa.worldwind.avkey.ElevationModelFactory";
 		const std::string ELEVATION_TILE_CACHE_SIZE = "gov.nasa.worldwind.avkey.ElevationTileCacheSize";
+		const std::string ELEVATION_PYRAMID_FILE = "gov.nasa.worldwind.avkey.ElevationPyramidFile";
 		const std::string ELEVATION_UNIT = "gov.nasa.worldwind.avkey.ElevationUnit";
 
 		const std::string END = "gov.nasa.worldwind.avkey.End";
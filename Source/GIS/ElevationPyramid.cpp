@@ -0,0 +1,406 @@
+#include "ElevationPyramid.h"
+#include <LZ4/lz4.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+	/**
+	 * Payloads start at this alignment, so uncompressed tiles can be read as floats in place
+	 */
+	const uint64_t PAYLOAD_ALIGNMENT = 16;
+
+	template <typename T>
+	void EndSwap(T *data) {
+		static_assert(std::is_pod<T>::value, "T must be a POD type");
+		auto byteData = reinterpret_cast<uint8_t*>(data);
+		std::reverse(byteData, byteData + sizeof(T));
+	}
+
+	/**
+	 * Read 'count' values of type T and convert them to float in one pass
+	 */
+	template <typename T>
+	bool ReadElevationData(std::FILE * file, size_t count, bool swapBytes, std::vector<float> & result)
+	{
+		result.resize(count);
+		if constexpr (std::is_same_v<T, float>)
+		{
+			if (std::fread(result.data(), sizeof(float), count, file) != count)
+				return false;
+			if (swapBytes)
+			{
+				for (auto & value : result)
+					EndSwap(&value);
+			}
+		}
+		else
+		{
+			std::vector<T> source(count);
+			if (std::fread(source.data(), sizeof(T), count, file) != count)
+				return false;
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (swapBytes)
+					EndSwap(&source[i]);
+				result[i] = static_cast<float>(source[i]);
+			}
+		}
+		return true;
+	}
+
+}
+
+const char GIS::ElevationPyramid::MAGIC[4] = { 'E', 'P', 'Y', 'R' };
+
+GIS::ElevationPyramid::~ElevationPyramid()
+{
+	Close();
+}
+
+bool GIS::ElevationPyramid::Open(const std::string & filename)
+{
+	Close();
+#ifdef _WIN32
+	file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		file_ = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file_, &fileSize) || !fileSize.QuadPart)
+	{
+		Close();
+		return false;
+	}
+	size_ = static_cast<size_t>(fileSize.QuadPart);
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_)
+	{
+		Close();
+		return false;
+	}
+	data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+	file_ = open(filename.c_str(), O_RDONLY);
+	if (file_ < 0)
+		return false;
+	struct stat fileStat;
+	if (fstat(file_, &fileStat) != 0 || !fileStat.st_size)
+	{
+		Close();
+		return false;
+	}
+	size_ = static_cast<size_t>(fileStat.st_size);
+	void * data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file_, 0);
+	data_ = data == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(data);
+#endif
+	if (!data_)
+	{
+		Close();
+		return false;
+	}
+
+	// Validate the tables once, lookups trust them afterwards
+	ElevationPyramidHeader header;
+	if (size_ < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, data_, sizeof(header));
+	uint64_t levelTableEnd = header.levelTableOffset + uint64_t{ header.levelCount } * sizeof(ElevationPyramidLevel);
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || levelTableEnd > header.tileTableOffset ||
+		header.tileTableOffset > size_ || (size_ - header.tileTableOffset) % sizeof(ElevationPyramidTile) != 0)
+	{
+		Close();
+		return false;
+	}
+	tiles_ = reinterpret_cast<const ElevationPyramidTile*>(data_ + header.tileTableOffset);
+	tileCount_ = (size_ - header.tileTableOffset) / sizeof(ElevationPyramidTile);
+
+	auto levels = reinterpret_cast<const ElevationPyramidLevel*>(data_ + header.levelTableOffset);
+	for (uint32_t i = 0; i < header.levelCount; ++i)
+	{
+		auto & level = levels[i];
+		uint64_t gridSize = uint64_t(std::max(level.rowCount, 0)) * uint64_t(std::max(level.colCount, 0));
+		if (level.levelNumber < 0 || level.firstTile + gridSize > tileCount_)
+		{
+			Close();
+			return false;
+		}
+		if (levels_.size() <= static_cast<size_t>(level.levelNumber))
+			levels_.resize(level.levelNumber + 1, nullptr);
+		levels_[level.levelNumber] = &level;
+	}
+	return true;
+}
+
+void GIS::ElevationPyramid::Close()
+{
+#ifdef _WIN32
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(mapping_);
+	if (file_)
+		CloseHandle(file_);
+	mapping_ = nullptr;
+	file_ = nullptr;
+#else
+	if (data_)
+		munmap(const_cast<uint8_t*>(data_), size_);
+	if (file_ >= 0)
+		close(file_);
+	file_ = -1;
+#endif
+	data_ = nullptr;
+	size_ = 0;
+	levels_.clear();
+	tiles_ = nullptr;
+	tileCount_ = 0;
+}
+
+auto GIS::ElevationPyramid::GetLevel(int levelNumber) const noexcept -> const ElevationPyramidLevel *
+{
+	if (levelNumber < 0 || static_cast<size_t>(levelNumber) >= levels_.size())
+		return nullptr;
+	return levels_[levelNumber];
+}
+
+auto GIS::ElevationPyramid::FindTile(int levelNumber, int row, int col) const noexcept -> const ElevationPyramidTile *
+{
+	auto level = GetLevel(levelNumber);
+	if (!level)
+		return nullptr;
+	int gridRow = row - level->firstRow;
+	int gridCol = col - level->firstCol;
+	if (gridRow < 0 || gridRow >= level->rowCount || gridCol < 0 || gridCol >= level->colCount)
+		return nullptr;
+	auto & tile = tiles_[level->firstTile + uint64_t(gridRow) * level->colCount + gridCol];
+	if (!(tile.flags & ElevationPyramidTile::PRESENT) || tile.offset + tile.storedSize > size_)
+		return nullptr;
+	return &tile;
+}
+
+bool GIS::ElevationPyramid::ReadTile(int levelNumber, int row, int col, std::vector<float> & result) const
+{
+	auto tile = FindTile(levelNumber, row, col);
+	if (!tile)
+		return false;
+	auto level = GetLevel(levelNumber);
+	size_t count = size_t(level->tileWidth) * level->tileHeight;
+	result.resize(count);
+	auto source = reinterpret_cast<const char*>(data_ + tile->offset);
+	if (tile->flags & ElevationPyramidTile::LZ4)
+	{
+		int rawSize = static_cast<int>(count * sizeof(float));
+		return LZ4_decompress_safe(source, reinterpret_cast<char*>(result.data()), static_cast<int>(tile->storedSize), rawSize) == rawSize;
+	}
+	if (tile->storedSize != count * sizeof(float))
+		return false;
+	memcpy(result.data(), source, tile->storedSize);
+	return true;
+}
+
+GIS::ElevationPyramidWriter::ElevationPyramidWriter(bool compress, std::optional<float> missingDataSignal)
+	: compress_( compress ), missingDataSignal_( missingDataSignal )
+{
+}
+
+GIS::ElevationPyramidWriter::~ElevationPyramidWriter()
+{
+	if (file_)
+		std::fclose(file_);
+}
+
+bool GIS::ElevationPyramidWriter::Open(const std::string & filename)
+{
+	file_ = std::fopen(filename.c_str(), "wb");
+	if (!file_)
+		return false;
+	// The header is written again by Finish, once the table offsets are known
+	ElevationPyramidHeader header{};
+	return Write(&header, sizeof(header));
+}
+
+bool GIS::ElevationPyramidWriter::AddTile(int levelNumber, int row, int col, int tileWidth, int tileHeight, const std::vector<float> & elevations)
+{
+	if (!file_ || elevations.size() != size_t(tileWidth) * tileHeight)
+		return false;
+	auto & level = levels_[levelNumber];
+	if (level.tiles.empty())
+	{
+		level.tileWidth = tileWidth;
+		level.tileHeight = tileHeight;
+	}
+	else if (level.tileWidth != tileWidth || level.tileHeight != tileHeight)
+		return false;
+
+	ElevationPyramidTile entry{};
+	entry.flags = ElevationPyramidTile::PRESENT;
+	entry.minElevation = FLT_MAX;
+	entry.maxElevation = -FLT_MAX;
+	for (auto elevation : elevations)
+	{
+		if (missingDataSignal_ && elevation == *missingDataSignal_)
+			continue;
+		entry.minElevation = std::min(entry.minElevation, elevation);
+		entry.maxElevation = std::max(entry.maxElevation, elevation);
+	}
+	if (entry.minElevation > entry.maxElevation)
+	{
+		// Nothing but missing data, the extremes then report the signal
+		entry.minElevation = entry.maxElevation = missingDataSignal_.value_or(0.0f);
+	}
+
+	if (!Align())
+		return false;
+
+	int rawSize = static_cast<int>(elevations.size() * sizeof(float));
+	const void * payload = elevations.data();
+	entry.storedSize = rawSize;
+	if (compress_)
+	{
+		compressed_.resize(LZ4_compressBound(rawSize));
+		int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(elevations.data()), compressed_.data(), rawSize,
+			static_cast<int>(compressed_.size()));
+		if (compressedSize > 0 && compressedSize < rawSize)
+		{
+			payload = compressed_.data();
+			entry.storedSize = compressedSize;
+			entry.flags |= ElevationPyramidTile::LZ4;
+		}
+	}
+	entry.offset = offset_;
+	if (!Write(payload, entry.storedSize))
+		return false;
+	rawBytes_ += rawSize;
+	storedBytes_ += entry.storedSize;
+	level.tiles.push_back({ row, col, entry });
+	return true;
+}
+
+bool GIS::ElevationPyramidWriter::Finish()
+{
+	if (!file_)
+		return false;
+
+	std::vector<ElevationPyramidLevel> levelTable;
+	std::vector<ElevationPyramidTile> tileTable;
+	for (auto & [levelNumber, record] : levels_)
+	{
+		ElevationPyramidLevel level{};
+		level.levelNumber = levelNumber;
+		level.tileWidth = record.tileWidth;
+		level.tileHeight = record.tileHeight;
+		int lastRow = INT32_MIN;
+		int lastCol = INT32_MIN;
+		level.firstRow = INT32_MAX;
+		level.firstCol = INT32_MAX;
+		for (auto & tile : record.tiles)
+		{
+			level.firstRow = std::min(level.firstRow, tile.row);
+			level.firstCol = std::min(level.firstCol, tile.col);
+			lastRow = std::max(lastRow, tile.row);
+			lastCol = std::max(lastCol, tile.col);
+		}
+		level.rowCount = lastRow - level.firstRow + 1;
+		level.colCount = lastCol - level.firstCol + 1;
+		level.firstTile = tileTable.size();
+		tileTable.resize(tileTable.size() + size_t(level.rowCount) * level.colCount, ElevationPyramidTile{});
+		for (auto & tile : record.tiles)
+		{
+			size_t index = level.firstTile + size_t(tile.row - level.firstRow) * level.colCount + (tile.col - level.firstCol);
+			tileTable[index] = tile.entry;
+		}
+		levelTable.push_back(level);
+	}
+
+	// The tables are read in place, so they are aligned like the payloads
+	if (!Align())
+		return false;
+	ElevationPyramidHeader header{};
+	memcpy(header.magic, ElevationPyramid::MAGIC, sizeof(header.magic));
+	header.version = ElevationPyramid::VERSION;
+	header.levelCount = static_cast<uint32_t>(levelTable.size());
+	header.levelTableOffset = offset_;
+	header.tileTableOffset = offset_ + levelTable.size() * sizeof(ElevationPyramidLevel);
+	bool success = Write(levelTable.data(), levelTable.size() * sizeof(ElevationPyramidLevel)) &&
+		Write(tileTable.data(), tileTable.size() * sizeof(ElevationPyramidTile)) &&
+		std::fseek(file_, 0, SEEK_SET) == 0 &&
+		std::fwrite(&header, sizeof(header), 1, file_) == 1;
+	success = std::fclose(file_) == 0 && success;
+	file_ = nullptr;
+	return success;
+}
+
+bool GIS::ElevationPyramidWriter::Align()
+{
+	static const char padding[PAYLOAD_ALIGNMENT] = {};
+	auto misalignment = offset_ % PAYLOAD_ALIGNMENT;
+	return !misalignment || Write(padding, PAYLOAD_ALIGNMENT - misalignment);
+}
+
+bool GIS::ElevationPyramidWriter::Write(const void * data, size_t size)
+{
+	if (size && std::fwrite(data, 1, size, file_) != size)
+		return false;
+	offset_ += size;
+	return true;
+}
+
+bool GIS::ReadRawElevationFile(const std::string & filename, ElevationConfig::DataType dataType, ElevationConfig::ByteOrder byteOrder,
+	std::vector<float> & result)
+{
+	using DataType = ElevationConfig::DataType;
+
+	std::FILE * file = std::fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+	std::fseek(file, 0, SEEK_END);
+	long byteSize = std::ftell(file);
+	std::fseek(file, 0, SEEK_SET);
+
+	bool swapBytes = byteOrder != ElevationConfig::ByteOrder::LittleEndian;
+	bool success = byteSize > 0;
+	if (success)
+	{
+		switch (dataType)
+		{
+		case DataType::Int16:
+			success = ReadElevationData<int16_t>(file, byteSize / sizeof(int16_t), swapBytes, result);
+			break;
+		case DataType::Int32:
+			success = ReadElevationData<int32_t>(file, byteSize / sizeof(int32_t), swapBytes, result);
+			break;
+		case DataType::Float32:
+			success = ReadElevationData<float>(file, byteSize / sizeof(float), swapBytes, result);
+			break;
+		case DataType::Float64:
+			success = ReadElevationData<double>(file, byteSize / sizeof(double), swapBytes, result);
+			break;
+		default:
+			success = false;
+			break;
+		}
+	}
+	std::fclose(file);
+	return success;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "ElevationConfig.h"
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GIS
+{
+
+	/**
+	 * Single file elevation pyramid.
+	 * The file starts with a header, the tile payloads follow, the level table and the tile table close it.
+	 * Every level has a dense row by column grid of tile entries over the range of its tiles, so finding a
+	 * tile is an index computation. Payloads are little endian float32, optionally LZ4 compressed.
+	 */
+	struct ElevationPyramidHeader
+	{
+		char magic[4];
+
+		uint32_t version;
+
+		uint32_t levelCount;
+
+		uint32_t reserved;
+
+		uint64_t levelTableOffset;
+
+		uint64_t tileTableOffset;
+	};
+
+	struct ElevationPyramidLevel
+	{
+		int32_t levelNumber;
+
+		int32_t tileWidth;
+
+		int32_t tileHeight;
+
+		int32_t firstRow;
+
+		int32_t rowCount;
+
+		int32_t firstCol;
+
+		int32_t colCount;
+
+		uint32_t reserved;
+
+		/**
+		 * Index of the entry of (firstRow, firstCol) in the tile table
+		 */
+		uint64_t firstTile;
+	};
+
+	struct ElevationPyramidTile
+	{
+		enum Flags : uint32_t
+		{
+			PRESENT = 1,
+			LZ4 = 2,
+		};
+
+		uint64_t offset;
+
+		uint32_t storedSize;
+
+		uint32_t flags;
+
+		float minElevation;
+
+		float maxElevation;
+	};
+
+	/**
+	 * Read access to a memory mapped elevation pyramid, safe to use from several threads
+	 */
+	class ElevationPyramid
+	{
+	public:
+
+		static const char MAGIC[4];
+
+		static const uint32_t VERSION = 1;
+
+	public:
+
+		ElevationPyramid() = default;
+
+		~ElevationPyramid();
+
+		ElevationPyramid(const ElevationPyramid &) = delete;
+
+		ElevationPyramid & operator =(const ElevationPyramid &) = delete;
+
+		bool Open(const std::string & filename);
+
+		void Close();
+
+		bool IsOpen() const noexcept
+		{
+			return data_ != nullptr;
+		}
+
+		const ElevationPyramidLevel * GetLevel(int levelNumber) const noexcept;
+
+		/**
+		 * @return the entry of the tile, null when the pyramid has no such tile
+		 */
+		const ElevationPyramidTile * FindTile(int levelNumber, int row, int col) const noexcept;
+
+		/**
+		 * Copy or decompress the elevations of a tile into 'result'
+		 */
+		bool ReadTile(int levelNumber, int row, int col, std::vector<float> & result) const;
+
+	private:
+
+		const uint8_t * data_ = nullptr;
+
+		size_t size_ = 0;
+
+		/**
+		 * Levels by level number, null for levels without tiles
+		 */
+		std::vector<const ElevationPyramidLevel *> levels_;
+
+		const ElevationPyramidTile * tiles_ = nullptr;
+
+		uint64_t tileCount_ = 0;
+
+#ifdef _WIN32
+		void * file_ = nullptr;
+
+		void * mapping_ = nullptr;
+#else
+		int file_ = -1;
+#endif
+
+	};
+
+	/**
+	 * Writes an elevation pyramid tile by tile, the tables are written by Finish
+	 */
+	class ElevationPyramidWriter
+	{
+	public:
+
+		/**
+		 * @param[in] compress whether payloads are LZ4 compressed, tiles that do not shrink are stored as they are
+		 * @param[in] missingDataSignal elevation value left out of the tile extremes
+		 */
+		ElevationPyramidWriter(bool compress, std::optional<float> missingDataSignal);
+
+		~ElevationPyramidWriter();
+
+		ElevationPyramidWriter(const ElevationPyramidWriter &) = delete;
+
+		ElevationPyramidWriter & operator =(const ElevationPyramidWriter &) = delete;
+
+		bool Open(const std::string & filename);
+
+		bool AddTile(int levelNumber, int row, int col, int tileWidth, int tileHeight, const std::vector<float> & elevations);
+
+		bool Finish();
+
+		uint64_t GetRawBytes() const noexcept
+		{
+			return rawBytes_;
+		}
+
+		uint64_t GetStoredBytes() const noexcept
+		{
+			return storedBytes_;
+		}
+
+	private:
+
+		struct TileRecord
+		{
+			int row;
+
+			int col;
+
+			ElevationPyramidTile entry;
+		};
+
+		struct LevelRecord
+		{
+			int tileWidth = 0;
+
+			int tileHeight = 0;
+
+			std::vector<TileRecord> tiles;
+		};
+
+		bool Write(const void * data, size_t size);
+
+		bool Align();
+
+		std::FILE * file_ = nullptr;
+
+		bool compress_;
+
+		std::optional<float> missingDataSignal_;
+
+		uint64_t offset_ = 0;
+
+		std::map<int, LevelRecord> levels_;
+
+		std::vector<char> compressed_;
+
+		uint64_t rawBytes_ = 0;
+
+		uint64_t storedBytes_ = 0;
+
+	};
+
+	/**
+	 * Read a raw tile of any data type and byte order, converted to native float32
+	 */
+	bool ReadRawElevationFile(const std::string & filename, ElevationConfig::DataType dataType, ElevationConfig::ByteOrder byteOrder,
+		std::vector<float> & result);
+
+}
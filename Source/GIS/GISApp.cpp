@@ -1,5 +1,6 @@
 #include "GISApp.h"
 #include "DrawableTile.h"
+#include "BasicElevationModel.h"
 #include <Urho3D/Engine/Application.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Engine/Console.h>
@@ -18,6 +19,7 @@
 #include <Urho3D/UI/Sprite.h>
 #include <Urho3D/Graphics/Texture2D.h>
 #include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/UI/UI.h>
 #include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/IO/Log.h>
@@ -91,6 +93,7 @@ void GIS::GISApp::CreateScene()
 	cameraNode_->GetComponent<Camera>()->SetFarClip(10000000000);
 	cameraNode_->GetComponent<Camera>()->SetNearClip(10000);
 	lightNode->SetPosition(cameraNode_->GetPosition());
+	global_.GetTessellator().SetWorkQueue(GetSubsystem<WorkQueue>());
 	m_TileNodeManager.reset(new TileNodeManager{ global_, scene_ });
 	m_TileNodeManager->Tessellate();
 }
@@ -115,6 +118,10 @@ void GIS::GISApp::HandleUpdate(StringHash eventType, VariantMap& eventData)
 	// Take the frame time step, which is stored as a float
 	float timeStep = eventData[Update::P_TIMESTEP].GetFloat();
 
+	// Publish the elevation tiles loaded in the background, tiles drawn from coarser levels are refined with them
+	if (global_.GetElevationModel().Update() && !m_Debug)
+		m_TileNodeManager->Tessellate();
+
 	// Move the camera, scale movement with time step
 	MoveCamera(timeStep);
 }
@@ -183,6 +190,13 @@ void GIS::GISApp::MoveCamera(float timeStep)
 	if (input->GetKeyPress(KEY_RIGHT)) {
 		m_TileNodeManager->SetTessellateEnable(true);
 	}
+	if (input->GetKeyPress(KEY_B)) {
+		for (auto & result : global_.GetTessellator().BenchmarkVertexData({ 5, 10, 20, 40 }, 1024))
+		{
+			URHO3D_LOGINFOF("Tile vertex data, density %d: %u tiles in %.3f s, %.0f tiles/s",
+				result.density, static_cast<unsigned>(result.tileCount), result.seconds, result.tilesPerSecond);
+		}
+	}
 	if (!m_Debug && (isNeedUpdate ||move || mouseMove.x_ || mouseMove.y_ ) ) {
 		Node* lightNode = scene_->GetChild("DirectionalLight");
 		auto light = lightNode->GetComponent<Light>();
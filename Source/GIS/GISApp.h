@@ -2,7 +2,7 @@
 
 #include "Sample.h"
 #include "Global.h"
-#include "GeometryTile.h"
+#include "TileGeometryArena.h"
 #include "TileNodeManager.h"
 
 namespace GIS {
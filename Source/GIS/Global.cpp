@@ -315,6 +315,23 @@ float GIS::Global::ComputePerspectiveNearDistance(float farDist, float farResolu
 	return farDist / (maxDepthValue / (1 - farResolution / farDist) - maxDepthValue + 1);
 }
 
+void GIS::Global::ComputePointsFromRow(const Angle & latitude, const double * sinLongitudes, const double * cosLongitudes,
+	const float * elevations, size_t count, Urho3D::Vector3 * result) const noexcept
+{
+	// Same as GeodeticToCartesian, with the latitude terms hoisted out of the loop
+	double cosLat = cos(latitude.GetRadians());
+	double sinLat = sin(latitude.GetRadians());
+	double rpm = equatorialRadius_ / sqrt(1.0 - es_ * sinLat * sinLat);
+	double rpmY = rpm * (1.0 - es_);
+	for (size_t i = 0; i < count; ++i)
+	{
+		double radius = (rpm + elevations[i]) * cosLat;
+		result[i].x_ = static_cast<float>(radius * sinLongitudes[i]);
+		result[i].y_ = static_cast<float>((rpmY + elevations[i]) * sinLat);
+		result[i].z_ = static_cast<float>(radius * cosLongitudes[i]);
+	}
+}
+
 auto GIS::Global::GeodeticToCartesian(const Angle & latitude, const Angle & longitude, float elevation) -> Vector4D
 {
 	float cosLat = cos(latitude.GetRadians());
@@ -55,6 +55,13 @@ namespace GIS
 		 */
 		Vector4D ComputePointFromPosition(const LatLon & latlon, float elevation);
 
+		/**
+		 * Convert a row of positions of one latitude to cartesian coordinates. The longitudes are given by
+		 * their sines and cosines, which all rows of a tile grid share. Safe to call from any thread
+		 */
+		void ComputePointsFromRow(const Angle & latitude, const double * sinLongitudes, const double * cosLongitudes,
+			const float * elevations, size_t count, Urho3D::Vector3 * result) const noexcept;
+
 		/**
 		 * ȡĳ뾶
 		 */
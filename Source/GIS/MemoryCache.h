@@ -1,41 +1,227 @@
 #pragma once
 
-#include "Tile.h"
-#include "Tilekey.h"
-#include "MutexMap.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
-namespace GIS 
+namespace GIS
 {
 
-	template <typename T>
-	class MemoryCache 
+	/**
+	 * Counters of a MemoryCache, summed over its shards
+	 */
+	struct MemoryCacheStatistics
+	{
+		uint64_t hits = 0;
+
+		uint64_t misses = 0;
+
+		uint64_t evictions = 0;
+
+		size_t usedBytes = 0;
+
+		size_t pinnedBytes = 0;
+
+		size_t count = 0;
+	};
+
+	/**
+	 * Least recently used cache with a byte budget.
+	 * Entries are spread over shards by the hash of their key, each shard has its own lock and an
+	 * equal part of the budget. Pinned entries do not count against the budget and are never evicted,
+	 * entries still referenced outside the cache are skipped until they are released.
+	 */
+	template <typename Key, typename T, typename Hash = std::hash<Key>>
+	class MemoryCache
 	{
 	public:
 
-		std::shared_ptr<T> Get(const TileKey & key) const {
-			std::shared_ptr<T> item;
-			map_.GetValue(key, item);
-			return item;
+		static constexpr size_t SHARD_COUNT = 16;
+
+		/**
+		 * @param[in] capacity budget in bytes, 0 means unbounded
+		 */
+		explicit MemoryCache(size_t capacity = 0)
+		{
+			SetCapacity(capacity);
+		}
+
+		MemoryCache(const MemoryCache &) = delete;
+
+		MemoryCache & operator =(const MemoryCache &) = delete;
+
+		void SetCapacity(size_t capacity)
+		{
+			capacity_ = capacity;
+			Trim();
+		}
+
+		size_t GetCapacity() const noexcept
+		{
+			return capacity_;
+		}
+
+		std::shared_ptr<T> Get(const Key & key) const {
+			auto & shard = GetShard(key);
+			std::lock_guard<std::mutex> guard{ shard.mutex };
+			auto iter = shard.index.find(key);
+			if (iter == shard.index.end())
+			{
+				++shard.misses;
+				return {};
+			}
+			++shard.hits;
+			shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+			return iter->second->value;
+		}
+
+		/**
+		 * Insert or replace an entry of 'size' bytes and make it the most recently used one
+		 */
+		void Put(const Key & key, const std::shared_ptr<T> & value, size_t size, bool pinned = false) {
+			auto & shard = GetShard(key);
+			std::lock_guard<std::mutex> guard{ shard.mutex };
+			if (auto iter = shard.index.find(key); iter != shard.index.end())
+				Erase(shard, iter->second);
+			shard.entries.push_front(Entry{ key, value, size, pinned });
+			shard.index[key] = shard.entries.begin();
+			(pinned ? shard.pinnedBytes : shard.usedBytes) += size;
+			Evict(shard);
+		}
+
+		bool Exists(const Key & key) const {
+			auto & shard = GetShard(key);
+			std::lock_guard<std::mutex> guard{ shard.mutex };
+			return shard.index.count(key) != 0;
+		}
+
+		void Remove(const Key & key) {
+			auto & shard = GetShard(key);
+			std::lock_guard<std::mutex> guard{ shard.mutex };
+			if (auto iter = shard.index.find(key); iter != shard.index.end())
+				Erase(shard, iter->second);
 		}
 
-		void Put(const TileKey & key, const std::shared_ptr<T> & tile) {
-			map_.SetValue( key, tile );
+		void Clear()
+		{
+			for (auto & shard : shards_)
+			{
+				std::lock_guard<std::mutex> guard{ shard.mutex };
+				shard.entries.clear();
+				shard.index.clear();
+				shard.usedBytes = 0;
+				shard.pinnedBytes = 0;
+			}
 		}
 
-		bool Exists(const TileKey & key) {
-			return map_.Exists(key);
+		/**
+		 * Evict down to the budget again, entries that were referenced on insertion may have been released since
+		 */
+		void Trim()
+		{
+			for (auto & shard : shards_)
+			{
+				std::lock_guard<std::mutex> guard{ shard.mutex };
+				Evict(shard);
+			}
 		}
 
-		void Remove(const TileKey & key) {
-			map_.Remove(key);
+		MemoryCacheStatistics GetStatistics() const
+		{
+			MemoryCacheStatistics statistics;
+			for (auto & shard : shards_)
+			{
+				std::lock_guard<std::mutex> guard{ shard.mutex };
+				statistics.hits += shard.hits;
+				statistics.misses += shard.misses;
+				statistics.evictions += shard.evictions;
+				statistics.usedBytes += shard.usedBytes;
+				statistics.pinnedBytes += shard.pinnedBytes;
+				statistics.count += shard.entries.size();
+			}
+			return statistics;
 		}
 
 	private:
 
-		MutexMap<TileKey, std::shared_ptr<T>> map_;
+		struct Entry
+		{
+			Key key;
+
+			std::shared_ptr<T> value;
+
+			size_t size;
+
+			bool pinned;
+		};
+
+		using EntryList = std::list<Entry>;
+
+		struct Shard
+		{
+			mutable std::mutex mutex;
+
+			/**
+			 * Most recently used first
+			 */
+			EntryList entries;
+
+			std::unordered_map<Key, typename EntryList::iterator, Hash> index;
+
+			size_t usedBytes = 0;
+
+			size_t pinnedBytes = 0;
+
+			uint64_t hits = 0;
+
+			uint64_t misses = 0;
+
+			uint64_t evictions = 0;
+		};
+
+		Shard & GetShard(const Key & key) const
+		{
+			return shards_[Hash{}(key) % SHARD_COUNT];
+		}
+
+		static void Erase(Shard & shard, typename EntryList::iterator entry)
+		{
+			(entry->pinned ? shard.pinnedBytes : shard.usedBytes) -= entry->size;
+			shard.index.erase(entry->key);
+			shard.entries.erase(entry);
+		}
+
+		/**
+		 * Evict the least recently used entries over the budget, the caller holds the shard lock
+		 */
+		void Evict(Shard & shard)
+		{
+			size_t capacity = capacity_;
+			if (!capacity)
+				return;
+			size_t shardCapacity = capacity / SHARD_COUNT;
+			auto iter = shard.entries.end();
+			while (shard.usedBytes > shardCapacity && iter != shard.entries.begin())
+			{
+				--iter;
+				if (iter->pinned || iter->value.use_count() > 1)
+					continue;
+				Erase(shard, iter++);
+				++shard.evictions;
+			}
+		}
+
+	private:
+
+		mutable std::array<Shard, SHARD_COUNT> shards_;
+
+		std::atomic<size_t> capacity_{ 0 };
 
 	};
 
-}
\ No newline at end of file
+}
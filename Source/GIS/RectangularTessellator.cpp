@@ -1,6 +1,10 @@
 #include "RectangularTessellator.h"
 #include "BasicElevationModel.h"
 #include "Global.h"
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <algorithm>
+#include <chrono>
 
 namespace 
 {
@@ -9,6 +13,21 @@ namespace
 	const uint32_t DEFAULT_NUM_LAT_SUBDIVISIONS = 3;
 	const uint32_t DEFAULT_NUM_LON_SUBDIVISIONS = 3;
 
+	/**
+	 * Vertex data cache budget in megabytes, unless the config sets SectorGeometryCacheSize
+	 */
+	const int DEFAULT_GEOMETRY_CACHE_SIZE = 256;
+
+	/**
+	 * Bounding box cache budget in bytes, the boxes spare computing vertex data of sectors that are only culled
+	 */
+	const size_t BBOX_CACHE_SIZE = 16 << 20;
+
+	/**
+	 * Estimated bytes per bounding box cache entry, including the list and index nodes
+	 */
+	const size_t BBOX_ENTRY_SIZE = sizeof(Urho3D::BoundingBox) + 96;
+
 }
 
 std::unordered_map<int, std::shared_ptr<std::vector<uint32_t>>> GIS::RectangularTessellator::ms_IndicesMap;
@@ -21,30 +40,109 @@ GIS::RectangularTessellator::RectangularTessellator(Global & global, ElevationCo
 	numLevel0LatSubdivision = DEFAULT_NUM_LAT_SUBDIVISIONS;
 	numLevel0LonSubdivision = DEFAULT_NUM_LON_SUBDIVISIONS;
 	m_MaxLevel = levelSet_.GetLevelCount() - 1;
+
+	int cacheSize = DEFAULT_GEOMETRY_CACHE_SIZE;
+	config.GetValue(ConfigKey::SECTOR_GEOMETRY_CACHE_SIZE, &cacheSize);
+	m_RenderInfoMap.SetCapacity(static_cast<size_t>(std::max(cacheSize, 1)) << 20);
+	m_BBoxMap.SetCapacity(BBOX_CACHE_SIZE);
 }
 
 auto GIS::RectangularTessellator::Tessellate( const RectTileTessellateParams & params ) -> const std::vector<std::shared_ptr<RectTile>>&
 {
-	currentTiles_.clear();
-	if (!topLevelTiles_.size()) 
+	global_.GetElevationModel().BeginRequestPass(global_.CartesianToGeodetic(params.eyePosition));
+	m_TileDelta.Clear();
+	m_SelectionStatistics = SelectionStatistics{};
+	if (m_RootNodes.empty()) 
 	{
 		CreateTopLevelTiles();
 	}
-	for (auto tile : topLevelTiles_) 
+	// The quadtree keeps its split state between frames, a camera that did not move keeps the whole selection
+	if (m_SelectionDirty || IsCameraChanged(params))
+	{
+		currentTiles_.clear();
+		for (auto & node : m_RootNodes) 
+		{
+			SelectVisibleTiles(params, *node);
+		}
+		m_LastParams = params;
+		m_SelectionDirty = false;
+	}
+	else
+		m_SelectionStatistics.reused = true;
+
+	// Tiles without up to date vertex data are built together, in parallel
+	std::vector<RectTile*> staleTiles;
+	std::vector<std::shared_ptr<RectTile>> refinedTiles;
+	for (auto & tile : currentTiles_) 
 	{
-		SelectVisibleTiles(params, tile);
+		if (!IsVertexDataStale(*tile))
+			continue;
+		staleTiles.push_back(tile.get());
+		if (tile->GetRenderInfo())
+			refinedTiles.push_back(tile);
 	}
-	for (auto tile : currentTiles_) 
+	if (!staleTiles.empty())
 	{
-		if (!tile->GetRenderInfo())
-			CheckVertexData(*tile);
+		CreateTileVertexData(staleTiles);
+		// The exact bounding boxes came with the vertex data
+		m_SelectionDirty = true;
 	}
+	for (auto & tile : refinedTiles)
+	{
+		auto & added = m_TileDelta.added;
+		if (std::find(added.begin(), added.end(), tile) == added.end())
+			m_TileDelta.updated.push_back(tile);
+	}
+	// The previous tiles are released, their vertex data may be evicted now
+	m_RenderInfoMap.Trim();
+	m_BBoxMap.Trim();
 	return currentTiles_;
 }
 
+GIS::MemoryCacheStatistics GIS::RectangularTessellator::GetRenderInfoCacheStatistics() const
+{
+	return m_RenderInfoMap.GetStatistics();
+}
+
+auto GIS::RectangularTessellator::BenchmarkVertexData(const std::vector<int> & densities, size_t tileCount) -> std::vector<VertexBenchmarkResult>
+{
+	std::vector<VertexBenchmarkResult> results;
+	if (!tileCount)
+		return results;
+
+	// A grid of sectors over the globe, so every kind of elevation lookup is hit
+	size_t gridSize = static_cast<size_t>(ceil(sqrt(static_cast<double>(tileCount))));
+	float deltaLat = 180.0f / gridSize;
+	float deltaLon = 360.0f / gridSize;
+	for (int density : densities)
+	{
+		std::vector<RectTile> tiles;
+		tiles.reserve(tileCount);
+		for (size_t i = 0; i < tileCount; ++i)
+		{
+			float minLat = -90.0f + (i / gridSize) * deltaLat;
+			float minLon = -180.0f + (i % gridSize) * deltaLon;
+			Sector sector{ Angle::FromDegrees(minLat), Angle::FromDegrees(minLat + deltaLat),
+				Angle::FromDegrees(minLon), Angle::FromDegrees(minLon + deltaLon) };
+			tiles.emplace_back(sector, 0, density, BBox{});
+		}
+		std::vector<VertexDataJob> jobs(tileCount);
+		for (size_t i = 0; i < tileCount; ++i)
+			jobs[i].tile = &tiles[i];
+
+		auto start = std::chrono::steady_clock::now();
+		BuildVertexData(jobs, false);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		double seconds = std::max(elapsed.count(), 1e-9);
+		results.push_back({ density, tileCount, seconds, tileCount / seconds });
+	}
+	return results;
+}
+
 void GIS::RectangularTessellator::CreateTopLevelTiles() 
 {
-	topLevelTiles_.clear();
+	m_RootNodes.clear();
 	float deltaLat = 180.0f / numLevel0LatSubdivision;
 	float deltaLon = 360.0f / numLevel0LonSubdivision;
 	Angle lastLat = Angle::FromDegrees(-90);
@@ -60,32 +158,87 @@ void GIS::RectangularTessellator::CreateTopLevelTiles()
 			if (lon.GetDegrees() + 1 > 180)
 				lon = Angle::FromDegrees(180);
 			Sector tileSector{ lastLat, lat, lastLon, lon };
-			topLevelTiles_.push_back(CreateTile( tileSector, 0 ));
+			m_RootNodes.push_back(CreateNode( tileSector, 0 ));
 			lastLon = lon;
 		}
 		lastLat = lat;
 	}
 }
 
-void GIS::RectangularTessellator::SelectVisibleTiles(const RectTileTessellateParams & params, std::shared_ptr<RectTile> tile)
+auto GIS::RectangularTessellator::CreateNode(const Sector & sector, int level) -> std::unique_ptr<QuadNode>
+{
+	auto node = std::make_unique<QuadNode>();
+	node->tile = CreateTile(sector, level);
+	node->canSplit = node->tile->GetLevelNumber() < m_MaxLevel && !AtBestResolution(*node->tile);
+	return node;
+}
+
+void GIS::RectangularTessellator::SelectVisibleTiles(const RectTileTessellateParams & params, QuadNode & node)
 {
-	if (params.frustum.IsInsideFast(tile->GetBBox())) 
+	++m_SelectionStatistics.visitedNodes;
+	if (!params.frustum.IsInsideFast(node.tile->GetBBox()))
 	{
-		if( tile->GetLevelNumber() < m_MaxLevel && !AtBestResolution(*tile) && NeedToSplit(params, *tile))
-		{
+		// Culled subtrees are released, so their vertex data can be evicted
+		Collapse(node);
+		return;
+	}
+	if (!NeedToSplit(params, node))
+	{
+		for (auto & child : node.children)
+			Collapse(*child);
+		node.children.clear();
+		SelectTile(node);
+		return;
+	}
+	Deselect(node);
+	if (node.children.empty())
+	{
+		for (auto & sector : node.tile->GetSector().Subdivide())
+			node.children.push_back(CreateNode(sector, node.tile->GetLevelNumber() + 1));
+	}
+	for (auto & child : node.children)
+		SelectVisibleTiles(params, *child);
+}
 
-			for (auto sector : tile->GetSector().Subdivide())
-			{
-				auto subTile = CreateTile(sector, tile->GetLevelNumber() + 1);
-				SelectVisibleTiles(params, subTile);
-			}
-		}
-		else {
-			currentTiles_.push_back(tile);
-		}
+void GIS::RectangularTessellator::SelectTile(QuadNode & node)
+{
+	currentTiles_.push_back(node.tile);
+	if (!node.selected)
+	{
+		node.selected = true;
+		m_TileDelta.added.push_back(node.tile);
 	}
 }
 
+void GIS::RectangularTessellator::Deselect(QuadNode & node)
+{
+	if (node.selected)
+	{
+		node.selected = false;
+		m_TileDelta.removed.push_back(node.tile);
+	}
+}
+
+void GIS::RectangularTessellator::Collapse(QuadNode & node)
+{
+	Deselect(node);
+	for (auto & child : node.children)
+		Collapse(*child);
+	node.children.clear();
+}
+
+bool GIS::RectangularTessellator::IsCameraChanged(const RectTileTessellateParams & params) const
+{
+	if (params.eyePosition != m_LastParams.eyePosition || params.fov != m_LastParams.fov)
+		return true;
+	for (unsigned i = 0; i < Urho3D::NUM_FRUSTUM_VERTICES; ++i)
+	{
+		if (params.frustum.vertices_[i] != m_LastParams.frustum.vertices_[i])
+			return true;
+	}
+	return false;
+}
+
 bool GIS::RectangularTessellator::AtBestResolution(const RectTile & rectTile)
 {
 	auto bestResolution = global_.GetElevationModel().GetBestResolution();
@@ -95,19 +248,38 @@ bool GIS::RectangularTessellator::AtBestResolution(const RectTile & rectTile)
 	return bestResolution >= cellSize;
 }
 
-bool GIS::RectangularTessellator::NeedToSplit(const RectTileTessellateParams & param, const RectTile & tile)
+bool GIS::RectangularTessellator::NeedToSplit(const RectTileTessellateParams & param, QuadNode & node)
 {
-	double cellSizeRadians = tile.GetCellSize();
-	double cellSizeMeters = global_.GetRadius() * cellSizeRadians;
-	double detailScale = pow(10, -(0.3f + 1.0f));
-	double fovScale = std::clamp(tanf(param.fov / 2) / tanf(PI / 8), 0.0f, 1.0f);
-	auto tileCenter = tile.GetRefCenter();
+	if (!node.canSplit)
+		return false;
+	// The eye distance to the tile center changes at most by the distance the eye moved, so the decision
+	// holds until the eye moved as far as the tile was from the split distance
+	if (node.splitMargin >= 0 && node.evaluatedFov == param.fov &&
+		(param.eyePosition - node.evaluatedEye).Length() < node.splitMargin)
+		return node.split;
+
+	++m_SelectionStatistics.splitEvaluations;
+	auto tileCenter = node.tile->GetRefCenter();
 	Urho3D::Vector3 tileCenterf;
 	tileCenterf.x_ = tileCenter.x;
 	tileCenterf.y_ = tileCenter.y;
 	tileCenterf.z_ = tileCenter.z;
-	double scaledDistance = tileCenterf.DistanceToPoint(param.eyePosition) * fovScale * detailScale;
-	return cellSizeMeters > scaledDistance;
+	double distance = tileCenterf.DistanceToPoint(param.eyePosition);
+	double splitDistance = ComputeSplitDistance(param, *node.tile);
+	node.split = distance < splitDistance;
+	node.splitMargin = static_cast<float>(std::abs(distance - splitDistance));
+	node.evaluatedEye = param.eyePosition;
+	node.evaluatedFov = param.fov;
+	return node.split;
+}
+
+double GIS::RectangularTessellator::ComputeSplitDistance(const RectTileTessellateParams & param, const RectTile & tile) const
+{
+	double cellSizeRadians = tile.GetCellSize();
+	double cellSizeMeters = global_.GetRadius() * cellSizeRadians;
+	double detailScale = pow(10, -(0.3f + 1.0f));
+	double fovScale = std::clamp(tanf(param.fov / 2) / tanf(PI / 8), 0.0f, 1.0f);
+	return cellSizeMeters / (fovScale * detailScale);
 }
 
 /**
@@ -116,12 +288,16 @@ bool GIS::RectangularTessellator::NeedToSplit(const RectTileTessellateParams & p
 auto GIS::RectangularTessellator::CreateTile(const Sector & sector, int level) -> std::shared_ptr<RectTile> 
 {
 	auto tile = std::make_shared<RectTile>(sector, level, density_, BBox {} );
-	if (auto iter = m_BBoxMap.find(sector); iter != m_BBoxMap.end()) {
-		tile->SetBoundingBox(iter->second);
+	if (auto bbox = m_BBoxMap.Get(SectorKey{ sector })) {
+		tile->SetBoundingBox(*bbox);
 	}
-	else {
+	else if (level == 0) {
+		// Top level sectors are too large for the extreme elevation box to enclose their curvature
 		CheckVertexData( *tile );
-		m_BBoxMap[SectorKey{ sector }] = tile->GetBBox();
+	}
+	else {
+		// Bound the sector by its extreme elevations for culling, the exact box comes with its vertex data
+		tile->SetBoundingBox(global_.ComputeBoundingBox(verticalExaggeration_, sector));
 	}
 	auto centroid = sector.GetCentroid();
 	auto refCenter = global_.ComputePointFromPosition(centroid.GetLatitude(), centroid.GetLongitude(), 0);
@@ -129,138 +305,224 @@ auto GIS::RectangularTessellator::CreateTile(const Sector & sector, int level) -
 	return tile;
 }
 
-void GIS::RectangularTessellator::CheckVertexData(RectTile & tile) 
+bool GIS::RectangularTessellator::IsVertexDataStale(RectTile & tile)
 {
 	if (tile.GetRenderInfo() == nullptr) 
 	{
 		RenderInfo::Key key{ tile.GetDensity(), tile.GetSector() };
-		auto result = m_RenderInfoMap.find(key);
-		if (result == m_RenderInfoMap.end()) {
-			CreateTileVertexData(tile);
+		if (auto renderInfo = m_RenderInfoMap.Get(key)) {
+			tile.SetRenderInfo(renderInfo);
 		}
 		else {
-			tile.SetRenderInfo(result->second);
+			return true;
 		}
 	}
+
+	// Vertices built from coarser levels are rebuilt once one of their missing elevation tiles arrived,
+	// until then the requests of the missing tiles are kept alive. The residency is only checked again
+	// after tiles were added, and tiles of other sectors do not trigger a rebuild
+	auto & renderInfo = *tile.GetRenderInfo();
+	if (!renderInfo.IsProvisional())
+		return false;
+	auto & elevationModel = global_.GetElevationModel();
+	if (renderInfo.GetElevationGeneration() != elevationModel.GetTileGeneration())
+	{
+		if (elevationModel.IsAnyTileResident(renderInfo.GetMissingTiles()))
+			return true;
+		renderInfo.SetElevationGeneration(elevationModel.GetTileGeneration());
+	}
+	elevationModel.RequestTiles(renderInfo.GetMissingTiles());
+	return false;
+}
+
+void GIS::RectangularTessellator::CheckVertexData(RectTile & tile) 
+{
+	if (IsVertexDataStale(tile))
+		CreateTileVertexData({ &tile });
 }
 
 /**
  * RectTileĶ
  */
-void GIS::RectangularTessellator::CreateTileVertexData(RectTile & tile) 
+void GIS::RectangularTessellator::CreateTileVertexData(const std::vector<RectTile*> & tiles) 
 {
+	std::vector<VertexDataJob> jobs(tiles.size());
+	for (size_t i = 0; i < tiles.size(); ++i)
+		jobs[i].tile = tiles[i];
+	BuildVertexData(jobs);
 
-	int density = tile.GetDensity();
-
-	int numVertices = (density + 3) * (density + 3);
-
-	std::vector<Point3> verts;
-	verts.reserve(numVertices);
-	std::vector<Point3> norms;
-	norms.reserve(numVertices);
-
-	auto tileLocations = ComputeLocation( tile );
-
-	auto elevationData = global_.GetElevationModel().GetElevations(tile.GetSector(), tileLocations, tile.GetResolution(), true);
-
-	auto centroid = tile.GetSector().GetCentroid();
-	auto refCenter = global_.ComputePointFromPosition(centroid.GetLatitude(), centroid.GetLongitude(), 0);
-
-	int ie = 0;
-	int iv = 0;
-	auto latlonIter = tileLocations.begin();
-	BBox bbox;
-	for (int j = 0; j <= density + 2; ++j) 
+	for (auto & job : jobs)
 	{
-		for (int i = 0; i <= density + 2; ++i)
+		auto & tile = *job.tile;
+		auto & ri = job.renderInfo;
+		if (auto fr = ms_IndicesMap.find(tile.GetDensity()); fr != ms_IndicesMap.end())
 		{
-			const auto & latlon = *latlonIter;
-			float elevation = elevationData[ie++];
-			if (j == 0 || i == 0 || i == density + 2 || j == density + 2)
-			elevation = 0;
-			auto p = global_.ComputePointFromPosition(latlon.GetLatitude(), latlon.GetLongitude(), elevation );
-			Urho3D::Vector3 pos;
-			pos.x_ = p.x;
-			pos.y_ = p.y;
-			pos.z_ = p.z;
-			bbox.Merge(pos);
-			verts.push_back(pos);
-			latlonIter++;
-			norms.push_back( pos.Normalized() );
+			ri->SetIndices(fr->second);
 		}
+		else 
+		{
+			std::shared_ptr<std::vector<uint32_t>> mem { new std::vector<uint32_t>( ComputeIndices( tile.GetDensity() ) ) };
+			ri->SetIndices(mem);
+			ms_IndicesMap[tile.GetDensity()] = mem;
+		}
+
+		if (auto fr = ms_TexCoordsMap.find(tile.GetDensity()); fr != ms_TexCoordsMap.end())
+		{
+			ri->SetTexCoords(fr->second);
+		}
+		else 
+		{
+			auto mem = std::make_shared<std::vector<Urho3D::Vector2>>(ComputeTextureTexCoords(tile.GetDensity()));
+			ri->SetTexCoords(mem);
+			ms_TexCoordsMap[tile.GetDensity()] = mem;
+		}
+		tile.SetRenderInfo(ri);
+		tile.SetRefCenter(job.refCenter);
+		m_RenderInfoMap.Put(RenderInfo::Key{ tile.GetDensity(), tile.GetSector() }, ri, ri->GetSizeInBytes());
+		m_BBoxMap.Put(SectorKey{ tile.GetSector() }, std::make_shared<BBox>(ri->GetBBox()), BBOX_ENTRY_SIZE);
 	}
-	
-	std::shared_ptr<RenderInfo> ri{ new RenderInfo { tile.GetSector(), tile.GetDensity() } };
-	ri->SetVertices(std::move(verts));
-	ri->SetNormals(std::move(norms));
-	tile.SetBoundingBox(bbox);
-	ri->SetBBox(bbox);
-	m_RenderInfoMap[RenderInfo::Key{ tile.GetDensity(), tile.GetSector() }] = ri;
-	if (auto fr = ms_IndicesMap.find(tile.GetDensity()); fr != ms_IndicesMap.end())
-	{
-		ri->SetIndices(fr->second);
-	}
-	else 
+}
+
+void GIS::RectangularTessellator::BuildVertexData(std::vector<VertexDataJob> & jobs, bool requestMissing)
+{
+	// The elevation lookups request tiles and touch the caches, they stay on this thread
+	auto & elevationModel = global_.GetElevationModel();
+	for (auto & job : jobs)
 	{
-		std::shared_ptr<std::vector<uint32_t>> mem { new std::vector<uint32_t>( ComputeIndices( tile.GetDensity() ) ) };
-		ri->SetIndices(mem);
-		ms_IndicesMap[tile.GetDensity()] = mem;
+		job.elevationGeneration = elevationModel.GetTileGeneration();
+		job.elevations = elevationModel.GetElevations(job.tile->GetSector(), job.tile->GetResolution(), requestMissing);
 	}
 
-	if (auto fr = ms_TexCoordsMap.find(tile.GetDensity()); fr != ms_TexCoordsMap.end())
+	unsigned numThreads = m_WorkQueue ? m_WorkQueue->GetNumThreads() : 0;
+	if (!numThreads || jobs.size() < 2)
 	{
-		ri->SetTexCoords(fr->second);
+		for (auto & job : jobs)
+			BuildVertexData(job);
+		return;
 	}
-	else 
+
+	// A few items per thread even out tiles of different cost, the main thread helps in Complete()
+	size_t numItems = std::min(jobs.size(), static_cast<size_t>(numThreads + 1) * 4);
+	size_t jobsPerItem = (jobs.size() + numItems - 1) / numItems;
+	for (size_t start = 0; start < jobs.size(); start += jobsPerItem)
 	{
-		auto mem = std::make_shared<std::vector<Urho3D::Vector2>>(ComputeTextureTexCoords(tile.GetDensity()));
-		ri->SetTexCoords(mem);
-		ms_TexCoordsMap[tile.GetDensity()] = mem;
+		auto item = m_WorkQueue->GetFreeItem();
+		item->priority_ = Urho3D::M_MAX_UNSIGNED;
+		item->workFunction_ = BuildVertexDataWork;
+		item->aux_ = this;
+		item->start_ = jobs.data() + start;
+		item->end_ = jobs.data() + std::min(start + jobsPerItem, jobs.size());
+		m_WorkQueue->AddWorkItem(item);
 	}
-	tile.SetRenderInfo(ri);
-	tile.SetRefCenter(refCenter);
+	m_WorkQueue->Complete(Urho3D::M_MAX_UNSIGNED);
 }
 
-std::vector<GIS::LatLon> GIS::RectangularTessellator::ComputeLocation(const RectTile & rectTile)
+void GIS::RectangularTessellator::BuildVertexDataWork(const Urho3D::WorkItem * item, unsigned threadIndex)
 {
-	std::vector<LatLon> latlons;
-	int density = rectTile.GetDensity();
-	int numVertices = (density + 3) * (density + 3);
-	latlons.reserve(numVertices);
+	auto tessellator = static_cast<const RectangularTessellator*>(item->aux_);
+	auto start = static_cast<VertexDataJob*>(item->start_);
+	auto end = static_cast<VertexDataJob*>(item->end_);
+	for (auto job = start; job != end; ++job)
+		tessellator->BuildVertexData(*job);
+}
 
-	Angle latMax = rectTile.GetSector().GetMaxLatitude();
-	Angle dLat = rectTile.GetSector().GetDeltaLat() / density;
-	Angle lat = rectTile.GetSector().GetMinLatitude();
+void GIS::RectangularTessellator::BuildVertexData(VertexDataJob & job) const
+{
+	auto & tile = *job.tile;
+	int density = tile.GetDensity();
+	int gridSize = density + 3;
 
-	Angle lonMin = rectTile.GetSector().GetMinLongitude();
-	Angle lonMax = rectTile.GetSector().GetMaxLongitude();
-	Angle dLon = rectTile.GetSector().GetDeltaLon() / density;
+	std::vector<Angle> latitudes, longitudes;
+	ComputeGridAngles(tile.GetSector(), density, latitudes, longitudes);
 
-	
-	for (int j = 0; j <= density + 2; j++)
+	// Every row shares the longitudes, so their trigonometry is done once per tile
+	std::vector<double> sinLongitudes(gridSize), cosLongitudes(gridSize);
+	for (int i = 0; i < gridSize; ++i)
 	{
-		Angle lon = lonMin;
-		for (int i = 0; i <= density + 2; i++)
-		{
-			latlons.push_back(LatLon(lat, lon));
+		sinLongitudes[i] = sin(longitudes[i].GetRadians());
+		cosLongitudes[i] = cos(longitudes[i].GetRadians());
+	}
 
-			if (i > density)
-				lon = lonMax;
-			else if (i != 0)
-				lon = lon + (dLon);
+	auto & elevationModel = global_.GetElevationModel();
+	float missingSignal = elevationModel.GetMissingDataSignal();
+	float missingReplacement = elevationModel.GetMissingDataReplacement();
 
-			if (lon.GetDegrees() < -180)
-				lon = Angle::FromDegrees(-180);
-			else if (lon.GetDegrees() > 180)
-				lon = Angle::FromDegrees(180);
+	std::vector<Point3> verts(gridSize * gridSize);
+	std::vector<float> elevations(gridSize, 0.0f);
+	for (int j = 0; j < gridSize; ++j)
+	{
+		// The outer rows and columns are the skirt, it stays at elevation zero
+		if (j != 0 && j != gridSize - 1)
+		{
+			job.elevations->GetElevationRow(latitudes[j], longitudes.data() + 1, gridSize - 2, elevations.data() + 1);
+			for (int i = 1; i < gridSize - 1; ++i)
+			{
+				if (elevations[i] == missingSignal)
+					elevations[i] = missingReplacement;
+			}
+		}
+		else
+		{
+			std::fill(elevations.begin(), elevations.end(), 0.0f);
 		}
+		global_.ComputePointsFromRow(latitudes[j], sinLongitudes.data(), cosLongitudes.data(), elevations.data(), gridSize,
+			verts.data() + j * gridSize);
+	}
+
+	std::vector<Point3> norms(verts.size());
+	for (size_t i = 0; i < verts.size(); ++i)
+		norms[i] = verts[i].Normalized();
+	BBox bbox;
+	bbox.Merge(verts.data(), static_cast<unsigned>(verts.size()));
+
+	auto centroid = tile.GetSector().GetCentroid();
+	job.refCenter = global_.ComputePointFromPosition(centroid.GetLatitude(), centroid.GetLongitude(), 0);
+
+	job.renderInfo = std::make_shared<RenderInfo>(tile.GetSector(), density);
+	job.renderInfo->SetVertices(std::move(verts));
+	job.renderInfo->SetNormals(std::move(norms));
+	job.renderInfo->SetBBox(bbox);
+	job.renderInfo->SetMissingTiles(std::vector<TileKey>(job.elevations->GetMissingTiles()), job.elevationGeneration);
+}
 
+void GIS::RectangularTessellator::ComputeGridAngles(const Sector & sector, int density, std::vector<Angle> & latitudes, std::vector<Angle> & longitudes)
+{
+	latitudes.clear();
+	longitudes.clear();
+	latitudes.reserve(density + 3);
+	longitudes.reserve(density + 3);
+
+	// The first and last row and column repeat the border, for the skirt
+	Angle latMax = sector.GetMaxLatitude();
+	Angle dLat = sector.GetDeltaLat() / density;
+	Angle lat = sector.GetMinLatitude();
+	for (int j = 0; j <= density + 2; j++)
+	{
+		latitudes.push_back(lat);
 		if (j > density)
 			lat = latMax;
 		else if (j != 0)
 			lat = lat + dLat;
 	}
-	return latlons;
+
+	Angle lonMin = sector.GetMinLongitude();
+	Angle lonMax = sector.GetMaxLongitude();
+	Angle dLon = sector.GetDeltaLon() / density;
+	Angle lon = lonMin;
+	for (int i = 0; i <= density + 2; i++)
+	{
+		longitudes.push_back(lon);
+
+		if (i > density)
+			lon = lonMax;
+		else if (i != 0)
+			lon = lon + (dLon);
+
+		if (lon.GetDegrees() < -180)
+			lon = Angle::FromDegrees(-180);
+		else if (lon.GetDegrees() > 180)
+			lon = Angle::FromDegrees(180);
+	}
 }
 
 std::vector<Urho3D::Vector2> GIS::RectangularTessellator::ComputeTextureTexCoords(int density)
@@ -6,11 +6,20 @@
 #include "LevelSet.h"
 #include "Global.h"
 #include "HashCombine.h"
+#include "MemoryCache.h"
+#include "BasicElevationModel.h"
 #include "Urho3D/Math/Frustum.h"
 #include <Urho3D/Math/BoundingBox.h>
 #include <vector>
 #include <memory>
 
+namespace Urho3D
+{
+	class WorkQueue;
+
+	struct WorkItem;
+}
+
 namespace GIS 
 {
 
@@ -146,6 +155,51 @@ namespace GIS
 				return m_BBox;
 			}
 
+			/**
+			 * Bytes owned by this RenderInfo, the shared indices and texture coordinates are not counted
+			 */
+			size_t GetSizeInBytes() const noexcept
+			{
+				return sizeof(*this) + (m_Vertices.capacity() + m_Normals.capacity()) * sizeof(Point3) +
+					m_MissingTiles.capacity() * sizeof(TileKey);
+			}
+
+			/**
+			 * Set the elevation tiles that were not resident when the vertices were built, and the
+			 * tile generation of the elevation model at that time
+			 */
+			void SetMissingTiles(std::vector<TileKey> && missingTiles, uint64_t elevationGeneration)
+			{
+				m_MissingTiles = std::move(missingTiles);
+				m_ElevationGeneration = elevationGeneration;
+			}
+
+			const std::vector<TileKey> & GetMissingTiles() const noexcept
+			{
+				return m_MissingTiles;
+			}
+
+			uint64_t GetElevationGeneration() const noexcept
+			{
+				return m_ElevationGeneration;
+			}
+
+			/**
+			 * Record that the missing tiles were checked at 'elevationGeneration' and are still missing
+			 */
+			void SetElevationGeneration(uint64_t elevationGeneration) noexcept
+			{
+				m_ElevationGeneration = elevationGeneration;
+			}
+
+			/**
+			 * Whether the vertices were built from coarser elevation levels and are to be refined
+			 */
+			bool IsProvisional() const noexcept
+			{
+				return !m_MissingTiles.empty();
+			}
+
 			Urho3D::Vector3 Interpolate(int row, int column, float xDec, float yDec) const;
 
 		private:
@@ -164,6 +218,10 @@ namespace GIS
 
 			BBox m_BBox;
 
+			std::vector<TileKey> m_MissingTiles;
+
+			uint64_t m_ElevationGeneration = 0;
+
 		};
 
 		class RectTile {
@@ -269,22 +327,188 @@ namespace GIS
 		 */
 		bool GetPointOnTerrain(const Angle & latitude, const Angle & longitude, Urho3D::Vector3 & point);
 
+		/**
+		 * Get the hit, miss and eviction counters of the per sector vertex data cache
+		 */
+		MemoryCacheStatistics GetRenderInfoCacheStatistics() const;
+
+		/**
+		 * Change of the selection made by the last Tessellate call
+		 */
+		struct TileDelta
+		{
+			std::vector<std::shared_ptr<RectTile>> added;
+
+			std::vector<std::shared_ptr<RectTile>> removed;
+
+			/**
+			 * Tiles selected before whose vertex data was rebuilt
+			 */
+			std::vector<std::shared_ptr<RectTile>> updated;
+
+			void Clear()
+			{
+				added.clear();
+				removed.clear();
+				updated.clear();
+			}
+		};
+
+		const TileDelta & GetTileDelta() const noexcept
+		{
+			return m_TileDelta;
+		}
+
+		struct SelectionStatistics
+		{
+			/**
+			 * Quadtree nodes visited by the last selection
+			 */
+			size_t visitedNodes = 0;
+
+			/**
+			 * Nodes whose split decision was computed again
+			 */
+			size_t splitEvaluations = 0;
+
+			/**
+			 * Whether the camera did not change and the selection was reused as a whole
+			 */
+			bool reused = false;
+		};
+
+		const SelectionStatistics & GetSelectionStatistics() const noexcept
+		{
+			return m_SelectionStatistics;
+		}
+
+		/**
+		 * Set the work queue vertex data of new tiles is built on, without one it is built on the calling thread
+		 */
+		void SetWorkQueue(Urho3D::WorkQueue * workQueue)
+		{
+			m_WorkQueue = workQueue;
+		}
+
+		struct VertexBenchmarkResult
+		{
+			int density;
+
+			size_t tileCount;
+
+			double seconds;
+
+			double tilesPerSecond;
+		};
+
+		/**
+		 * Build the vertex data of 'tileCount' tiles spread over the globe for every density, without caching it.
+		 * Only resident elevation tiles are used, so the benchmark does not queue tile loads
+		 * @return the throughput per density
+		 */
+		std::vector<VertexBenchmarkResult> BenchmarkVertexData(const std::vector<int> & densities, size_t tileCount);
+
 	private:
 
 		void CreateTopLevelTiles();
 
-		void SelectVisibleTiles(const RectTileTessellateParams & params, std::shared_ptr<RectTile> tile );
+		/**
+		 * Node of the tile quadtree kept between frames, children exist only while the node is split
+		 */
+		struct QuadNode
+		{
+			std::shared_ptr<RectTile> tile;
+
+			std::vector<std::unique_ptr<QuadNode>> children;
+
+			/**
+			 * Eye position and fov the split decision was made for
+			 */
+			Urho3D::Vector3 evaluatedEye;
+
+			float evaluatedFov = 0;
+
+			/**
+			 * Distance the eye may move before the split decision can change, negative until first evaluated
+			 */
+			float splitMargin = -1;
+
+			bool canSplit = false;
+
+			bool split = false;
+
+			/**
+			 * Whether the tile was part of the last selection
+			 */
+			bool selected = false;
+		};
+
+		std::unique_ptr<QuadNode> CreateNode(const Sector & sector, int level);
+
+		/**
+		 * Update the split state of the visible part of the quadtree, recording the tiles that enter and leave the selection
+		 */
+		void SelectVisibleTiles(const RectTileTessellateParams & params, QuadNode & node);
+
+		void SelectTile(QuadNode & node);
+
+		/**
+		 * Remove the tiles of the subtree from the selection and release its children
+		 */
+		void Collapse(QuadNode & node);
+
+		void Deselect(QuadNode & node);
+
+		/**
+		 * Whether the camera differs from the one of the last selection
+		 */
+		bool IsCameraChanged(const RectTileTessellateParams & params) const;
 
 		std::shared_ptr<RectTile> CreateTile(const Sector & sector, int level);
 
+		/**
+		 * Vertex data of one tile, built on any thread
+		 */
+		struct VertexDataJob
+		{
+			RectTile * tile = nullptr;
+
+			BasicElevationModel::ElevationsPtr elevations;
+
+			uint64_t elevationGeneration = 0;
+
+			std::shared_ptr<RenderInfo> renderInfo;
+
+			Global::Vector4D refCenter;
+		};
+
+		/**
+		 * Attach cached vertex data to 'tile' if there is any, return whether it has to be built
+		 */
+		bool IsVertexDataStale( RectTile & tile );
+
 		void CheckVertexData( RectTile & tile );
 
-		void CreateTileVertexData(RectTile & tile);
+		/**
+		 * Build the vertex data of 'tiles' in parallel and publish it to the tiles and the caches
+		 */
+		void CreateTileVertexData(const std::vector<RectTile*> & tiles);
+
+		/**
+		 * Look up the elevations of the jobs, then build their vertex data on the work queue
+		 * @param[in] requestMissing whether elevation tiles that are not resident are requested
+		 */
+		void BuildVertexData(std::vector<VertexDataJob> & jobs, bool requestMissing = true);
+
+		void BuildVertexData(VertexDataJob & job) const;
+
+		static void BuildVertexDataWork(const Urho3D::WorkItem * item, unsigned threadIndex);
 
 		/**
 		 * 㵱ǰRectTileжӦľγ
+		 * The grid is the product of the row latitudes and column longitudes
 		 */
-		std::vector<LatLon> ComputeLocation(const RectTile & rectTile);
+		static void ComputeGridAngles(const Sector & sector, int density, std::vector<Angle> & latitudes, std::vector<Angle> & longitudes);
 
 		/**
 		 * RectTile
@@ -310,13 +534,32 @@ namespace GIS
 		/**
 		 * ݾжϵǰTileǷҪϸ
 		 */
-		bool NeedToSplit(const RectTileTessellateParams & param, const RectTile & tile);
+		bool NeedToSplit(const RectTileTessellateParams & param, QuadNode & node);
+
+		/**
+		 * Eye distance below which a tile is split
+		 */
+		double ComputeSplitDistance(const RectTileTessellateParams & param, const RectTile & tile) const;
 
 	private:
 
 		std::vector<std::shared_ptr<RectTile>> currentTiles_;
 
-		std::vector<std::shared_ptr<RectTile>> topLevelTiles_;
+		std::vector<std::unique_ptr<QuadNode>> m_RootNodes;
+
+		TileDelta m_TileDelta;
+
+		SelectionStatistics m_SelectionStatistics;
+
+		/**
+		 * Camera of the last selection
+		 */
+		RectTileTessellateParams m_LastParams;
+
+		/**
+		 * Set when tile bounding boxes may have changed, the next selection is then not reused
+		 */
+		bool m_SelectionDirty = true;
 
 		uint32_t density_;
 
@@ -330,11 +573,16 @@ namespace GIS
 
 		Global & global_;
 
-		std::unordered_map<RenderInfo::Key, std::shared_ptr<RenderInfo>, RenderInfo::KeyHash> m_RenderInfoMap;
+		Urho3D::WorkQueue * m_WorkQueue = nullptr;
+
+		/**
+		 * Vertex data per sector, entries used by a live RectTile are not evicted
+		 */
+		MemoryCache<RenderInfo::Key, RenderInfo, RenderInfo::KeyHash> m_RenderInfoMap;
 
 		uint32_t m_MaxLevel = 0;
 
-		std::unordered_map<SectorKey, Urho3D::BoundingBox> m_BBoxMap;
+		MemoryCache<SectorKey, Urho3D::BoundingBox> m_BBoxMap;
 
 		static std::unordered_map<int, std::shared_ptr<std::vector<uint32_t>>> ms_IndicesMap;
 
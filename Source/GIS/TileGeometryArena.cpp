@@ -0,0 +1,215 @@
+#include "TileGeometryArena.h"
+#include "DrawableTile.h"
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/Scene/Node.h>
+#include <algorithm>
+
+namespace
+{
+
+	/**
+	 * Pages are kept within the range of 16 bit indices, unless a single slot exceeds it
+	 */
+	const uint32_t MAX_PAGE_VERTICES = 65536;
+
+	const uint32_t MAX_SLOTS_PER_PAGE = 1024;
+
+	/**
+	 * Position, normal and texture coordinate
+	 */
+	const uint32_t FLOATS_PER_VERTEX = 8;
+
+}
+
+GIS::TileGeometryArena::TileGeometryArena(Urho3D::Node * parent, int density, const std::vector<uint32_t> & indices)
+	: m_Parent( parent ), m_Density( density )
+{
+	m_VerticesPerSlot = (density + 3) * (density + 3);
+	m_IndicesPerSlot = static_cast<uint32_t>(indices.size()) + 2;
+	m_SlotsPerPage = std::clamp(MAX_PAGE_VERTICES / m_VerticesPerSlot, 1u, MAX_SLOTS_PER_PAGE);
+
+	// The strip of a slot has an even length, so the two joining indices keep the winding of the next slot
+	std::vector<uint32_t> pageIndices;
+	pageIndices.reserve(m_IndicesPerSlot * m_SlotsPerPage);
+	for (uint32_t slot = 0; slot < m_SlotsPerPage; ++slot)
+	{
+		uint32_t base = slot * m_VerticesPerSlot;
+		for (auto index : indices)
+			pageIndices.push_back(base + index);
+		bool isLast = slot + 1 == m_SlotsPerPage;
+		pageIndices.push_back(base + indices.back());
+		pageIndices.push_back(isLast ? base + indices.back() : base + m_VerticesPerSlot + indices.front());
+	}
+	m_IndexBuffer = new Urho3D::IndexBuffer{ parent->GetContext() };
+	m_IndexBuffer->SetShadowed(false);
+
+	// A slot of more than 65536 vertices gets a page of its own, which then needs 32 bit indices
+	if (m_SlotsPerPage * m_VerticesPerSlot > MAX_PAGE_VERTICES)
+	{
+		m_IndexBuffer->SetSize(static_cast<unsigned>(pageIndices.size()), true);
+		m_IndexBuffer->SetData(pageIndices.data());
+	}
+	else
+	{
+		std::vector<uint16_t> shortIndices(pageIndices.begin(), pageIndices.end());
+		m_IndexBuffer->SetSize(static_cast<unsigned>(shortIndices.size()), false);
+		m_IndexBuffer->SetData(shortIndices.data());
+	}
+}
+
+GIS::TileGeometryArena::~TileGeometryArena()
+{
+	for (auto & page : m_Pages)
+		page.node->Remove();
+}
+
+auto GIS::TileGeometryArena::Allocate() -> Slot
+{
+	for (uint32_t pageIndex = 0; pageIndex < m_Pages.size(); ++pageIndex)
+	{
+		auto & page = m_Pages[pageIndex];
+		if (page.usedCount == m_SlotsPerPage)
+			continue;
+		auto iter = std::find(page.used.begin(), page.used.end(), false);
+		uint32_t index = static_cast<uint32_t>(iter - page.used.begin());
+		page.used[index] = true;
+		++page.usedCount;
+		page.dirty = true;
+		return { pageIndex, index };
+	}
+	AddPage();
+	auto & page = m_Pages.back();
+	page.used[0] = true;
+	page.usedCount = 1;
+	page.dirty = true;
+	return { static_cast<uint32_t>(m_Pages.size() - 1), 0 };
+}
+
+void GIS::TileGeometryArena::Free(const Slot & slot)
+{
+	if (!slot.IsValid() || slot.page >= m_Pages.size())
+		return;
+	auto & page = m_Pages[slot.page];
+	if (!page.used[slot.index])
+		return;
+	page.used[slot.index] = false;
+	page.slotBounds[slot.index].Clear();
+	--page.usedCount;
+	page.dirty = true;
+}
+
+void GIS::TileGeometryArena::Upload(const Slot & slot, const RectangularTessellator::RenderInfo & renderInfo)
+{
+	auto & page = m_Pages[slot.page];
+	auto & vertices = renderInfo.GetVertices();
+	auto & normals = renderInfo.GetNormals();
+	auto & texCoords = renderInfo.GetTexCoords();
+	if (vertices.size() != m_VerticesPerSlot)
+		return;
+
+	m_UploadBuffer.resize(m_VerticesPerSlot * FLOATS_PER_VERTEX);
+	float * dest = m_UploadBuffer.data();
+	for (uint32_t i = 0; i < m_VerticesPerSlot; ++i)
+	{
+		*dest++ = vertices[i].x_;
+		*dest++ = vertices[i].y_;
+		*dest++ = vertices[i].z_;
+		*dest++ = normals[i].x_;
+		*dest++ = normals[i].y_;
+		*dest++ = normals[i].z_;
+		*dest++ = texCoords[i].x_;
+		*dest++ = texCoords[i].y_;
+	}
+	page.vertexBuffer->SetDataRange(m_UploadBuffer.data(), slot.index * m_VerticesPerSlot, m_VerticesPerSlot);
+	page.slotBounds[slot.index] = renderInfo.GetBBox();
+	page.dirty = true;
+}
+
+void GIS::TileGeometryArena::UpdateDrawables()
+{
+	for (auto & page : m_Pages)
+	{
+		if (page.dirty)
+			UpdateDrawable(page);
+	}
+}
+
+uint32_t GIS::TileGeometryArena::GetDrawCallCount() const noexcept
+{
+	uint32_t drawCalls = 0;
+	for (auto & page : m_Pages)
+		drawCalls += page.runCount;
+	return drawCalls;
+}
+
+void GIS::TileGeometryArena::AddPage()
+{
+	auto context = m_Parent->GetContext();
+	Page page;
+	page.vertexBuffer = new Urho3D::VertexBuffer{ context };
+	page.vertexBuffer->SetShadowed(false);
+	Urho3D::PODVector<Urho3D::VertexElement> elements;
+	elements.Push(Urho3D::VertexElement{ Urho3D::VertexElementType::TYPE_VECTOR3, Urho3D::VertexElementSemantic::SEM_POSITION });
+	elements.Push(Urho3D::VertexElement{ Urho3D::VertexElementType::TYPE_VECTOR3, Urho3D::VertexElementSemantic::SEM_NORMAL });
+	elements.Push(Urho3D::VertexElement{ Urho3D::VertexElementType::TYPE_VECTOR2, Urho3D::VertexElementSemantic::SEM_TEXCOORD });
+	page.vertexBuffer->SetSize(m_SlotsPerPage * m_VerticesPerSlot, elements);
+
+	page.node = m_Parent->CreateChild();
+	page.drawable = page.node->CreateComponent<DrawableTile>();
+	page.slotBounds.resize(m_SlotsPerPage);
+	page.used.resize(m_SlotsPerPage, false);
+	m_Pages.push_back(std::move(page));
+}
+
+void GIS::TileGeometryArena::UpdateDrawable(Page & page)
+{
+	page.dirty = false;
+
+	std::vector<Urho3D::Geometry*> runs;
+	Urho3D::BoundingBox bbox;
+	uint32_t slot = 0;
+	while (slot < m_SlotsPerPage)
+	{
+		if (!page.used[slot])
+		{
+			++slot;
+			continue;
+		}
+		uint32_t first = slot;
+		while (slot < m_SlotsPerPage && page.used[slot])
+		{
+			bbox.Merge(page.slotBounds[slot]);
+			++slot;
+		}
+		uint32_t count = slot - first;
+
+		if (runs.size() == page.geometries.size())
+		{
+			Urho3D::SharedPtr<Urho3D::Geometry> geometry{ new Urho3D::Geometry{ m_Parent->GetContext() } };
+			geometry->SetNumVertexBuffers(1);
+			geometry->SetVertexBuffer(0, page.vertexBuffer);
+			geometry->SetIndexBuffer(m_IndexBuffer);
+			page.geometries.push_back(geometry);
+		}
+		auto geometry = page.geometries[runs.size()].Get();
+		// The joining indices of the last slot of the run are not drawn
+		geometry->SetDrawRange(Urho3D::PrimitiveType::TRIANGLE_STRIP, first * m_IndicesPerSlot, count * m_IndicesPerSlot - 2,
+			first * m_VerticesPerSlot, count * m_VerticesPerSlot);
+		runs.push_back(geometry);
+	}
+
+	page.runCount = static_cast<uint32_t>(runs.size());
+	page.drawable->SetGeometries(runs);
+	if (runs.empty())
+	{
+		page.drawable->SetEnabled(false);
+	}
+	else
+	{
+		page.drawable->SetBoundingBox(bbox);
+		page.drawable->SetEnabled(true);
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "RectangularTessellator.h"
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <cstdint>
+#include <vector>
+
+namespace Urho3D
+{
+	class Geometry;
+
+	class IndexBuffer;
+
+	class Node;
+
+	class VertexBuffer;
+}
+
+namespace GIS
+{
+
+	class DrawableTile;
+
+	/**
+	 * Vertex and index storage of the terrain tiles of one density.
+	 * Tiles live in fixed size slots of a few large interleaved vertex buffers, the pages. All pages share one
+	 * index buffer in which the strip of every slot is joined to the next by degenerate triangles, so a run of
+	 * neighbouring used slots is drawn with a single call. Every page is drawn by one DrawableTile.
+	 * Pages use 16 bit indices, only densities whose slot alone exceeds that range hold one slot per page
+	 * with 32 bit indices.
+	 */
+	class TileGeometryArena
+	{
+	public:
+
+		struct Slot
+		{
+			uint32_t page = UINT32_MAX;
+
+			uint32_t index = 0;
+
+			bool IsValid() const noexcept
+			{
+				return page != UINT32_MAX;
+			}
+		};
+
+	public:
+
+		/**
+		 * @param[in] parent node the page nodes are created under
+		 * @param[in] density density of the tiles
+		 * @param[in] indices triangle strip of one tile
+		 */
+		TileGeometryArena(Urho3D::Node * parent, int density, const std::vector<uint32_t> & indices);
+
+		~TileGeometryArena();
+
+		TileGeometryArena(const TileGeometryArena &) = delete;
+
+		TileGeometryArena & operator =(const TileGeometryArena &) = delete;
+
+		/**
+		 * Take the lowest free slot, so used slots stay packed into few runs. Adds a page when all are full
+		 */
+		Slot Allocate();
+
+		void Free(const Slot & slot);
+
+		/**
+		 * Write the vertex data of a tile into its slot
+		 */
+		void Upload(const Slot & slot, const RectangularTessellator::RenderInfo & renderInfo);
+
+		/**
+		 * Update the draw ranges and bounding boxes of the pages whose slots changed
+		 */
+		void UpdateDrawables();
+
+		int GetDensity() const noexcept
+		{
+			return m_Density;
+		}
+
+		uint32_t GetSlotsPerPage() const noexcept
+		{
+			return m_SlotsPerPage;
+		}
+
+		uint32_t GetPageCount() const noexcept
+		{
+			return static_cast<uint32_t>(m_Pages.size());
+		}
+
+		/**
+		 * Get the amount of draw calls of all pages, one per run of used slots
+		 */
+		uint32_t GetDrawCallCount() const noexcept;
+
+	private:
+
+		struct Page
+		{
+			Urho3D::SharedPtr<Urho3D::VertexBuffer> vertexBuffer;
+
+			Urho3D::SharedPtr<Urho3D::Node> node;
+
+			DrawableTile * drawable = nullptr;
+
+			/**
+			 * One geometry per run of used slots, kept for reuse
+			 */
+			std::vector<Urho3D::SharedPtr<Urho3D::Geometry>> geometries;
+
+			std::vector<Urho3D::BoundingBox> slotBounds;
+
+			std::vector<bool> used;
+
+			uint32_t usedCount = 0;
+
+			uint32_t runCount = 0;
+
+			bool dirty = false;
+		};
+
+		void AddPage();
+
+		void UpdateDrawable(Page & page);
+
+	private:
+
+		Urho3D::Node * m_Parent;
+
+		int m_Density;
+
+		uint32_t m_VerticesPerSlot;
+
+		/**
+		 * Indices per slot, including the two that join it to the next slot
+		 */
+		uint32_t m_IndicesPerSlot;
+
+		uint32_t m_SlotsPerPage;
+
+		Urho3D::SharedPtr<Urho3D::IndexBuffer> m_IndexBuffer;
+
+		std::vector<Page> m_Pages;
+
+		std::vector<float> m_UploadBuffer;
+
+	};
+
+}
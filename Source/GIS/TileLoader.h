@@ -0,0 +1,254 @@
+#pragma once
+
+#include "TileKey.h"
+#include "LatLon.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace GIS
+{
+
+	/**
+	 * Loads tiles on a bounded pool of worker threads.
+	 * Queued requests are served coarsest level first, then nearest to the eye. Loaded tiles
+	 * are held until the owner collects them, so they can be published on the main thread.
+	 */
+	template <typename T>
+	class TileLoader
+	{
+	public:
+
+		using LoadFunction = std::function<std::shared_ptr<T>( const TileKey & )>;
+
+		using LoadedTile = std::pair<TileKey, std::shared_ptr<T>>;
+
+	public:
+
+		TileLoader( LoadFunction load, unsigned threadCount )
+			: load_( std::move( load ) )
+		{
+			threadCount = std::max( threadCount, 1u );
+			for (unsigned i = 0; i < threadCount; ++i)
+				threads_.emplace_back( [this]() { WorkerLoop(); } );
+		}
+
+		~TileLoader()
+		{
+			{
+				std::lock_guard<std::mutex> guard{ mutex_ };
+				stop_ = true;
+				queued_.clear();
+			}
+			wakeWorker_.notify_all();
+			for (auto & thread : threads_)
+				thread.join();
+		}
+
+		TileLoader( const TileLoader & ) = delete;
+
+		TileLoader & operator =( const TileLoader & ) = delete;
+
+		/**
+		 * Queue a tile, or renew a queued one for request pass 'pass'
+		 */
+		void Request( const TileKey & key, const LatLon & center, uint64_t pass )
+		{
+			{
+				std::lock_guard<std::mutex> guard{ mutex_ };
+				auto & request = queued_[key];
+				request.center_ = center;
+				request.pass_ = pass;
+			}
+			wakeWorker_.notify_one();
+		}
+
+		/**
+		 * Renew a request that is still queued for request pass 'pass'. Returns false when the tile
+		 * is not queued, e.g. it is loading already
+		 */
+		bool Renew( const TileKey & key, uint64_t pass )
+		{
+			std::lock_guard<std::mutex> guard{ mutex_ };
+			auto iter = queued_.find( key );
+			if (iter == queued_.end())
+				return false;
+			iter->second.pass_ = pass;
+			return true;
+		}
+
+		/**
+		 * Set the eye position queued requests are ordered by
+		 */
+		void SetEyePosition( const LatLon & eye )
+		{
+			std::lock_guard<std::mutex> guard{ mutex_ };
+			eye_ = eye;
+		}
+
+		/**
+		 * Drop the queued requests last renewed before request pass 'pass', loads already running
+		 * are finished. Returns the keys of the dropped requests
+		 */
+		std::vector<TileKey> CancelOlderThan( uint64_t pass )
+		{
+			std::vector<TileKey> cancelled;
+			{
+				std::lock_guard<std::mutex> guard{ mutex_ };
+				for (auto iter = queued_.begin(); iter != queued_.end(); )
+				{
+					if (iter->second.pass_ < pass)
+					{
+						cancelled.push_back( iter->first );
+						iter = queued_.erase( iter );
+					}
+					else
+						++iter;
+				}
+			}
+			idle_.notify_all();
+			return cancelled;
+		}
+
+		/**
+		 * Move the tiles loaded since the last call to 'loaded', a null tile means the load failed
+		 */
+		void TakeLoaded( std::vector<LoadedTile> & loaded )
+		{
+			std::lock_guard<std::mutex> guard{ mutex_ };
+			if (loaded.empty())
+				loaded.swap( loaded_ );
+			else
+			{
+				loaded.insert( loaded.end(), loaded_.begin(), loaded_.end() );
+				loaded_.clear();
+			}
+		}
+
+		/**
+		 * Block until the queue is empty and no load is running
+		 */
+		void WaitIdle()
+		{
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			idle_.wait( lock, [this]() { return queued_.empty() && !active_; } );
+		}
+
+		size_t GetQueuedCount() const
+		{
+			std::lock_guard<std::mutex> guard{ mutex_ };
+			return queued_.size();
+		}
+
+		size_t GetActiveCount() const
+		{
+			std::lock_guard<std::mutex> guard{ mutex_ };
+			return active_;
+		}
+
+	private:
+
+		struct PendingRequest
+		{
+			LatLon center_;
+
+			uint64_t pass_ = 0;
+		};
+
+		/**
+		 * Angular distance between two positions, in radians
+		 */
+		static double ComputeDistance( const LatLon & a, const LatLon & b ) noexcept
+		{
+			double lat1 = a.GetLatitude().GetRadians();
+			double lat2 = b.GetLatitude().GetRadians();
+			double dLon = b.GetLongitude().GetRadians() - a.GetLongitude().GetRadians();
+			double cosDistance = sin( lat1 ) * sin( lat2 ) + cos( lat1 ) * cos( lat2 ) * cos( dLon );
+			return acos( std::min( std::max( cosDistance, -1.0 ), 1.0 ) );
+		}
+
+		/**
+		 * Pick the most important queued request, the caller holds the lock
+		 */
+		typename std::unordered_map<TileKey, PendingRequest>::iterator PickNext()
+		{
+			auto best = queued_.end();
+			double bestDistance = 0;
+			for (auto iter = queued_.begin(); iter != queued_.end(); ++iter)
+			{
+				int level = iter->first.GetLevelNumber();
+				double distance = ComputeDistance( eye_, iter->second.center_ );
+				if (best == queued_.end() || level < best->first.GetLevelNumber() ||
+					(level == best->first.GetLevelNumber() && distance < bestDistance))
+				{
+					best = iter;
+					bestDistance = distance;
+				}
+			}
+			return best;
+		}
+
+		void WorkerLoop()
+		{
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			while (true)
+			{
+				wakeWorker_.wait( lock, [this]() { return stop_ || !queued_.empty(); } );
+				if (stop_)
+					return;
+
+				auto next = PickNext();
+				TileKey key = next->first;
+				queued_.erase( next );
+				++active_;
+
+				lock.unlock();
+				std::shared_ptr<T> tile;
+				try
+				{
+					tile = load_( key );
+				}
+				catch (...)
+				{
+					// A failed load is reported as a null tile, the worker keeps running
+				}
+				lock.lock();
+
+				loaded_.emplace_back( key, std::move( tile ) );
+				--active_;
+				if (queued_.empty() && !active_)
+					idle_.notify_all();
+			}
+		}
+
+	private:
+
+		LoadFunction load_;
+
+		std::vector<std::thread> threads_;
+
+		mutable std::mutex mutex_;
+
+		std::condition_variable wakeWorker_;
+
+		std::condition_variable idle_;
+
+		std::unordered_map<TileKey, PendingRequest> queued_;
+
+		std::vector<LoadedTile> loaded_;
+
+		LatLon eye_;
+
+		size_t active_ = 0;
+
+		bool stop_ = false;
+
+	};
+
+}
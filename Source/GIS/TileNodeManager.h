@@ -2,13 +2,11 @@
 
 #include "RectangularTessellator.h"
 #include "Global.h"
-#include "GeometryTile.h"
+#include "TileGeometryArena.h"
 #include <Urho3D/Scene/Node.h>
 #include <Urho3D/Scene/Scene.h>
-#include <Urho3D/Graphics/VertexBuffer.h>
-#include <Urho3D/Graphics/IndexBuffer.h>
 #include <Urho3D/Graphics/Camera.h>
-#include <queue>
+#include <memory>
 #include <unordered_map>
 
 namespace GIS 
@@ -20,8 +18,6 @@ namespace GIS
 
 	using Urho3D::SharedPtr;
 
-	using Urho3D::VertexBuffer;
-
 	using Urho3D::Camera;
 
 	class TileNodeManager 
@@ -34,25 +30,44 @@ namespace GIS
 		
 		void SetTessellateEnable(bool isEnable);
 
+		/**
+		 * Get the amount of draw calls the terrain tiles take
+		 */
+		uint32_t GetDrawCallCount() const noexcept;
+
 	private:
 
 		Global *m_Global;
 
 		Scene *m_Scene;
 
-		std::unordered_map<SectorKey, SharedPtr<Node>> m_NodesMap;
+		/**
+		 * Arena slot a tile is drawn from, and the vertex data written into it
+		 */
+		struct TileSlot
+		{
+			TileGeometryArena *arena = nullptr;
 
-		std::queue<SharedPtr<Node>> m_FreeNodes;
+			TileGeometryArena::Slot slot;
 
-		Node *m_CameraNode = nullptr;
+			std::shared_ptr<RectangularTessellator::RenderInfo> renderInfo;
+		};
 
-		Camera *m_Camera = nullptr;
+		/**
+		 * Slots of the selected tiles, kept up to date from the selection delta of the tessellator
+		 */
+		std::unordered_map<const RectangularTessellator::RectTile*, TileSlot> m_TileSlots;
 
-		SharedPtr<Urho3D::IndexBuffer> m_IndexBuffer;
+		/**
+		 * One arena per tile density
+		 */
+		std::unordered_map<int, std::unique_ptr<TileGeometryArena>> m_Arenas;
 
-		SharedPtr<Urho3D::VertexBuffer> m_TexCoordsBuffer;
+		Node *m_TileNode = nullptr;
 
-		uint32_t m_Density = 0;
+		Node *m_CameraNode = nullptr;
+
+		Camera *m_Camera = nullptr;
 
 		bool m_IsEnableTessellate = true;
 
@@ -0,0 +1,111 @@
+#include "ElevationConfig.h"
+#include "ElevationPyramid.h"
+#include "LevelSet.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * Packs the tile directories of an elevation model into one elevation pyramid.
+ * Usage: ElevationPyramidBuilder <config.xml> <output> [-lz4] [-model <directory>]
+ * The model directory defaults to the store path of the config.
+ */
+
+namespace
+{
+
+	namespace fs = std::filesystem;
+
+	/**
+	 * Parse a tile file name of the form <row>_<col><suffix>
+	 */
+	bool ParseTileName(const std::string & name, const std::string & suffix, int & row, int & col)
+	{
+		if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+			return false;
+		return std::sscanf(name.c_str(), "%d_%d", &row, &col) == 2;
+	}
+
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 3)
+	{
+		std::printf("Usage: ElevationPyramidBuilder <config.xml> <output> [-lz4] [-model <directory>]\n");
+		return 1;
+	}
+	GIS::ElevationConfig config{ argv[1] };
+	std::string modelPath;
+	config.GetValue(GIS::ConfigKey::MODEL_STORE_PATH, &modelPath);
+	bool compress = false;
+	for (int i = 3; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-lz4") == 0)
+			compress = true;
+		else if (std::strcmp(argv[i], "-model") == 0 && i + 1 < argc)
+			modelPath = argv[++i];
+	}
+	auto dataType = GIS::ElevationConfig::DataType::Int16;
+	config.GetValue(GIS::ConfigKey::DATA_TYPE, &dataType);
+	auto byteOrder = GIS::ElevationConfig::ByteOrder::LittleEndian;
+	config.GetValue(GIS::ConfigKey::BYTE_ORDER, &byteOrder);
+	std::optional<float> missingDataSignal;
+	if (float signal; config.GetValue(GIS::ConfigKey::MISSING_DATA_SIGNAL, &signal))
+		missingDataSignal = signal;
+	GIS::LevelSet levelSet{ config };
+
+	GIS::ElevationPyramidWriter writer{ compress, missingDataSignal };
+	if (!writer.Open(argv[2]))
+	{
+		std::printf("Could not open %s\n", argv[2]);
+		return 1;
+	}
+
+	size_t tileCount = 0;
+	size_t failedCount = 0;
+	std::vector<float> elevations;
+	for (uint32_t levelNumber = 0; levelNumber < levelSet.GetLevelCount(); ++levelNumber)
+	{
+		auto & level = levelSet.GetLevel(levelNumber);
+		fs::path levelPath = fs::path{ modelPath } / level.GetPath();
+		std::error_code error;
+		if (!fs::is_directory(levelPath, error))
+			continue;
+
+		size_t levelTileCount = 0;
+		for (auto & rowEntry : fs::directory_iterator{ levelPath, error })
+		{
+			if (!rowEntry.is_directory())
+				continue;
+			for (auto & tileEntry : fs::directory_iterator{ rowEntry.path(), error })
+			{
+				int row = 0;
+				int col = 0;
+				if (!tileEntry.is_regular_file() || !ParseTileName(tileEntry.path().filename().string(), level.GetFormatSuffix(), row, col))
+					continue;
+				if (!GIS::ReadRawElevationFile(tileEntry.path().string(), dataType, byteOrder, elevations) ||
+					!writer.AddTile(levelNumber, row, col, level.GetTileWidth(), level.GetTileHeight(), elevations))
+				{
+					std::printf("Skipped %s\n", tileEntry.path().string().c_str());
+					++failedCount;
+					continue;
+				}
+				++levelTileCount;
+			}
+		}
+		tileCount += levelTileCount;
+		std::printf("Level %u: %zu tiles\n", levelNumber, levelTileCount);
+	}
+
+	if (!writer.Finish())
+	{
+		std::printf("Could not write %s\n", argv[2]);
+		return 1;
+	}
+	std::printf("%zu tiles, %zu skipped, %.1f MB raw, %.1f MB stored\n", tileCount, failedCount,
+		writer.GetRawBytes() / 1048576.0, writer.GetStoredBytes() / 1048576.0);
+	return 0;
+}
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+
+// Drawables are scattered in a cube of this half size, the camera looks along +Z from its center
+static const float WORLD_HALF_SIZE = 1000.0f;
+static const unsigned NUM_ITERATIONS = 20;
+
+/// Frustum query opting in to the culling data cached by the octants.
+class CachedFrustumOctreeQuery : public FrustumOctreeQuery
+{
+public:
+    /// Construct with frustum.
+    CachedFrustumOctreeQuery(PODVector<Drawable*>& result, const Frustum& frustum) :
+        FrustumOctreeQuery(result, frustum)
+    {
+    }
+
+    /// Return whether the cached culling data is used.
+    bool IsCacheable() const override { return true; }
+};
+
+SharedPtr<Context> context_(new Context());
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+float TimeQuery(Octree* octree, OctreeQuery& query);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned drawableCount = 1000000;
+    if (arguments.Size())
+    {
+        if (arguments[0] == "-h" || arguments[0] == "--help")
+            ErrorExit(
+                "Usage: CullingBenchmark [drawable count]\n"
+                "\n"
+                "Times a single threaded frustum octree query on randomly placed static models, once with the\n"
+                "scalar per-drawable test and once with the cached culling data test. Default is 1000000 drawables.\n"
+            );
+        drawableCount = Max(ToUInt(arguments[0]), 1U);
+    }
+
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    context_->RegisterSubsystem(new WorkQueue(context_));
+    RegisterSceneLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+
+    // Only the bounding box of the model matters for culling
+    SharedPtr<Model> model(new Model(context_));
+    model->SetNumGeometries(1);
+    model->SetNumGeometryLodLevels(0, 1);
+    model->SetGeometry(0, 0, new Geometry(context_));
+    model->SetBoundingBox(BoundingBox(-1.0f, 1.0f));
+
+    SharedPtr<Scene> scene(new Scene(context_));
+    auto* octree = scene->CreateComponent<Octree>();
+    octree->SetSize(BoundingBox(-WORLD_HALF_SIZE, WORLD_HALF_SIZE), 8);
+    SetRandomSeed(1);
+    for (unsigned i = 0; i < drawableCount; ++i)
+    {
+        Node* node = scene->CreateChild();
+        node->SetPosition(Vector3(Random(-WORLD_HALF_SIZE, WORLD_HALF_SIZE), Random(-WORLD_HALF_SIZE, WORLD_HALF_SIZE),
+            Random(-WORLD_HALF_SIZE, WORLD_HALF_SIZE)));
+        node->CreateComponent<StaticModel>()->SetModel(model);
+    }
+
+    // Insert the drawables into their octants
+    FrameInfo frame;
+    octree->Update(frame);
+
+    Frustum frustum;
+    frustum.Define(60.0f, 16.0f / 9.0f, 1.0f, 0.1f, WORLD_HALF_SIZE, Matrix3x4::IDENTITY);
+
+    PODVector<Drawable*> scalarResult;
+    FrustumOctreeQuery scalarQuery(scalarResult, frustum);
+    const float scalar = TimeQuery(octree, scalarQuery);
+
+    PODVector<Drawable*> cachedResult;
+    CachedFrustumOctreeQuery cachedQuery(cachedResult, frustum);
+    const float cached = TimeQuery(octree, cachedQuery);
+
+    PrintLine("Drawables: " + String(drawableCount));
+    PrintLine("Visible: " + String(scalarResult.Size()) + " scalar, " + String(cachedResult.Size()) + " cached");
+#ifdef URHO3D_SSE
+    PrintLine("Cached test: SSE");
+#else
+    PrintLine("Cached test: scalar fallback");
+#endif
+    PrintLine("Scalar query: " + String(scalar) + " ms");
+    PrintLine("Cached query: " + String(cached) + " ms");
+    if (cached > 0.0f)
+        PrintLine("Speedup: " + String(scalar / cached));
+}
+
+float TimeQuery(Octree* octree, OctreeQuery& query)
+{
+    // Warm up once, then average
+    query.result_.Clear();
+    octree->GetDrawables(query);
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        query.result_.Clear();
+        octree->GetDrawables(query);
+    }
+    return timer.GetUSec(false) / 1000.0f / NUM_ITERATIONS;
+}
@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Effects/ModelEffectSet.h>
+#include <Urho3D/Graphics/Effects/ModelEffectUtil.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+
+// A building-like hierarchy: floors of rooms of elements, one static model per element
+static const unsigned ELEMENTS_PER_ROOM = 50;
+static const unsigned ROOMS_PER_FLOOR = 20;
+
+SharedPtr<Context> context_(new Context());
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+float GetMSec(HiresTimer& timer);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned drawableCount = 100000;
+    if (arguments.Size())
+    {
+        if (arguments[0] == "-h" || arguments[0] == "--help")
+            ErrorExit(
+                "Usage: ModelEffectBenchmark [drawable count]\n"
+                "\n"
+                "Times ModelEffectUtil::SetDiffuse and CancelDiffuse on a generated hierarchy of static models,\n"
+                "once through the node versions and once through a ModelEffectSet. Default is 100000 drawables.\n"
+            );
+        drawableCount = Max(ToUInt(arguments[0]), 1U);
+    }
+
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    RegisterSceneLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+
+    // One empty geometry is enough, the effects only touch the batches
+    SharedPtr<Model> model(new Model(context_));
+    model->SetNumGeometries(1);
+    model->SetNumGeometryLodLevels(0, 1);
+    model->SetGeometry(0, 0, new Geometry(context_));
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+
+    SharedPtr<Scene> scene(new Scene(context_));
+    Node* floor = nullptr;
+    Node* room = nullptr;
+    for (unsigned i = 0; i < drawableCount; ++i)
+    {
+        if (i % (ELEMENTS_PER_ROOM * ROOMS_PER_FLOOR) == 0)
+            floor = scene->CreateChild();
+        if (i % ELEMENTS_PER_ROOM == 0)
+            room = floor->CreateChild();
+        room->CreateChild()->CreateComponent<StaticModel>()->SetModel(model);
+    }
+
+    HiresTimer timer;
+    ModelEffectUtil::SetDiffuse(scene, Color::RED);
+    ModelEffectUtil::CancelDiffuse(scene);
+    const float nodeApplyRevert = GetMSec(timer);
+
+    ModelEffectSet set;
+    set.SetNode(scene);
+    const float collect = GetMSec(timer);
+    ModelEffectUtil::SetDiffuse(set, Color::RED);
+    const float setApply = GetMSec(timer);
+    ModelEffectUtil::CancelDiffuse(set);
+    const float setRevert = GetMSec(timer);
+
+    PrintLine("Drawables: " + String(drawableCount));
+    PrintLine("Node SetDiffuse + CancelDiffuse: " + String(nodeApplyRevert) + " ms");
+    PrintLine("ModelEffectSet collect: " + String(collect) + " ms");
+    PrintLine("ModelEffectSet SetDiffuse: " + String(setApply) + " ms");
+    PrintLine("ModelEffectSet CancelDiffuse: " + String(setRevert) + " ms");
+}
+
+float GetMSec(HiresTimer& timer)
+{
+    return timer.GetUSec(true) / 1000.0f;
+}
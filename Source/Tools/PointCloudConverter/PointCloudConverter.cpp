@@ -0,0 +1,1269 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Urho3D/PointCloud/AgPointCloudNormalUtils.h>
+#include <Urho3D/PointCloud/AgPointCloudOptions.h>
+#include <Urho3D/PointCloud/AgVoxelContainer.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+// PCVL stores 18 bit millimeter offsets from the container minimum
+static const double MAX_CONTAINER_SIZE = 262.143;
+static const unsigned MAX_CONTAINER_COORD = 0x3FFFF;
+// Input is read in blocks of this size, at most two blocks are in memory at once
+static const unsigned READ_BLOCK_SIZE = 32 * 1024 * 1024;
+// Points read back from a spill file at once when splitting a cell
+static const unsigned SPILL_BLOCK_POINTS = 1024 * 1024;
+// Grid resolution of LOD 0 inside a container, every further LOD doubles it
+static const unsigned LOD0_GRID_SIZE = 16;
+static const unsigned MAX_LOD_LEVELS = 24;
+// Octree depth below a root cell when splitting overfull cells
+static const unsigned MAX_SPLIT_DEPTH = 8;
+
+/// Point decoded from an input file, relative to the scan offset.
+struct InputPoint
+{
+    double x_;
+    double y_;
+    double z_;
+    /// Color as 0xRRGGBBAA, the byte order of the PCVL leaf node.
+    unsigned rgba_;
+    /// LIDAR classification.
+    unsigned classification_;
+};
+
+/// Point stored in a cell spill file, relative to the minimum of its root cell.
+struct SpillPoint
+{
+    float x_;
+    float y_;
+    float z_;
+    unsigned rgba_;
+    unsigned classification_;
+};
+
+/// Root cell of the binning grid and its spill file.
+struct Cell
+{
+    /// Grid coordinates.
+    int x_, y_, z_;
+    /// Points not yet written to the spill file.
+    std::vector<SpillPoint> buffer_;
+    /// Total amount of points binned into the cell.
+    unsigned long long numPoints_{};
+    /// Spill file name.
+    String fileName_;
+};
+
+/// Voxel container written by a cell task.
+struct ContainerInfo
+{
+    String name_;
+    Vector3 boundsMin_;
+    Vector3 boundsMax_;
+    unsigned numPoints_;
+    unsigned numLods_;
+};
+
+/// Cell processed on the work queue.
+struct CellTask
+{
+    const Cell* cell_;
+    /// Minimum of the root cell relative to the scan offset.
+    double min_[3];
+    /// Containers written, in octree order.
+    std::vector<ContainerInfo> containers_;
+    /// Error message if the task failed.
+    String error_;
+};
+
+/// Range of a ParallelFor call processed by one work item.
+struct ParallelRange
+{
+    const std::function<void(unsigned, unsigned)>* function_;
+    unsigned begin_;
+    unsigned end_;
+};
+
+/// Input file reader.
+class PointReader
+{
+public:
+    /// Destruct.
+    virtual ~PointReader() = default;
+    /// Open the file and read its header. Return false on failure.
+    virtual bool Open(const String& fileName) = 0;
+    /// Decode the next block of points relative to 'offset'. Return false at the end of the file.
+    virtual bool ReadBlock(const double* offset, std::vector<InputPoint>& points) = 0;
+    /// Return the bounds from the file header, false if the file has none.
+    virtual bool GetHeaderBounds(double* min, double* max) const { return false; }
+    /// Return the point count from the file header, 0 if the file has none.
+    virtual unsigned long long GetHeaderNumPoints() const { return 0; }
+    /// Return whether the points have colors.
+    virtual bool HasColors() const = 0;
+};
+
+SharedPtr<Context> context_(new Context());
+String outputDir_;
+String sceneName_;
+String resourcePrefix_;
+String tempDir_;
+double cellSize_ = 100.0;
+double normalRadius_ = 0.1;
+unsigned maxContainerPoints_ = 1000000;
+unsigned long long memoryBudget_ = 512ULL * 1024 * 1024;
+unsigned numThreads_ = 0;
+bool hasColors_ = false;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+PointReader* CreateReader(const String& fileName);
+void ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& function);
+void ComputeBounds(const Vector<String>& inputNames, double* min, double* max, unsigned long long& numPoints);
+void BinPoints(const Vector<String>& inputNames, const double* offset, const double* gridMin, HashMap<unsigned long long, Cell>& cells);
+void FlushCells(HashMap<unsigned long long, Cell>& cells);
+void ProcessCellWork(const WorkItem* item, unsigned threadIndex);
+bool ProcessCell(CellTask& task, const String& spillName, const String& name, const double* min, double size,
+    unsigned long long numPoints, unsigned depth);
+bool WriteContainer(CellTask& task, std::vector<SpillPoint>& points, const String& name, const double* min, double size);
+void EstimateNormals(const std::vector<SpillPoint>& points, const double* min, double size, std::vector<unsigned>& normalsOut);
+unsigned AssignLods(const std::vector<SpillPoint>& points, const double* min, double size, std::vector<unsigned char>& levelsOut);
+void WriteScene(const std::vector<CellTask>& tasks, const double* offset, const double* min, const double* max,
+    unsigned long long numPoints);
+String FormatRate(unsigned long long numPoints, long long usec);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    if (arguments.Size() < 2)
+        ErrorExit(
+            "Usage: PointCloudConverter <output scene> <input file> [input file ...] [options]\n"
+            "\n"
+            "Converts LAS and ASCII (xyz, pts, txt) point files to a voxel container scene\n"
+            "(json) plus one PCVL file per container LOD, written next to the scene.\n"
+            "Input files are streamed, so they may be larger than the available memory.\n"
+            "\n"
+            "Options:\n"
+            "-c<meters>  Maximum voxel container size, default 100, at most 262\n"
+            "-n<meters>  Neighbourhood size for the normal estimation, default 0.1\n"
+            "-p<points>  Maximum points per container, larger cells are split, default 1000000\n"
+            "-m<MB>      Memory used for binning buffers, default 512\n"
+            "-r<prefix>  Resource name prefix of the PCVL files, default is the scene name\n"
+            "-t<count>   Worker threads, default is one per logical CPU\n"
+        );
+
+    String outputName = arguments[0];
+    Vector<String> inputNames;
+    for (unsigned i = 1; i < arguments.Size(); ++i)
+    {
+        const String& argument = arguments[i];
+        if (argument.Length() < 2 || argument[0] != '-')
+        {
+            inputNames.Push(argument);
+            continue;
+        }
+
+        String value = argument.Substring(2);
+        switch (argument[1])
+        {
+        case 'c':
+            cellSize_ = Clamp(ToDouble(value), 1.0, MAX_CONTAINER_SIZE);
+            break;
+        case 'n':
+            normalRadius_ = Max(ToDouble(value), 0.001);
+            break;
+        case 'p':
+            maxContainerPoints_ = Max(ToUInt(value), 1000U);
+            break;
+        case 'm':
+            memoryBudget_ = Max(ToUInt(value), 16U) * 1024ULL * 1024ULL;
+            break;
+        case 'r':
+            resourcePrefix_ = value;
+            break;
+        case 't':
+            numThreads_ = ToUInt(value);
+            break;
+        default:
+            ErrorExit("Unrecognized option " + argument);
+        }
+    }
+    if (inputNames.Empty())
+        ErrorExit("No input files");
+
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    context_->RegisterSubsystem(new WorkQueue(context_));
+    RegisterSceneLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+
+    auto* queue = context_->GetSubsystem<WorkQueue>();
+    // The main thread takes part in WorkQueue::Complete(), so one thread less
+    const unsigned numCPUs = numThreads_ ? numThreads_ : GetNumLogicalCPUs();
+    if (numCPUs > 1)
+        queue->CreateThreads(numCPUs - 1);
+
+    auto* fileSystem = context_->GetSubsystem<FileSystem>();
+    outputName = GetInternalPath(outputName);
+    outputDir_ = GetPath(outputName);
+    sceneName_ = GetFileName(outputName);
+    if (resourcePrefix_.Empty())
+        resourcePrefix_ = sceneName_ + "/";
+    const String containerDir = outputDir_ + GetPath(resourcePrefix_);
+    tempDir_ = outputDir_ + sceneName_ + "_tmp/";
+    if (!fileSystem->CreateDir(containerDir) || !fileSystem->CreateDir(tempDir_))
+        ErrorExit("Could not create output directory " + containerDir);
+
+    // The table is built lazily, build it before the worker threads use it
+    AgPointCloudNormalUtils::indexForNormal(Vector3::UP);
+
+    HiresTimer totalTimer;
+
+    // Pass 1: bounds. LAS headers already hold them, ASCII files are scanned once
+    double min[3], max[3];
+    unsigned long long numPoints = 0;
+    {
+        HiresTimer timer;
+        ComputeBounds(inputNames, min, max, numPoints);
+        if (!numPoints)
+            ErrorExit("No points found in the input files");
+        PrintLine("Bounds of " + String(numPoints) + " points " + FormatRate(numPoints, timer.GetUSec(false)));
+    }
+
+    // Positions are stored relative to the bounds minimum, like the AssetImporter does with the scan translation
+    double offset[3] = { min[0], min[1], min[2] };
+    const double gridMin[3] = { 0.0, 0.0, 0.0 };
+
+    // Pass 2: bin the points into root cells, spilling to disk when the buffers are full
+    HashMap<unsigned long long, Cell> cells;
+    {
+        HiresTimer timer;
+        BinPoints(inputNames, offset, gridMin, cells);
+        PrintLine("Binned into " + String(cells.Size()) + " cells " + FormatRate(numPoints, timer.GetUSec(false)));
+    }
+
+    // Pass 3: split overfull cells, build LODs and normals, write the PCVL files. Every cell is an
+    // independent work item, tasks are kept in cell key order so the scene does not depend on timing
+    std::vector<CellTask> tasks;
+    {
+        HiresTimer timer;
+        Vector<unsigned long long> keys = cells.Keys();
+        Sort(keys.Begin(), keys.End());
+        tasks.resize(keys.Size());
+        for (unsigned i = 0; i < keys.Size(); ++i)
+        {
+            const Cell& cell = cells[keys[i]];
+            tasks[i].cell_ = &cell;
+            tasks[i].min_[0] = gridMin[0] + cell.x_ * cellSize_;
+            tasks[i].min_[1] = gridMin[1] + cell.y_ * cellSize_;
+            tasks[i].min_[2] = gridMin[2] + cell.z_ * cellSize_;
+        }
+
+        Vector<SharedPtr<WorkItem> > items;
+        for (auto& task : tasks)
+        {
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->priority_ = M_MAX_UNSIGNED;
+            item->workFunction_ = ProcessCellWork;
+            item->start_ = &task;
+            queue->AddWorkItem(item);
+        }
+        queue->Complete(M_MAX_UNSIGNED);
+
+        for (const auto& task : tasks)
+        {
+            if (!task.error_.Empty())
+                ErrorExit(task.error_);
+        }
+        PrintLine("Wrote voxel containers " + FormatRate(numPoints, timer.GetUSec(false)));
+    }
+
+    WriteScene(tasks, offset, min, max, numPoints);
+    fileSystem->Delete(tempDir_);
+
+    PrintLine("Converted " + String(numPoints) + " points " + FormatRate(numPoints, totalTimer.GetUSec(false)));
+}
+
+String FormatRate(unsigned long long numPoints, long long usec)
+{
+    const double seconds = Max((double)usec / 1000000.0, 0.000001);
+    return ToString("in %.2f s (%.0f points/sec)", seconds, (double)numPoints / seconds);
+}
+
+void ParallelRangeWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* range = reinterpret_cast<ParallelRange*>(item->start_);
+    (*range->function_)(range->begin_, range->end_);
+}
+
+void ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& function)
+{
+    if (!count)
+        return;
+
+    auto* queue = context_->GetSubsystem<WorkQueue>();
+    grain = Max(grain, 1U);
+    if (count <= grain)
+    {
+        function(0, count);
+        return;
+    }
+
+    std::vector<ParallelRange> ranges;
+    for (unsigned begin = 0; begin < count; begin += grain)
+    {
+        ParallelRange range;
+        range.function_ = &function;
+        range.begin_ = begin;
+        range.end_ = Min(begin + grain, count);
+        ranges.push_back(range);
+    }
+
+    for (auto& range : ranges)
+    {
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = ParallelRangeWork;
+        item->start_ = &range;
+        queue->AddWorkItem(item);
+    }
+    queue->Complete(M_MAX_UNSIGNED);
+}
+
+/// Return a grain that splits 'count' over all threads.
+static unsigned ThreadGrain(unsigned count)
+{
+    auto* queue = context_->GetSubsystem<WorkQueue>();
+    const unsigned numThreads = queue->GetNumThreads() + 1;
+    return Max((count + numThreads - 1) / numThreads, 1024U);
+}
+
+/// Open a file for binary stdio access, which is not limited to 4GB like File.
+static FILE* OpenStdFile(const String& fileName, const char* mode)
+{
+#ifdef _WIN32
+    return _wfopen(GetWideNativePath(fileName).CString(), WString(String(mode)).CString());
+#else
+    return fopen(GetNativePath(fileName).CString(), mode);
+#endif
+}
+
+/// LAS 1.0 - 1.4 reader.
+class LasReader : public PointReader
+{
+public:
+    ~LasReader() override
+    {
+        if (file_)
+            fclose(file_);
+    }
+
+    bool Open(const String& fileName) override
+    {
+        file_ = OpenStdFile(fileName, "rb");
+        if (!file_)
+            return false;
+
+        unsigned char header[375];
+        memset(header, 0, sizeof(header));
+        const size_t headerRead = fread(header, 1, sizeof(header), file_);
+        if (headerRead < 227 || memcmp(header, "LASF", 4) != 0)
+            return false;
+
+        const unsigned char versionMinor = header[25];
+        unsigned short headerSize;
+        unsigned pointDataOffset, legacyNumPoints;
+        memcpy(&headerSize, header + 94, sizeof(headerSize));
+        memcpy(&pointDataOffset, header + 96, sizeof(pointDataOffset));
+        format_ = header[104] & 0x3F;
+        memcpy(&recordLength_, header + 105, sizeof(recordLength_));
+        memcpy(&legacyNumPoints, header + 107, sizeof(legacyNumPoints));
+        memcpy(scale_, header + 131, sizeof(scale_));
+        memcpy(offset_, header + 155, sizeof(offset_));
+        double bounds[6];
+        memcpy(bounds, header + 179, sizeof(bounds));
+        max_[0] = bounds[0]; min_[0] = bounds[1];
+        max_[1] = bounds[2]; min_[1] = bounds[3];
+        max_[2] = bounds[4]; min_[2] = bounds[5];
+
+        numPoints_ = legacyNumPoints;
+        if (versionMinor >= 4 && headerSize >= 375 && headerRead >= 375)
+        {
+            unsigned long long numPoints;
+            memcpy(&numPoints, header + 247, sizeof(numPoints));
+            if (numPoints)
+                numPoints_ = numPoints;
+        }
+
+        // Offset of the classification and color fields depend on the point record format
+        classificationOffset_ = format_ >= 6 ? 16 : 15;
+        switch (format_)
+        {
+        case 2: colorOffset_ = 20; break;
+        case 3: case 5: colorOffset_ = 28; break;
+        case 7: case 8: case 10: colorOffset_ = 30; break;
+        default: colorOffset_ = 0; break;
+        }
+        if (recordLength_ < 20 || (colorOffset_ && recordLength_ < colorOffset_ + 6))
+            return false;
+
+        return fseek(file_, (long)pointDataOffset, SEEK_SET) == 0;
+    }
+
+    bool ReadBlock(const double* offset, std::vector<InputPoint>& points) override
+    {
+        points.clear();
+        if (!file_ || pointsRead_ >= numPoints_)
+            return false;
+
+        const unsigned long long blockPoints = Min((unsigned long long)(READ_BLOCK_SIZE / recordLength_), numPoints_ - pointsRead_);
+        buffer_.resize((size_t)blockPoints * recordLength_);
+        const size_t numRead = fread(buffer_.data(), recordLength_, (size_t)blockPoints, file_);
+        pointsRead_ += numRead;
+        if (!numRead)
+            return false;
+
+        // Fixed size records, so each thread decodes its own range in place
+        points.resize(numRead);
+        ParallelFor((unsigned)numRead, ThreadGrain((unsigned)numRead), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                const unsigned char* record = buffer_.data() + (size_t)i * recordLength_;
+                int coords[3];
+                memcpy(coords, record, sizeof(coords));
+                InputPoint& point = points[i];
+                point.x_ = coords[0] * scale_[0] + offset_[0] - offset[0];
+                point.y_ = coords[1] * scale_[1] + offset_[1] - offset[1];
+                point.z_ = coords[2] * scale_[2] + offset_[2] - offset[2];
+                point.classification_ = format_ >= 6 ? record[classificationOffset_] : (record[classificationOffset_] & 0x1F);
+
+                if (colorOffset_)
+                {
+                    unsigned short rgb[3];
+                    memcpy(rgb, record + colorOffset_, sizeof(rgb));
+                    point.rgba_ = ((unsigned)(rgb[0] >> 8) << 24) | ((unsigned)(rgb[1] >> 8) << 16) | ((unsigned)(rgb[2] >> 8) << 8) | 0xFF;
+                }
+                else
+                {
+                    unsigned short intensity;
+                    memcpy(&intensity, record + 12, sizeof(intensity));
+                    const unsigned gray = intensity > 255 ? intensity >> 8 : intensity;
+                    point.rgba_ = (gray << 24) | (gray << 16) | (gray << 8) | 0xFF;
+                }
+            }
+        });
+        return true;
+    }
+
+    bool GetHeaderBounds(double* min, double* max) const override
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            min[i] = min_[i];
+            max[i] = max_[i];
+        }
+        return min_[0] <= max_[0] && min_[1] <= max_[1] && min_[2] <= max_[2];
+    }
+
+    unsigned long long GetHeaderNumPoints() const override { return numPoints_; }
+
+    bool HasColors() const override { return colorOffset_ != 0; }
+
+private:
+    FILE* file_{};
+    std::vector<unsigned char> buffer_;
+    unsigned long long numPoints_{};
+    unsigned long long pointsRead_{};
+    unsigned short recordLength_{};
+    unsigned char format_{};
+    unsigned classificationOffset_{};
+    unsigned colorOffset_{};
+    double scale_[3]{};
+    double offset_[3]{};
+    double min_[3]{};
+    double max_[3]{};
+};
+
+/// Parse the lines of [begin, end) to points. Lines holding less than x, y and z, like the PTS point count, are skipped.
+static void ParseAsciiLines(const char* begin, const char* end, const double* offset, std::vector<InputPoint>& points)
+{
+    const char* line = begin;
+    while (line < end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        double values[7];
+        unsigned numValues = 0;
+        const char* pos = line;
+        while (numValues < 7)
+        {
+            while (pos < lineEnd && (*pos == ' ' || *pos == '\t' || *pos == ',' || *pos == '\r'))
+                ++pos;
+            if (pos >= lineEnd)
+                break;
+            char* valueEnd;
+            values[numValues] = strtod(pos, &valueEnd);
+            if (valueEnd == pos)
+                break;
+            ++numValues;
+            pos = valueEnd;
+        }
+
+        if (numValues >= 3)
+        {
+            InputPoint point;
+            point.x_ = values[0] - offset[0];
+            point.y_ = values[1] - offset[1];
+            point.z_ = values[2] - offset[2];
+            point.classification_ = 0;
+
+            // x y z [intensity] [r g b], PTS intensity is in [-2048, 2047]
+            unsigned rgb[3] = { 255, 255, 255 };
+            if (numValues >= 6)
+            {
+                for (unsigned i = 0; i < 3; ++i)
+                    rgb[i] = (unsigned)Clamp((int)values[numValues - 3 + i], 0, 255);
+            }
+            else if (numValues == 4)
+            {
+                const double intensity = values[3] < 0.0 ? (values[3] + 2048.0) / 16.0 : (values[3] > 255.0 ? values[3] / 256.0 : values[3]);
+                rgb[0] = rgb[1] = rgb[2] = (unsigned)Clamp((int)intensity, 0, 255);
+            }
+            point.rgba_ = (rgb[0] << 24) | (rgb[1] << 16) | (rgb[2] << 8) | 0xFF;
+            points.push_back(point);
+        }
+
+        line = lineEnd + 1;
+    }
+}
+
+/// ASCII xyz / pts / txt reader.
+class AsciiReader : public PointReader
+{
+public:
+    ~AsciiReader() override
+    {
+        if (file_)
+            fclose(file_);
+    }
+
+    bool Open(const String& fileName) override
+    {
+        file_ = OpenStdFile(fileName, "rb");
+        return file_ != nullptr;
+    }
+
+    bool ReadBlock(const double* offset, std::vector<InputPoint>& points) override
+    {
+        points.clear();
+        if (!file_)
+            return false;
+
+        // Keep the partial last line of the previous block in front
+        buffer_.resize(tail_.size() + READ_BLOCK_SIZE + 1);
+        if (!tail_.empty())
+            memcpy(buffer_.data(), tail_.data(), tail_.size());
+        const size_t numRead = fread(buffer_.data() + tail_.size(), 1, READ_BLOCK_SIZE, file_);
+        size_t size = tail_.size() + numRead;
+        tail_.clear();
+        if (!size)
+            return false;
+
+        if (numRead == READ_BLOCK_SIZE)
+        {
+            size_t lineEnd = size;
+            while (lineEnd > 0 && buffer_[lineEnd - 1] != '\n')
+                --lineEnd;
+            if (lineEnd > 0)
+            {
+                tail_.assign(buffer_.begin() + lineEnd, buffer_.begin() + size);
+                size = lineEnd;
+            }
+        }
+        buffer_[size] = '\0';
+
+        // Split at line starts, every range is parsed by one thread and appended in order
+        auto* queue = context_->GetSubsystem<WorkQueue>();
+        const size_t numRanges = queue->GetNumThreads() + 1;
+        std::vector<size_t> starts(1, 0);
+        for (size_t i = 1; i < numRanges; ++i)
+        {
+            size_t start = Max(size * i / numRanges, starts.back());
+            while (start > 0 && start < size && buffer_[start - 1] != '\n')
+                ++start;
+            starts.push_back(start);
+        }
+        starts.push_back(size);
+
+        std::vector<std::vector<InputPoint> > rangePoints(numRanges);
+        ParallelFor((unsigned)numRanges, 1, [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                rangePoints[i].reserve((starts[i + 1] - starts[i]) / 24);
+                ParseAsciiLines(buffer_.data() + starts[i], buffer_.data() + starts[i + 1], offset, rangePoints[i]);
+            }
+        });
+
+        for (const auto& range : rangePoints)
+            points.insert(points.end(), range.begin(), range.end());
+        return true;
+    }
+
+    bool HasColors() const override { return true; }
+
+private:
+    FILE* file_{};
+    std::vector<char> buffer_;
+    std::vector<char> tail_;
+};
+
+PointReader* CreateReader(const String& fileName)
+{
+    PointReader* reader;
+    if (GetExtension(fileName) == ".las")
+        reader = new LasReader();
+    else
+        reader = new AsciiReader();
+
+    if (!reader->Open(fileName))
+    {
+        delete reader;
+        ErrorExit("Could not open input file " + fileName);
+    }
+    return reader;
+}
+
+void ComputeBounds(const Vector<String>& inputNames, double* min, double* max, unsigned long long& numPoints)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        min[i] = M_INFINITY;
+        max[i] = -M_INFINITY;
+    }
+    numPoints = 0;
+
+    const double zero[3] = { 0.0, 0.0, 0.0 };
+    std::vector<InputPoint> points;
+    for (const String& inputName : inputNames)
+    {
+        std::unique_ptr<PointReader> reader(CreateReader(inputName));
+        hasColors_ |= reader->HasColors();
+
+        double headerMin[3], headerMax[3];
+        const bool useHeader = reader->GetHeaderBounds(headerMin, headerMax);
+        if (useHeader)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                min[i] = Min(min[i], headerMin[i]);
+                max[i] = Max(max[i], headerMax[i]);
+            }
+        }
+
+        // ASCII files have no header, they are read once for their bounds and point count
+        if (useHeader && reader->GetHeaderNumPoints())
+        {
+            numPoints += reader->GetHeaderNumPoints();
+            continue;
+        }
+        while (reader->ReadBlock(zero, points))
+        {
+            numPoints += points.size();
+            for (const auto& point : points)
+            {
+                min[0] = Min(min[0], point.x_); max[0] = Max(max[0], point.x_);
+                min[1] = Min(min[1], point.y_); max[1] = Max(max[1], point.y_);
+                min[2] = Min(min[2], point.z_); max[2] = Max(max[2], point.z_);
+            }
+        }
+    }
+}
+
+void BinPoints(const Vector<String>& inputNames, const double* offset, const double* gridMin, HashMap<unsigned long long, Cell>& cells)
+{
+    std::vector<InputPoint> points;
+    std::vector<unsigned long long> keys;
+    std::vector<SpillPoint> spillPoints;
+    unsigned long long bufferedPoints = 0;
+    const unsigned long long maxBufferedPoints = Max(memoryBudget_ / sizeof(SpillPoint), (unsigned long long)SPILL_BLOCK_POINTS);
+
+    for (const String& inputName : inputNames)
+    {
+        std::unique_ptr<PointReader> reader(CreateReader(inputName));
+        while (reader->ReadBlock(offset, points))
+        {
+            // Cell keys and cell relative positions are computed in parallel, appending is serial
+            const unsigned numPoints = (unsigned)points.size();
+            keys.resize(numPoints);
+            spillPoints.resize(numPoints);
+            ParallelFor(numPoints, ThreadGrain(numPoints), [&](unsigned begin, unsigned end)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                {
+                    const InputPoint& point = points[i];
+                    const int x = Max((int)floor((point.x_ - gridMin[0]) / cellSize_), 0);
+                    const int y = Max((int)floor((point.y_ - gridMin[1]) / cellSize_), 0);
+                    const int z = Max((int)floor((point.z_ - gridMin[2]) / cellSize_), 0);
+                    keys[i] = (unsigned long long)x | ((unsigned long long)y << 21) | ((unsigned long long)z << 42);
+
+                    SpillPoint& spillPoint = spillPoints[i];
+                    spillPoint.x_ = (float)(point.x_ - gridMin[0] - x * cellSize_);
+                    spillPoint.y_ = (float)(point.y_ - gridMin[1] - y * cellSize_);
+                    spillPoint.z_ = (float)(point.z_ - gridMin[2] - z * cellSize_);
+                    spillPoint.rgba_ = point.rgba_;
+                    spillPoint.classification_ = point.classification_;
+                }
+            });
+
+            Cell* cell = nullptr;
+            unsigned long long cellKey = 0;
+            for (unsigned i = 0; i < numPoints; ++i)
+            {
+                if (!cell || keys[i] != cellKey)
+                {
+                    cellKey = keys[i];
+                    HashMap<unsigned long long, Cell>::Iterator it = cells.Find(cellKey);
+                    if (it == cells.End())
+                    {
+                        it = cells.Insert(MakePair(cellKey, Cell()));
+                        it->second_.x_ = (int)(cellKey & 0x1FFFFF);
+                        it->second_.y_ = (int)((cellKey >> 21) & 0x1FFFFF);
+                        it->second_.z_ = (int)(cellKey >> 42);
+                        it->second_.fileName_ = tempDir_ + ToString("%d_%d_%d.bin", it->second_.x_, it->second_.y_, it->second_.z_);
+                    }
+                    cell = &it->second_;
+                }
+                cell->buffer_.push_back(spillPoints[i]);
+                ++cell->numPoints_;
+            }
+
+            bufferedPoints += numPoints;
+            if (bufferedPoints > maxBufferedPoints)
+            {
+                FlushCells(cells);
+                bufferedPoints = 0;
+            }
+        }
+    }
+    FlushCells(cells);
+}
+
+/// Append points to a spill file.
+static bool AppendSpillFile(const String& fileName, const SpillPoint* points, size_t count)
+{
+    FILE* file = OpenStdFile(fileName, "ab");
+    if (!file)
+        return false;
+    const bool success = fwrite(points, sizeof(SpillPoint), count, file) == count;
+    fclose(file);
+    return success;
+}
+
+void FlushCells(HashMap<unsigned long long, Cell>& cells)
+{
+    for (HashMap<unsigned long long, Cell>::Iterator i = cells.Begin(); i != cells.End(); ++i)
+    {
+        Cell& cell = i->second_;
+        if (cell.buffer_.empty())
+            continue;
+        if (!AppendSpillFile(cell.fileName_, cell.buffer_.data(), cell.buffer_.size()))
+            ErrorExit("Could not write " + cell.fileName_);
+        std::vector<SpillPoint>().swap(cell.buffer_);
+    }
+}
+
+void ProcessCellWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* task = reinterpret_cast<CellTask*>(item->start_);
+    const Cell* cell = task->cell_;
+    const String name = ToString("%d_%d_%d", cell->x_, cell->y_, cell->z_);
+    ProcessCell(*task, cell->fileName_, name, task->min_, cellSize_, cell->numPoints_, 0);
+}
+
+bool ProcessCell(CellTask& task, const String& spillName, const String& name, const double* min, double size,
+    unsigned long long numPoints, unsigned depth)
+{
+    FILE* file = OpenStdFile(spillName, "rb");
+    if (!file)
+    {
+        task.error_ = "Could not read " + spillName;
+        return false;
+    }
+
+    // Cells under the limit are converted in memory
+    if (numPoints <= maxContainerPoints_ || depth >= MAX_SPLIT_DEPTH)
+    {
+        std::vector<SpillPoint> points((size_t)numPoints);
+        const size_t numRead = fread(points.data(), sizeof(SpillPoint), points.size(), file);
+        fclose(file);
+        context_->GetSubsystem<FileSystem>()->Delete(spillName);
+        if (numRead != points.size())
+        {
+            task.error_ = "Could not read " + spillName;
+            return false;
+        }
+        return WriteContainer(task, points, name, min, size);
+    }
+
+    // Overfull cells are split into octants, streaming the spill file so memory stays bounded
+    const double halfSize = size * 0.5;
+    const float center[3] = { (float)(min[0] - task.min_[0] + halfSize), (float)(min[1] - task.min_[1] + halfSize),
+        (float)(min[2] - task.min_[2] + halfSize) };
+    std::vector<SpillPoint> octants[8];
+    unsigned long long octantPoints[8] = {};
+    std::vector<SpillPoint> block(SPILL_BLOCK_POINTS);
+    size_t numRead;
+    while ((numRead = fread(block.data(), sizeof(SpillPoint), block.size(), file)) > 0)
+    {
+        for (size_t i = 0; i < numRead; ++i)
+        {
+            const SpillPoint& point = block[i];
+            const unsigned octant = (point.x_ >= center[0] ? 1 : 0) | (point.y_ >= center[1] ? 2 : 0) | (point.z_ >= center[2] ? 4 : 0);
+            octants[octant].push_back(point);
+        }
+        for (unsigned octant = 0; octant < 8; ++octant)
+        {
+            if (octants[octant].size() < SPILL_BLOCK_POINTS / 8)
+                continue;
+            if (!AppendSpillFile(spillName + String(octant), octants[octant].data(), octants[octant].size()))
+            {
+                fclose(file);
+                task.error_ = "Could not write " + spillName + String(octant);
+                return false;
+            }
+            octantPoints[octant] += octants[octant].size();
+            octants[octant].clear();
+        }
+    }
+    fclose(file);
+    context_->GetSubsystem<FileSystem>()->Delete(spillName);
+
+    for (unsigned octant = 0; octant < 8; ++octant)
+    {
+        if (!octants[octant].empty())
+        {
+            if (!AppendSpillFile(spillName + String(octant), octants[octant].data(), octants[octant].size()))
+            {
+                task.error_ = "Could not write " + spillName + String(octant);
+                return false;
+            }
+            octantPoints[octant] += octants[octant].size();
+            std::vector<SpillPoint>().swap(octants[octant]);
+        }
+    }
+
+    for (unsigned octant = 0; octant < 8; ++octant)
+    {
+        if (!octantPoints[octant])
+            continue;
+        const double octantMin[3] = { min[0] + ((octant & 1) ? halfSize : 0.0), min[1] + ((octant & 2) ? halfSize : 0.0),
+            min[2] + ((octant & 4) ? halfSize : 0.0) };
+        if (!ProcessCell(task, spillName + String(octant), name + "_" + String(octant), octantMin, halfSize, octantPoints[octant],
+            depth + 1))
+            return false;
+    }
+    return true;
+}
+
+/// Smallest eigenvector of a symmetric 3x3 matrix, by Jacobi rotations.
+static Vector3 SmallestEigenVector(double a[3][3])
+{
+    double v[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+    static const int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+    for (int sweep = 0; sweep < 16; ++sweep)
+    {
+        if (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2] < 1e-30)
+            break;
+
+        for (const auto& pair : pairs)
+        {
+            const int p = pair[0];
+            const int q = pair[1];
+            if (fabs(a[p][q]) < 1e-30)
+                continue;
+
+            const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+            const double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+            const double c = 1.0 / sqrt(t * t + 1.0);
+            const double s = t * c;
+            for (int k = 0; k < 3; ++k)
+            {
+                const double akp = a[k][p], akq = a[k][q];
+                a[k][p] = c * akp - s * akq;
+                a[k][q] = s * akp + c * akq;
+            }
+            for (int k = 0; k < 3; ++k)
+            {
+                const double apk = a[p][k], aqk = a[q][k];
+                a[p][k] = c * apk - s * aqk;
+                a[q][k] = s * apk + c * aqk;
+            }
+            for (int k = 0; k < 3; ++k)
+            {
+                const double vkp = v[k][p], vkq = v[k][q];
+                v[k][p] = c * vkp - s * vkq;
+                v[k][q] = s * vkp + c * vkq;
+            }
+        }
+    }
+
+    int smallest = 0;
+    for (int i = 1; i < 3; ++i)
+    {
+        if (a[i][i] < a[smallest][smallest])
+            smallest = i;
+    }
+    return Vector3((float)v[0][smallest], (float)v[1][smallest], (float)v[2][smallest]);
+}
+
+/// Accumulated position moments of the points in a normal estimation voxel.
+struct VoxelMoments
+{
+    double count_;
+    double sum_[3];
+    /// xx, xy, xz, yy, yz, zz
+    double sumSq_[6];
+};
+
+void EstimateNormals(const std::vector<SpillPoint>& points, const double* min, double size, std::vector<unsigned>& normalsOut)
+{
+    // Points are binned into voxels of the normal radius, the normal of a voxel is the plane
+    // fitted to the points of its 3x3x3 neighbourhood
+    const int gridSize = Clamp((int)ceil(size / normalRadius_), 1, 0xFFFFF);
+    const double voxelScale = gridSize / size;
+    const float center[3] = { (float)(min[0] + size * 0.5), (float)(min[1] + size * 0.5), (float)(min[2] + size * 0.5) };
+
+    HashMap<unsigned long long, unsigned> voxelIndices;
+    std::vector<VoxelMoments> moments;
+    std::vector<unsigned> pointVoxels(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const SpillPoint& point = points[i];
+        const unsigned long long x = (unsigned long long)Clamp((int)((point.x_ - min[0]) * voxelScale), 0, gridSize - 1);
+        const unsigned long long y = (unsigned long long)Clamp((int)((point.y_ - min[1]) * voxelScale), 0, gridSize - 1);
+        const unsigned long long z = (unsigned long long)Clamp((int)((point.z_ - min[2]) * voxelScale), 0, gridSize - 1);
+        const unsigned long long key = x | (y << 20) | (z << 40);
+
+        HashMap<unsigned long long, unsigned>::Iterator it = voxelIndices.Find(key);
+        if (it == voxelIndices.End())
+        {
+            it = voxelIndices.Insert(MakePair(key, (unsigned)moments.size()));
+            VoxelMoments empty;
+            memset(&empty, 0, sizeof(empty));
+            moments.push_back(empty);
+        }
+        pointVoxels[i] = it->second_;
+
+        // Relative to the container center, so the sums do not lose precision
+        const double px = point.x_ - center[0], py = point.y_ - center[1], pz = point.z_ - center[2];
+        VoxelMoments& voxel = moments[it->second_];
+        voxel.count_ += 1.0;
+        voxel.sum_[0] += px; voxel.sum_[1] += py; voxel.sum_[2] += pz;
+        voxel.sumSq_[0] += px * px; voxel.sumSq_[1] += px * py; voxel.sumSq_[2] += px * pz;
+        voxel.sumSq_[3] += py * py; voxel.sumSq_[4] += py * pz; voxel.sumSq_[5] += pz * pz;
+    }
+
+    std::vector<unsigned> voxelNormals(moments.size(), (unsigned)IndexNoNormal);
+    for (HashMap<unsigned long long, unsigned>::ConstIterator it = voxelIndices.Begin(); it != voxelIndices.End(); ++it)
+    {
+        const int x = (int)(it->first_ & 0xFFFFF);
+        const int y = (int)((it->first_ >> 20) & 0xFFFFF);
+        const int z = (int)(it->first_ >> 40);
+
+        VoxelMoments total;
+        memset(&total, 0, sizeof(total));
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (x + dx < 0 || y + dy < 0 || z + dz < 0)
+                        continue;
+                    const unsigned long long key = (unsigned long long)(x + dx) | ((unsigned long long)(y + dy) << 20) |
+                        ((unsigned long long)(z + dz) << 40);
+                    HashMap<unsigned long long, unsigned>::ConstIterator neighbour = voxelIndices.Find(key);
+                    if (neighbour == voxelIndices.End())
+                        continue;
+                    const VoxelMoments& voxel = moments[neighbour->second_];
+                    total.count_ += voxel.count_;
+                    for (int k = 0; k < 3; ++k)
+                        total.sum_[k] += voxel.sum_[k];
+                    for (int k = 0; k < 6; ++k)
+                        total.sumSq_[k] += voxel.sumSq_[k];
+                }
+            }
+        }
+        if (total.count_ < 3.0)
+            continue;
+
+        const double invCount = 1.0 / total.count_;
+        const double mean[3] = { total.sum_[0] * invCount, total.sum_[1] * invCount, total.sum_[2] * invCount };
+        double covariance[3][3];
+        covariance[0][0] = total.sumSq_[0] * invCount - mean[0] * mean[0];
+        covariance[0][1] = covariance[1][0] = total.sumSq_[1] * invCount - mean[0] * mean[1];
+        covariance[0][2] = covariance[2][0] = total.sumSq_[2] * invCount - mean[0] * mean[2];
+        covariance[1][1] = total.sumSq_[3] * invCount - mean[1] * mean[1];
+        covariance[1][2] = covariance[2][1] = total.sumSq_[4] * invCount - mean[1] * mean[2];
+        covariance[2][2] = total.sumSq_[5] * invCount - mean[2] * mean[2];
+
+        // The sign is unknown without the scanner position, face up like aerial LIDAR
+        Vector3 normal = SmallestEigenVector(covariance);
+        if (normal.z_ < 0.0f)
+            normal = -normal;
+        voxelNormals[it->second_] = (unsigned)AgPointCloudNormalUtils::indexForNormal(normal.Normalized());
+    }
+
+    normalsOut.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        normalsOut[i] = voxelNormals[pointVoxels[i]];
+}
+
+unsigned AssignLods(const std::vector<SpillPoint>& points, const double* min, double size, std::vector<unsigned char>& levelsOut)
+{
+    // LOD files are additive: LOD n adds one point to every cell of a grid with LOD0_GRID_SIZE << n cells
+    // per axis that no coarser LOD covers yet. The last LOD holds all remaining points
+    static const unsigned char UNASSIGNED = 0xFF;
+    levelsOut.assign(points.size(), UNASSIGNED);
+    size_t remaining = points.size();
+    unsigned level = 0;
+    for (; remaining && level + 1 < MAX_LOD_LEVELS; ++level)
+    {
+        const unsigned gridSize = LOD0_GRID_SIZE << level;
+        // Finer than the millimeter resolution of PCVL, take all remaining points
+        if (size / gridSize < 0.001 || gridSize > 0xFFFFF)
+            break;
+
+        const double gridScale = gridSize / size;
+        HashSet<unsigned long long> occupied;
+        for (unsigned pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                // First pass marks the cells of the coarser LODs, second pass fills the empty ones
+                if ((pass == 0) != (levelsOut[i] != UNASSIGNED))
+                    continue;
+
+                const SpillPoint& point = points[i];
+                const unsigned long long x = (unsigned long long)Clamp((int)((point.x_ - min[0]) * gridScale), 0, (int)gridSize - 1);
+                const unsigned long long y = (unsigned long long)Clamp((int)((point.y_ - min[1]) * gridScale), 0, (int)gridSize - 1);
+                const unsigned long long z = (unsigned long long)Clamp((int)((point.z_ - min[2]) * gridScale), 0, (int)gridSize - 1);
+                const unsigned long long key = x | (y << 20) | (z << 40);
+                if (pass == 0)
+                    occupied.Insert(key);
+                else if (!occupied.Contains(key))
+                {
+                    occupied.Insert(key);
+                    levelsOut[i] = (unsigned char)level;
+                    --remaining;
+                }
+            }
+        }
+    }
+
+    for (auto& pointLevel : levelsOut)
+    {
+        if (pointLevel == UNASSIGNED)
+            pointLevel = (unsigned char)level;
+    }
+    return level + 1;
+}
+
+bool WriteContainer(CellTask& task, std::vector<SpillPoint>& points, const String& name, const double* min, double size)
+{
+    // 'min' is relative to the scan offset, the points relative to their root cell
+    const double localMin[3] = { min[0] - task.min_[0], min[1] - task.min_[1], min[2] - task.min_[2] };
+
+    std::vector<unsigned> normals;
+    EstimateNormals(points, localMin, size, normals);
+    std::vector<unsigned char> levels;
+    const unsigned numLevels = AssignLods(points, localMin, size, levels);
+
+    // Leave out LODs that received no points, so the files are numbered without gaps
+    std::vector<unsigned> levelCounts(numLevels, 0);
+    for (unsigned char level : levels)
+        ++levelCounts[level];
+    std::vector<unsigned char> levelRemap(numLevels, 0);
+    unsigned numLods = 0;
+    for (unsigned level = 0; level < numLevels; ++level)
+    {
+        levelRemap[level] = (unsigned char)numLods;
+        if (levelCounts[level])
+            ++numLods;
+    }
+
+    // Bounds of the points in scan space, the PCVL offset is the container minimum
+    Vector3 boundsMin(M_INFINITY, M_INFINITY, M_INFINITY);
+    Vector3 boundsMax(-M_INFINITY, -M_INFINITY, -M_INFINITY);
+    const Vector3 cellOrigin((float)task.min_[0], (float)task.min_[1], (float)task.min_[2]);
+    for (const auto& point : points)
+    {
+        const Vector3 position = cellOrigin + Vector3(point.x_, point.y_, point.z_);
+        boundsMin = VectorMin(boundsMin, position);
+        boundsMax = VectorMax(boundsMax, position);
+    }
+    const Vector3 fileOffset((float)min[0], (float)min[1], (float)min[2]);
+
+    // One PCVL file per LOD, see AgVoxelLeafNode for the layout of the 128 bit leaf nodes
+    std::vector<unsigned long long> leafNodes;
+    for (unsigned level = 0; level < numLevels; ++level)
+    {
+        if (!levelCounts[level])
+            continue;
+
+        leafNodes.clear();
+        leafNodes.reserve(levelCounts[level] * 2);
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            if (levels[i] != level)
+                continue;
+
+            const SpillPoint& point = points[i];
+            const unsigned long long x = (unsigned long long)Clamp((int)round((point.x_ - localMin[0]) * 1000.0), 0, (int)MAX_CONTAINER_COORD);
+            const unsigned long long y = (unsigned long long)Clamp((int)round((point.y_ - localMin[1]) * 1000.0), 0, (int)MAX_CONTAINER_COORD);
+            const unsigned long long z = (unsigned long long)Clamp((int)round((point.z_ - localMin[2]) * 1000.0), 0, (int)MAX_CONTAINER_COORD);
+            leafNodes.push_back(x | (y << 18) | (z << 36) | ((unsigned long long)(point.classification_ & 0xFF) << 54));
+            leafNodes.push_back((unsigned long long)point.rgba_ | ((unsigned long long)(normals[i] & 0x3FFF) << 32));
+        }
+
+        const String fileName = outputDir_ + resourcePrefix_ + name + "_" + String((unsigned)levelRemap[level]) + ".vxl";
+        File file(context_);
+        if (!file.Open(fileName, FILE_WRITE))
+        {
+            task.error_ = "Could not open output file " + fileName;
+            return false;
+        }
+        file.WriteFileID("PCVL");
+        file.WriteVector3(fileOffset);
+        file.WriteUInt(levelCounts[level]);
+        const unsigned dataSize = (unsigned)(leafNodes.size() * sizeof(unsigned long long));
+        if (file.Write(leafNodes.data(), dataSize) != dataSize)
+        {
+            task.error_ = "Could not write " + fileName;
+            return false;
+        }
+    }
+
+    ContainerInfo info;
+    info.name_ = name;
+    info.boundsMin_ = boundsMin;
+    info.boundsMax_ = boundsMax;
+    info.numPoints_ = (unsigned)points.size();
+    info.numLods_ = numLods;
+    task.containers_.push_back(info);
+    return true;
+}
+
+void WriteScene(const std::vector<CellTask>& tasks, const double* offset, const double* min, const double* max,
+    unsigned long long numPoints)
+{
+    // Same layout as the scenes exported by the AssetImporter
+    SharedPtr<Node> rootNode(new Node(context_));
+    auto* options = rootNode->CreateComponent<AgPointCloudOptions>();
+    const Vector3 sceneOffset((float)offset[0], (float)offset[1], (float)offset[2]);
+    options->setOffset(sceneOffset);
+
+    Node* pNode = rootNode->CreateChild("PointCloud");
+    const Vector3 scanMin((float)(min[0] - offset[0]), (float)(min[1] - offset[1]), (float)(min[2] - offset[2]));
+    const Vector3 scanMax((float)(max[0] - offset[0]), (float)(max[1] - offset[1]), (float)(max[2] - offset[2]));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_LIDARDATA, Variant(true));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_TOTALPOINTS, Variant((unsigned long long)numPoints));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_HASRGB, Variant(hasColors_));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_HASNORMALS, Variant(true));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_HASINTENSITY, Variant(false));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_POINTSIZE, Variant(5.0f));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_MATERIAL, Variant(ResourceRef(Material::GetTypeStatic(), "Materials/PointCloud.xml")));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_SVOBOUNDSMIN, Variant(scanMin));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_SVOBOUNDSMAX, Variant(scanMax));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_SCANBOUNDSMIN, Variant(scanMin));
+    pNode->SetVar(VoxelTreeRunTimeVars::VAR_SCANBOUNDSMAX, Variant(scanMax));
+
+    unsigned numContainers = 0;
+    for (const auto& task : tasks)
+    {
+        for (const auto& container : task.containers_)
+        {
+            auto* voxelContainer = pNode->CreateComponent<AgVoxelContainer>();
+            voxelContainer->SetSVOBoundsMin(container.boundsMin_);
+            voxelContainer->SetSVOBoundsMax(container.boundsMax_);
+            voxelContainer->SetAmountOfPoints(container.numPoints_);
+            voxelContainer->SetMaxLOD((char)container.numLods_);
+            voxelContainer->SetResourceName(resourcePrefix_ + container.name_);
+            ++numContainers;
+        }
+    }
+
+    const String sceneFileName = outputDir_ + sceneName_ + ".json";
+    File file(context_);
+    if (!file.Open(sceneFileName, FILE_WRITE))
+        ErrorExit("Could not open output file " + sceneFileName);
+    rootNode->SaveJSON(file);
+
+    PrintLine("Wrote " + String(numContainers) + " voxel containers to " + sceneFileName);
+}
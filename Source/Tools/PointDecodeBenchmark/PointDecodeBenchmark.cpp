@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/PointCloud/AgLidarPointDecoder.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <cstring>
+#include <vector>
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+static const unsigned NUM_ITERATIONS = 10;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+void CheckQuantized(const std::vector<AgLidarPoint>& points, const std::vector<AgQuantizedLidarPoint>& quantizedPoints,
+    const Matrix3x4& transform)
+{
+    // Rounding to the grid moves a point by at most half a step on each axis
+    const float tolerance = transform.Scale().x_ * 0.5f + 0.0005f;
+    float maxError = 0.0f;
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        const AgLidarPoint& point = points[i];
+        const AgQuantizedLidarPoint& quantized = quantizedPoints[i];
+        const Vector3 position = transform * Vector3(quantized.m_xy[0], quantized.m_xy[1], quantized.m_z);
+        const Vector3 error = (position - Vector3(point.m_pos[0], point.m_pos[1], point.m_pos[2])).Abs();
+        maxError = Max(maxError, Max(error.x_, Max(error.y_, error.z_)));
+        if (maxError > tolerance)
+            ErrorExit("Quantized position of point " + String(i) + " is off by " + String(maxError));
+        if (memcmp(&point.m_rgba, &quantized.m_rgba, sizeof(AgCompactColor)))
+            ErrorExit("Quantized color of point " + String(i) + " differs");
+        if (point.m_misc != quantized.m_misc || point.getLidarClassification() != ((quantized.m_misc >> 14) & 0xFF))
+            ErrorExit("Quantized normal, class or flags of point " + String(i) + " differ");
+    }
+    PrintLine("Quantized round trip: max position error " + String(maxError) + ", step " + String(transform.Scale().x_));
+}
+
+void PrintRate(const String& name, unsigned pointCount, float msec);
+void CheckQuantized(const std::vector<AgLidarPoint>& points, const std::vector<AgQuantizedLidarPoint>& quantizedPoints,
+    const Matrix3x4& transform);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned pointCount = 4000000;
+    if (arguments.Size())
+    {
+        if (arguments[0] == "-h" || arguments[0] == "--help")
+            ErrorExit(
+                "Usage: PointDecodeBenchmark [point count]\n"
+                "\n"
+                "Decodes a generated PCVL leaf payload with each kernel of AgLidarPointDecoder and prints points/sec.\n"
+                "The quantized vertices are dequantized and compared against the scalar decode.\n"
+                "The SSE2 kernel is only present when built with URHO3D_SSE. There are no AVX2 or NEON kernels: the\n"
+                "build has no AVX2 switch, and NEON targets build without URHO3D_SSE, so they run the scalar kernel.\n"
+                "Default is 4000000 points.\n"
+            );
+        pointCount = Max(ToUInt(arguments[0]), 1U);
+    }
+
+    // Random leaf nodes, two ulongs per point
+    SetRandomSeed(1);
+    std::vector<std::uint64_t> payload(pointCount * 2);
+    for (unsigned i = 0; i < payload.size(); ++i)
+        payload[i] = (std::uint64_t)Rand() << 49 ^ (std::uint64_t)Rand() << 34 ^ (std::uint64_t)Rand() << 19 ^ Rand();
+    const auto* rawData = reinterpret_cast<const std::uint8_t*>(payload.data());
+    const Vector3 offset(100.0f, 200.0f, 300.0f);
+
+    std::vector<AgLidarPoint> scalarPoints(pointCount);
+    std::vector<AgLidarPoint> simdPoints(pointCount);
+
+    PrintLine("Points: " + String(pointCount));
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+        AgLidarPointDecoder::decodeScalar(rawData, pointCount, offset, scalarPoints.data());
+    PrintRate("Scalar", pointCount, timer.GetUSec(true) / 1000.0f / NUM_ITERATIONS);
+
+    std::vector<AgQuantizedLidarPoint> quantizedPoints(pointCount);
+    Matrix3x4 transform;
+    timer.Reset();
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+        transform = AgLidarPointDecoder::decodeQuantized(rawData, pointCount, offset, quantizedPoints.data());
+    PrintRate("Quantized", pointCount, timer.GetUSec(true) / 1000.0f / NUM_ITERATIONS);
+    CheckQuantized(scalarPoints, quantizedPoints, transform);
+
+    if (!AgLidarPointDecoder::hasSSE2())
+    {
+        PrintLine("SSE2: not built( URHO3D_SSE is off )");
+        return;
+    }
+
+    timer.Reset();
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+        AgLidarPointDecoder::decode(rawData, pointCount, offset, simdPoints.data());
+    PrintRate("SSE2", pointCount, timer.GetUSec(true) / 1000.0f / NUM_ITERATIONS);
+
+    // Both kernels must produce the same vertices
+    if (memcmp(scalarPoints.data(), simdPoints.data(), pointCount * sizeof(AgLidarPoint)))
+        ErrorExit("SSE2 and scalar decode differ");
+}
+
+void PrintRate(const String& name, unsigned pointCount, float msec)
+{
+    PrintLine(name + ": " + String(msec) + " ms, " + String(pointCount / Max(msec, M_EPSILON) / 1000.0f) + " Mpoints/sec");
+}
@@ -0,0 +1,242 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/OcclusionBuffer.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/PointCloud/AgVoxelContainer.h>
+#include <Urho3D/PointCloud/AgVoxelLidarPoints.h>
+#include <Urho3D/PointCloud/AgVoxelOcclusion.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <vector>
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+// A wall of square tiles faces the camera, which looks along +Z from the origin
+static const float WALL_DISTANCE = 50.0f;
+static const float TILE_SIZE = 10.0f;
+static const int WALL_TILES_X = 6;
+static const int WALL_TILES_Y = 4;
+// Small containers behind the wall must be hidden, the ones beside it must not
+static const float TARGET_DISTANCE = 80.0f;
+static const float TARGET_SIZE = 2.0f;
+static const float POINT_SIZE = 2.0f;
+static const int VIEW_WIDTH = 1920;
+static const int VIEW_HEIGHT = 1080;
+static const int OCCLUSION_BUFFER_SIZE = 256;
+static const float OCCLUDER_SIZE_THRESHOLD = 0.025f;
+static const unsigned NUM_ITERATIONS = 100;
+
+SharedPtr<Context> context_(new Context());
+// The containers only reference the geometry of their LODs
+Vector<SharedPtr<AgVoxelPoints> > points_;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+AgVoxelContainer* CreateContainer(Node* scan, const Vector3& center, const Vector3& size, unsigned gridSize);
+float ScreenSize(Camera* camera, AgVoxelContainer* container);
+unsigned CountHidden(const std::vector<std::uint8_t>& visible, size_t begin, size_t end);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned gridSize = 250;
+    if (arguments.Size())
+    {
+        if (arguments[0] == "-h" || arguments[0] == "--help")
+            ErrorExit(
+                "Usage: PointOcclusionBenchmark [points per tile side]\n"
+                "\n"
+                "Builds a wall scan of voxel containers with loaded lidar points in front of a camera, culls small\n"
+                "containers behind and beside the wall with AgVoxelOcclusion and prints the time per cull. Fails when\n"
+                "a container behind the wall stays visible, a container beside it is hidden, or the wall occludes\n"
+                "anything while its points are not loaded. Default is 250 points per tile side.\n"
+            );
+        gridSize = Max(ToUInt(arguments[0]), 1U);
+    }
+
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    context_->RegisterSubsystem(new WorkQueue(context_));
+    RegisterSceneLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+
+    SharedPtr<Scene> scene(new Scene(context_));
+    scene->CreateComponent<Octree>();
+    Node* cameraNode = scene->CreateChild("Camera");
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFov(45.0f);
+    camera->SetAspectRatio((float)VIEW_WIDTH / (float)VIEW_HEIGHT);
+    camera->SetFarClip(1000.0f);
+    Node* scan = scene->CreateChild("Scan");
+
+    // Wall tiles first, then one target behind the center of every tile, then targets beside the shadow of the wall
+    std::vector<AgVoxelContainer*> containers;
+    for (int y = 0; y < WALL_TILES_Y; ++y)
+    {
+        for (int x = 0; x < WALL_TILES_X; ++x)
+        {
+            const Vector3 center((x + 0.5f - WALL_TILES_X * 0.5f) * TILE_SIZE, (y + 0.5f - WALL_TILES_Y * 0.5f) * TILE_SIZE, WALL_DISTANCE);
+            containers.push_back(CreateContainer(scan, center, Vector3(TILE_SIZE, TILE_SIZE, 1.0f), gridSize));
+        }
+    }
+    const size_t numWall = containers.size();
+    for (size_t i = 0; i < numWall; ++i)
+    {
+        const Vector3 center = containers[i]->GetWorldBoundingBox().Center();
+        containers.push_back(CreateContainer(scan, Vector3(center.x_, center.y_, TARGET_DISTANCE), Vector3::ONE * TARGET_SIZE, 0));
+    }
+    const size_t numBehind = containers.size();
+    const float besideX = WALL_TILES_X * TILE_SIZE * 0.5f * TARGET_DISTANCE / WALL_DISTANCE + TARGET_SIZE * 3.0f;
+    containers.push_back(CreateContainer(scan, Vector3(-besideX, 0.0f, TARGET_DISTANCE), Vector3::ONE * TARGET_SIZE, 0));
+    containers.push_back(CreateContainer(scan, Vector3(besideX, 0.0f, TARGET_DISTANCE), Vector3::ONE * TARGET_SIZE, 0));
+
+    std::vector<AgOcclusionTestItem> items(containers.size());
+    for (size_t i = 0; i < containers.size(); ++i)
+        AgVoxelOcclusion::makeTestItem(*containers[i], ScreenSize(camera, containers[i]), items[i]);
+    if (items[0].m_loadedPoints != gridSize * gridSize)
+        ErrorExit("Wall tiles report " + String(items[0].m_loadedPoints) + " loaded points instead of " + String(gridSize * gridSize));
+
+    SharedPtr<OcclusionBuffer> buffer(new OcclusionBuffer(context_));
+    buffer->SetSize(OCCLUSION_BUFFER_SIZE, OCCLUSION_BUFFER_SIZE * VIEW_HEIGHT / VIEW_WIDTH, false);
+    buffer->SetView(camera);
+    buffer->SetCullMode(CULL_NONE);
+    const float minOccluderSize = OCCLUDER_SIZE_THRESHOLD * (float)VIEW_WIDTH;
+    const Vector3 cameraPos = cameraNode->GetWorldPosition();
+
+    std::vector<std::uint8_t> visible;
+    unsigned numOccluders = 0;
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        visible.assign(containers.size(), 0);
+        buffer->Clear();
+        numOccluders = AgVoxelOcclusion::cull(buffer, cameraPos, items, minOccluderSize, POINT_SIZE, visible.data());
+    }
+    const float msec = timer.GetUSec(false) / 1000.0f / NUM_ITERATIONS;
+
+    const unsigned hiddenBehind = CountHidden(visible, numWall, numBehind);
+    const unsigned hiddenBeside = CountHidden(visible, numBehind, containers.size());
+    PrintLine("Containers: " + String((unsigned)containers.size()) + ", wall points: " + String(items[0].m_loadedPoints * numWall));
+    PrintLine("Occluders: " + String(numOccluders));
+    PrintLine("Hidden behind the wall: " + String(hiddenBehind) + " of " + String((unsigned)(numBehind - numWall)));
+    PrintLine("Cull: " + String(msec) + " ms");
+    if (hiddenBehind != numBehind - numWall)
+        ErrorExit("Containers behind the wall are visible");
+    if (hiddenBeside)
+        ErrorExit("Containers beside the wall are hidden");
+
+    // The same wall with no points loaded must not occlude anything
+    for (size_t i = 0; i < numWall; ++i)
+        items[i].m_loadedPoints = 0;
+    visible.assign(containers.size(), 0);
+    buffer->Clear();
+    AgVoxelOcclusion::cull(buffer, cameraPos, items, minOccluderSize, POINT_SIZE, visible.data());
+    if (CountHidden(visible, 0, containers.size()))
+        ErrorExit("A wall without loaded points hides containers");
+}
+
+AgVoxelContainer* CreateContainer(Node* scan, const Vector3& center, const Vector3& size, unsigned gridSize)
+{
+    auto* container = scan->CreateComponent<AgVoxelContainer>();
+    container->SetSVOBoundsMin(center - size * 0.5f);
+    container->SetSVOBoundsMax(center + size * 0.5f);
+    container->SetAmountOfPoints(gridSize * gridSize);
+    container->SetMaxLOD(1);
+    if (!gridSize)
+        return container;
+
+    // One LOD file in PCVL layout, a grid of points on the face towards the camera( millimeter offsets from the minimum )
+    VectorBuffer file;
+    file.WriteFileID("PCVL");
+    file.WriteVector3(container->GetSVOBoundsMin());
+    file.WriteUInt(gridSize * gridSize);
+    for (unsigned y = 0; y < gridSize; ++y)
+    {
+        for (unsigned x = 0; x < gridSize; ++x)
+        {
+            const auto offsetX = (std::uint64_t)(size.x_ * 1000.0f * x / gridSize);
+            const auto offsetY = (std::uint64_t)(size.y_ * 1000.0f * y / gridSize);
+            file.WriteUInt64(offsetX | offsetY << 18);
+            file.WriteUInt64(0xFFFFFFFFULL);
+        }
+    }
+    file.Seek(0);
+
+    SharedPtr<AgVoxelLidarPoints> points(new AgVoxelLidarPoints(context_));
+    if (!points->Load(file))
+        ErrorExit("Could not load the generated wall points");
+    container->SetVoxelPoints(points);
+    points_.Push(SharedPtr<AgVoxelPoints>(points));
+    return container;
+}
+
+float ScreenSize(Camera* camera, AgVoxelContainer* container)
+{
+    // Projected diameter of the bounding sphere in view pixels
+    const BoundingBox& box = container->GetWorldBoundingBox();
+    const float distance = Max(box.DistanceToPoint(camera->GetNode()->GetWorldPosition()), camera->GetNearClip());
+    const float viewHeightAtDistance = 2.0f * distance * tanf(camera->GetFov() * 0.5f * M_DEGTORAD);
+    return box.Size().Length() / viewHeightAtDistance * (float)VIEW_HEIGHT;
+}
+
+unsigned CountHidden(const std::vector<std::uint8_t>& visible, size_t begin, size_t end)
+{
+    unsigned hidden = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (!visible[i])
+            ++hidden;
+    }
+    return hidden;
+}
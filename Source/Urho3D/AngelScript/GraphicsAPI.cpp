@@ -472,7 +472,9 @@ static void RegisterTextures(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Viewport", "IntVector2 WorldToScreenPoint(const Vector3&in) const", asMETHOD(Viewport, WorldToScreenPoint), asCALL_THISCALL);
     engine->RegisterObjectMethod("Viewport", "Vector3 ScreenToWorldPoint(int, int, float) const", asMETHOD(Viewport, ScreenToWorldPoint), asCALL_THISCALL);
 	engine->RegisterObjectMethod("Viewport", "void EnableStaticShadow(bool)", asMETHOD(Viewport, EnableStaticShadow), asCALL_THISCALL); 
-	engine->RegisterObjectMethod("Viewport", "void UpdateStaticShadow()", asMETHOD(Viewport, UpdateStaticShadow), asCALL_THISCALL);
+	engine->RegisterObjectMethod("Viewport", "void UpdateStaticShadow()", asMETHODPR(Viewport, UpdateStaticShadow, (), void), asCALL_THISCALL);
+	engine->RegisterObjectMethod("Viewport", "void UpdateStaticShadow(const BoundingBox&in)", asMETHODPR(Viewport, UpdateStaticShadow, (const BoundingBox&), void), asCALL_THISCALL);
+	engine->RegisterObjectMethod("Viewport", "void ResetStaticShadow()", asMETHOD(Viewport, ResetStaticShadow), asCALL_THISCALL);
 	
 
     engine->RegisterObjectType("RenderSurface", 0, asOBJ_REF);
@@ -2032,6 +2034,8 @@ static void RegisterRenderer(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Renderer", "float get_occluderSizeThreshold() const", asMETHOD(Renderer, GetOccluderSizeThreshold), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_threadedOcclusion(bool)", asMETHOD(Renderer, SetThreadedOcclusion), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "bool get_threadedOcclusion() const", asMETHOD(Renderer, GetThreadedOcclusion), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "void set_multiViewCulling(bool)", asMETHOD(Renderer, SetMultiViewCulling), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "bool get_multiViewCulling() const", asMETHOD(Renderer, GetMultiViewCulling), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_mobileShadowBiasMul(float)", asMETHOD(Renderer, SetMobileShadowBiasMul), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "float get_mobileShadowBiasMul() const", asMETHOD(Renderer, GetMobileShadowBiasMul), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_mobileShadowBiasAdd(float)", asMETHOD(Renderer, SetMobileShadowBiasAdd), asCALL_THISCALL);
@@ -40,6 +40,9 @@
 namespace Urho3D
 {
 
+/// Per-instance diffuse color written for instances without an override. The negative alpha selects the material color in the shaders.
+static const Color NO_INSTANCE_DIFF_COLOR(0.0f, 0.0f, 0.0f, -1.0f);
+
 inline bool CompareBatchesState(Batch* lhs, Batch* rhs)
 {
     if (lhs->renderOrder_ != rhs->renderOrder_)
@@ -425,9 +428,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
             }
 			if (graphics->HasShaderParameter(VSP_STATICLIGHTMATRIX) && light->GetLightType() == LIGHT_DIRECTIONAL)
 			{
-				if (view->GetEnableStaticShadow() && lightQueue_->staticShadowMap_ &&
-					(lightQueue_->staticShadow_.shadowBatches_.sortedBatches_.Size() > 0 ||
-						lightQueue_->staticShadow_.shadowBatches_.sortedBatchGroups_.Size() > 0))
+				if (view->GetEnableStaticShadow() && lightQueue_->staticShadowMap_ && lightQueue_->staticShadow_.shadowCamera_)
 				{
 					Matrix4 staticShadowMatrix;
 					CalculateDirectionalLightStaticShadowMatrix(staticShadowMatrix, lightQueue_, renderer);
@@ -496,9 +497,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
             }
 			if (graphics->HasShaderParameter(PSP_STATICLIGHTMATRIX) && light->GetLightType() == LIGHT_DIRECTIONAL)
 			{
-				if (view->GetEnableStaticShadow() && lightQueue_->staticShadowMap_ &&
-				(lightQueue_->staticShadow_.shadowBatches_.sortedBatches_.Size() > 0 ||
-					lightQueue_->staticShadow_.shadowBatches_.sortedBatchGroups_.Size() > 0))
+				if (view->GetEnableStaticShadow() && lightQueue_->staticShadowMap_ && lightQueue_->staticShadow_.shadowCamera_)
 				{
 					Matrix4 staticShadowMatrix;
 					CalculateDirectionalLightStaticShadowMatrix(staticShadowMatrix, lightQueue_, renderer);
@@ -689,14 +688,26 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     // Set material-specific shader parameters and textures
     if (material_)
     {
-        if (graphics->NeedParameterUpdate(SP_MATERIAL, reinterpret_cast<const void*>(material_->GetShaderParameterHash())) || renderer->GetOverrideShaderParametersSet() )
+        PODVector<StringHash>& overriddenParameters = renderer->GetOverriddenShaderParameters();
+        const HashMap<StringHash, MaterialShaderParameter>& parameters = material_->GetShaderParameters();
+        if (graphics->NeedParameterUpdate(SP_MATERIAL, reinterpret_cast<const void*>(material_->GetShaderParameterHash())))
         {
-            const HashMap<StringHash, MaterialShaderParameter>& parameters = material_->GetShaderParameters();
             for (HashMap<StringHash, MaterialShaderParameter>::ConstIterator i = parameters.Begin(); i != parameters.End(); ++i)
             {
 				graphics->SetShaderParameter(i->first_, i->second_.value_);
             }
-			renderer->SetOverrideShaderParametersSet(false);
+            overriddenParameters.Clear();
+        }
+        else if (overriddenParameters.Size())
+        {
+            // Same material as the previous batch: restore only the parameters it overrode
+            for (unsigned i = 0; i < overriddenParameters.Size(); ++i)
+            {
+                HashMap<StringHash, MaterialShaderParameter>::ConstIterator j = parameters.Find(overriddenParameters[i]);
+                if (j != parameters.End())
+                    graphics->SetShaderParameter(j->first_, j->second_.value_);
+            }
+            overriddenParameters.Clear();
         }
 
         const HashMap<TextureUnit, SharedPtr<Texture> >& textures = material_->GetTextures();
@@ -734,7 +745,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
 		for (HashMap<StringHash, MaterialShaderParameter>::ConstIterator iter = overrideShaderParameters_->Begin(); iter != overrideShaderParameters_->End(); ++iter)
 		{
 			graphics->SetShaderParameter(iter->first_, iter->second_.value_);
-			renderer->SetOverrideShaderParametersSet(true);
+			renderer->MarkShaderParameterOverridden(iter->first_);
 		}
 	}
 }
@@ -763,7 +774,9 @@ void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned&
 
         memcpy(buffer, instance.worldTransform_, sizeof(Matrix3x4));    // NOLINT(bugprone-undefined-memory-manipulation)
         if (instance.instancingData_)
-            memcpy(buffer + sizeof(Matrix3x4), instance.instancingData_, stride - sizeof(Matrix3x4));
+            memcpy(buffer + sizeof(Matrix3x4), instance.instancingData_, stride - sizeof(Matrix3x4) - sizeof(Color));
+        const Color& diffColor = instance.diffColor_ ? *instance.diffColor_ : NO_INSTANCE_DIFF_COLOR;
+        memcpy(buffer + stride - sizeof(Color), diffColor.Data(), sizeof(Color));
 
         buffer += stride;
     }
@@ -787,10 +800,24 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
             graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
             graphics->SetVertexBuffers(geometry_->GetVertexBuffers());
 
+            // Diffuse color overrides become shader parameters, set only when they change between instances
+            const Color* lastDiffColor = nullptr;
             for (unsigned i = 0; i < instances_.Size(); ++i)
             {
                 if (graphics->NeedParameterUpdate(SP_OBJECT, instances_[i].worldTransform_))
                     graphics->SetShaderParameter(VSP_MODEL, *instances_[i].worldTransform_);
+                const Color* diffColor = instances_[i].diffColor_;
+                if (diffColor != lastDiffColor)
+                {
+                    if (diffColor)
+                    {
+                        graphics->SetShaderParameter(PSP_MATDIFFCOLOR, *diffColor);
+                        renderer->MarkShaderParameterOverridden(PSP_MATDIFFCOLOR);
+                    }
+                    else
+                        graphics->SetShaderParameter(PSP_MATDIFFCOLOR, material_->GetShaderParameter("MatDiffColor").GetColor());
+                    lastDiffColor = diffColor;
+                }
 
                 graphics->Draw(geometry_->GetPrimitiveType(), geometry_->GetIndexStart(), geometry_->GetIndexCount(),
                     geometry_->GetVertexStart(), geometry_->GetVertexCount());
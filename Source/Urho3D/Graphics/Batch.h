@@ -33,6 +33,7 @@ namespace Urho3D
 {
 
 class Camera;
+class Color;
 class Drawable;
 class Geometry;
 class Light;
@@ -112,6 +113,8 @@ struct Batch
 	HashMap<StringHash, MaterialShaderParameter>* overrideShaderParameters_{};
 	///override render state
 	FillMode overrideFillMode;
+	/// Diffuse color override carried as per-instance data when instanced, or null to use the material color.
+	const Color* instanceDiffColor_{};
 };
 
 /// Data for one geometry instance.
@@ -134,6 +137,8 @@ struct InstanceData
     const void* instancingData_{};
     /// Distance from camera.
     float distance_{};
+    /// Diffuse color override, or null to use the material color.
+    const Color* diffColor_{};
 };
 
 /// Instanced 3D geometry draw call.
@@ -161,6 +166,7 @@ struct BatchGroup : public Batch
         InstanceData newInstance;
         newInstance.distance_ = batch.distance_;
         newInstance.instancingData_ = batch.instancingData_;
+        newInstance.diffColor_ = batch.instanceDiffColor_;
 
         for (unsigned i = 0; i < batch.numWorldTransforms_; ++i)
         {
@@ -313,6 +319,8 @@ struct LightBatchQueue
     Vector<ShadowBatchQueue> shadowSplits_;
 	/// ̬Ӱ queues.
 	ShadowBatchQueue staticShadow_;
+	/// Static shadow map tiles rendered this frame, a single queue covering the whole map on a full update.
+	Vector<ShadowBatchQueue> staticShadowTiles_;
     /// Per-vertex lights.
     PODVector<Light*> vertexLights_;
     /// Light volume draw calls.
@@ -103,6 +103,8 @@ BillboardSet::BillboardSet(Context* context) :
     batches_.Resize(1);
     batches_[0].geometry_ = geometry_;
     batches_[0].geometryType_ = GEOM_BILLBOARD;
+    // Fixed screen size changes the bounding box when updating batches
+    volatileWorldBoundingBox_ = true;
     batches_[0].worldTransform_ = &transforms_[0];
 }
 
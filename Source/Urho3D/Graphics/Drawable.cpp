@@ -100,7 +100,9 @@ Drawable::Drawable(Context* context, unsigned char drawableFlags) :
 	occludee_(true),
 	updateQueued_(false),
 	zoneDirty_(false),
+	volatileWorldBoundingBox_(false),
 	octant_(nullptr),
+	octantIndex_(0),
 	zone_(nullptr),
 	viewMask_(DEFAULT_VIEWMASK),
 	overrideViewMask_(DEFAULT_VIEWMASK),
@@ -238,18 +240,24 @@ void Drawable::SetLodBias(float bias)
 void Drawable::SetViewMask(unsigned mask)
 {
     viewMask_ = mask;
+    if (octant_)
+        octant_->UpdateDrawable(this);
     MarkNetworkUpdate();
 }
 
 void Drawable::SetOverrideViewMask(unsigned mask)
 {
 	overrideViewMask_ = mask;
+	if (octant_)
+		octant_->UpdateDrawable(this);
 	MarkNetworkUpdate();
 }
 
 void Drawable::CancelOverrideViewMask()
 {
 	overrideViewMask_ = DEFAULT_VIEWMASK;
+	if (octant_)
+		octant_->UpdateDrawable(this);
 	MarkNetworkUpdate();
 }
 
@@ -274,7 +282,11 @@ void Drawable::SetZoneMask(unsigned mask)
 }
 void Drawable::SetDynamicType(DynamicType type)
 {
+	if (type != dynamicType_ && octant_ && octant_->GetRoot())
+		octant_->GetRoot()->MarkStaticDrawablesChanged();
 	dynamicType_ = type;
+	if (octant_)
+		octant_->UpdateDrawable(this);
 	MarkNetworkUpdate();
 }
 void Drawable::SetMaxLights(unsigned num)
@@ -578,6 +590,7 @@ void Drawable::RemoveFromOctree()
         Octree* octree = octant_->GetRoot();
         if (updateQueued_)
             octree->CancelUpdate(this);
+        octree->NotifyDrawableRemoved(this);
 
         // Perform subclass specific deinitialization if necessary
         OnRemoveFromOctree();
@@ -702,6 +715,50 @@ bool Drawable::RemoveOverrideShaderParameter(int index, const String& name)
 	return true;
 }
 
+void Drawable::SetOverrideShaderParameter(StringHash nameHash, const MaterialShaderParameter& parameter)
+{
+#ifdef 	URHO3D_THREADING
+	if (!Thread::IsMainThread())
+	{
+		URHO3D_LOGERROR("Drawable#SetOverrideShaderParameter was called in non-main thread!!!!!!!!");
+		return;
+	}
+#endif
+	for (unsigned i = 0; i < batches_.Size(); ++i)
+		batches_[i].overrideShaderParameters_[nameHash] = parameter;
+}
+
+void Drawable::SetOverrideShaderParameter(int index, StringHash nameHash, const MaterialShaderParameter& parameter)
+{
+#ifdef 	URHO3D_THREADING
+	if (!Thread::IsMainThread())
+	{
+		URHO3D_LOGERROR("Drawable#SetOverrideShaderParameter was called in non-main thread!!!!!!!!");
+		return;
+	}
+#endif
+	if (index < 0 || (unsigned)index >= batches_.Size())
+	{
+		URHO3D_LOGERROR(String("Drawable#SetOverrideShaderParameter的index参数超出batch的总数数!!!!!!!!"));
+		return;
+	}
+	batches_[index].overrideShaderParameters_[nameHash] = parameter;
+}
+
+bool Drawable::EraseOverrideShaderParameter(StringHash nameHash)
+{
+#ifdef 	URHO3D_THREADING
+	if (!Thread::IsMainThread())
+	{
+		URHO3D_LOGERROR("Drawable#EraseOverrideShaderParameter was called in non-main thread!!!!!!!!");
+		return false;
+	}
+#endif
+	for (unsigned i = 0; i < batches_.Size(); ++i)
+		batches_[i].overrideShaderParameters_.Erase(nameHash);
+	return true;
+}
+
 HashMap<StringHash, MaterialShaderParameter>& Drawable::GetOverrideShaderParameters(int index)
 {
 	if (index >= batches_.Size())
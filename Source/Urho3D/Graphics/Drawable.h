@@ -77,6 +77,7 @@ enum UpdateGeometryType
     UPDATE_WORKER_THREAD
 };
 
+/// Whether a drawable may move. Views cache the visibility of static drawables over frames, so objects that move or animate must be set to Dynamic.
 enum DynamicType
 {
 	Dynamic,
@@ -381,6 +382,7 @@ public:
     void SetShadowMask(unsigned mask);
     /// Set zone mask. Is and'ed with zone's zone mask to see if the object should belong to the zone.
     void SetZoneMask(unsigned mask);
+	/// Set dynamic type. Drawables default to Static, set Dynamic for objects that move so that cached visibility is not rebuilt for them every frame.
 	void SetDynamicType(DynamicType type);
     /// Set maximum number of per-pixel lights. Default 0 is unlimited.
     void SetMaxLights(unsigned num);
@@ -473,6 +475,9 @@ public:
     /// Return octree octant.
     Octant* GetOctant() const { return octant_; }
 
+    /// Return whether the world bounding box may change outside the octree update, so that octants do not cache it for culling.
+    bool HasVolatileWorldBoundingBox() const { return volatileWorldBoundingBox_; }
+
     /// Return current zone.
     Zone* GetZone() const { return zone_; }
 
@@ -539,6 +544,11 @@ public:
 	/// Remove override shader parameter.
 	bool RemoveOverrideShaderParameter(const String& name);
 	bool RemoveOverrideShaderParameter(int index, const String& name);
+	/// Set override shader parameter of all batches from a prepared name hash and parameter. Used by bulk effects.
+	void SetOverrideShaderParameter(StringHash nameHash, const MaterialShaderParameter& parameter);
+	void SetOverrideShaderParameter(int index, StringHash nameHash, const MaterialShaderParameter& parameter);
+	/// Remove override shader parameter of all batches by name hash. Used by bulk effects.
+	bool EraseOverrideShaderParameter(StringHash nameHash);
 	/// override shader parameters
 	HashMap<StringHash, MaterialShaderParameter>& GetOverrideShaderParameters(int index);
 	/// override technique
@@ -599,8 +609,12 @@ protected:
     bool updateQueued_;
     /// Zone inconclusive or dirtied flag.
     bool zoneDirty_;
+    /// Volatile world bounding box flag. Set by subclasses that change the bounding box without marking the drawable dirty, for example when updating batches.
+    bool volatileWorldBoundingBox_;
     /// Octree octant.
     Octant* octant_;
+    /// Index in the octant's drawables.
+    unsigned octantIndex_;
     /// Current zone.
     Zone* zone_;
     /// View mask.
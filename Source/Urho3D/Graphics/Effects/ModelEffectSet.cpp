@@ -0,0 +1,161 @@
+#include "../../Graphics/Effects/ModelEffectSet.h"
+#include "../../Graphics/Effects/ModelEffectUtil.h"
+#include "../../Container/HashSet.h"
+#include "../../Graphics/Drawable.h"
+#include "../../Scene/Node.h"
+
+namespace Urho3D
+{
+
+void ModelEffectSet::SetNode(Node* node)
+{
+	RevertEffects();
+	roots_.Clear();
+	if (node)
+		roots_.Push(WeakPtr<Node>(node));
+	tag_.Clear();
+	Collect();
+}
+
+void ModelEffectSet::SetNodes(const PODVector<Node*>& nodes)
+{
+	RevertEffects();
+	roots_.Clear();
+	for (unsigned i = 0; i < nodes.Size(); ++i)
+	{
+		if (nodes[i])
+			roots_.Push(WeakPtr<Node>(nodes[i]));
+	}
+	tag_.Clear();
+	Collect();
+}
+
+void ModelEffectSet::SetTag(Node* root, const String& tag)
+{
+	RevertEffects();
+	roots_.Clear();
+	if (root)
+		roots_.Push(WeakPtr<Node>(root));
+	tag_ = tag;
+	Collect();
+}
+
+void ModelEffectSet::Refresh()
+{
+	HashMap<Drawable*, unsigned char> effects;
+	for (unsigned i = 0; i < states_.Size(); ++i)
+	{
+		if (states_[i].effects_ && !states_[i].drawable_.Expired())
+			effects[states_[i].drawable_.Get()] = states_[i].effects_;
+	}
+	Collect();
+	if (effects.Empty())
+		return;
+	for (unsigned i = 0; i < states_.Size(); ++i)
+	{
+		HashMap<Drawable*, unsigned char>::ConstIterator j = effects.Find(states_[i].drawable_.Get());
+		if (j != effects.End())
+			states_[i].effects_ = j->second_;
+	}
+}
+
+void ModelEffectSet::RevertEffects()
+{
+	// Transparency erases the diffuse override as well, so it goes before the diffuse color
+	ModelEffectUtil::CancelTwinkle(*this);
+	ModelEffectUtil::CancelModelTransparent(*this);
+	ModelEffectUtil::CancelDiffuse(*this);
+	ModelEffectUtil::CancelWireframe(*this);
+	ModelEffectUtil::CancelBloom(*this);
+	ModelEffectUtil::SetModelVisible(*this, true);
+}
+
+void ModelEffectSet::Clear()
+{
+	roots_.Clear();
+	tag_.Clear();
+	states_.Clear();
+}
+
+void ModelEffectSet::CollectDrawables(Node* node, PODVector<Drawable*>& dest, PODVector<Node*>& stack)
+{
+	if (!node)
+		return;
+	stack.Clear();
+	stack.Push(node);
+	while (stack.Size())
+	{
+		Node* current = stack.Back();
+		stack.Pop();
+		const Vector<SharedPtr<Component> >& components = current->GetComponents();
+		for (unsigned i = 0; i < components.Size(); ++i)
+		{
+			// The type info check replaces a dynamic_cast per component
+			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
+				dest.Push(static_cast<Drawable*>(components[i].Get()));
+		}
+		const Vector<SharedPtr<Node> >& children = current->GetChildren();
+		for (unsigned i = children.Size(); i > 0; --i)
+			stack.Push(children[i - 1].Get());
+	}
+}
+
+void ModelEffectSet::Collect()
+{
+	drawables_.Clear();
+	for (unsigned i = 0; i < roots_.Size(); ++i)
+	{
+		Node* root = roots_[i].Get();
+		if (!root)
+			continue;
+		if (tag_.Empty())
+		{
+			CollectDrawables(root, drawables_, stack_);
+			continue;
+		}
+
+		// Find the tagged nodes first, a tagged node inside a tagged subtree is already covered
+		PODVector<Node*> tagged;
+		stack_.Clear();
+		stack_.Push(root);
+		while (stack_.Size())
+		{
+			Node* current = stack_.Back();
+			stack_.Pop();
+			if (current->HasTag(tag_))
+			{
+				tagged.Push(current);
+				continue;
+			}
+			const Vector<SharedPtr<Node> >& children = current->GetChildren();
+			for (unsigned j = children.Size(); j > 0; --j)
+				stack_.Push(children[j - 1].Get());
+		}
+		for (unsigned j = 0; j < tagged.Size(); ++j)
+			CollectDrawables(tagged[j], drawables_, stack_);
+	}
+
+	// Roots may lie inside each other's subtrees, keep the first occurrence of every drawable
+	if (roots_.Size() > 1)
+	{
+		HashSet<Drawable*> seen;
+		unsigned count = 0;
+		for (unsigned i = 0; i < drawables_.Size(); ++i)
+		{
+			bool exists;
+			seen.Insert(drawables_[i], exists);
+			if (!exists)
+				drawables_[count++] = drawables_[i];
+		}
+		drawables_.Resize(count);
+	}
+
+	states_.Resize(drawables_.Size());
+	for (unsigned i = 0; i < drawables_.Size(); ++i)
+	{
+		states_[i].drawable_ = drawables_[i];
+		states_[i].effects_ = 0;
+	}
+}
+
+}
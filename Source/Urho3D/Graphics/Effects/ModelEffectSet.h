@@ -0,0 +1,73 @@
+#pragma once
+#include "../../Container/Ptr.h"
+#include "../../Container/Str.h"
+#include "../../Container/Vector.h"
+
+namespace Urho3D
+{
+	class Drawable;
+	class Node;
+
+	/// Effects applied to a drawable through a ModelEffectSet, one bit each.
+	enum ModelEffectFlags : unsigned char
+	{
+		MODEL_EFFECT_DIFFUSE = 0x1,
+		MODEL_EFFECT_TRANSPARENT = 0x2,
+		MODEL_EFFECT_WIREFRAME = 0x4,
+		MODEL_EFFECT_BLOOM = 0x8,
+		MODEL_EFFECT_TWINKLE = 0x10,
+		MODEL_EFFECT_HIDDEN = 0x20
+	};
+
+	/// Effect state of one drawable of a set.
+	struct ModelEffectState
+	{
+		/// Drawable, expires when the component is destroyed.
+		WeakPtr<Drawable> drawable_;
+		/// Applied effects, see ModelEffectFlags.
+		unsigned char effects_;
+	};
+
+	/// Drawables of some node subtrees, collected once so that ModelEffectUtil applies and reverts effects on all of them in bulk.
+	/// Effects applied through a set are reverted through the same set, SetNode, SetNodes and SetTag revert them before replacing
+	/// the drawables. Call Refresh after the subtrees gained or lost drawables.
+	class URHO3D_API ModelEffectSet
+	{
+	public:
+		/// Revert the applied effects and collect the drawables below a node.
+		void SetNode(Node* node);
+		/// Revert the applied effects and collect the drawables below several nodes. Drawables below more than one of them are collected once.
+		void SetNodes(const PODVector<Node*>& nodes);
+		/// Revert the applied effects and collect the drawables below every node under root carrying the tag.
+		void SetTag(Node* root, const String& tag);
+		/// Collect the drawables again from the same nodes, keeping the effect state of drawables still present.
+		void Refresh();
+		/// Revert every effect applied through the set.
+		void RevertEffects();
+		/// Forget the nodes and drawables. Effects stay applied.
+		void Clear();
+
+		/// Return the effect states.
+		Vector<ModelEffectState>& GetStates() { return states_; }
+		/// Return the number of drawables.
+		unsigned GetNumDrawables() const { return states_.Size(); }
+
+		/// Collect the drawables below a node without recursion. Stack is scratch storage kept by the caller.
+		static void CollectDrawables(Node* node, PODVector<Drawable*>& dest, PODVector<Node*>& stack);
+
+	private:
+		/// Collect the drawables of the roots, or of the tagged nodes below the roots when a tag is set.
+		void Collect();
+
+		/// Subtree roots.
+		Vector<WeakPtr<Node> > roots_;
+		/// Tag selecting the subtrees below the roots, empty to use the roots themselves.
+		String tag_;
+		/// Effect states of the collected drawables.
+		Vector<ModelEffectState> states_;
+		/// Scratch storage for collecting.
+		PODVector<Node*> stack_;
+		PODVector<Drawable*> drawables_;
+	};
+
+}
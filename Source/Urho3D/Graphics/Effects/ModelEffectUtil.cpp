@@ -1,4 +1,5 @@
 #include "../../Graphics/Effects/ModelEffectUtil.h"
+#include "../../Graphics/Effects/ModelEffectSet.h"
 #include "../../Graphics/Viewport.h"
 #include "../../Scene/Node.h"
 #include "../../Math/Color.h"
@@ -18,6 +19,113 @@
 namespace Urho3D
 {
 
+static MaterialShaderParameter MakeParameter(const char* name, const Variant& value)
+{
+	MaterialShaderParameter parameter;
+	parameter.name_ = name;
+	parameter.value_ = value;
+	return parameter;
+}
+
+/// Call function for every drawable below node, walking the hierarchy without recursion.
+template <class T> static void ForEachDrawable(Node* node, T function)
+{
+	PODVector<Drawable*> drawables;
+	PODVector<Node*> stack;
+	ModelEffectSet::CollectDrawables(node, drawables, stack);
+	for (unsigned i = 0; i < drawables.Size(); ++i)
+		function(drawables[i]);
+}
+
+/// Call function for the drawables of a set and record the effect in their state. Reverting visits only the drawables carrying the effect.
+template <class T> static void ForEachDrawable(ModelEffectSet& set, unsigned char effect, bool apply, T function)
+{
+	Vector<ModelEffectState>& states = set.GetStates();
+	for (unsigned i = 0; i < states.Size(); ++i)
+	{
+		ModelEffectState& state = states[i];
+		if (!apply && !(state.effects_ & effect))
+			continue;
+		Drawable* drawable = state.drawable_.Get();
+		if (!drawable)
+			continue;
+		function(drawable);
+		if (apply)
+			state.effects_ |= effect;
+		else
+			state.effects_ &= ~effect;
+	}
+}
+
+/// Return a technique through the resource cache of the first drawable of a set.
+static Technique* GetTechnique(ModelEffectSet& set, const char* name)
+{
+	Vector<ModelEffectState>& states = set.GetStates();
+	for (unsigned i = 0; i < states.Size(); ++i)
+	{
+		if (Drawable* drawable = states[i].drawable_.Get())
+			return drawable->GetSubsystem<ResourceCache>()->GetResource<Technique>(name);
+	}
+	return nullptr;
+}
+
+/// Keep the material diffuse color of every batch and replace its alpha. Parameter is reused between calls.
+static void ApplyTransparent(Drawable* drawable, Technique* technique, float alpha, MaterialShaderParameter& parameter)
+{
+	drawable->SetOverrideTechnique(technique);
+	const Vector<SourceBatch>& batches = drawable->GetBatches();
+	for (unsigned i = 0; i < batches.Size(); ++i)
+	{
+		Color color = Color::WHITE;
+		if (batches[i].material_)
+		{
+			const HashMap<StringHash, MaterialShaderParameter>& materialParameters = batches[i].material_->GetShaderParameters();
+			HashMap<StringHash, MaterialShaderParameter>::ConstIterator j = materialParameters.Find(PSP_MATDIFFCOLOR);
+			if (j != materialParameters.End())
+				color = j->second_.value_.GetColor();
+		}
+		parameter.value_ = Color(color, alpha);
+		drawable->SetOverrideShaderParameter(i, PSP_MATDIFFCOLOR, parameter);
+	}
+}
+
+static void RevertOverrideTechniqueAndDiffuse(Drawable* drawable)
+{
+	drawable->CancelOverrideTechnique();
+	drawable->EraseOverrideShaderParameter(PSP_MATDIFFCOLOR);
+}
+
+static void ApplyVisible(Drawable* drawable, bool visible)
+{
+	if (visible)
+		drawable->CancelOverrideViewMask();
+	else
+		drawable->SetOverrideViewMask(0);
+}
+
+/// Blink every batch from its material diffuse color to color. Batches of one material share an animation.
+static void ApplyTwinkle(Drawable* drawable, float period, const Color& color, HashMap<Material*, SharedPtr<ValueAnimation> >& animations)
+{
+	const Vector<SourceBatch>& batches = drawable->GetBatches();
+	for (unsigned i = 0; i < batches.Size(); ++i)
+	{
+		Material* material = batches[i].material_;
+		if (!material)
+			continue;
+		SharedPtr<ValueAnimation>& animation = animations[material];
+		if (!animation)
+		{
+			const Variant& diffColor = material->GetShaderParameter("MatDiffColor");
+			const Color baseColor = diffColor != Variant::EMPTY ? diffColor.GetColor() : Color::WHITE;
+			animation = new ValueAnimation(drawable->GetContext());
+			animation->SetKeyFrame(0.0f, baseColor);
+			animation->SetKeyFrame(period / 2.f, color);
+			animation->SetKeyFrame(period, baseColor);
+		}
+		drawable->SetOverrideShaderParameterAnimation(i, "MatDiffColor", animation);
+	}
+}
+
 void ModelEffectUtil::SetOutlinePerspect(const Viewport* viewport, Node* node)
 {
 	if(!viewport)
@@ -176,54 +284,14 @@ void ModelEffectUtil::SetDiffuse(Node* node, Color diffColor)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-
-				drawable->SetOverrideShaderParameter("MatDiffColor", diffColor);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetDiffuse(node->GetChild(i), diffColor);
-		}
-	}
+	const MaterialShaderParameter parameter = MakeParameter("MatDiffColor", diffColor);
+	ForEachDrawable(node, [&](Drawable* drawable) { drawable->SetOverrideShaderParameter(PSP_MATDIFFCOLOR, parameter); });
 }
 void ModelEffectUtil::CancelDiffuse(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->RemoveOverrideShaderParameter("MatDiffColor");
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelDiffuse(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->EraseOverrideShaderParameter(PSP_MATDIFFCOLOR); });
 }
 
 void ModelEffectUtil::SetUnshadedColor(const Viewport* viewport, Node* node, Color color)
@@ -254,183 +322,45 @@ void ModelEffectUtil::SetModelTransparent(Node * node, float alpha)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		auto* cache = node->GetSubsystem<ResourceCache>();
-		Technique* technique = cache->GetResource<Technique>("Techniques/PBR/ModelTransparent.xml");
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideTechnique(technique);
-				for (int j = 0; j < drawable->GetBatches().Size(); ++j)
-				{
-					if (drawable->GetBatches()[j].material_)
-					{
-						auto& varient = drawable->GetBatches()[j].material_->GetShaderParameter("MatDiffColor");
-						if (varient != Variant::EMPTY)
-						{
-							drawable->SetOverrideShaderParameter(j, "MatDiffColor", Color(varient.GetColor(), alpha));
-						}
-						else
-						{
-							drawable->SetOverrideShaderParameter(j, "MatDiffColor", Color(1.f, 1.f, 1.f, alpha));
-						}
-					}
-					else
-					{
-						drawable->SetOverrideShaderParameter(j, "MatDiffColor", Color(1.f, 1.f, 1.f, alpha));
-					}
-				}
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetModelTransparent(node->GetChild(i), alpha);
-		}
-	}
+	Technique* technique = node->GetSubsystem<ResourceCache>()->GetResource<Technique>("Techniques/PBR/ModelTransparent.xml");
+	MaterialShaderParameter parameter = MakeParameter("MatDiffColor", Color::WHITE);
+	ForEachDrawable(node, [&](Drawable* drawable) { ApplyTransparent(drawable, technique, alpha, parameter); });
 }
 void ModelEffectUtil::CancelModelTransparent(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->CancelOverrideTechnique();
-				drawable->RemoveOverrideShaderParameter("MatDiffColor");
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelModelTransparent(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, RevertOverrideTechniqueAndDiffuse);
 }
 void ModelEffectUtil::SetModelUnshadedTransparent(Node * node, Color color)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
+	Technique* technique = node->GetSubsystem<ResourceCache>()->GetResource<Technique>("Techniques/PBR/ModelUnshadedTransparent.xml");
+	const MaterialShaderParameter parameter = MakeParameter("MatDiffColor", color);
+	ForEachDrawable(node, [&](Drawable* drawable)
 	{
-		auto* cache = node->GetSubsystem<ResourceCache>();
-		Technique* technique = cache->GetResource<Technique>("Techniques/PBR/ModelUnshadedTransparent.xml");
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideTechnique(technique);
-				drawable->SetOverrideShaderParameter("MatDiffColor", color);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetModelUnshadedTransparent(node->GetChild(i), color);
-		}
-	}
+		drawable->SetOverrideTechnique(technique);
+		drawable->SetOverrideShaderParameter(PSP_MATDIFFCOLOR, parameter);
+	});
 }
 void ModelEffectUtil::CancelModelUnshadedTransparent(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->CancelOverrideTechnique();
-				drawable->RemoveOverrideShaderParameter("MatDiffColor");
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelModelUnshadedTransparent(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, RevertOverrideTechniqueAndDiffuse);
 }
 void ModelEffectUtil::SetWireframe(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideFillMode(FILL_WIREFRAME);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetWireframe(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->SetOverrideFillMode(FILL_WIREFRAME); });
 }
 void ModelEffectUtil::CancelWireframe(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideFillMode(FILL_SOLID);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelWireframe(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->SetOverrideFillMode(FILL_SOLID); });
 }
 void ModelEffectUtil::SetTranslucent(const Viewport* viewport, Node * node)
 {
@@ -485,263 +415,115 @@ void ModelEffectUtil::SetBloom(Node * node, Color color)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideShaderParameter("MatEmissiveColor", color);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetBloom(node->GetChild(i), color);
-		}
-	}
+	const MaterialShaderParameter parameter = MakeParameter("MatEmissiveColor", color);
+	ForEachDrawable(node, [&](Drawable* drawable) { drawable->SetOverrideShaderParameter(PSP_MATEMISSIVECOLOR, parameter); });
 }
 void ModelEffectUtil::CancelBloom(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->RemoveOverrideShaderParameter("MatEmissiveColor");
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelBloom(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->EraseOverrideShaderParameter(PSP_MATEMISSIVECOLOR); });
 }
 void ModelEffectUtil::SetDynamicHint(Node * node, DynamicType dynamicHint)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetDynamicType(dynamicHint);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetDynamicHint(node->GetChild(i), dynamicHint);
-		}
-	}
+	ForEachDrawable(node, [=](Drawable* drawable) { drawable->SetDynamicType(dynamicHint); });
 }
 void ModelEffectUtil::SetModelVisible(Node * node, bool visible)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				if (visible)
-					drawable->CancelOverrideViewMask();
-				else
-					drawable->SetOverrideViewMask(0);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetModelVisible(node->GetChild(i), visible);
-		}
-	}
+	ForEachDrawable(node, [=](Drawable* drawable) { ApplyVisible(drawable, visible); });
 }
 void ModelEffectUtil::SetTwinkle(Node * node, float period, Color color)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				/*for (int i = 0; i < drawable->GetBatches().Size(); ++i)
-				{
-					if(drawable->GetBatches()[i].material_)
-					{
-						if(drawable->GetBatches()[i].material_->GetShaderParameter("MatDiffColor") != Variant::EMPTY)
-						{
-							SharedPtr<ValueAnimation> colorAnimation(new ValueAnimation(drawable->GetContext()));
-							colorAnimation->SetKeyFrame(0.0f, drawable->GetBatches()[i].material_->GetShaderParameter("MatDiffColor").GetColor());
-							colorAnimation->SetKeyFrame(period/2.f, color);
-							colorAnimation->SetKeyFrame(period, drawable->GetBatches()[i].material_->GetShaderParameter("MatDiffColor").GetColor());
-							drawable->GetBatches()[i].material_->SetShaderParameterAnimation("MatDiffColor", colorAnimation);
-						}else
-						{
-							SharedPtr<ValueAnimation> colorAnimation(new ValueAnimation(drawable->GetContext()));
-							colorAnimation->SetKeyFrame(0.0f, Color(1.,1.,1.,1.));
-							colorAnimation->SetKeyFrame(period/2.f, color);
-							colorAnimation->SetKeyFrame(period, Color(1., 1., 1., 1.));
-							drawable->GetBatches()[i].material_->SetShaderParameterAnimation("MatDiffColor", colorAnimation);
-						}
-					}
-				}*/
-				for( int j = 0; j < drawable->GetBatches().Size(); ++j)
-				if (drawable->GetBatches().Size() > 0 && drawable->GetBatches()[j].material_)
-				{
-					if (drawable->GetBatches()[j].material_->GetShaderParameter("MatDiffColor") != Variant::EMPTY)
-					{
-						SharedPtr<ValueAnimation> colorAnimation(new ValueAnimation(drawable->GetContext()));
-						colorAnimation->SetKeyFrame(0.0f, drawable->GetBatches()[j].material_->GetShaderParameter("MatDiffColor").GetColor());
-						colorAnimation->SetKeyFrame(period / 2.f, color);
-						colorAnimation->SetKeyFrame(period, drawable->GetBatches()[j].material_->GetShaderParameter("MatDiffColor").GetColor());
-						drawable->SetOverrideShaderParameterAnimation(j, "MatDiffColor", colorAnimation);
-					}else
-					{
-						SharedPtr<ValueAnimation> colorAnimation(new ValueAnimation(drawable->GetContext()));
-						colorAnimation->SetKeyFrame(0.0f, Color::WHITE);
-						colorAnimation->SetKeyFrame(period / 2.f, color);
-						colorAnimation->SetKeyFrame(period, Color::WHITE);
-						drawable->SetOverrideShaderParameterAnimation(j, "MatDiffColor", colorAnimation);
-					}
-				}
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetTwinkle(node->GetChild(i), period, color);
-		}
-	}
+	HashMap<Material*, SharedPtr<ValueAnimation> > animations;
+	ForEachDrawable(node, [&](Drawable* drawable) { ApplyTwinkle(drawable, period, color, animations); });
 }
 void ModelEffectUtil::CancelTwinkle(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-//				for (int i = 0; i < drawable->GetBatches().Size(); ++i)
-//				{
-//					if (drawable->GetBatches()[i].material_)
-//					{
-//						drawable->GetBatches()[i].material_->SetShaderParameterAnimation("MatDiffColor", nullptr);
-//					}
-//				}
-				drawable->SetOverrideShaderParameterAnimation("MatDiffColor", nullptr);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelTwinkle(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->SetOverrideShaderParameterAnimation("MatDiffColor", nullptr); });
 }
 
 void ModelEffectUtil::SetNormalShowEffect(Node* node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		auto* cache = node->GetSubsystem<ResourceCache>();
-		Technique* technique = cache->GetResource<Technique>("Techniques/Debug/DebugNormal.xml");
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->SetOverrideTechnique(technique);
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			SetNormalShowEffect(node->GetChild(i));
-		}
-	}
+	Technique* technique = node->GetSubsystem<ResourceCache>()->GetResource<Technique>("Techniques/Debug/DebugNormal.xml");
+	ForEachDrawable(node, [=](Drawable* drawable) { drawable->SetOverrideTechnique(technique); });
 }
 	
 void ModelEffectUtil::CancelNormalShowEffect(Node * node)
 {
 	if (!node)
 		return;
-	if (node->GetNumComponents() > 0)
-	{
-		const Vector<SharedPtr<Component> >& components = node->GetComponents();
-		for (int i = 0; i < components.Size(); i++)
-		{
-			if (components[i]->GetTypeInfo()->IsTypeOf(Drawable::GetTypeStatic()))
-			{
-				Drawable* drawable = dynamic_cast<Drawable*>(components[i].Get());
-				if (!drawable)
-					continue;
-				drawable->CancelOverrideTechnique();
-			}
-		}
-	}
-	if (node->GetNumChildren() > 0)
-	{
-		for (int i = 0; i < node->GetNumChildren(); i++)
-		{
-			CancelNormalShowEffect(node->GetChild(i));
-		}
-	}
+	ForEachDrawable(node, [](Drawable* drawable) { drawable->CancelOverrideTechnique(); });
+}
+void ModelEffectUtil::SetDiffuse(ModelEffectSet& set, Color diffColor)
+{
+	const MaterialShaderParameter parameter = MakeParameter("MatDiffColor", diffColor);
+	ForEachDrawable(set, MODEL_EFFECT_DIFFUSE, true, [&](Drawable* drawable) { drawable->SetOverrideShaderParameter(PSP_MATDIFFCOLOR, parameter); });
+}
+
+void ModelEffectUtil::CancelDiffuse(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_DIFFUSE, false, [](Drawable* drawable) { drawable->EraseOverrideShaderParameter(PSP_MATDIFFCOLOR); });
+}
+
+void ModelEffectUtil::SetModelTransparent(ModelEffectSet& set, float alpha)
+{
+	Technique* technique = GetTechnique(set, "Techniques/PBR/ModelTransparent.xml");
+	MaterialShaderParameter parameter = MakeParameter("MatDiffColor", Color::WHITE);
+	ForEachDrawable(set, MODEL_EFFECT_TRANSPARENT, true, [&](Drawable* drawable) { ApplyTransparent(drawable, technique, alpha, parameter); });
 }
+
+void ModelEffectUtil::CancelModelTransparent(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_TRANSPARENT, false, RevertOverrideTechniqueAndDiffuse);
+}
+
+void ModelEffectUtil::SetWireframe(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_WIREFRAME, true, [](Drawable* drawable) { drawable->SetOverrideFillMode(FILL_WIREFRAME); });
+}
+
+void ModelEffectUtil::CancelWireframe(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_WIREFRAME, false, [](Drawable* drawable) { drawable->SetOverrideFillMode(FILL_SOLID); });
+}
+
+void ModelEffectUtil::SetBloom(ModelEffectSet& set, Color color)
+{
+	const MaterialShaderParameter parameter = MakeParameter("MatEmissiveColor", color);
+	ForEachDrawable(set, MODEL_EFFECT_BLOOM, true, [&](Drawable* drawable) { drawable->SetOverrideShaderParameter(PSP_MATEMISSIVECOLOR, parameter); });
+}
+
+void ModelEffectUtil::CancelBloom(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_BLOOM, false, [](Drawable* drawable) { drawable->EraseOverrideShaderParameter(PSP_MATEMISSIVECOLOR); });
+}
+
+void ModelEffectUtil::SetModelVisible(ModelEffectSet& set, bool visible)
+{
+	ForEachDrawable(set, MODEL_EFFECT_HIDDEN, !visible, [=](Drawable* drawable) { ApplyVisible(drawable, visible); });
+}
+
+void ModelEffectUtil::SetTwinkle(ModelEffectSet& set, float period, Color color)
+{
+	HashMap<Material*, SharedPtr<ValueAnimation> > animations;
+	ForEachDrawable(set, MODEL_EFFECT_TWINKLE, true, [&](Drawable* drawable) { ApplyTwinkle(drawable, period, color, animations); });
+}
+
+void ModelEffectUtil::CancelTwinkle(ModelEffectSet& set)
+{
+	ForEachDrawable(set, MODEL_EFFECT_TWINKLE, false, [](Drawable* drawable) { drawable->SetOverrideShaderParameterAnimation("MatDiffColor", nullptr); });
+}
+
 void ModelEffectUtil::SetFireEffect(Node * node, Color color)
 {
 	
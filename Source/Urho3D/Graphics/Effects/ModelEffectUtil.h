@@ -1,12 +1,14 @@
 #pragma once
+#include "../../Graphics/Drawable.h"
+#include "../../Math/Color.h"
 
 namespace Urho3D
 {
 	class Viewport;
 	class Node;
-	class Color;
-	enum DynamicType;
-	class ModelEffectUtil
+	class ModelEffectSet;
+
+	class URHO3D_API ModelEffectUtil
 	{
 	public:
 		///͸Ч
@@ -56,6 +58,19 @@ namespace Urho3D
 		///ʾ
 		static void SetNormalShowEffect(Node* node);
 		static void CancelNormalShowEffect(Node* node);
+
+		/// Bulk versions working on the drawables collected by a ModelEffectSet. Cancel reverts only the drawables the set applied the effect to.
+		static void SetDiffuse(ModelEffectSet& set, Color diffColor);
+		static void CancelDiffuse(ModelEffectSet& set);
+		static void SetModelTransparent(ModelEffectSet& set, float alpha);
+		static void CancelModelTransparent(ModelEffectSet& set);
+		static void SetWireframe(ModelEffectSet& set);
+		static void CancelWireframe(ModelEffectSet& set);
+		static void SetBloom(ModelEffectSet& set, Color color);
+		static void CancelBloom(ModelEffectSet& set);
+		static void SetModelVisible(ModelEffectSet& set, bool visible);
+		static void SetTwinkle(ModelEffectSet& set, float period, Color color);
+		static void CancelTwinkle(ModelEffectSet& set);
 	};
 
 }
@@ -45,6 +45,10 @@ namespace Urho3D
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
+/// Minimum number of drawables in the octree to split a threaded query.
+static const unsigned MIN_THREADED_QUERY_DRAWABLES = 1024;
+/// Octree levels below the root that a threaded query is split into.
+static const unsigned THREADED_QUERY_LEVELS = 2;
 
 extern const char* SUBSYSTEM_CATEGORY;
 
@@ -63,6 +67,33 @@ void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
+void GetDrawablesWork(const WorkItem* item, unsigned threadIndex)
+{
+    const OctreeQuerySegment& segment = *(reinterpret_cast<OctreeQuerySegment*>(item->aux_));
+    const Octant* octant = segment.octant_;
+    OctreeQuery& query = *segment.query_;
+    PODVector<Drawable*>& result = *segment.result_;
+
+    if (octant->drawables_.Size())
+    {
+        auto** start = const_cast<Drawable**>(&octant->drawables_[0]);
+        Drawable** end = start + octant->drawables_.Size();
+        if (query.IsCacheable())
+            query.TestDrawablesCached(start, octant->drawableData_, segment.inside_, result);
+        else
+            query.TestDrawablesThreaded(start, end, segment.inside_, result);
+    }
+
+    if (segment.recursive_)
+    {
+        for (auto child : octant->children_)
+        {
+            if (child)
+                child->GetDrawablesInternal(query, segment.inside_, result);
+        }
+    }
+}
+
 inline bool CompareRayQueryResults(const RayQueryResult& lhs, const RayQueryResult& rhs)
 {
     return lhs.distance_ < rhs.distance_;
@@ -85,10 +116,13 @@ Octant::~Octant()
         for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
         {
             (*i)->SetOctant(root_);
+            (*i)->octantIndex_ = root_->drawables_.Size();
             root_->drawables_.Push(*i);
+            root_->drawableData_.Push(*i);
             root_->QueueUpdate(*i);
         }
         drawables_.Clear();
+        drawableData_.Clear();
         numDrawables_ = 0;
     }
 
@@ -204,6 +238,12 @@ void Octant::ResetRoot()
     }
 }
 
+void Octant::NotifyDrawableChanged(Drawable* drawable)
+{
+    if (root_ && drawable->GetDynamicType() == Static && !drawable->HasVolatileWorldBoundingBox())
+        root_->MarkStaticDrawablesChanged();
+}
+
 void Octant::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
 {
     if (debug && debug->IsInside(worldBoundingBox_))
@@ -244,7 +284,10 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     {
         auto** start = const_cast<Drawable**>(&drawables_[0]);
         Drawable** end = start + drawables_.Size();
-        query.TestDrawables(start, end, inside);
+        if (query.IsCacheable())
+            query.TestDrawablesCached(start, drawableData_, inside, query.result_);
+        else
+            query.TestDrawables(start, end, inside);
     }
 
     for (auto child : children_)
@@ -254,6 +297,96 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     }
 }
 
+void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside, PODVector<Drawable*>& result) const
+{
+    if (this != root_)
+    {
+        Intersection res = query.TestOctant(cullingBox_, inside);
+        if (res == INSIDE)
+            inside = true;
+        else if (res == OUTSIDE)
+            return;
+    }
+
+    if (drawables_.Size())
+    {
+        auto** start = const_cast<Drawable**>(&drawables_[0]);
+        Drawable** end = start + drawables_.Size();
+        if (query.IsCacheable())
+            query.TestDrawablesCached(start, drawableData_, inside, result);
+        else
+            query.TestDrawablesThreaded(start, end, inside, result);
+    }
+
+    for (auto child : children_)
+    {
+        if (child)
+            child->GetDrawablesInternal(query, inside, result);
+    }
+}
+
+void Octant::GetQuerySegments(OctreeQuery& query, bool inside, unsigned levels, PODVector<OctreeQuerySegment>& segments) const
+{
+    if (this != root_)
+    {
+        Intersection res = query.TestOctant(cullingBox_, inside);
+        if (res == INSIDE)
+            inside = true;
+        else if (res == OUTSIDE)
+            return;
+    }
+
+    OctreeQuerySegment segment;
+    segment.octant_ = this;
+    segment.inside_ = inside;
+    segment.query_ = &query;
+    segment.result_ = nullptr;
+
+    // At the last level the whole subtree goes into one segment, the worker tests the child octants
+    if (!levels)
+    {
+        segment.recursive_ = true;
+        segments.Push(segment);
+        return;
+    }
+
+    if (drawables_.Size())
+    {
+        segment.recursive_ = false;
+        segments.Push(segment);
+    }
+
+    for (auto child : children_)
+    {
+        if (child)
+            child->GetQuerySegments(query, inside, levels - 1, segments);
+    }
+}
+
+void Octant::GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned insideMask, unsigned testMask) const
+{
+    if (this != root_)
+    {
+        query.TestOctant(cullingBox_, insideMask, testMask);
+        // Outside all frustums, so cull this octant, its children & drawables
+        if (!(insideMask | testMask))
+            return;
+    }
+
+    if (drawables_.Size())
+    {
+        auto** start = const_cast<Drawable**>(&drawables_[0]);
+        Drawable** end = start + drawables_.Size();
+        query.TestDrawables(start, end, insideMask, testMask);
+    }
+
+    for (auto child : children_)
+    {
+        if (child)
+            child->GetDrawablesInternal(query, insideMask, testMask);
+    }
+}
+
 void Octant::GetDrawablesInternal(RayOctreeQuery& query) const
 {
     float octantDist = query.ray_.HitDistance(cullingBox_);
@@ -453,11 +586,17 @@ void Octree::Update(const FrameInfo& frame)
             // Skip if no octant or does not belong to this octree anymore
             if (!octant || octant->GetRoot() != this)
                 continue;
-            // Skip if still fits the current octant
+            // Skip if still fits the current octant, but refresh the culling data it caches
             if (drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE && octant->CheckDrawableFit(box))
+            {
+                octant->UpdateDrawable(drawable);
                 continue;
+            }
 
             InsertDrawable(drawable);
+            // Reinsertion to the same octant does not add the drawable again
+            if (drawable->GetOctant() == octant)
+                octant->UpdateDrawable(drawable);
 
 #ifdef _DEBUG
             // Verify that the drawable will be culled correctly
@@ -492,10 +631,55 @@ void Octree::RemoveManualDrawable(Drawable* drawable)
         octant->RemoveDrawable(drawable);
 }
 
-void Octree::GetDrawables(OctreeQuery& query) const
+void Octree::GetDrawables(OctreeQuery& query, bool threaded) const
 {
     query.result_.Clear();
-    GetDrawablesInternal(query, false);
+
+    auto* queue = threaded ? GetSubsystem<WorkQueue>() : nullptr;
+    if (!queue || !queue->GetNumThreads() || numDrawables_ < MIN_THREADED_QUERY_DRAWABLES || !query.IsThreadSafe() ||
+        !Thread::IsMainThread())
+    {
+        GetDrawablesInternal(query, false);
+        return;
+    }
+
+    URHO3D_PROFILE(ThreadedOctreeQuery);
+
+    // Octants near the root are tested here, below them each segment is traversed in a work item into its own result
+    querySegments_.Clear();
+    GetQuerySegments(query, false, THREADED_QUERY_LEVELS, querySegments_);
+    if (querySegmentResults_.Size() < querySegments_.Size())
+        querySegmentResults_.Resize(querySegments_.Size());
+
+    for (unsigned i = 0; i < querySegments_.Size(); ++i)
+    {
+        OctreeQuerySegment& segment = querySegments_[i];
+        segment.result_ = &querySegmentResults_[i];
+        segment.result_->Clear();
+
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = GetDrawablesWork;
+        item->aux_ = &segment;
+        queue->AddWorkItem(item);
+    }
+    queue->Complete(M_MAX_UNSIGNED);
+
+    // Concatenate in traversal order, so the result is the same as from a serial query
+    unsigned numResults = 0;
+    for (unsigned i = 0; i < querySegments_.Size(); ++i)
+        numResults += querySegmentResults_[i].Size();
+    query.result_.Reserve(numResults);
+    for (unsigned i = 0; i < querySegments_.Size(); ++i)
+        query.result_.Push(querySegmentResults_[i]);
+}
+
+void Octree::GetDrawables(MultiFrustumOctreeQuery& query) const
+{
+    query.result_.Clear();
+    query.resultMasks_.Clear();
+    if (!query.frustums_.Empty())
+        GetDrawablesInternal(query, 0, query.GetFrustumsMask());
 }
 
 void Octree::Raycast(RayOctreeQuery& query) const
@@ -569,6 +753,13 @@ void Octree::CancelUpdate(Drawable* drawable)
     drawable->updateQueued_ = false;
 }
 
+void Octree::SetTrackRemovals(bool enable)
+{
+    trackRemovals_ = enable;
+    if (!enable)
+        removedDrawables_.Clear();
+}
+
 void Octree::DrawDebugGeometry(bool depthTest)
 {
     auto* debug = GetComponent<DebugRenderer>();
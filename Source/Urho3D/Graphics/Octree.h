@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "../Container/HashSet.h"
 #include "../Container/List.h"
 #include "../Core/Mutex.h"
 #include "../Graphics/Drawable.h"
@@ -31,13 +32,32 @@ namespace Urho3D
 {
 
 class Octree;
+class Octant;
+struct WorkItem;
 
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
 
+/// Part of a threaded octree query: the drawables of one octant, and of its child octants when recursive.
+struct OctreeQuerySegment
+{
+    /// Octant.
+    const Octant* octant_;
+    /// Whether the octant is already known to be inside the query volume.
+    bool inside_;
+    /// Whether to include the child octants.
+    bool recursive_;
+    /// Query.
+    OctreeQuery* query_;
+    /// Result vector of this segment.
+    PODVector<Drawable*>* result_;
+};
+
 /// %Octree octant
 class URHO3D_API Octant
 {
+    friend void GetDrawablesWork(const WorkItem* item, unsigned threadIndex);
+
 public:
     /// Construct.
     Octant(const BoundingBox& box, unsigned level, Octant* parent, Octree* root, unsigned index = ROOT_INDEX);
@@ -57,21 +77,40 @@ public:
     void AddDrawable(Drawable* drawable)
     {
         drawable->SetOctant(this);
+        drawable->octantIndex_ = drawables_.Size();
         drawables_.Push(drawable);
+        drawableData_.Push(drawable);
         IncDrawableCount();
+        NotifyDrawableChanged(drawable);
     }
 
     /// Remove a drawable object from this octant.
     void RemoveDrawable(Drawable* drawable, bool resetOctant = true)
     {
-        if (drawables_.Remove(drawable))
+        // The drawable knows its index, unless it has already been added to another octant
+        unsigned index = drawable->octant_ == this ? drawable->octantIndex_ : drawables_.IndexOf(drawable);
+        if (index < drawables_.Size() && drawables_[index] == drawable)
         {
+            drawables_.EraseSwap(index);
+            drawableData_.EraseSwap(index);
+            if (index < drawables_.Size())
+                drawables_[index]->octantIndex_ = index;
             if (resetOctant)
                 drawable->SetOctant(nullptr);
             DecDrawableCount();
+            NotifyDrawableChanged(drawable);
         }
     }
 
+    /// Refresh the cached culling data of a drawable in this octant. The static revision only advances if the data changed.
+    void UpdateDrawable(Drawable* drawable)
+    {
+        if (drawableData_.Set(drawable->octantIndex_, drawable))
+            NotifyDrawableChanged(drawable);
+    }
+    /// Advance the octree's static revision if the drawable is static. Called when a drawable is added, removed or changed.
+    void NotifyDrawableChanged(Drawable* drawable);
+
     /// Return world-space bounding box.
     const BoundingBox& GetWorldBoundingBox() const { return worldBoundingBox_; }
 
@@ -103,6 +142,12 @@ protected:
     void Initialize(const BoundingBox& box);
     /// Return drawable objects by a query, called internally.
     void GetDrawablesInternal(OctreeQuery& query, bool inside) const;
+    /// Return drawable objects by a thread safe query into a separate result vector, called internally.
+    void GetDrawablesInternal(OctreeQuery& query, bool inside, PODVector<Drawable*>& result) const;
+    /// Split a threaded query into segments in traversal order, descending the given number of levels, called internally.
+    void GetQuerySegments(OctreeQuery& query, bool inside, unsigned levels, PODVector<OctreeQuerySegment>& segments) const;
+    /// Return drawable objects by a multi-frustum query, called internally.
+    void GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned insideMask, unsigned testMask) const;
     /// Return drawable objects by a ray query, called internally.
     void GetDrawablesInternal(RayOctreeQuery& query) const;
     /// Return drawable objects only for a threaded ray query, called internally.
@@ -138,6 +183,8 @@ protected:
     BoundingBox cullingBox_;
     /// Drawable objects.
     PODVector<Drawable*> drawables_;
+    /// Culling data of the drawable objects.
+    DrawableCullData drawableData_;
     /// Child octants.
     Octant* children_[NUM_OCTANTS]{};
     /// World bounding box center.
@@ -181,8 +228,10 @@ public:
     /// Remove a manually added drawable.
     void RemoveManualDrawable(Drawable* drawable);
 
-    /// Return drawable objects by a query.
-    void GetDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a query. When threaded, a large octree is traversed on the work queue if the query is thread safe. The result order is the same either way. Threaded queries must be made from the main thread outside work items.
+    void GetDrawables(OctreeQuery& query, bool threaded = false) const;
+    /// Return drawable objects by a multi-frustum query, traversing the octree once for all frustums.
+    void GetDrawables(MultiFrustumOctreeQuery& query) const;
     /// Return drawable objects by a ray query.
     void Raycast(RayOctreeQuery& query) const;
     /// Return the closest drawable object by a ray query.
@@ -190,11 +239,21 @@ public:
 
     /// Return subdivision levels.
     unsigned GetNumLevels() const { return numLevels_; }
+    /// Return the static revision, advanced whenever a static drawable is added, removed, moved or changes its view mask. Views use it to validate cached visibility.
+    unsigned GetStaticRevision() const { return staticRevision_; }
+    /// Advance the static revision.
+    void MarkStaticDrawablesChanged() { ++staticRevision_; }
 
     /// Mark drawable object as requiring an update and a reinsertion.
     void QueueUpdate(Drawable* drawable);
     /// Cancel drawable object's update.
     void CancelUpdate(Drawable* drawable);
+    /// Set whether to record drawables removed from the octree. Disabling clears the record. Used by Renderer to keep shared culling results valid over view update event handlers.
+    void SetTrackRemovals(bool enable);
+    /// Record a drawable removed from the octree if tracking is enabled. Called by Drawable.
+    void NotifyDrawableRemoved(Drawable* drawable) { if (trackRemovals_) removedDrawables_.Insert(drawable); }
+    /// Return drawables removed since tracking was enabled. They may have been destroyed, so only compare the pointers.
+    const HashSet<Drawable*>& GetRemovedDrawables() const { return removedDrawables_; }
     /// Visualize the component as debug geometry.
     void DrawDebugGeometry(bool depthTest);
 
@@ -212,8 +271,18 @@ private:
     Mutex octreeMutex_;
     /// Ray query temporary list of drawables.
     mutable PODVector<Drawable*> rayQueryDrawables_;
+    /// Threaded query segments.
+    mutable PODVector<OctreeQuerySegment> querySegments_;
+    /// Threaded query result vectors per segment, kept to avoid reallocation.
+    mutable Vector<PODVector<Drawable*> > querySegmentResults_;
     /// Subdivision level.
     unsigned numLevels_;
+    /// Static drawable revision.
+    unsigned staticRevision_{};
+    /// Drawables removed while tracking removals.
+    HashSet<Drawable*> removedDrawables_;
+    /// Removal tracking flag.
+    bool trackRemovals_{};
 };
 
 }
@@ -24,6 +24,10 @@
 
 #include "../Graphics/OctreeQuery.h"
 
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Urho3D
@@ -95,6 +99,76 @@ void BoxOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool inside
     }
 }
 
+void DrawableCullData::Push(Drawable* drawable)
+{
+    centerX_.Push(0.0f);
+    centerY_.Push(0.0f);
+    centerZ_.Push(0.0f);
+    edgeX_.Push(0.0f);
+    edgeY_.Push(0.0f);
+    edgeZ_.Push(0.0f);
+    viewMasks_.Push(0);
+    flags_.Push(0);
+    volatile_.Push(0);
+    dynamic_.Push(0);
+    Set(flags_.Size() - 1, drawable);
+}
+
+bool DrawableCullData::Set(unsigned index, Drawable* drawable)
+{
+    const BoundingBox& box = drawable->GetWorldBoundingBox();
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    auto isVolatile = (unsigned char)drawable->HasVolatileWorldBoundingBox();
+    auto isDynamic = (unsigned char)(isVolatile || drawable->GetDynamicType() != Static);
+
+    if (centerX_[index] == center.x_ && centerY_[index] == center.y_ && centerZ_[index] == center.z_ &&
+        edgeX_[index] == edge.x_ && edgeY_[index] == edge.y_ && edgeZ_[index] == edge.z_ &&
+        viewMasks_[index] == drawable->GetViewMask() && flags_[index] == drawable->GetDrawableFlags() &&
+        volatile_[index] == isVolatile && dynamic_[index] == isDynamic)
+        return false;
+
+    centerX_[index] = center.x_;
+    centerY_[index] = center.y_;
+    centerZ_[index] = center.z_;
+    edgeX_[index] = edge.x_;
+    edgeY_[index] = edge.y_;
+    edgeZ_[index] = edge.z_;
+    viewMasks_[index] = drawable->GetViewMask();
+    flags_[index] = drawable->GetDrawableFlags();
+    volatile_[index] = isVolatile;
+    dynamic_[index] = isDynamic;
+    return true;
+}
+
+void DrawableCullData::EraseSwap(unsigned index)
+{
+    centerX_.EraseSwap(index);
+    centerY_.EraseSwap(index);
+    centerZ_.EraseSwap(index);
+    edgeX_.EraseSwap(index);
+    edgeY_.EraseSwap(index);
+    edgeZ_.EraseSwap(index);
+    viewMasks_.EraseSwap(index);
+    flags_.EraseSwap(index);
+    volatile_.EraseSwap(index);
+    dynamic_.EraseSwap(index);
+}
+
+void DrawableCullData::Clear()
+{
+    centerX_.Clear();
+    centerY_.Clear();
+    centerZ_.Clear();
+    edgeX_.Clear();
+    edgeY_.Clear();
+    edgeZ_.Clear();
+    viewMasks_.Clear();
+    flags_.Clear();
+    volatile_.Clear();
+    dynamic_.Clear();
+}
+
 Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -104,6 +178,11 @@ Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 }
 
 void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool inside)
+{
+    TestDrawablesThreaded(start, end, inside, result_);
+}
+
+void FrustumOctreeQuery::TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result)
 {
     while (start != end)
     {
@@ -112,7 +191,7 @@ void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool in
         if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
         {
             if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
-                result_.Push(drawable);
+                result.Push(drawable);
         }
     }
 }
@@ -122,7 +201,106 @@ Intersection AllCastersQuery::TestOctant(const BoundingBox& box, bool inside)
 	return INSIDE;;
 }
 
+void FrustumOctreeQuery::TestDrawablesCached(Drawable** start, const DrawableCullData& data, bool inside, PODVector<Drawable*>& result)
+{
+    unsigned count = data.Size();
+    unsigned i = 0;
+
+    if (!inside)
+    {
+#ifdef URHO3D_SSE
+        // Test four boxes against each plane at once. A box is outside if it is behind any plane
+        for (; i + 4 <= count; i += 4)
+        {
+            // Skip the plane tests when all four are rejected by their dynamic bit
+            int rejectMask = 0;
+            for (unsigned j = 0; j < 4; ++j)
+            {
+                if (data.dynamic_[i + j] ? rejectDynamic_ : rejectStatic_)
+                    rejectMask |= 1 << j;
+            }
+            if (rejectMask == 0xf)
+                continue;
+
+            __m128 centerX = _mm_loadu_ps(&data.centerX_[i]);
+            __m128 centerY = _mm_loadu_ps(&data.centerY_[i]);
+            __m128 centerZ = _mm_loadu_ps(&data.centerZ_[i]);
+            __m128 edgeX = _mm_loadu_ps(&data.edgeX_[i]);
+            __m128 edgeY = _mm_loadu_ps(&data.edgeY_[i]);
+            __m128 edgeZ = _mm_loadu_ps(&data.edgeZ_[i]);
+            __m128 outside = _mm_setzero_ps();
+
+            for (const auto& plane : frustum_.planes_)
+            {
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal_.x_), centerX),
+                    _mm_mul_ps(_mm_set1_ps(plane.normal_.y_), centerY)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal_.z_), centerZ), _mm_set1_ps(plane.d_)));
+                __m128 absDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.absNormal_.x_), edgeX),
+                    _mm_mul_ps(_mm_set1_ps(plane.absNormal_.y_), edgeY)), _mm_mul_ps(_mm_set1_ps(plane.absNormal_.z_), edgeZ));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, absDist), _mm_setzero_ps()));
+            }
+
+            int outsideMask = _mm_movemask_ps(outside);
+            for (unsigned j = 0; j < 4; ++j)
+            {
+                unsigned index = i + j;
+                if ((rejectMask & (1 << j)) || !(data.flags_[index] & drawableFlags_) || !(data.viewMasks_[index] & viewMask_))
+                    continue;
+                if (data.volatile_[index])
+                {
+                    if (frustum_.IsInsideFast(start[index]->GetWorldBoundingBox()))
+                        result.Push(start[index]);
+                }
+                else if (!(outsideMask & (1 << j)))
+                    result.Push(start[index]);
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            if (!(data.flags_[i] & drawableFlags_) || !(data.viewMasks_[i] & viewMask_) ||
+                (data.dynamic_[i] ? rejectDynamic_ : rejectStatic_))
+                continue;
+            if (data.volatile_[i])
+            {
+                if (frustum_.IsInsideFast(start[i]->GetWorldBoundingBox()))
+                    result.Push(start[i]);
+                continue;
+            }
+
+            Vector3 center(data.centerX_[i], data.centerY_[i], data.centerZ_[i]);
+            Vector3 edge(data.edgeX_[i], data.edgeY_[i], data.edgeZ_[i]);
+            bool outside = false;
+            for (const auto& plane : frustum_.planes_)
+            {
+                if (plane.normal_.DotProduct(center) + plane.d_ < -plane.absNormal_.DotProduct(edge))
+                {
+                    outside = true;
+                    break;
+                }
+            }
+            if (!outside)
+                result.Push(start[i]);
+        }
+    }
+    else
+    {
+        for (; i < count; ++i)
+        {
+            if ((data.flags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_) &&
+                !(data.dynamic_[i] ? rejectDynamic_ : rejectStatic_))
+                result.Push(start[i]);
+        }
+    }
+}
+
 void AllCastersQuery::TestDrawables(Drawable** start, Drawable** end, bool inside)
+{
+	TestDrawablesThreaded(start, end, inside, result_);
+}
+
+void AllCastersQuery::TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result)
 {
 	while (start != end)
 	{
@@ -131,7 +309,7 @@ void AllCastersQuery::TestDrawables(Drawable** start, Drawable** end, bool insid
 		if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
 		{
 			if (drawable->GetCastShadows() && drawable->GetDynamicType() == dynamicType_)
-				result_.Push(drawable);
+				result.Push(drawable);
 		}
 	}
 }
@@ -153,4 +331,63 @@ void AllContentOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool
     }
 }
 
+unsigned MultiFrustumOctreeQuery::AddFrustum(const Frustum& frustum, unsigned viewMask)
+{
+    if (frustums_.Size() >= MAX_QUERY_FRUSTUMS)
+        return M_MAX_UNSIGNED;
+
+    frustums_.Push(frustum);
+    viewMasks_.Push(viewMask);
+    return frustums_.Size() - 1;
+}
+
+void MultiFrustumOctreeQuery::TestOctant(const BoundingBox& box, unsigned& insideMask, unsigned& testMask) const
+{
+    for (unsigned i = 0; i < frustums_.Size(); ++i)
+    {
+        unsigned bit = 1u << i;
+        if (!(testMask & bit))
+            continue;
+
+        Intersection res = frustums_[i].IsInside(box);
+        if (res != INTERSECTS)
+        {
+            testMask &= ~bit;
+            if (res == INSIDE)
+                insideMask |= bit;
+        }
+    }
+}
+
+void MultiFrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, unsigned insideMask, unsigned testMask)
+{
+    unsigned activeMask = insideMask | testMask;
+
+    while (start != end)
+    {
+        Drawable* drawable = *start++;
+
+        if (!(drawable->GetDrawableFlags() & drawableFlags_))
+            continue;
+
+        unsigned drawableViewMask = drawable->GetViewMask();
+        const BoundingBox& box = drawable->GetWorldBoundingBox();
+        unsigned mask = 0;
+        for (unsigned i = 0; i < frustums_.Size(); ++i)
+        {
+            unsigned bit = 1u << i;
+            if (!(activeMask & bit) || !(drawableViewMask & viewMasks_[i]))
+                continue;
+            if ((insideMask & bit) || frustums_[i].IsInsideFast(box))
+                mask |= bit;
+        }
+
+        if (mask)
+        {
+            result_.Push(drawable);
+            resultMasks_.Push(mask);
+        }
+    }
+}
+
 }
@@ -34,6 +34,42 @@ namespace Urho3D
 class Drawable;
 class Node;
 
+/// Culling data of the drawables of an octant in structure of arrays layout, parallel to the octant's drawable vector, so that queries can test drawables without dereferencing them.
+struct URHO3D_API DrawableCullData
+{
+    /// Append the data of a drawable.
+    void Push(Drawable* drawable);
+    /// Refresh the data of a drawable. Return true if any of it changed.
+    bool Set(unsigned index, Drawable* drawable);
+    /// Remove an entry by moving the last entry in its place.
+    void EraseSwap(unsigned index);
+    /// Remove all entries.
+    void Clear();
+    /// Return number of entries.
+    unsigned Size() const { return flags_.Size(); }
+
+    /// World bounding box center X coordinates.
+    PODVector<float> centerX_;
+    /// World bounding box center Y coordinates.
+    PODVector<float> centerY_;
+    /// World bounding box center Z coordinates.
+    PODVector<float> centerZ_;
+    /// World bounding box half size along X.
+    PODVector<float> edgeX_;
+    /// World bounding box half size along Y.
+    PODVector<float> edgeY_;
+    /// World bounding box half size along Z.
+    PODVector<float> edgeZ_;
+    /// View masks.
+    PODVector<unsigned> viewMasks_;
+    /// Drawable flags.
+    PODVector<unsigned char> flags_;
+    /// Nonzero when the world bounding box changes outside the octree update and must be read from the drawable.
+    PODVector<unsigned char> volatile_;
+    /// Nonzero when the drawable is not static or its world bounding box is volatile, so its visibility can not be cached over frames.
+    PODVector<unsigned char> dynamic_;
+};
+
 /// Base class for octree queries.
 class URHO3D_API OctreeQuery
 {
@@ -58,6 +94,14 @@ public:
     virtual Intersection TestOctant(const BoundingBox& box, bool inside) = 0;
     /// Intersection test for drawables.
     virtual void TestDrawables(Drawable** start, Drawable** end, bool inside) = 0;
+    /// Intersection test for drawables into a separate result vector. Called from worker threads when the query is thread safe.
+    virtual void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) { }
+    /// Return whether the octant and threaded drawable tests may run on several threads at once. Subclasses that change TestDrawables must also override TestDrawablesThreaded, or return false.
+    virtual bool IsThreadSafe() const { return false; }
+    /// Return whether drawables are tested with TestDrawablesCached instead of TestDrawables and TestDrawablesThreaded. Subclasses opt in explicitly, so that a subclass only changing TestDrawables is never bypassed.
+    virtual bool IsCacheable() const { return false; }
+    /// Intersection test for drawables using the culling data cached by their octant, into the given result vector. Called only when the query is cacheable.
+    virtual void TestDrawablesCached(Drawable** start, const DrawableCullData& data, bool inside, PODVector<Drawable*>& result) { }
 
     /// Result vector reference.
     PODVector<Drawable*>& result_;
@@ -146,9 +190,21 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables into a separate result vector.
+    void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override;
+    /// Return whether the query may run on several threads at once.
+    bool IsThreadSafe() const override { return true; }
+    /// Intersection test for drawables using the culling data cached by their octant. Tests four boxes at a time when SSE is enabled. Not used unless a subclass opts in with IsCacheable.
+    void TestDrawablesCached(Drawable** start, const DrawableCullData& data, bool inside, PODVector<Drawable*>& result) override;
 
     /// Frustum.
     Frustum frustum_;
+
+protected:
+    /// Whether the cached test rejects drawables that are static with a non-volatile bounding box.
+    bool rejectStatic_{};
+    /// Whether the cached test rejects dynamic drawables and drawables with a volatile bounding box.
+    bool rejectDynamic_{};
 };
 
 /// ѯо̬̬ӰͶ.
@@ -167,6 +223,10 @@ public:
 	Intersection TestOctant(const BoundingBox& box, bool inside) override;
 	/// Intersection test for drawables.
 	void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+	/// Intersection test for drawables into a separate result vector.
+	void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override;
+	/// Return whether the query may run on several threads at once.
+	bool IsThreadSafe() const override { return true; }
 
 	DynamicType dynamicType_;
 
@@ -288,4 +348,45 @@ public:
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
 };
 
+/// Maximum number of frustums in a multi-frustum octree query.
+static const unsigned MAX_QUERY_FRUSTUMS = 32;
+
+/// %Frustum octree query against several frustums in one traversal. Each drawable inside any frustum is returned once, with a mask of the frustums it is inside of.
+class URHO3D_API MultiFrustumOctreeQuery
+{
+public:
+    /// Construct with result vectors and query parameters.
+    MultiFrustumOctreeQuery(PODVector<Drawable*>& result, PODVector<unsigned>& resultMasks, unsigned char drawableFlags = DRAWABLE_ANY) :
+        result_(result),
+        resultMasks_(resultMasks),
+        drawableFlags_(drawableFlags)
+    {
+    }
+
+    /// Prevent copy construction.
+    MultiFrustumOctreeQuery(const MultiFrustumOctreeQuery& rhs) = delete;
+    /// Prevent assignment.
+    MultiFrustumOctreeQuery& operator =(const MultiFrustumOctreeQuery& rhs) = delete;
+
+    /// Add a frustum with the drawable layers to include. Return its bit index in the result masks, or M_MAX_UNSIGNED if the query is full.
+    unsigned AddFrustum(const Frustum& frustum, unsigned viewMask = DEFAULT_VIEWMASK);
+    /// Intersection test for an octant. Frustums of the test mask that contain the octant move to the inside mask, frustums that do not touch it are dropped.
+    void TestOctant(const BoundingBox& box, unsigned& insideMask, unsigned& testMask) const;
+    /// Intersection test for drawables against the frustums of both masks.
+    void TestDrawables(Drawable** start, Drawable** end, unsigned insideMask, unsigned testMask);
+    /// Return a mask with the bits of all frustums set.
+    unsigned GetFrustumsMask() const { return frustums_.Size() >= MAX_QUERY_FRUSTUMS ? M_MAX_UNSIGNED : (1u << frustums_.Size()) - 1; }
+
+    /// Result vector reference.
+    PODVector<Drawable*>& result_;
+    /// Result frustum masks reference, one per result drawable.
+    PODVector<unsigned>& resultMasks_;
+    /// Frustums.
+    Vector<Frustum> frustums_;
+    /// Drawable layers to include per frustum.
+    PODVector<unsigned> viewMasks_;
+    /// Drawable flags to include.
+    unsigned char drawableFlags_;
+};
+
 }
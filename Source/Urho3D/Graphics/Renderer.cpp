@@ -250,6 +250,13 @@ static const char* heightFogVariations[] =
     "HEIGHTFOG "
 };
 
+// Instanced batches get their own pixel shaders, which read the per-instance diffuse color
+static const char* instancingPSVariations[] =
+{
+    "",
+    "INSTANCED "
+};
+
 static const unsigned MAX_BUFFER_AGE = 1000;
 
 static const int MAX_EXTRA_INSTANCING_BUFFER_ELEMENTS = 4;
@@ -258,17 +265,19 @@ inline PODVector<VertexElement> CreateInstancingBufferElements(unsigned numExtra
 {
     static const unsigned NUM_INSTANCEMATRIX_ELEMENTS = 3;
     static const unsigned FIRST_UNUSED_TEXCOORD = 4;
+    // The per-instance diffuse color follows the extra elements in memory, but keeps a fixed texcoord past their range
+    static const unsigned INSTANCEDIFFCOLOR_TEXCOORD = FIRST_UNUSED_TEXCOORD + NUM_INSTANCEMATRIX_ELEMENTS + MAX_EXTRA_INSTANCING_BUFFER_ELEMENTS;
 
     PODVector<VertexElement> elements;
     for (unsigned i = 0; i < NUM_INSTANCEMATRIX_ELEMENTS + numExtraElements; ++i)
         elements.Push(VertexElement(TYPE_VECTOR4, SEM_TEXCOORD, FIRST_UNUSED_TEXCOORD + i, true));
+    elements.Push(VertexElement(TYPE_VECTOR4, SEM_TEXCOORD, INSTANCEDIFFCOLOR_TEXCOORD, true));
     return elements;
 }
 
 Renderer::Renderer(Context* context) :
     Object(context),
     defaultZone_(new Zone(context)),
-	overrideShaderParametersSet(false),
 	usingLogDepth_(false)
 {
     SubscribeToEvent(E_SCREENMODE, URHO3D_HANDLER(Renderer, HandleScreenMode));
@@ -525,6 +534,11 @@ void Renderer::SetThreadedOcclusion(bool enable)
     }
 }
 
+void Renderer::SetMultiViewCulling(bool enable)
+{
+    multiViewCulling_ = enable;
+}
+
 void Renderer::ReloadShaders()
 {
     shadersDirty_ = true;
@@ -677,15 +691,33 @@ void Renderer::Update(float timeStep)
 
     // Update main viewports. This may queue further views
     unsigned numMainViewports = queuedViewports_.Size();
-    for (unsigned i = 0; i < numMainViewports; ++i)
-        UpdateQueuedViewport(i);
+    if (multiViewCulling_)
+        UpdateQueuedViewportsShared(0, numMainViewports);
+    else
+    {
+        for (unsigned i = 0; i < numMainViewports; ++i)
+            UpdateQueuedViewport(i);
+    }
 
     // Gather queued & autoupdated render surfaces
     SendEvent(E_RENDERSURFACEUPDATE);
 
     // Update viewports that were added as result of the event above
-    for (unsigned i = numMainViewports; i < queuedViewports_.Size(); ++i)
-        UpdateQueuedViewport(i);
+    if (multiViewCulling_)
+    {
+        // Viewports queued by these updates are culled together in the next round
+        for (unsigned start = numMainViewports; start < queuedViewports_.Size();)
+        {
+            unsigned end = queuedViewports_.Size();
+            UpdateQueuedViewportsShared(start, end);
+            start = end;
+        }
+    }
+    else
+    {
+        for (unsigned i = numMainViewports; i < queuedViewports_.Size(); ++i)
+            UpdateQueuedViewport(i);
+    }
 
     queuedViewports_.Clear();
     resetViews_ = false;
@@ -1004,9 +1036,9 @@ Texture2D* Renderer::GetDirectionalLightStaticShadowMap(Light* light, Camera* ca
 	int width = NextPowerOfTwo((unsigned)size);
 	int height = width;
 
-	unsigned long long searchKey = width << 16u | height;
-	searchKey << 32u;
-	searchKey |= *reinterpret_cast<unsigned*>(view);
+	// Each view keeps its own static shadow map, as the view tracks which of its tiles are up to date
+	int sizeKey = width << 16u | height;
+	Pair<View*, int> searchKey(view, sizeKey);
 	if (staticShadowMaps_.Contains(searchKey))
 	{
 		return staticShadowMaps_[searchKey][0];
@@ -1071,14 +1103,14 @@ Texture2D* Renderer::GetDirectionalLightStaticShadowMap(Light* light, Camera* ca
 			if (shadowMapUsage == TEXTURE_DEPTHSTENCIL && dummyColorFormat)
 			{
 				// If no dummy color rendertarget for this size exists yet, create one now
-				if (!colorShadowMaps_.Contains(searchKey))
+				if (!colorShadowMaps_.Contains(sizeKey))
 				{
-					colorShadowMaps_[searchKey] = new Texture2D(context_);
-					colorShadowMaps_[searchKey]->SetNumLevels(1);
-					colorShadowMaps_[searchKey]->SetSize(width, height, dummyColorFormat, TEXTURE_RENDERTARGET);
+					colorShadowMaps_[sizeKey] = new Texture2D(context_);
+					colorShadowMaps_[sizeKey]->SetNumLevels(1);
+					colorShadowMaps_[sizeKey]->SetSize(width, height, dummyColorFormat, TEXTURE_RENDERTARGET);
 				}
 				// Link the color rendertarget to the shadow map
-				newShadowMap->GetRenderSurface()->SetLinkedRenderTarget(colorShadowMaps_[searchKey]->GetRenderSurface());
+				newShadowMap->GetRenderSurface()->SetLinkedRenderTarget(colorShadowMaps_[sizeKey]->GetRenderSurface());
 			}
 			break;
 		}
@@ -1234,6 +1266,7 @@ Camera* Renderer::GetShadowCamera()
     auto* camera = shadowCameraNodes_[numShadowCameras_++]->GetComponent<Camera>();
     camera->SetOrthographic(false);
     camera->SetZoom(1.0f);
+    camera->SetProjectionOffset(Vector2::ZERO);
 
     return camera;
 }
@@ -1336,6 +1369,8 @@ void Renderer::SetBatchShaders(Batch& batch, Technique* tech, bool allowShadows,
 
             if (heightFog)
                 psi += MAX_LIGHT_PS_VARIATIONS;
+            if (batch.geometryType_ == GEOM_INSTANCED)
+                psi += MAX_LIGHT_PS_VARIATIONS * 2;
 
             batch.vertexShader_ = vertexShaders[vsi];
             batch.pixelShader_ = pixelShaders[psi];
@@ -1358,7 +1393,7 @@ void Renderer::SetBatchShaders(Batch& batch, Technique* tech, bool allowShadows,
                 batch.vertexShader_ = vertexShaders[vsi];
             }
 
-            batch.pixelShader_ = pixelShaders[heightFog ? 1 : 0];
+            batch.pixelShader_ = pixelShaders[(heightFog ? 1 : 0) + (batch.geometryType_ == GEOM_INSTANCED ? 2 : 0)];
         }
     }
 
@@ -1581,12 +1616,24 @@ const Rect& Renderer::GetLightScissor(Light* light, Camera* camera)
 
 void Renderer::UpdateQueuedViewport(unsigned index)
 {
-    WeakPtr<RenderSurface>& renderTarget = queuedViewports_[index].first_;
-    WeakPtr<Viewport>& viewport = queuedViewports_[index].second_;
+    View* view = DefineQueuedViewport(index);
+    if (!view)
+        return;
+
+    // Update view. This may queue further views. View will send update begin/end events once its state is set
+    ResetShadowMapAllocations(); // Each view can reuse the same shadow maps
+    view->Update(frame_);
+}
+
+View* Renderer::DefineQueuedViewport(unsigned index)
+{
+    // Copy the pointers, defining may queue further viewports
+    WeakPtr<RenderSurface> renderTarget = queuedViewports_[index].first_;
+    WeakPtr<Viewport> viewport = queuedViewports_[index].second_;
 
     // Null pointer means backbuffer view. Differentiate between that and an expired rendersurface
     if ((renderTarget.NotNull() && renderTarget.Expired()) || viewport.Expired())
-        return;
+        return nullptr;
 
     // (Re)allocate the view structure if necessary
 	if (!viewport->GetView() || resetViews_)
@@ -1599,14 +1646,14 @@ void Renderer::UpdateQueuedViewport(unsigned index)
     assert(view);
     // Check if view can be defined successfully (has either valid scene, camera and octree, or no scene passes)
     if (!view->Define(renderTarget, viewport))
-        return;
+        return nullptr;
 
     views_.Push(WeakPtr<View>(view));
 
     const IntRect& viewRect = viewport->GetRect();
     Scene* scene = viewport->GetScene();
     if (!scene)
-        return;
+        return nullptr;
 
     auto* octree = scene->GetComponent<Octree>();
 
@@ -1628,9 +1675,90 @@ void Renderer::UpdateQueuedViewport(unsigned index)
             debug->SetView(viewport->GetCamera());
     }
 
-    // Update view. This may queue further views. View will send update begin/end events once its state is set
-    ResetShadowMapAllocations(); // Each view can reuse the same shadow maps
-    view->Update(frame_);
+    return view;
+}
+
+void Renderer::UpdateQueuedViewportsShared(unsigned start, unsigned end)
+{
+    Vector<WeakPtr<View> > views;
+    for (unsigned i = start; i < end; ++i)
+    {
+        View* view = DefineQueuedViewport(i);
+        if (view)
+            views.Push(WeakPtr<View>(view));
+    }
+
+    CullViewsShared(views);
+
+    for (unsigned i = 0; i < views.Size(); ++i)
+    {
+        if (views[i].Expired())
+            continue;
+
+        // Update view. This may queue further views. View will send update begin/end events once its state is set
+        ResetShadowMapAllocations(); // Each view can reuse the same shadow maps
+        views[i]->Update(frame_);
+    }
+
+    // The shared results are consumed, stop recording removals
+    for (unsigned i = 0; i < sharedCulling_.Size(); ++i)
+    {
+        if (sharedCulling_[i].octree_)
+            sharedCulling_[i].octree_->SetTrackRemovals(false);
+        sharedCulling_[i].octree_.Reset();
+    }
+}
+
+void Renderer::CullViewsShared(const Vector<WeakPtr<View> >& views)
+{
+    // Group the views by octree, up to the number of bits in the visibility masks per group
+    unsigned numGroups = 0;
+    for (unsigned i = 0; i < views.Size(); ++i)
+    {
+        View* view = views[i];
+        if (!view->PrepareSharedCulling())
+            continue;
+
+        unsigned j = 0;
+        for (; j < numGroups; ++j)
+        {
+            if (sharedCulling_[j].octree_ == view->GetOctree() && sharedCulling_[j].views_.Size() < MAX_QUERY_FRUSTUMS)
+                break;
+        }
+        if (j == numGroups)
+        {
+            if (sharedCulling_.Size() <= numGroups)
+                sharedCulling_.Resize(numGroups + 1);
+            sharedCulling_[j].octree_ = view->GetOctree();
+            sharedCulling_[j].views_.Clear();
+            ++numGroups;
+        }
+        sharedCulling_[j].views_.Push(view);
+    }
+
+    for (unsigned i = 0; i < numGroups; ++i)
+    {
+        SharedViewCulling& culling = sharedCulling_[i];
+        // A view alone is better off with its own query, which can also use the occlusion buffer for octants
+        if (culling.views_.Size() < 2)
+            continue;
+
+        URHO3D_PROFILE(CullViewsShared);
+
+        MultiFrustumOctreeQuery query(culling.drawables_, culling.visibility_,
+            DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_ZONE | DRAWABLE_POINTCLOUD);
+        for (unsigned j = 0; j < culling.views_.Size(); ++j)
+        {
+            Camera* cullCamera = culling.views_[j]->GetCullCamera();
+            query.AddFrustum(cullCamera->GetFrustum(), cullCamera->GetViewMask());
+        }
+        culling.octree_->GetDrawables(query);
+        // Event handlers of the views updated first may remove drawables the later views still hold
+        culling.octree_->SetTrackRemovals(true);
+
+        for (unsigned j = 0; j < culling.views_.Size(); ++j)
+            culling.views_[j]->SetSharedCulling(&culling, j);
+    }
 }
 
 void Renderer::PrepareViewRender()
@@ -1793,7 +1921,7 @@ void Renderer::LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >&
     {
         // Load forward pixel lit variations
         vertexShaders.Resize(MAX_GEOMETRYTYPES * MAX_LIGHT_VS_VARIATIONS);
-        pixelShaders.Resize(MAX_LIGHT_PS_VARIATIONS * 2);
+        pixelShaders.Resize(MAX_LIGHT_PS_VARIATIONS * 2 * 2);
 
         for (unsigned j = 0; j < MAX_GEOMETRYTYPES * MAX_LIGHT_VS_VARIATIONS; ++j)
         {
@@ -1803,20 +1931,21 @@ void Renderer::LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >&
             vertexShaders[j] = graphics_->GetShader(VS, pass->GetVertexShader(),
                 vsDefines + lightVSVariations[l] + geometryVSVariations[g]);
         }
-        for (unsigned j = 0; j < MAX_LIGHT_PS_VARIATIONS * 2; ++j)
+        for (unsigned j = 0; j < MAX_LIGHT_PS_VARIATIONS * 2 * 2; ++j)
         {
             unsigned l = j % MAX_LIGHT_PS_VARIATIONS;
-            unsigned h = j / MAX_LIGHT_PS_VARIATIONS;
+            unsigned h = (j / MAX_LIGHT_PS_VARIATIONS) % 2;
+            unsigned i = j / (MAX_LIGHT_PS_VARIATIONS * 2);
 
             if (l & LPS_SHADOW)
             {
                 pixelShaders[j] = graphics_->GetShader(PS, pass->GetPixelShader(),
                     psDefines + lightPSVariations[l] + GetShadowVariations() +
-                    heightFogVariations[h]);
+                    heightFogVariations[h] + instancingPSVariations[i]);
             }
             else
                 pixelShaders[j] = graphics_->GetShader(PS, pass->GetPixelShader(),
-                    psDefines + lightPSVariations[l] + heightFogVariations[h]);
+                    psDefines + lightPSVariations[l] + heightFogVariations[h] + instancingPSVariations[i]);
         }
     }
     else
@@ -1843,11 +1972,11 @@ void Renderer::LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >&
             }
         }
 
-        pixelShaders.Resize(2);
-        for (unsigned j = 0; j < 2; ++j)
+        pixelShaders.Resize(2 * 2);
+        for (unsigned j = 0; j < 2 * 2; ++j)
         {
-            pixelShaders[j] =
-                graphics_->GetShader(PS, pass->GetPixelShader(), psDefines + heightFogVariations[j]);
+            pixelShaders[j] = graphics_->GetShader(PS, pass->GetPixelShader(),
+                psDefines + heightFogVariations[j % 2] + instancingPSVariations[j / 2]);
         }
     }
 
@@ -2011,6 +2140,17 @@ void Renderer::CreateInstancingBuffer()
     }
 }
 
+void Renderer::ReleaseStaticShadowMaps(View* view)
+{
+    for (auto i = staticShadowMaps_.Begin(); i != staticShadowMaps_.End();)
+    {
+        if (i->first_.first_ == view)
+            i = staticShadowMaps_.Erase(i);
+        else
+            ++i;
+    }
+}
+
 void Renderer::ResetShadowMaps()
 {
     shadowMaps_.Clear();
@@ -169,6 +169,19 @@ enum DeferredLightPSVariation
     MAX_DEFERRED_LIGHT_PS_VARIATIONS
 };
 
+/// Culling pass shared by views of the same octree. Drawables are in octree order, each with a bitmask of the views it is visible in.
+struct SharedViewCulling
+{
+    /// Octree. Records drawable removals while the views are updated.
+    WeakPtr<Octree> octree_;
+    /// Views taking part, bit i of the visibility masks belongs to view i.
+    PODVector<View*> views_;
+    /// Drawables visible in at least one of the views.
+    PODVector<Drawable*> drawables_;
+    /// Visibility bitmask per drawable.
+    PODVector<unsigned> visibility_;
+};
+
 /// High-level rendering subsystem. Manages drawing of 3D views.
 class URHO3D_API Renderer : public Object
 {
@@ -224,7 +237,7 @@ public:
     void SetMaxShadowMaps(int shadowMaps);
     /// Set dynamic instancing on/off. When on (default), drawables using the same static-type geometry and material will be automatically combined to an instanced draw call.
     void SetDynamicInstancing(bool enable);
-    /// Set number of extra instancing buffer elements. Default is 0. Extra 4-vectors are available through TEXCOORD7 and further.
+    /// Set number of extra instancing buffer elements. Default is 0. Extra 4-vectors are available through TEXCOORD7 and further, TEXCOORD11 carries the per-instance diffuse color.
     void SetNumExtraInstancingBufferElements(int elements);
     /// Set minimum number of instances required in a batch group to render as instanced.
     void SetMinInstances(int instances);
@@ -238,6 +251,8 @@ public:
     void SetOccluderSizeThreshold(float screenSize);
     /// Set whether to thread occluder rendering. Default false.
     void SetThreadedOcclusion(bool enable);
+    /// Set whether views of the same scene are culled together, in one octree traversal per frame. Coarse octant occlusion is then skipped, drawables are still tested against the occlusion buffer. Cameras must not be moved in E_BEGINVIEWUPDATE when enabled, drawables removed there are dropped from the shared result. Default false.
+    void SetMultiViewCulling(bool enable);
     /// Set shadow depth bias multiplier for mobile platforms to counteract possible worse shadow map precision. Default 1.0 (no effect.)
     void SetMobileShadowBiasMul(float mul);
     /// Set shadow depth bias addition for mobile platforms to counteract possible worse shadow map precision. Default 0.0 (no effect.)
@@ -328,6 +343,9 @@ public:
     /// Return whether occlusion rendering is threaded.
     bool GetThreadedOcclusion() const { return threadedOcclusion_; }
 
+    /// Return whether views of the same scene are culled together.
+    bool GetMultiViewCulling() const { return multiViewCulling_; }
+
     /// Return shadow depth bias multiplier for mobile platforms.
     float GetMobileShadowBiasMul() const { return mobileShadowBiasMul_; }
 
@@ -398,6 +416,8 @@ public:
     Texture2D* GetShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight);
 	/// Allocate a static shadow map. view, ֻз
 	Texture2D* GetDirectionalLightStaticShadowMap(Light* light, Camera* camera, View* view);
+    /// Release the static shadow maps of a view. Called when the view is destroyed.
+    void ReleaseStaticShadowMaps(View* view);
     /// Allocate a rendertarget or depth-stencil texture for deferred rendering or postprocessing. Should only be called during actual rendering, not before.
     Texture* GetScreenBuffer
         (int width, int height, unsigned format, int multiSample, bool autoResolve, bool cubemap, bool filtered, bool srgb, unsigned persistentKey = 0);
@@ -430,8 +450,14 @@ public:
     /// Return a view or its source view if it uses one. Used internally for render statistics.
     static View* GetActualView(View* view);
 
-	void SetOverrideShaderParametersSet(bool enable) { overrideShaderParametersSet = enable; }
-	bool GetOverrideShaderParametersSet() { return overrideShaderParametersSet;}
+	/// Mark a shader parameter as overridden by the batch being prepared, so that the next batch restores its material value.
+	void MarkShaderParameterOverridden(StringHash name)
+	{
+		if (!overriddenShaderParameters_.Contains(name))
+			overriddenShaderParameters_.Push(name);
+	}
+	/// Return shader parameters overridden since the material parameters were last uploaded.
+	PODVector<StringHash>& GetOverriddenShaderParameters() { return overriddenShaderParameters_; }
 	/// ö
 	void EnableLogDepth(bool enable){ usingLogDepth_ = enable; }
 	/// Ƿö
@@ -455,6 +481,12 @@ private:
     void SetIndirectionTextureData();
     /// Update a queued viewport for rendering.
     void UpdateQueuedViewport(unsigned index);
+    /// Define the view of a queued viewport and update its octree. Return the view if it should be updated.
+    View* DefineQueuedViewport(unsigned index);
+    /// Update a range of queued viewports, culling views of the same octree together.
+    void UpdateQueuedViewportsShared(unsigned start, unsigned end);
+    /// Run the shared culling passes for defined views.
+    void CullViewsShared(const Vector<WeakPtr<View> >& views);
     /// Prepare for rendering of a new view.
     void PrepareViewRender();
     /// Remove unused occlusion and screen buffers.
@@ -509,7 +541,7 @@ private:
     /// Shadow maps by resolution.
     HashMap<int, Vector<SharedPtr<Texture2D> > > shadowMaps_;
 	/// ̬Ӱ
-	HashMap<unsigned long long, Vector<SharedPtr<Texture2D> > > staticShadowMaps_;
+	HashMap<Pair<View*, int>, Vector<SharedPtr<Texture2D> > > staticShadowMaps_;
     /// Shadow map dummy color buffers by resolution.
     HashMap<int, SharedPtr<Texture2D> > colorShadowMaps_;
     /// Shadow map allocations by resolution.
@@ -534,6 +566,8 @@ private:
     HashMap<Camera*, WeakPtr<View> > preparedViews_;
     /// Octrees that have been updated during the frame.
     HashSet<Octree*> updatedOctrees_;
+    /// Shared culling passes, kept to avoid reallocation.
+    Vector<SharedViewCulling> sharedCulling_;
     /// Techniques for which missing shader error has been displayed.
     HashSet<Technique*> shaderErrorDisplayed_;
     /// Mutex for shadow camera allocation.
@@ -604,14 +638,16 @@ private:
     int numExtraInstancingBufferElements_{};
     /// Threaded occlusion rendering flag.
     bool threadedOcclusion_{};
+    /// Multi-view culling flag.
+    bool multiViewCulling_{};
     /// Shaders need reloading flag.
     bool shadersDirty_{true};
     /// Initialized flag.
     bool initialized_{};
     /// Flag for views needing reset.
     bool resetViews_{};
-	///batchoverride
-	bool overrideShaderParametersSet;
+	/// Shader parameters overridden since the material parameters were last uploaded.
+	PODVector<StringHash> overriddenShaderParameters_;
 	///Ƿʹö
 	bool usingLogDepth_;
 };
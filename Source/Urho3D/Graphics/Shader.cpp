@@ -64,7 +64,8 @@ void CommentOutFunction(String& code, const String& signature)
 Shader::Shader(Context* context) :
     Resource(context),
     timeStamp_(0),
-    numVariations_(0)
+    numVariations_(0),
+    usesInstanceDiffColor_(false)
 {
     RefreshMemoryUse();
 }
@@ -89,6 +90,7 @@ bool Shader::BeginLoad(Deserializer& source)
 
     // Load the shader source code and resolve any includes
     timeStamp_ = 0;
+    usesInstanceDiffColor_ = false;
     String shaderCode;
     if (!ProcessSource(shaderCode, source))
         return false;
@@ -194,6 +196,9 @@ bool Shader::ProcessSource(String& code, Deserializer& source)
         }
         else
         {
+            // Only the shader's own code counts, the includes declare the per-instance color for every shader
+            if (source.GetName() == GetName() && line.Contains("iInstanceDiffColor"))
+                usesInstanceDiffColor_ = true;
             code += line;
             code += "\n";
         }
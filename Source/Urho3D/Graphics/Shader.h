@@ -59,6 +59,9 @@ public:
     /// Return the latest timestamp of the shader code and its includes.
     unsigned GetTimeStamp() const { return timeStamp_; }
 
+    /// Return whether the shader itself reads the per-instance diffuse color (iInstanceDiffColor) when instanced.
+    bool UsesInstanceDiffColor() const { return usesInstanceDiffColor_; }
+
 private:
     /// Process source code and include files. Return true if successful.
     bool ProcessSource(String& code, Deserializer& source);
@@ -79,6 +82,8 @@ private:
     unsigned timeStamp_;
     /// Number of unique variations so far.
     unsigned numVariations_;
+    /// Whether the shader itself reads the per-instance diffuse color.
+    bool usesInstanceDiffColor_;
 };
 
 }
@@ -35,6 +35,7 @@
 #include "../Graphics/Octree.h"
 #include "../Graphics/Renderer.h"
 #include "../Graphics/RenderPath.h"
+#include "../Graphics/Shader.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Skybox.h"
 #include "../Graphics/Technique.h"
@@ -56,6 +57,83 @@
 namespace Urho3D
 {
 
+/// Temporal visibility cache state: inside the frustum shrunk by the margin.
+static const unsigned char TEMPORAL_INNER = 0x1;
+/// Temporal visibility cache state: found occluded or beyond draw distance when last checked.
+static const unsigned char TEMPORAL_HIDDEN = 0x2;
+/// Frustum corner movement in world units below which the camera counts as still.
+static const float TEMPORAL_STILL_DISTANCE = 0.001f;
+
+/// Return whether a drawable can be held in the temporal visibility cache.
+static inline bool IsTemporallyCached(Drawable* drawable)
+{
+    return drawable->GetDynamicType() == Static && !drawable->HasVolatileWorldBoundingBox();
+}
+
+/// %Frustum octree query for either the drawables held in the temporal visibility cache or the rest.
+class TemporalFrustumOctreeQuery : public FrustumOctreeQuery
+{
+public:
+    /// Construct with frustum and query parameters.
+    TemporalFrustumOctreeQuery(PODVector<Drawable*>& result, const Frustum& frustum, bool cached, unsigned char drawableFlags = DRAWABLE_ANY,
+        unsigned viewMask = DEFAULT_VIEWMASK) :
+        FrustumOctreeQuery(result, frustum, drawableFlags, viewMask),
+        cached_(cached)
+    {
+        // The cached test rejects by the dynamic bit of the culling data, without touching the drawables
+        rejectStatic_ = !cached;
+        rejectDynamic_ = cached;
+    }
+
+    /// Intersection test for drawables.
+    void TestDrawables(Drawable** start, Drawable** end, bool inside) override
+    {
+        TestDrawablesThreaded(start, end, inside, result_);
+    }
+
+    /// Return whether the cached culling data is used.
+    bool IsCacheable() const override { return true; }
+
+    /// Intersection test for drawables into a separate result vector.
+    void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override
+    {
+        unsigned first = result.Size();
+        FrustumOctreeQuery::TestDrawablesThreaded(start, end, inside, result);
+        Filter(result, first);
+    }
+
+    /// Whether to return the cacheable drawables instead of the rest.
+    bool cached_;
+
+private:
+    /// Remove the drawables not matching from the end of the result.
+    void Filter(PODVector<Drawable*>& result, unsigned first) const
+    {
+        unsigned last = first;
+        for (unsigned i = first; i < result.Size(); ++i)
+        {
+            if (IsTemporallyCached(result[i]) == cached_)
+                result[last++] = result[i];
+        }
+        result.Resize(last);
+    }
+};
+
+/// %Frustum octree query using the culling data cached by the octants.
+class CachedFrustumOctreeQuery : public FrustumOctreeQuery
+{
+public:
+    /// Construct with frustum and query parameters.
+    CachedFrustumOctreeQuery(PODVector<Drawable*>& result, const Frustum& frustum, unsigned char drawableFlags = DRAWABLE_ANY,
+        unsigned viewMask = DEFAULT_VIEWMASK) :
+        FrustumOctreeQuery(result, frustum, drawableFlags, viewMask)
+    {
+    }
+
+    /// Return whether the cached culling data is used.
+    bool IsCacheable() const override { return true; }
+};
+
 /// %Frustum octree query for shadowcasters.
 class ShadowCasterOctreeQuery : public FrustumOctreeQuery
 {
@@ -69,6 +147,30 @@ public:
 
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override
+    {
+        TestDrawablesThreaded(start, end, inside, result_);
+    }
+
+    /// Return whether the cached culling data is used.
+    bool IsCacheable() const override { return true; }
+
+    /// Intersection test for drawables using cached culling data, then keep the shadow casters.
+    void TestDrawablesCached(Drawable** start, const DrawableCullData& data, bool inside, PODVector<Drawable*>& result) override
+    {
+        unsigned first = result.Size();
+        FrustumOctreeQuery::TestDrawablesCached(start, data, inside, result);
+
+        unsigned last = first;
+        for (unsigned i = first; i < result.Size(); ++i)
+        {
+            if (result[i]->GetCastShadows())
+                result[last++] = result[i];
+        }
+        result.Resize(last);
+    }
+
+    /// Intersection test for drawables into a separate result vector.
+    void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override
     {
         while (start != end)
         {
@@ -78,7 +180,7 @@ public:
                 (drawable->GetViewMask() & viewMask_))
             {
                 if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
-                    result_.Push(drawable);
+                    result.Push(drawable);
             }
         }
     }
@@ -97,6 +199,32 @@ public:
 
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override
+    {
+        TestDrawablesThreaded(start, end, inside, result_);
+    }
+
+    /// Return whether the cached culling data is used.
+    bool IsCacheable() const override { return true; }
+
+    /// Intersection test for drawables using cached culling data, then keep the zones and occluders.
+    void TestDrawablesCached(Drawable** start, const DrawableCullData& data, bool inside, PODVector<Drawable*>& result) override
+    {
+        unsigned first = result.Size();
+        FrustumOctreeQuery::TestDrawablesCached(start, data, inside, result);
+
+        unsigned last = first;
+        for (unsigned i = first; i < result.Size(); ++i)
+        {
+            Drawable* drawable = result[i];
+            unsigned char flags = drawable->GetDrawableFlags();
+            if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder()))
+                result[last++] = drawable;
+        }
+        result.Resize(last);
+    }
+
+    /// Intersection test for drawables into a separate result vector.
+    void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override
     {
         while (start != end)
         {
@@ -107,7 +235,7 @@ public:
                 (drawable->GetViewMask() & viewMask_))
             {
                 if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
-                    result_.Push(drawable);
+                    result.Push(drawable);
             }
         }
     }
@@ -141,6 +269,15 @@ public:
 
     /// Intersection test for drawables. Note: drawable occlusion is performed later in worker threads.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override
+    {
+        TestDrawablesThreaded(start, end, inside, result_);
+    }
+
+    /// Return whether the cached culling data is used. The drawable test is the plain frustum test.
+    bool IsCacheable() const override { return true; }
+
+    /// Intersection test for drawables into a separate result vector. The occlusion buffer is only read during the query.
+    void TestDrawablesThreaded(Drawable** start, Drawable** end, bool inside, PODVector<Drawable*>& result) override
     {
         while (start != end)
         {
@@ -149,7 +286,7 @@ public:
             if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
             {
                 if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
-                    result_.Push(drawable);
+                    result.Push(drawable);
             }
         }
     }
@@ -276,7 +413,25 @@ void SortShadowQueueWork(const WorkItem* item, unsigned threadIndex)
     auto* start = reinterpret_cast<LightBatchQueue*>(item->start_);
     for (unsigned i = 0; i < start->shadowSplits_.Size(); ++i)
         start->shadowSplits_[i].shadowBatches_.SortFrontToBack();
-	start->staticShadow_.shadowBatches_.SortFrontToBack();
+	for (unsigned i = 0; i < start->staticShadowTiles_.Size(); ++i)
+		start->staticShadowTiles_[i].shadowBatches_.SortFrontToBack();
+}
+
+/// Return whether the override shader parameters of a batch allow instancing. Only a diffuse color override can be carried as per-instance data.
+static bool GetInstanceDiffColorOverride(const Batch& batch, const Color*& diffColor)
+{
+    diffColor = nullptr;
+    const HashMap<StringHash, MaterialShaderParameter>* parameters = batch.overrideShaderParameters_;
+    if (!parameters || parameters->Empty())
+        return true;
+    if (parameters->Size() > 1 || parameters->Begin()->first_ != PSP_MATDIFFCOLOR)
+        return false;
+
+    const Variant& value = parameters->Begin()->second_.value_;
+    if (value.GetType() != VAR_COLOR && value.GetType() != VAR_VECTOR4)
+        return false;
+    diffColor = &value.GetColor();
+    return true;
 }
 
 StringHash ParseTextureTypeXml(ResourceCache* cache, const String& filename);
@@ -294,9 +449,17 @@ View::View(Context* context) :
     sceneResults_.Resize(numThreads);
 }
 
+View::~View()
+{
+    // The static shadow maps are keyed by view, a later view at the same address must not inherit them
+    if (renderer_)
+        renderer_->ReleaseStaticShadowMaps(this);
+}
+
 bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
 {
     sourceView_ = nullptr;
+    sharedCulling_ = nullptr;
     renderPath_ = viewport->GetRenderPath();
     if (!renderPath_)
         return false;
@@ -564,6 +727,30 @@ void View::Update(const FrameInfo& frame)
     SendViewEvent(E_ENDVIEWUPDATE);
 }
 
+bool View::PrepareSharedCulling()
+{
+    sharedCulling_ = nullptr;
+    if (sourceView_ || !hasScenePasses_ || !octree_ || !cullCamera_)
+        return false;
+
+    // The shared pass runs before Update, so set the automatic aspect ratio already here
+    if (cullCamera_->GetAutoAspectRatio())
+        cullCamera_->SetAspectRatioInternal((float)viewSize_.x_ / (float)viewSize_.y_);
+    return true;
+}
+
+bool View::IsSharedDrawableRemoved(Drawable* drawable) const
+{
+    const HashSet<Drawable*>& removed = octree_->GetRemovedDrawables();
+    return !removed.Empty() && removed.Contains(drawable);
+}
+
+void View::SetSharedCulling(const SharedViewCulling* culling, unsigned index)
+{
+    sharedCulling_ = culling;
+    sharedCullingMask_ = 1u << index;
+}
+
 void View::Render()
 {
     SendViewEvent(E_BEGINVIEWRENDER);
@@ -801,18 +988,30 @@ void View::GetDrawables()
     PODVector<Drawable*>& tempDrawables = tempDrawables_[0];
 
 	//ȡо̬Ͷ
-	if(enableStaticShadow_&&updateStaticShadow_)
-    {
-		AllCastersQuery
-			query(allStaticCasters_, DynamicType::Static, DRAWABLE_GEOMETRY , cullCamera_->GetViewMask());
-		octree_->GetDrawables(query);
-    }
+	if(enableStaticShadow_)
+		CollectStaticShadowChanges();
 
     // Get zones and occluders first
+    if (sharedCulling_)
+    {
+        tempDrawables.Clear();
+        for (unsigned i = 0; i < sharedCulling_->drawables_.Size(); ++i)
+        {
+            if (!(sharedCulling_->visibility_[i] & sharedCullingMask_) || IsSharedDrawableRemoved(sharedCulling_->drawables_[i]))
+                continue;
+            Drawable* drawable = sharedCulling_->drawables_[i];
+            unsigned char flags = drawable->GetDrawableFlags();
+            if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder()))
+                tempDrawables.Push(drawable);
+        }
+    }
+    else if (temporalCulling_)
+        GetTemporalZonesOccluders(tempDrawables);
+    else
     {
         ZoneOccluderOctreeQuery
             query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_ZONE | DRAWABLE_POINTCLOUD, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        octree_->GetDrawables(query, true);
     }
 
     highestZonePriority_ = M_MIN_INT;
@@ -879,16 +1078,35 @@ void View::GetDrawables()
         occluders_.Clear();
 
     // Get lights and geometries. Coarse occlusion for octants is used at this point
-    if (occlusionBuffer_)
+    bool temporalCulling = false;
+    if (sharedCulling_)
+    {
+        // The shared pass has no octant occlusion, drawables are still tested against the occlusion buffer below
+        tempDrawables.Clear();
+        for (unsigned i = 0; i < sharedCulling_->drawables_.Size(); ++i)
+        {
+            Drawable* drawable = sharedCulling_->drawables_[i];
+            if ((sharedCulling_->visibility_[i] & sharedCullingMask_) && !IsSharedDrawableRemoved(drawable) &&
+                (drawable->GetDrawableFlags() & (DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD)))
+                tempDrawables.Push(drawable);
+        }
+        sharedCulling_ = nullptr;
+    }
+    else if (temporalCulling_)
+    {
+        temporalCulling = true;
+        GetTemporalDrawables(tempDrawables);
+    }
+    else if (occlusionBuffer_)
     {
         OccludedFrustumOctreeQuery query
             (tempDrawables, cullCamera_->GetFrustum(), occlusionBuffer_, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        octree_->GetDrawables(query, true);
     }
     else
     {
-        FrustumOctreeQuery query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        CachedFrustumOctreeQuery query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD, cullCamera_->GetViewMask());
+        octree_->GetDrawables(query, true);
     }
 
     // Check drawable occlusion, find zones for moved drawables and collect geometries & lights in worker threads
@@ -929,6 +1147,9 @@ void View::GetDrawables()
         queue->Complete(M_MAX_UNSIGNED);
     }
 
+    if (temporalCulling)
+        StoreTemporalOcclusion();
+
     // Combine lights, geometries & scene Z range from the threads
     geometries_.Clear();
     lights_.Clear();
@@ -970,6 +1191,185 @@ void View::GetDrawables()
     Sort(lights_.Begin(), lights_.End(), CompareLights);
 }
 
+void View::GetTemporalZonesOccluders(PODVector<Drawable*>& result)
+{
+    URHO3D_PROFILE(GetTemporalDrawables);
+
+    TemporalCullingStats& stats = temporalCullingStats_;
+    stats = TemporalCullingStats();
+    const Frustum& frustum = cullCamera_->GetFrustum();
+    unsigned viewMask = cullCamera_->GetViewMask();
+    float margin = temporalCullingMargin_;
+
+    // While no frustum corner has moved by the margin, the frustum stays inside the cached frustum grown by the margin and
+    // contains the cached frustum shrunk by the margin. Static changes to the octree invalidate the cache as a whole
+    bool valid = temporalOctree_.Get() == octree_ && temporalRevision_ == octree_->GetStaticRevision() && temporalViewMask_ == viewMask;
+    bool still = valid;
+    for (unsigned i = 0; i < NUM_FRUSTUM_VERTICES; ++i)
+    {
+        const Vector3& corner = frustum.vertices_[i];
+        if ((corner - temporalCorners_[i]).LengthSquared() >= margin * margin)
+            valid = false;
+        if ((corner - temporalLastCorners_[i]).LengthSquared() > TEMPORAL_STILL_DISTANCE * TEMPORAL_STILL_DISTANCE)
+            still = false;
+        temporalLastCorners_[i] = corner;
+    }
+    temporalStill_ = valid && still;
+
+    if (!valid)
+    {
+        Frustum grown = frustum;
+        Frustum shrunk = frustum;
+        for (unsigned i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+        {
+            grown.planes_[i].d_ += margin;
+            shrunk.planes_[i].d_ -= margin;
+        }
+
+        temporalDrawables_.Clear();
+        TemporalFrustumOctreeQuery query(temporalDrawables_, grown, true, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_ZONE |
+            DRAWABLE_POINTCLOUD, viewMask);
+        octree_->GetDrawables(query, true);
+
+        // Drawables fully inside the shrunk frustum need no frustum test while the cache is valid
+        temporalStates_.Resize(temporalDrawables_.Size());
+        for (unsigned i = 0; i < temporalDrawables_.Size(); ++i)
+            temporalStates_[i] = shrunk.IsInside(temporalDrawables_[i]->GetWorldBoundingBox()) == INSIDE ? TEMPORAL_INNER : 0;
+
+        temporalOctree_ = octree_;
+        temporalRevision_ = octree_->GetStaticRevision();
+        temporalViewMask_ = viewMask;
+        for (unsigned i = 0; i < NUM_FRUSTUM_VERTICES; ++i)
+            temporalCorners_[i] = frustum.vertices_[i];
+        temporalCursor_ = 0;
+        stats.rebuilt_ = true;
+    }
+    stats.numCached_ = temporalDrawables_.Size();
+
+    result.Clear();
+    temporalVisible_.Clear();
+    for (unsigned i = 0; i < temporalDrawables_.Size(); ++i)
+    {
+        Drawable* drawable = temporalDrawables_[i];
+        if (temporalStates_[i] & TEMPORAL_INNER)
+            ++stats.cacheHits_;
+        else
+        {
+            ++stats.boundaryTests_;
+            if (!frustum.IsInsideFast(drawable->GetWorldBoundingBox()))
+                continue;
+        }
+
+        temporalVisible_.Push(i);
+        unsigned char flags = drawable->GetDrawableFlags();
+        if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder()))
+            result.Push(drawable);
+    }
+
+    // Drawables that may move are not cached and are queried every frame
+    temporalDynamic_.Clear();
+    TemporalFrustumOctreeQuery query(temporalDynamic_, frustum, false, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_ZONE |
+        DRAWABLE_POINTCLOUD, viewMask);
+    octree_->GetDrawables(query, true);
+    stats.numDynamic_ = temporalDynamic_.Size();
+
+    for (PODVector<Drawable*>::ConstIterator i = temporalDynamic_.Begin(); i != temporalDynamic_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        unsigned char flags = drawable->GetDrawableFlags();
+        if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder()))
+            result.Push(drawable);
+    }
+}
+
+void View::GetTemporalDrawables(PODVector<Drawable*>& result)
+{
+    TemporalCullingStats& stats = temporalCullingStats_;
+
+    // Occlusion results hold while the camera and the occluders have not changed. Non-cached occluders may have moved
+    bool reuseOcclusion = temporalStill_ && occluders_ == temporalOccluders_;
+    for (PODVector<Drawable*>::ConstIterator i = occluders_.Begin(); i != occluders_.End() && reuseOcclusion; ++i)
+        reuseOcclusion = IsTemporallyCached(*i);
+    temporalOccluders_ = occluders_;
+
+    // A slice of the cache is checked for occlusion again every frame, so that all results are revalidated over time
+    unsigned numCached = temporalDrawables_.Size();
+    unsigned budget = Min(temporalCullingBudget_, numCached);
+
+    result.Clear();
+    temporalChecked_.Clear();
+    for (PODVector<unsigned>::ConstIterator i = temporalVisible_.Begin(); i != temporalVisible_.End(); ++i)
+    {
+        unsigned index = *i;
+        Drawable* drawable = temporalDrawables_[index];
+        if (!(drawable->GetDrawableFlags() & (DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD)))
+            continue;
+
+        if (reuseOcclusion && (temporalStates_[index] & TEMPORAL_HIDDEN))
+        {
+            unsigned offset = index >= temporalCursor_ ? index - temporalCursor_ : index + numCached - temporalCursor_;
+            if (offset >= budget)
+            {
+                ++stats.occlusionHits_;
+                continue;
+            }
+            ++stats.revalidations_;
+        }
+
+        result.Push(drawable);
+        temporalChecked_.Push(index);
+    }
+    if (numCached)
+        temporalCursor_ = (temporalCursor_ + budget) % numCached;
+
+    for (PODVector<Drawable*>::ConstIterator i = temporalDynamic_.Begin(); i != temporalDynamic_.End(); ++i)
+    {
+        if ((*i)->GetDrawableFlags() & (DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_POINTCLOUD))
+            result.Push(*i);
+    }
+}
+
+void View::StoreTemporalOcclusion()
+{
+    for (PODVector<unsigned>::ConstIterator i = temporalChecked_.Begin(); i != temporalChecked_.End(); ++i)
+    {
+        unsigned index = *i;
+        if (temporalDrawables_[index]->IsInView(frame_))
+            temporalStates_[index] &= ~TEMPORAL_HIDDEN;
+        else
+            temporalStates_[index] |= TEMPORAL_HIDDEN;
+    }
+}
+
+void View::SetTemporalCulling(bool enable)
+{
+    temporalCulling_ = enable;
+    if (!enable)
+        ResetTemporalCulling();
+}
+
+void View::SetTemporalCullingMargin(float margin)
+{
+    margin = Max(margin, 0.0f);
+    if (margin != temporalCullingMargin_)
+    {
+        temporalCullingMargin_ = margin;
+        ResetTemporalCulling();
+    }
+}
+
+void View::ResetTemporalCulling()
+{
+    temporalOctree_.Reset();
+    temporalDrawables_.Clear();
+    temporalStates_.Clear();
+    temporalVisible_.Clear();
+    temporalChecked_.Clear();
+    temporalDynamic_.Clear();
+    temporalOccluders_.Clear();
+    temporalStill_ = false;
+}
+
 void View::GetBatches()
 {
     if (!octree_ || !cullCamera_)
@@ -1051,6 +1451,10 @@ void View::GetLightBatches()
                 lightQueue.light_ = light;
                 lightQueue.negative_ = light->IsNegative();
                 lightQueue.shadowMap_ = nullptr;
+				lightQueue.staticShadowMap_ = nullptr;
+				lightQueue.staticShadow_.shadowCamera_ = nullptr;
+				if (lightQueue.staticShadowTiles_.Size())
+					lightQueue.staticShadowTiles_.Clear();
                 lightQueue.litBaseBatches_.Clear(maxSortedInstances);
                 lightQueue.litBatches_.Clear(maxSortedInstances);
                 if (forwardLightsCommand_)
@@ -1078,40 +1482,24 @@ void View::GetLightBatches()
                         shadowSplits = 0;
                 }
 				//
-				if (enableStaticShadow_&& updateStaticShadow_ && light->GetLightType() == LIGHT_DIRECTIONAL && shadowSplits > 0)
+				if (enableStaticShadow_ && light->GetLightType() == LIGHT_DIRECTIONAL && shadowSplits > 0 && lightQueue.staticShadowMap_)
+				{
+					// The threaded light processing set the camera up from the previous fit, set it up again if the box moved
+					Camera* staticCamera = query.shadowCameras_[shadowSplits - 1];
+					if (FitStaticShadowBox(light))
+						SetupDirLightStaticShadowCamera(staticCamera, light, query.shadowNearSplits_[shadowSplits - 1],
+							query.shadowFarSplits_[shadowSplits - 1]);
+				}
+				if (enableStaticShadow_ && light->GetLightType() == LIGHT_DIRECTIONAL && shadowSplits > 0 && lightQueue.staticShadowMap_ &&
+					staticShadowBox_.Defined())
                 {
+					// The whole map camera is set up every frame for sampling, casters are only rendered into dirty tiles
 					ShadowBatchQueue& shadowQueue = lightQueue.staticShadow_;
-					Camera* shadowCamera = query.shadowCameras_[shadowSplits - 1];
-					shadowQueue.shadowCamera_ = shadowCamera;
+					shadowQueue.shadowCamera_ = query.shadowCameras_[shadowSplits - 1];
 					shadowQueue.nearSplit_ = query.shadowNearSplits_[shadowSplits - 1];
 					shadowQueue.farSplit_ = query.shadowFarSplits_[shadowSplits - 1];
-					shadowQueue.shadowBatches_.Clear(maxSortedInstances);
-					// Setup the shadow split viewport and finalize shadow camera parameters
-					shadowQueue.shadowViewport_ = GetDirectionalLightStaticShadowMapViewport(lightQueue.shadowMap_);
-					for (int i = 0; i < allStaticCasters_.Size(); i++)
-					{
-						Drawable* drawable = allStaticCasters_[i];
-						const Vector<SourceBatch>& batches = drawable->GetBatches();
-						for (unsigned l = 0; l < batches.Size(); ++l)
-						{
-							const SourceBatch& srcBatch = batches[l];
-
-							Technique* tech = GetTechnique(drawable, srcBatch.material_);
-							if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
-								continue;
-
-							Pass* pass = tech->GetSupportedPass(Technique::shadowPassIndex);
-							// Skip if material has no shadow pass
-							if (!pass)
-								continue;
-
-							Batch destBatch(srcBatch);
-							destBatch.pass_ = pass;
-							destBatch.zone_ = nullptr;
-
-							AddBatchToQueue(shadowQueue.shadowBatches_, destBatch, tech);
-						}
-					}
+					shadowQueue.shadowViewport_ = GetDirectionalLightStaticShadowMapViewport(lightQueue.staticShadowMap_);
+					SetupStaticShadowTiles(lightQueue, maxSortedInstances);
                 }
                 // Setup shadow batch queues
                 lightQueue.shadowSplits_.Resize(shadowSplits);
@@ -2399,7 +2787,7 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
 
     case LIGHT_SPOT:
         {
-            FrustumOctreeQuery octreeQuery(tempDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY,
+            CachedFrustumOctreeQuery octreeQuery(tempDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY,
                 cullCamera_->GetViewMask());
             octree_->GetDrawables(octreeQuery);
             for (unsigned i = 0; i < tempDrawables.Size(); ++i)
@@ -2784,24 +3172,46 @@ void View::SetupDirLightShadowCamera(Camera* shadowCamera, Light* light, float n
     QuantizeDirLightShadowCamera(shadowCamera, light, IntRect(0, 0, 0, 0), shadowBox);
 }
 
-void View::SetupDirLightStaticShadowCamera(Camera* shadowCamera, Light* light, float nearSplit, float farSplit)
+bool View::FitStaticShadowBox(Light* light)
 {
-	Node* shadowCameraNode = shadowCamera->GetNode();
-	Node* lightNode = light->GetNode();
-	BoundingBox shadowBox;
-	shadowCameraNode->SetTransform(Vector3(0,0,0), lightNode->GetWorldRotation());
+	// Refit only while casters are being updated, the camera has to stay put for the tiles that are not rendered again
+	if (!staticShadowPending_)
+		return false;
+
+	const Quaternion& lightRotation = light->GetNode()->GetWorldRotation();
+	BoundingBox casterBox;
+	for (unsigned i = 0; i < allStaticCasters_.Size(); ++i)
+		casterBox.Merge(allStaticCasters_[i]->GetWorldBoundingBox());
+	// Transform the casters to light space
+	if (casterBox.Defined())
+		casterBox.Transform(Matrix3x4(Vector3::ZERO, lightRotation, 1.0f).Inverse());
+
+	bool changed = false;
+	// Casters that grew out of the fitted box or a turned light make every tile stale
+	if (resetStaticShadow_ || staticShadowRotation_ != lightRotation || !staticShadowBox_.Defined() ||
+		(casterBox.Defined() && staticShadowBox_.IsInside(casterBox) != INSIDE))
 	{
-		unsigned lightMask = light->GetLightMask();
-
-		for (unsigned i = 0; i < allStaticCasters_.Size(); ++i)
-		{
-			Drawable* drawable = allStaticCasters_[i];
-			shadowBox.Merge(drawable->GetWorldBoundingBox());
-		}
+		if (casterBox.Defined())
+			staticShadowBox_ = casterBox;
+		staticShadowRotation_ = lightRotation;
+		resetStaticShadow_ = true;
+		changed = true;
 	}
-	// Transform frustum volume to light space
+	// Nothing casts a static shadow yet
+	if (!staticShadowBox_.Defined())
+		staticShadowPending_ = false;
+	return changed;
+}
+
+void View::SetupDirLightStaticShadowCamera(Camera* shadowCamera, Light* light, float nearSplit, float farSplit)
+{
+	// Runs on the light processing threads, so only reads the box fitted by FitStaticShadowBox()
+	Node* shadowCameraNode = shadowCamera->GetNode();
+	shadowCameraNode->SetTransform(Vector3::ZERO, staticShadowRotation_);
+	if (!staticShadowBox_.Defined())
+		return;
+	const BoundingBox& shadowBox = staticShadowBox_;
 	const Matrix3x4& lightView = shadowCamera->GetView();
-	shadowBox.Transform(lightView);
 
 	// Fit the frustum volume inside a bounding box. If uniform size, use a sphere instead
 
@@ -2820,6 +3230,212 @@ void View::SetupDirLightStaticShadowCamera(Camera* shadowCamera, Light* light, f
 	QuantizeDirLightShadowCamera(shadowCamera, light, IntRect(0, 0, 0, 0), shadowBox);
 }
 
+void View::UpdateStaticShadow(const BoundingBox& region)
+{
+	if (region.Defined())
+		staticShadowDirtyRegions_.Push(region);
+	updateStaticShadow_ = true;
+}
+
+void View::SetStaticShadowTileDivisions(unsigned divisions)
+{
+	// Tiles have to split the power of two map into whole texels
+	divisions = NextPowerOfTwo(Clamp(divisions, 1U, 16U));
+	if (divisions != staticShadowTileDivisions_)
+	{
+		staticShadowTileDivisions_ = divisions;
+		ResetStaticShadow();
+	}
+}
+
+void View::CollectStaticShadowChanges()
+{
+	staticShadowStats_.tilesRendered_ = 0;
+	staticShadowStats_.batchesRendered_ = 0;
+	staticShadowStats_.fullUpdate_ = false;
+	if (!updateStaticShadow_ && !staticShadowPending_)
+		return;
+
+	// Query again also while pending tiles are finished over several frames, casters may have been destroyed meanwhile
+	AllCastersQuery query(allStaticCasters_, DynamicType::Static, DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
+	octree_->GetDrawables(query, true);
+	staticShadowPending_ = true;
+	if (!updateStaticShadow_)
+		return;
+
+	// An added, removed or moved caster dirties the tiles under its old and new bounding box
+	HashMap<Drawable*, BoundingBox> casterBoxes;
+	for (unsigned i = 0; i < allStaticCasters_.Size(); ++i)
+	{
+		Drawable* drawable = allStaticCasters_[i];
+		const BoundingBox& box = drawable->GetWorldBoundingBox();
+		casterBoxes[drawable] = box;
+		HashMap<Drawable*, BoundingBox>::Iterator j = staticCasterBoxes_.Find(drawable);
+		if (j == staticCasterBoxes_.End())
+			staticShadowDirtyRegions_.Push(box);
+		else
+		{
+			if (j->second_ != box)
+			{
+				staticShadowDirtyRegions_.Push(j->second_);
+				staticShadowDirtyRegions_.Push(box);
+			}
+			staticCasterBoxes_.Erase(j);
+		}
+	}
+	for (HashMap<Drawable*, BoundingBox>::ConstIterator j = staticCasterBoxes_.Begin(); j != staticCasterBoxes_.End(); ++j)
+		staticShadowDirtyRegions_.Push(j->second_);
+	staticCasterBoxes_.Swap(casterBoxes);
+	updateStaticShadow_ = false;
+}
+
+void View::SetupStaticShadowTiles(LightBatchQueue& lightQueue, unsigned maxSortedInstances)
+{
+	Texture2D* shadowMap = lightQueue.staticShadowMap_;
+	const ShadowBatchQueue& mapQueue = lightQueue.staticShadow_;
+	Camera* shadowCamera = mapQueue.shadowCamera_;
+	unsigned divisions = staticShadowTileDivisions_;
+	unsigned numTiles = divisions * divisions;
+	staticShadowStats_.numTiles_ = numTiles;
+
+	if (!staticShadowPending_)
+	{
+		// The renderer recreated the map, render it again next frame after the casters have been queried
+		if (staticShadowMapTarget_ != shadowMap)
+			ResetStaticShadow();
+		staticShadowStats_.tilesPending_ = 0;
+		return;
+	}
+
+	// Blurred VSM maps are filtered as a whole, so they are never updated partially
+	if (resetStaticShadow_ || staticShadowMapTarget_ != shadowMap || staticShadowDirtyTiles_.Size() != numTiles ||
+		renderer_->GetShadowQuality() == SHADOWQUALITY_BLUR_VSM)
+	{
+		lightQueue.staticShadowTiles_.Resize(1);
+		ShadowBatchQueue& tileQueue = lightQueue.staticShadowTiles_[0];
+		tileQueue.shadowCamera_ = shadowCamera;
+		tileQueue.shadowViewport_ = mapQueue.shadowViewport_;
+		tileQueue.nearSplit_ = mapQueue.nearSplit_;
+		tileQueue.farSplit_ = mapQueue.farSplit_;
+		tileQueue.shadowBatches_.Clear(maxSortedInstances);
+		for (unsigned i = 0; i < allStaticCasters_.Size(); ++i)
+			AddStaticShadowBatches(allStaticCasters_[i], tileQueue);
+
+		staticShadowDirtyTiles_.Resize(numTiles);
+		for (unsigned i = 0; i < numTiles; ++i)
+			staticShadowDirtyTiles_[i] = false;
+		staticShadowDirtyRegions_.Clear();
+		staticShadowMapTarget_ = shadowMap;
+		resetStaticShadow_ = false;
+		staticShadowPending_ = false;
+		staticShadowStats_.tilesRendered_ = numTiles;
+		staticShadowStats_.tilesPending_ = 0;
+		staticShadowStats_.fullUpdate_ = true;
+		return;
+	}
+
+	// A region shadows the tiles under its projection along the light direction. Map rows are counted from the top, NDC y points up
+	const Matrix3x4& lightView = shadowCamera->GetView();
+	const Matrix4& lightProj = shadowCamera->GetProjection();
+	int maxTile = (int)divisions - 1;
+	for (unsigned i = 0; i < staticShadowDirtyRegions_.Size(); ++i)
+	{
+		Rect rect = staticShadowDirtyRegions_[i].Transformed(lightView).Projected(lightProj);
+		if (rect.max_.x_ < -1.0f || rect.min_.x_ > 1.0f || rect.max_.y_ < -1.0f || rect.min_.y_ > 1.0f)
+			continue;
+		int left = Clamp(FloorToInt((rect.min_.x_ + 1.0f) * 0.5f * divisions), 0, maxTile);
+		int right = Clamp(FloorToInt((rect.max_.x_ + 1.0f) * 0.5f * divisions), 0, maxTile);
+		int top = Clamp(FloorToInt((1.0f - rect.max_.y_) * 0.5f * divisions), 0, maxTile);
+		int bottom = Clamp(FloorToInt((1.0f - rect.min_.y_) * 0.5f * divisions), 0, maxTile);
+		for (int y = top; y <= bottom; ++y)
+		{
+			for (int x = left; x <= right; ++x)
+				staticShadowDirtyTiles_[y * divisions + x] = true;
+		}
+	}
+	staticShadowDirtyRegions_.Clear();
+
+	// Caster rectangles in the same space, computed once for all tiles
+	PODVector<Rect> casterRects(allStaticCasters_.Size());
+	for (unsigned i = 0; i < allStaticCasters_.Size(); ++i)
+		casterRects[i] = allStaticCasters_[i]->GetWorldBoundingBox().Transformed(lightView).Projected(lightProj);
+
+	Node* shadowCameraNode = shadowCamera->GetNode();
+	Vector2 tileOrthoSize(shadowCamera->GetOrthoSize() * shadowCamera->GetAspectRatio() / divisions,
+		shadowCamera->GetOrthoSize() / divisions);
+	int tileWidth = shadowMap->GetWidth() / divisions;
+	int tileHeight = shadowMap->GetHeight() / divisions;
+	float tileSize = 2.0f / divisions;
+	unsigned budget = staticShadowTileBudget_ ? staticShadowTileBudget_ : numTiles;
+	unsigned numRendered = 0;
+	unsigned numPending = 0;
+	for (unsigned i = 0; i < numTiles; ++i)
+	{
+		if (!staticShadowDirtyTiles_[i])
+			continue;
+		if (numRendered == budget)
+		{
+			++numPending;
+			continue;
+		}
+
+		int x = i % divisions;
+		int y = i / divisions;
+		Rect tileRect(-1.0f + x * tileSize, 1.0f - (y + 1) * tileSize, -1.0f + (x + 1) * tileSize, 1.0f - y * tileSize);
+
+		lightQueue.staticShadowTiles_.Resize(numRendered + 1);
+		ShadowBatchQueue& tileQueue = lightQueue.staticShadowTiles_[numRendered++];
+		// The tile camera sees only the tile, offset so that its viewport receives the same texels as the whole map camera
+		Camera* tileCamera = renderer_->GetShadowCamera();
+		tileCamera->GetNode()->SetTransform(shadowCameraNode->GetWorldPosition(), shadowCameraNode->GetWorldRotation());
+		tileCamera->SetOrthographic(true);
+		tileCamera->SetNearClip(shadowCamera->GetNearClip());
+		tileCamera->SetFarClip(shadowCamera->GetFarClip());
+		tileCamera->SetOrthoSize(tileOrthoSize);
+		tileCamera->SetProjectionOffset(tileRect.Center() * (-0.5f * divisions));
+		tileQueue.shadowCamera_ = tileCamera;
+		tileQueue.shadowViewport_ = IntRect(x * tileWidth, y * tileHeight, (x + 1) * tileWidth, (y + 1) * tileHeight);
+		tileQueue.nearSplit_ = mapQueue.nearSplit_;
+		tileQueue.farSplit_ = mapQueue.farSplit_;
+		tileQueue.shadowBatches_.Clear(maxSortedInstances);
+		for (unsigned j = 0; j < allStaticCasters_.Size(); ++j)
+		{
+			if (tileRect.IsInside(casterRects[j]) != OUTSIDE)
+				AddStaticShadowBatches(allStaticCasters_[j], tileQueue);
+		}
+		staticShadowDirtyTiles_[i] = false;
+	}
+
+	staticShadowPending_ = numPending > 0;
+	staticShadowStats_.tilesRendered_ = numRendered;
+	staticShadowStats_.tilesPending_ = numPending;
+}
+
+void View::AddStaticShadowBatches(Drawable* drawable, ShadowBatchQueue& tileQueue)
+{
+	const Vector<SourceBatch>& batches = drawable->GetBatches();
+	for (unsigned i = 0; i < batches.Size(); ++i)
+	{
+		const SourceBatch& srcBatch = batches[i];
+
+		Technique* tech = GetTechnique(drawable, srcBatch.material_);
+		if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+			continue;
+
+		Pass* pass = tech->GetSupportedPass(Technique::shadowPassIndex);
+		// Skip if material has no shadow pass
+		if (!pass)
+			continue;
+
+		Batch destBatch(srcBatch);
+		destBatch.pass_ = pass;
+		destBatch.zone_ = nullptr;
+
+		AddBatchToQueue(tileQueue.shadowBatches_, destBatch, tech);
+		++staticShadowStats_.batchesRendered_;
+	}
+}
+
 void View::FinalizeShadowCamera(Camera* shadowCamera, Light* light, const IntRect& shadowViewport,
     const BoundingBox& shadowCasterBox)
 {
@@ -3054,9 +3670,14 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
     if (!batch.material_)
         batch.material_ = renderer_->GetDefaultMaterial();
 
-    // Convert to instanced if possible
-    if (allowInstancing && batch.geometryType_ == GEOM_STATIC && batch.geometry_->GetIndexBuffer() &&!(batch.overrideShaderParameters_) && batch.overrideFillMode == FILL_SOLID)
+    // Convert to instanced if possible. A diffuse color override travels with the instance, so the batch stays grouped
+    const Color* instanceDiffColor = nullptr;
+    if (allowInstancing && batch.geometryType_ == GEOM_STATIC && batch.geometry_->GetIndexBuffer() && batch.overrideFillMode == FILL_SOLID &&
+        GetInstanceDiffColorOverride(batch, instanceDiffColor))
+    {
         batch.geometryType_ = GEOM_INSTANCED;
+        batch.instanceDiffColor_ = instanceDiffColor;
+    }
 
     if (batch.geometryType_ == GEOM_INSTANCED)
     {
@@ -3067,43 +3688,56 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
         {
             // Create a new group based on the batch
             // In case the group remains below the instancing limit, do not enable instancing shaders yet
+            // The overrides of the first batch are per instance, not shared by the group
             BatchGroup newGroup(batch);
             newGroup.geometryType_ = GEOM_STATIC;
+            newGroup.overrideShaderParameters_ = nullptr;
+            newGroup.instanceDiffColor_ = nullptr;
             renderer_->SetBatchShaders(newGroup, tech, allowShadows, queue);
             newGroup.CalculateSortKey();
             i = queue.batchGroups_.Insert(MakePair(key, newGroup));
         }
 
-        int oldSize = i->second_.instances_.Size();
-        i->second_.AddTransforms(batch);
-        // Convert to using instancing shaders when the instancing limit is reached
-        if (oldSize < minInstances_ && (int)i->second_.instances_.Size() >= minInstances_)
+        // A diffuse color override can only be instanced when the pass shader reads the per-instance color,
+        // otherwise the batch is drawn on its own with the override set as a shader parameter
+        ShaderVariation* groupShader = i->second_.vertexShader_;
+        if (batch.instanceDiffColor_ && (!groupShader || !groupShader->GetOwner() || !groupShader->GetOwner()->UsesInstanceDiffColor()))
         {
-            i->second_.geometryType_ = GEOM_INSTANCED;
-            renderer_->SetBatchShaders(i->second_, tech, allowShadows, queue);
-            i->second_.CalculateSortKey();
+            batch.geometryType_ = GEOM_STATIC;
+            batch.instanceDiffColor_ = nullptr;
         }
-    }
-    else
-    {
-        renderer_->SetBatchShaders(batch, tech, allowShadows, queue);
-        batch.CalculateSortKey();
-
-        // If batch is static with multiple world transforms and cannot instance, we must push copies of the batch individually
-        if (batch.geometryType_ == GEOM_STATIC && batch.numWorldTransforms_ > 1)
+        else
         {
-            unsigned numTransforms = batch.numWorldTransforms_;
-            batch.numWorldTransforms_ = 1;
-            for (unsigned i = 0; i < numTransforms; ++i)
+            int oldSize = i->second_.instances_.Size();
+            i->second_.AddTransforms(batch);
+            // Convert to using instancing shaders when the instancing limit is reached
+            if (oldSize < minInstances_ && (int)i->second_.instances_.Size() >= minInstances_)
             {
-                // Move the transform pointer to generate copies of the batch which only refer to 1 world transform
-                queue.batches_.Push(batch);
-                ++batch.worldTransform_;
+                i->second_.geometryType_ = GEOM_INSTANCED;
+                renderer_->SetBatchShaders(i->second_, tech, allowShadows, queue);
+                i->second_.CalculateSortKey();
             }
+            return;
         }
-        else
+    }
+
+    renderer_->SetBatchShaders(batch, tech, allowShadows, queue);
+    batch.CalculateSortKey();
+
+    // If batch is static with multiple world transforms and cannot instance, we must push copies of the batch individually
+    if (batch.geometryType_ == GEOM_STATIC && batch.numWorldTransforms_ > 1)
+    {
+        unsigned numTransforms = batch.numWorldTransforms_;
+        batch.numWorldTransforms_ = 1;
+        for (unsigned i = 0; i < numTransforms; ++i)
+        {
+            // Move the transform pointer to generate copies of the batch which only refer to 1 world transform
             queue.batches_.Push(batch);
+            ++batch.worldTransform_;
+        }
     }
+    else
+        queue.batches_.Push(batch);
 }
 
 void View::PrepareInstancingBuffer()
@@ -3129,7 +3763,8 @@ void View::PrepareInstancingBuffer()
 		{
 			totalInstances += i->shadowSplits_[j].shadowBatches_.GetNumInstances();
 		}
-		totalInstances += i->staticShadow_.shadowBatches_.GetNumInstances();
+		for (unsigned j = 0; j < i->staticShadowTiles_.Size(); ++j)
+			totalInstances += i->staticShadowTiles_[j].shadowBatches_.GetNumInstances();
         totalInstances += i->litBaseBatches_.GetNumInstances();
         totalInstances += i->litBatches_.GetNumInstances();
 		
@@ -3154,7 +3789,8 @@ void View::PrepareInstancingBuffer()
 		{
 			i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
 		}
-		i->staticShadow_.shadowBatches_.SetInstancingData(dest, stride, freeIndex);
+		for (unsigned j = 0; j < i->staticShadowTiles_.Size(); ++j)
+			i->staticShadowTiles_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
         i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
         i->litBatches_.SetInstancingData(dest, stride, freeIndex);
     }
@@ -3299,9 +3935,9 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
     graphics_->SetColorWrite(true);
     graphics_->SetDepthBias(0.0f, 0.0f);
 
-	if(queue.light_->GetLightType() == LIGHT_DIRECTIONAL && queue.staticShadowMap_ && enableStaticShadow_ && updateStaticShadow_)
+	if(queue.light_->GetLightType() == LIGHT_DIRECTIONAL && queue.staticShadowMap_ && queue.staticShadowTiles_.Size())
 	{
-		URHO3D_PROFILE(RenderShadowMap);
+		URHO3D_PROFILE(RenderStaticShadowMap);
 
 		Texture2D* shadowMap = queue.staticShadowMap_;
 		graphics_->SetTexture(TU_STATICSHADOWMAP, nullptr);
@@ -3312,6 +3948,7 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
 
 		// Set shadow depth bias
 		BiasParameters parameters = queue.light_->GetShadowBias();
+		unsigned clearFlags = CLEAR_DEPTH;
 
 		// The shadow map is a depth stencil texture
 		if (shadowMap->GetUsage() == TEXTURE_DEPTHSTENCIL)
@@ -3322,8 +3959,6 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
 			// Disable other render targets
 			for (unsigned i = 1; i < MAX_RENDERTARGETS; ++i)
 				graphics_->SetRenderTarget(i, (RenderSurface*) nullptr);
-			graphics_->SetViewport(IntRect(0, 0, shadowMap->GetWidth(), shadowMap->GetHeight()));
-			graphics_->Clear(CLEAR_DEPTH);
 		} else // if the shadow map is a color rendertarget
 		{
 			graphics_->SetColorWrite(true);
@@ -3333,40 +3968,37 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
 				graphics_->SetRenderTarget(i, (RenderSurface*) nullptr);
 			graphics_->SetDepthStencil(renderer_->GetDepthStencil(shadowMap->GetWidth(), shadowMap->GetHeight(),
 				shadowMap->GetMultiSample(), shadowMap->GetAutoResolve()));
-			graphics_->SetViewport(IntRect(0, 0, shadowMap->GetWidth(), shadowMap->GetHeight()));
-			graphics_->Clear(CLEAR_DEPTH | CLEAR_COLOR, Color::WHITE);
+			clearFlags |= CLEAR_COLOR;
 
 			parameters = BiasParameters(0.0f, 0.0f);
 		}
 
-		// Render each of the splits
-			const ShadowBatchQueue& shadowQueue = queue.staticShadow_;
-
-			float multiplier = 1.0f;
-			// For directional light cascade splits, adjust depth bias according to the far clip ratio of the splits
-			if ( queue.light_->GetLightType() == LIGHT_DIRECTIONAL)
-			{
-				multiplier =
-					Max(shadowQueue.shadowCamera_->GetFarClip() / queue.shadowSplits_[0].shadowCamera_->GetFarClip(), 10.0f);
-				multiplier = 1.0f + (multiplier - 1.0f) * queue.light_->GetShadowCascade().biasAutoAdjust_;
-				// Quantize multiplier to prevent creation of too many rasterizer states on D3D11
-				multiplier = (int)(multiplier * 10.0f) / 10.0f;
-			}
+		float multiplier = 1.0f;
+		// For directional light cascade splits, adjust depth bias according to the far clip ratio of the splits
+		multiplier =
+			Max(queue.staticShadow_.shadowCamera_->GetFarClip() / queue.shadowSplits_[0].shadowCamera_->GetFarClip(), 10.0f);
+		multiplier = 1.0f + (multiplier - 1.0f) * queue.light_->GetShadowCascade().biasAutoAdjust_;
+		// Quantize multiplier to prevent creation of too many rasterizer states on D3D11
+		multiplier = (int)(multiplier * 10.0f) / 10.0f;
 
-			// Perform further modification of depth bias on OpenGL ES, as shadow calculations' precision is limited
-			float addition = 0.0f;
+		// Perform further modification of depth bias on OpenGL ES, as shadow calculations' precision is limited
+		float addition = 0.0f;
 #ifdef GL_ES_VERSION_2_0
-			multiplier *= renderer_->GetMobileShadowBiasMul();
-			addition = renderer_->GetMobileShadowBiasAdd();
+		multiplier *= renderer_->GetMobileShadowBiasMul();
+		addition = renderer_->GetMobileShadowBiasAdd();
 #endif
 
+		// Clear and render each tile inside its own viewport, the tiles that are not dirty keep their contents
+		for (unsigned i = 0; i < queue.staticShadowTiles_.Size(); ++i)
+		{
+			const ShadowBatchQueue& shadowQueue = queue.staticShadowTiles_[i];
+			graphics_->SetViewport(shadowQueue.shadowViewport_);
+			graphics_->SetDepthBias(0.0f, 0.0f);
+			graphics_->Clear(clearFlags, Color::WHITE);
 			graphics_->SetDepthBias(multiplier * parameters.constantBias_ + addition, multiplier * parameters.slopeScaledBias_);
-			//graphics_->SetDepthBias(0.002f, 0.5f);
 			if (!shadowQueue.shadowBatches_.IsEmpty())
-			{
-				graphics_->SetViewport(shadowQueue.shadowViewport_);
 				shadowQueue.shadowBatches_.Draw(this, shadowQueue.shadowCamera_, false, false, true);
-			}
+		}
 		// Scale filter blur amount to shadow map viewport size so that different shadow map resolutions don't behave differently
 		float blurScale = queue.staticShadow_.shadowViewport_.Width() / 1024.0f;
 		renderer_->ApplyShadowMapFilter(this, shadowMap, blurScale);
@@ -3375,8 +4007,6 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
 		graphics_->SetColorWrite(true);
 		graphics_->SetDepthBias(0.0f, 0.0f);
 	}
-	
-	updateStaticShadow_ = false;
 }
 
 RenderSurface* View::GetDepthStencil(RenderSurface* renderTarget)
@@ -49,6 +49,7 @@ class Texture2D;
 class Viewport;
 class Zone;
 struct RenderPathCommand;
+struct SharedViewCulling;
 struct WorkItem;
 
 /// Intermediate light processing result.
@@ -106,6 +107,40 @@ struct PerThreadSceneResult
     float maxZ_;
 };
 
+/// Static shadow map update statistics of one frame.
+struct StaticShadowStats
+{
+    /// Number of tiles in the static shadow map.
+    unsigned numTiles_{};
+    /// Tiles rendered this frame.
+    unsigned tilesRendered_{};
+    /// Dirty tiles left for later frames.
+    unsigned tilesPending_{};
+    /// Shadow caster batches rendered this frame.
+    unsigned batchesRendered_{};
+    /// Whether the whole map was rendered this frame.
+    bool fullUpdate_{};
+};
+
+/// Temporal visibility cache statistics of one frame.
+struct TemporalCullingStats
+{
+    /// Static drawables in the cache.
+    unsigned numCached_{};
+    /// Cached drawables accepted as inside the frustum without a test.
+    unsigned cacheHits_{};
+    /// Cached drawables near the frustum edges tested again.
+    unsigned boundaryTests_{};
+    /// Cached drawables skipped as occluded without an occlusion test.
+    unsigned occlusionHits_{};
+    /// Cached occlusion results tested again on the revalidation budget.
+    unsigned revalidations_{};
+    /// Non-static drawables queried from the octree.
+    unsigned numDynamic_{};
+    /// Whether the cache was rebuilt this frame.
+    bool rebuilt_{};
+};
+
 static const unsigned MAX_VIEWPORT_TEXTURES = 2;
 
 /// Internal structure for 3D rendering work. Created for each backbuffer and texture viewport, but not for shadow cameras.
@@ -120,7 +155,7 @@ public:
     /// Construct.
     explicit View(Context* context);
     /// Destruct.
-    ~View() override = default;
+    ~View() override;
 
     /// Define with rendertarget and viewport. Return true if successful.
     bool Define(RenderSurface* renderTarget, Viewport* viewport);
@@ -128,6 +163,12 @@ public:
     void Update(const FrameInfo& frame);
     /// Render batches.
     void Render();
+    /// Prepare to join a culling pass shared with other views of the same octree. Return false if the view does not cull the octree itself. Called by Renderer after Define.
+    bool PrepareSharedCulling();
+    /// Take the drawables of the next update from a shared culling pass, index is the bit of this view in the visibility masks. Called by Renderer.
+    void SetSharedCulling(const SharedViewCulling* culling, unsigned index);
+    /// Return whether a drawable of the shared culling result was removed from the octree after the pass.
+    bool IsSharedDrawableRemoved(Drawable* drawable) const;
 
     /// Return graphics subsystem.
     Graphics* GetGraphics() const;
@@ -199,12 +240,49 @@ public:
 
 	void EnableStaticShadow(bool enableStaticShadow) { enableStaticShadow_ = enableStaticShadow; }
 	bool GetEnableStaticShadow() { return enableStaticShadow_; }
+	/// Update the static shadow map tiles covered by static casters that were added, removed or moved since the last update.
 	void UpdateStaticShadow() { updateStaticShadow_ = true; }
+	/// Update the static shadow map tiles covering a world space region, e.g. after a static caster changed its material.
+	void UpdateStaticShadow(const BoundingBox& region);
+	/// Render the whole static shadow map again.
+	void ResetStaticShadow() { updateStaticShadow_ = true; resetStaticShadow_ = true; }
 	bool GetUpdateStaticShadow() { return updateStaticShadow_; }
+	/// Set the number of static shadow map tiles per side.
+	void SetStaticShadowTileDivisions(unsigned divisions);
+	/// Return the number of static shadow map tiles per side.
+	unsigned GetStaticShadowTileDivisions() const { return staticShadowTileDivisions_; }
+	/// Set the maximum number of static shadow map tiles rendered per frame, 0 for no limit. Full updates are not limited.
+	void SetStaticShadowTileBudget(unsigned budget) { staticShadowTileBudget_ = budget; }
+	/// Return the maximum number of static shadow map tiles rendered per frame.
+	unsigned GetStaticShadowTileBudget() const { return staticShadowTileBudget_; }
+	/// Return the static shadow map update statistics of the last frame.
+	const StaticShadowStats& GetStaticShadowStats() const { return staticShadowStats_; }
+	/// Enable caching the visibility of static drawables over frames. The cached drawables are only tested again near the frustum edges while the camera stays within the margin, and their occlusion results are reused while the camera and the occluders stay still. Drawables that move or animate must be set to Dynamic, a changed static drawable rebuilds the cache.
+	void SetTemporalCulling(bool enable);
+	/// Return whether static drawable visibility is cached over frames.
+	bool GetTemporalCulling() const { return temporalCulling_; }
+	/// Set how far in world units the frustum corners may move before the temporal visibility cache is rebuilt.
+	void SetTemporalCullingMargin(float margin);
+	/// Return the temporal visibility cache margin.
+	float GetTemporalCullingMargin() const { return temporalCullingMargin_; }
+	/// Set the number of cached drawables whose occlusion result is tested again per frame.
+	void SetTemporalCullingBudget(unsigned budget) { temporalCullingBudget_ = Max(budget, 1U); }
+	/// Return the number of cached drawables whose occlusion result is tested again per frame.
+	unsigned GetTemporalCullingBudget() const { return temporalCullingBudget_; }
+	/// Discard the temporal visibility cache. It is rebuilt on the next frame.
+	void ResetTemporalCulling();
+	/// Return the temporal visibility cache statistics of the last frame.
+	const TemporalCullingStats& GetTemporalCullingStats() const { return temporalCullingStats_; }
 
 private:
     /// Query the octree for drawable objects.
     void GetDrawables();
+    /// Find the zones and occluders inside the frustum using the temporal visibility cache, rebuilding the cache when no longer valid.
+    void GetTemporalZonesOccluders(PODVector<Drawable*>& result);
+    /// Return the lights and geometries inside the frustum using the temporal visibility cache, leaving out static drawables known to be occluded.
+    void GetTemporalDrawables(PODVector<Drawable*>& result);
+    /// Store the occlusion results of the cached drawables checked this frame.
+    void StoreTemporalOcclusion();
     /// Construct batches from the drawable objects.
     void GetBatches();
     /// Get lit geometries and shadowcasters for visible lights.
@@ -251,6 +329,14 @@ private:
     void SetupDirLightShadowCamera(Camera* shadowCamera, Light* light, float nearSplit, float farSplit);
 	///̬Ӱ
 	void SetupDirLightStaticShadowCamera(Camera* shadowCamera, Light* light, float nearSplit, float farSplit);
+	/// Refit the static shadow box to the static casters in the main thread. Return true if the box or rotation changed.
+	bool FitStaticShadowBox(Light* light);
+	/// Query the static shadow casters and turn the bounding boxes of changed casters into dirty regions.
+	void CollectStaticShadowChanges();
+	/// Mark the dirty regions as dirty tiles and set up the batch queues of the tiles to render this frame.
+	void SetupStaticShadowTiles(LightBatchQueue& lightQueue, unsigned maxSortedInstances);
+	/// Add the shadow batches of a static caster to a static shadow map tile.
+	void AddStaticShadowBatches(Drawable* drawable, ShadowBatchQueue& tileQueue);
     /// Finalize shadow camera view after shadow casters and the shadow map are known.
     void
         FinalizeShadowCamera(Camera* shadowCamera, Light* light, const IntRect& shadowViewport, const BoundingBox& shadowCasterBox);
@@ -332,6 +418,10 @@ private:
     Camera* cullCamera_{};
     /// Shared source view. Null if this view is using its own culling.
     WeakPtr<View> sourceView_;
+    /// Shared culling pass for the next update. Null if the view queries the octree itself.
+    const SharedViewCulling* sharedCulling_{};
+    /// Bit of this view in the shared culling visibility masks.
+    unsigned sharedCullingMask_{};
     /// Zone the camera is inside, or default zone if not assigned.
     Zone* cameraZone_{};
     /// Zone at far clip plane.
@@ -404,6 +494,58 @@ private:
     PODVector<Drawable*> geometries_;
 	/// о̬ӰͶ弸Σڲ̬Ӱ
 	PODVector<Drawable*> allStaticCasters_;
+	/// World bounding boxes of the static casters at the last static shadow update, compared to find moved casters.
+	HashMap<Drawable*, BoundingBox> staticCasterBoxes_;
+	/// World space regions whose static shadow tiles need rendering.
+	PODVector<BoundingBox> staticShadowDirtyRegions_;
+	/// Dirty flags of the static shadow map tiles.
+	PODVector<bool> staticShadowDirtyTiles_;
+	/// Static shadow map the tiles were rendered to. A different map needs a full update.
+	WeakPtr<Texture2D> staticShadowMapTarget_;
+	/// Light space bounding box of the static casters the static shadow camera was fitted to.
+	BoundingBox staticShadowBox_;
+	/// Light rotation the static shadow camera was fitted with.
+	Quaternion staticShadowRotation_;
+	/// Static shadow map update statistics of the last frame.
+	StaticShadowStats staticShadowStats_;
+	/// Static shadow map tiles per side.
+	unsigned staticShadowTileDivisions_{4};
+	/// Maximum static shadow map tiles rendered per frame, 0 for no limit.
+	unsigned staticShadowTileBudget_{4};
+	/// Octree the temporal visibility cache was built from.
+	WeakPtr<Octree> temporalOctree_;
+	/// Static drawables inside the frustum grown by the margin when the cache was built.
+	PODVector<Drawable*> temporalDrawables_;
+	/// Frustum and occlusion state of the cached drawables.
+	PODVector<unsigned char> temporalStates_;
+	/// Indices of the cached drawables inside the frustum this frame.
+	PODVector<unsigned> temporalVisible_;
+	/// Indices of the cached drawables checked for occlusion this frame.
+	PODVector<unsigned> temporalChecked_;
+	/// Non-static drawables inside the frustum this frame.
+	PODVector<Drawable*> temporalDynamic_;
+	/// Occluders of the last frame, compared to decide whether occlusion results can be reused.
+	PODVector<Drawable*> temporalOccluders_;
+	/// Frustum corners when the cache was built.
+	Vector3 temporalCorners_[NUM_FRUSTUM_VERTICES];
+	/// Frustum corners on the last frame.
+	Vector3 temporalLastCorners_[NUM_FRUSTUM_VERTICES];
+	/// Temporal visibility cache statistics of the last frame.
+	TemporalCullingStats temporalCullingStats_;
+	/// Temporal visibility cache margin in world units.
+	float temporalCullingMargin_{1.0f};
+	/// Cached drawables whose occlusion result is tested again per frame.
+	unsigned temporalCullingBudget_{256};
+	/// Octree static revision when the cache was built.
+	unsigned temporalRevision_{};
+	/// Camera view mask when the cache was built.
+	unsigned temporalViewMask_{};
+	/// First cached drawable of the next occlusion revalidation slice.
+	unsigned temporalCursor_{};
+	/// Whether static drawable visibility is cached over frames.
+	bool temporalCulling_{};
+	/// Whether the camera has not moved since the last frame.
+	bool temporalStill_{};
     /// Geometry objects that will be updated in the main thread.
     PODVector<Drawable*> nonThreadedGeometries_;
     /// Geometry objects that will be updated in worker threads.
@@ -453,6 +595,10 @@ private:
 	bool enableStaticShadow_;
 	//Ƿ¾̬Ӱ
 	bool updateStaticShadow_;
+	/// Whether the whole static shadow map must be rendered.
+	bool resetStaticShadow_{};
+	/// Whether static shadow tiles are waiting to be rendered, also over later frames when limited by the budget.
+	bool staticShadowPending_{};
 };
 
 }
@@ -246,4 +246,18 @@ void Viewport::AddFilter(Filter* filter)
 			AllocateView();
 		GetView()->UpdateStaticShadow();
 	}
+
+	void Viewport::UpdateStaticShadow(const BoundingBox& region)
+	{
+		if (!GetView())
+			AllocateView();
+		GetView()->UpdateStaticShadow(region);
+	}
+
+	void Viewport::ResetStaticShadow()
+	{
+		if (!GetView())
+			AllocateView();
+		GetView()->ResetStaticShadow();
+	}
 }
@@ -104,6 +104,10 @@ public:
 	void EnableStaticShadow(bool enableStaticShadow);
 	bool GetEnableStaticShadow() { return enableStaticShadow_; }
 	void UpdateStaticShadow();
+	/// Update the static shadow map tiles covering a world space region.
+	void UpdateStaticShadow(const BoundingBox& region);
+	/// Render the whole static shadow map again.
+	void ResetStaticShadow();
 
 private:
     /// Scene pointer.
@@ -62,5 +62,33 @@ namespace ambergris {
 			AgCompactColor                       m_rgba;
 			uint32_t                           m_misc;         //normals, lidar classification
 		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// \brief: AgQuantizedLidarPoint compact vertex format for LIDAR based data,
+		//         positions are 16 bit offsets inside the bounding box of the
+		//         container and are dequantized by the batch world transform
+		//////////////////////////////////////////////////////////////////////////
+		/*
+		AgQuantizedLidarPoint ( 32*4 bits total )
+		//2 * UShort #1     xy Coordinates( POSITION, UBYTE4 )
+
+		//4 * UByte #2      RGBA( COLOR, UBYTE4_NORM )
+
+		//2 * UShort #3     z Coordinate, reserved( BLENDINDICES, UBYTE4 )
+
+		//UInt #4           same bits as the AgLidarPoint misc word( OBJECTINDEX, INT )
+		[0....13]           Normal index
+		[14...21]           Lidar classification
+		[30]                Filtered : 1 filtered, 0 not filtered
+		[31]                Crop: 1 clipped, 0 not clipped
+		*/
+		struct AgQuantizedLidarPoint
+		{
+			uint16_t                           m_xy[2];
+			AgCompactColor                     m_rgba;
+			uint16_t                           m_z;
+			uint16_t                           m_reserved;
+			uint32_t                           m_misc;         //normals, classification, filter flags
+		};
 	}
 }
\ No newline at end of file
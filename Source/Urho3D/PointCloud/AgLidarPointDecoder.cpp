@@ -0,0 +1,208 @@
+#include "AgLidarPointDecoder.h"
+#include "AgPointCloudOptions.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Misc word shared by both vertex layouts
+//////////////////////////////////////////////////////////////////////////
+static inline std::uint32_t decodeLeafNodeMisc(std::uint64_t data1, std::uint64_t data2)
+{
+	//normal index [0...13], lidar classification [14...21], filtered [30]
+	return std::uint32_t((data2 >> 32) & 0x3FFFULL)
+		| (std::uint32_t((data1 >> 54) & 0xFFULL) << 14)
+		| (std::uint32_t(data1 >> 63) << 30);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Decode a single PCVL leaf node( see AgVoxelLeafNode ) straight
+//         into the lidar vertex layout
+//////////////////////////////////////////////////////////////////////////
+static inline void decodeLeafNodeScalar(std::uint64_t data1, std::uint64_t data2, const Vector3& offset, AgLidarPoint& pointOut)
+{
+	pointOut.m_pos[0] = float(std::uint32_t(data1 & 0x3FFFFULL)) * 0.001f + offset.x_;
+	pointOut.m_pos[1] = float(std::uint32_t((data1 >> 18) & 0x3FFFFULL)) * 0.001f + offset.y_;
+	pointOut.m_pos[2] = float(std::uint32_t((data1 >> 36) & 0x3FFFFULL)) * 0.001f + offset.z_;
+
+	pointOut.m_rgba.r_ = std::uint8_t((data2 >> 24) & 0xFFULL);
+	pointOut.m_rgba.g_ = std::uint8_t((data2 >> 16) & 0xFFULL);
+	pointOut.m_rgba.b_ = std::uint8_t((data2 >> 8) & 0xFFULL);
+	pointOut.m_rgba.a_ = std::uint8_t(data2 & 0xFFULL);
+
+	pointOut.m_misc = decodeLeafNodeMisc(data1, data2);
+}
+
+#ifdef URHO3D_SSE
+//////////////////////////////////////////////////////////////////////////
+// \brief: Gather the low dwords of two 64-bit lane vectors into one
+//         vector of four 32-bit values
+//////////////////////////////////////////////////////////////////////////
+static inline __m128i gatherLowDwords(__m128i lanes01, __m128i lanes23)
+{
+	return _mm_unpacklo_epi64(_mm_shuffle_epi32(lanes01, _MM_SHUFFLE(3, 1, 2, 0)),
+		_mm_shuffle_epi32(lanes23, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+#endif
+
+unsigned AgLidarPointDecoder::decodeSSE2(const std::uint8_t* rawData, unsigned amountOfPoints, const Vector3& offset, AgLidarPoint* pointsOut)
+{
+#ifdef URHO3D_SSE
+	const __m128i coordMask = _mm_set1_epi64x(0x3FFFFLL);
+	const __m128i normalMask = _mm_set1_epi64x(0x3FFFLL);
+	const __m128i classMask = _mm_set1_epi64x(0xFFLL);
+	const __m128i byteMask = _mm_set1_epi32(0xFF00);
+	const __m128 scale = _mm_set1_ps(0.001f);
+	const __m128 offsetX = _mm_set1_ps(offset.x_);
+	const __m128 offsetY = _mm_set1_ps(offset.y_);
+	const __m128 offsetZ = _mm_set1_ps(offset.z_);
+
+	unsigned i = 0;
+	for (; i + 4 <= amountOfPoints; i += 4)
+	{
+		const __m128i* src = reinterpret_cast<const __m128i*>(rawData + i * sizeof(AgVoxelLeafNode));
+		const __m128i p0 = _mm_loadu_si128(src + 0);
+		const __m128i p1 = _mm_loadu_si128(src + 1);
+		const __m128i p2 = _mm_loadu_si128(src + 2);
+		const __m128i p3 = _mm_loadu_si128(src + 3);
+
+		//first and second ulong of each point
+		const __m128i first01 = _mm_unpacklo_epi64(p0, p1);
+		const __m128i first23 = _mm_unpacklo_epi64(p2, p3);
+		const __m128i second01 = _mm_unpackhi_epi64(p0, p1);
+		const __m128i second23 = _mm_unpackhi_epi64(p2, p3);
+
+		const __m128i rawX = gatherLowDwords(_mm_and_si128(first01, coordMask), _mm_and_si128(first23, coordMask));
+		const __m128i rawY = gatherLowDwords(_mm_and_si128(_mm_srli_epi64(first01, 18), coordMask),
+			_mm_and_si128(_mm_srli_epi64(first23, 18), coordMask));
+		const __m128i rawZ = gatherLowDwords(_mm_and_si128(_mm_srli_epi64(first01, 36), coordMask),
+			_mm_and_si128(_mm_srli_epi64(first23, 36), coordMask));
+
+		__m128 x = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(rawX), scale), offsetX);
+		__m128 y = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(rawY), scale), offsetY);
+		__m128 z = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(rawZ), scale), offsetZ);
+
+		//rgba is stored as 0xRRGGBBAA, swap to the r, g, b, a byte order of AgCompactColor
+		const __m128i color = gatherLowDwords(second01, second23);
+		const __m128i colorSwapped = _mm_or_si128(
+			_mm_or_si128(_mm_slli_epi32(color, 24), _mm_srli_epi32(color, 24)),
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi32(color, 8), byteMask), _mm_slli_epi32(_mm_and_si128(color, byteMask), 8)));
+		__m128 rgba = _mm_castsi128_ps(colorSwapped);
+
+		const __m128i misc01 = _mm_or_si128(_mm_or_si128(
+			_mm_and_si128(_mm_srli_epi64(second01, 32), normalMask),
+			_mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(first01, 54), classMask), 14)),
+			_mm_slli_epi64(_mm_srli_epi64(first01, 63), 30));
+		const __m128i misc23 = _mm_or_si128(_mm_or_si128(
+			_mm_and_si128(_mm_srli_epi64(second23, 32), normalMask),
+			_mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(first23, 54), classMask), 14)),
+			_mm_slli_epi64(_mm_srli_epi64(first23, 63), 30));
+		std::uint32_t misc[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(misc), gatherLowDwords(misc01, misc23));
+
+		//x, y, z, rgba are contiguous in AgLidarPoint, so one transpose gives the first 16 bytes of each point
+		_MM_TRANSPOSE4_PS(x, y, z, rgba);
+		_mm_storeu_ps(pointsOut[i + 0].m_pos, x);
+		_mm_storeu_ps(pointsOut[i + 1].m_pos, y);
+		_mm_storeu_ps(pointsOut[i + 2].m_pos, z);
+		_mm_storeu_ps(pointsOut[i + 3].m_pos, rgba);
+		pointsOut[i + 0].m_misc = misc[0];
+		pointsOut[i + 1].m_misc = misc[1];
+		pointsOut[i + 2].m_misc = misc[2];
+		pointsOut[i + 3].m_misc = misc[3];
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
+
+bool AgLidarPointDecoder::hasSSE2()
+{
+#ifdef URHO3D_SSE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AgLidarPointDecoder::decodeScalar(const std::uint8_t* rawData, unsigned amountOfPoints, const Vector3& offset, AgLidarPoint* pointsOut)
+{
+	for (unsigned i = 0; i < amountOfPoints; ++i)
+	{
+		std::uint64_t data[2];
+		memcpy(data, rawData + i * sizeof(AgVoxelLeafNode), sizeof(data));
+		decodeLeafNodeScalar(data[0], data[1], offset, pointsOut[i]);
+	}
+}
+
+void AgLidarPointDecoder::decode(const std::uint8_t* rawData, unsigned amountOfPoints, const Vector3& offset, AgLidarPoint* pointsOut)
+{
+	const unsigned decoded = decodeSSE2(rawData, amountOfPoints, offset, pointsOut);
+	decodeScalar(rawData + decoded * sizeof(AgVoxelLeafNode), amountOfPoints - decoded, offset, pointsOut + decoded);
+}
+
+Matrix3x4 AgLidarPointDecoder::decodeQuantized(const std::uint8_t* rawData, unsigned amountOfPoints, const Vector3& offset,
+	AgQuantizedLidarPoint* pointsOut)
+{
+	std::uint32_t rawMin[3] = { 0x3FFFFu, 0x3FFFFu, 0x3FFFFu };
+	std::uint32_t rawMax[3] = { 0u, 0u, 0u };
+	for (unsigned i = 0; i < amountOfPoints; ++i)
+	{
+		std::uint64_t data1;
+		memcpy(&data1, rawData + i * sizeof(AgVoxelLeafNode), sizeof(data1));
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const std::uint32_t raw = std::uint32_t((data1 >> (18 * axis)) & 0x3FFFFULL);
+			rawMin[axis] = std::min(rawMin[axis], raw);
+			rawMax[axis] = std::max(rawMax[axis], raw);
+		}
+	}
+	if (!amountOfPoints)
+		rawMin[0] = rawMin[1] = rawMin[2] = 0u;
+
+	//one shift for all axes keeps the quantization grid uniform
+	const std::uint32_t extent = std::max(rawMax[0] - rawMin[0], std::max(rawMax[1] - rawMin[1], rawMax[2] - rawMin[2]));
+	unsigned shift = 0;
+	while ((extent >> shift) > 0xFFFFu)
+		++shift;
+	const std::uint32_t half = (1u << shift) >> 1;
+
+	for (unsigned i = 0; i < amountOfPoints; ++i)
+	{
+		std::uint64_t data[2];
+		memcpy(data, rawData + i * sizeof(AgVoxelLeafNode), sizeof(data));
+
+		std::uint16_t quantized[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const std::uint32_t raw = std::uint32_t((data[0] >> (18 * axis)) & 0x3FFFFULL) - rawMin[axis];
+			quantized[axis] = std::uint16_t(std::min((raw + half) >> shift, 0xFFFFu));
+		}
+
+		AgQuantizedLidarPoint& pointOut = pointsOut[i];
+		pointOut.m_xy[0] = quantized[0];
+		pointOut.m_xy[1] = quantized[1];
+		pointOut.m_z = quantized[2];
+		pointOut.m_reserved = 0;
+
+		pointOut.m_rgba.r_ = std::uint8_t((data[1] >> 24) & 0xFFULL);
+		pointOut.m_rgba.g_ = std::uint8_t((data[1] >> 16) & 0xFFULL);
+		pointOut.m_rgba.b_ = std::uint8_t((data[1] >> 8) & 0xFFULL);
+		pointOut.m_rgba.a_ = std::uint8_t(data[1] & 0xFFULL);
+
+		pointOut.m_misc = decodeLeafNodeMisc(data[0], data[1]);
+	}
+
+	const float step = 0.001f * float(1u << shift);
+	const Vector3 origin(rawMin[0] * 0.001f + offset.x_, rawMin[1] * 0.001f + offset.y_, rawMin[2] * 0.001f + offset.z_);
+	return Matrix3x4(origin, Quaternion::IDENTITY, Vector3(step, step, step));
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "AgLidarPoint.h"
+
+#include "../Math/Matrix3x4.h"
+
+#include <cstdint>
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		//////////////////////////////////////////////////////////////////////////
+		// \brief: Block decode of PCVL leaf payloads( see AgVoxelLeafNode ) into
+		//         the lidar vertex layouts. The payload may come straight from a
+		//         mapped file, so no alignment is assumed
+		//////////////////////////////////////////////////////////////////////////
+		class URHO3D_API AgLidarPointDecoder
+		{
+		public:
+			//decode with the best kernel of the build, the scalar path handles the remainder
+			static void decode(const std::uint8_t* rawData, unsigned amountOfPoints, const Urho3D::Vector3& offset, AgLidarPoint* pointsOut);
+			//decode one point at a time
+			static void decodeScalar(const std::uint8_t* rawData, unsigned amountOfPoints, const Urho3D::Vector3& offset, AgLidarPoint* pointsOut);
+			//decode four points at a time with SSE2, returns the amount of points decoded( 0 when built without URHO3D_SSE )
+			static unsigned decodeSSE2(const std::uint8_t* rawData, unsigned amountOfPoints, const Urho3D::Vector3& offset, AgLidarPoint* pointsOut);
+			//true when decodeSSE2 is compiled in
+			static bool hasSSE2();
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Decode to 16 bit positions relative to the bounding box of the
+			//         points. The 18 bit millimeter offsets are kept exact when the
+			//         box is smaller than 65.535m, larger boxes drop the low bits.
+			//         Returns the transform from quantized positions to node space
+			//////////////////////////////////////////////////////////////////////////
+			static Urho3D::Matrix3x4 decodeQuantized(const std::uint8_t* rawData, unsigned amountOfPoints, const Urho3D::Vector3& offset,
+				AgQuantizedLidarPoint* pointsOut);
+		};
+	}
+}
@@ -0,0 +1,111 @@
+#include "AgMemoryMapFile.h"
+
+#include "../IO/FileSystem.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+AgMemoryMapFile::AgMemoryMapFile()
+	: m_data(nullptr)
+	, m_size(0)
+#ifdef _WIN32
+	, m_fileHandle(nullptr)
+	, m_mappingHandle(nullptr)
+#endif
+{
+}
+
+AgMemoryMapFile::~AgMemoryMapFile()
+{
+	close();
+}
+
+bool AgMemoryMapFile::open(const String& fileName)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileW(GetWideNativePath(fileName).CString(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_mappingHandle = mappingHandle;
+	m_size = (std::uint64_t)fileSize.QuadPart;
+#else
+	int fileDescriptor = ::open(GetNativePath(fileName).CString(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(fileDescriptor);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	//the mapping keeps its own reference to the file
+	::close(fileDescriptor);
+	if (data == MAP_FAILED)
+		return false;
+
+	//the payload is decoded front to back exactly once
+	madvise(data, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+	m_size = (std::uint64_t)fileStat.st_size;
+#endif
+
+	m_data = static_cast<const std::uint8_t*>(data);
+	return true;
+}
+
+void AgMemoryMapFile::close()
+{
+	if (!m_data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle((HANDLE)m_mappingHandle);
+	CloseHandle((HANDLE)m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	munmap(const_cast<std::uint8_t*>(m_data), (size_t)m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
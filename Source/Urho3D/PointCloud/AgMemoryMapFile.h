@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../Container/Str.h"
+
+#include <cstdint>
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgMemoryMapFile read-only memory mapping of a point cloud file,
+		//         pages are only made resident when they are touched
+		//////////////////////////////////////////////////////////////////////////
+		class AgMemoryMapFile
+		{
+		public:
+			AgMemoryMapFile();
+			~AgMemoryMapFile();
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Map the whole file into memory, returns false on failure
+			//////////////////////////////////////////////////////////////////////////
+			bool                                    open(const Urho3D::String& fileName);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Unmap the file and release the handles
+			//////////////////////////////////////////////////////////////////////////
+			void                                    close();
+
+			bool                                    isOpen() const { return m_data != nullptr; }
+			const std::uint8_t*                     getData() const { return m_data; }
+			std::uint64_t                           getSize() const { return m_size; }
+
+		private:
+			AgMemoryMapFile(const AgMemoryMapFile&) = delete;
+			AgMemoryMapFile& operator =(const AgMemoryMapFile&) = delete;
+
+			const std::uint8_t*                     m_data;
+			std::uint64_t                           m_size;
+#ifdef _WIN32
+			void*                                   m_fileHandle;
+			void*                                   m_mappingHandle;
+#endif
+		};
+	}
+}
@@ -1,11 +1,17 @@
 #include "AgPointCloudEngine.h"
 #include "AgVoxelContainer.h"
+#include "AgPointCloudOptions.h"
+#include "AgVoxelOcclusion.h"
 
 #include "../Core/Context.h"
 #include "../Scene/Scene.h"
 #include "../Graphics/Renderer.h"
 #include "../Graphics/Camera.h"
 #include "../Graphics/View.h"
+#include "../Graphics/OcclusionBuffer.h"
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
 
 #include <common/RCMath.h>
 #include <common/RCMemoryHelper.h>
@@ -14,8 +20,13 @@
 #include <utility/RCTimer.h>
 #include <utility/RCStringUtils.h>
 #include <algorithm>
+#include <cmath>
 #include <assert.h>
 
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#endif
+
 using namespace Urho3D;
 using namespace ambergris::PointCloudEngine;
 using namespace ambergris::RealityComputing::Common;
@@ -23,7 +34,7 @@ using namespace ambergris::RealityComputing::Utility;
 using namespace ambergris::RealityComputing::Utility::String;
 using namespace ambergris::RealityComputing::Utility::Threading;
 
-static int calcLOD(const RCBox& voxelBounds, const Viewport* viewport, float pointSize)
+static int calcLOD(const RCBox& voxelBounds, const Viewport* viewport, float pointSize, float* screenSizeOut = nullptr)
 {
 	if (!viewport)
 		return 0;
@@ -92,6 +103,9 @@ static int calcLOD(const RCBox& voxelBounds, const Viewport* viewport, float poi
 		return 0;
 	}
 
+	if (screenSizeOut)
+		*screenSizeOut = (float)std::min(pixSize, (double)std::numeric_limits<float>::max());
+
 	// Check for infinity
 	if (pixSize > std::numeric_limits<double>::max())
 	{
@@ -122,7 +136,8 @@ static bool calcLODs(const Renderer* renderer, const RCBox& voxelBounds, std::ve
 		const Viewport* viewport = renderer->GetViewport(i);
 		if(!viewport)
 			continue;
-		const int lod = calcLOD(voxelBounds, viewport, pointSize);
+		lodsOut[i].m_screenSize = 0.0f;
+		const int lod = calcLOD(voxelBounds, viewport, pointSize, &lodsOut[i].m_screenSize);
 		someGood |= (lod > 0);
 		lodsOut[i].m_LOD = (std::uint8_t) lod;
 	}
@@ -198,28 +213,30 @@ static std::uint8_t findMaxLod(const std::vector< LodRecord >& lods)
 }
 
 //////////////////////////////////////////////////////////////////////////
-// \brief: Sort voxels based on their least recently used value
+// \brief: Screen space error of a voxel container, the on screen spacing in
+//         pixels between the points of the LOD that is currently loaded
 //////////////////////////////////////////////////////////////////////////
-class VoxelTreeSorterLRU
+static float calcScreenSpaceError(const std::vector< LodRecord >& lods, unsigned loadedLOD)
 {
-public:
-	VoxelTreeSorterLRU() {}
-
-	bool operator() (const AgVoxelContainer* p1, const AgVoxelContainer* p2) const
-	{
-		return (p1->m_lastTimeModified < p2->m_lastTimeModified);
-	}
-};
+	float screenSize = 0.0f;
+	for (size_t i = 0; i != lods.size(); ++i)
+		screenSize = std::max(screenSize, lods[i].m_screenSize);
+	return std::ldexp(screenSize, -(int)std::min(loadedLOD, 31u));
+}
 
 AgPointCloudEngine::AgPointCloudEngine(Context* context)
 	: Component(context)
 	, mMaxPointsLoad(75)
 	, mPointSize(1.0f)
+	, mCullMethod(kCullMethodFrustumCullingOnly)
+	, mPointBudget(75 * 1000000ULL)
+	, mBudgetPointCount(0)
+	, mTargetFrameTime(0.0f)
+	, mAverageFrameTime(0.0f)
 	, mIgnoreClip(false)
 	, mIsProjectDirty(false)
 	, mCoordinateSystemHasChanged(false)
-	, m_maxAllocatedMemory(1200 * 1024 * 1024)
-	, m_lruFreeMemory(400)
+	, mStreamer(new AgVoxelStreamer(context))
 {
 }
 
@@ -311,85 +328,271 @@ std::uint32_t AgPointCloudEngine::getTotalPointCount(const Viewport* viewport, c
 	return numPoints;
 }
 
-int AgPointCloudEngine::_ReducePointCloudLoad(std::uint32_t amountOfPointsVisible, const Viewport* viewport, std::vector<ScanContainerID>& voxelContainerListOut)
+//////////////////////////////////////////////////////////////////////////
+// \brief: Candidate step of the point budget solver, lowering the LOD cap of
+//         one container from 'm_lod' to 'm_lod - 1'
+//////////////////////////////////////////////////////////////////////////
+struct BudgetStep
 {
-	const int viewId = _GetViewIndex(viewport);
-	if (viewId < 0)
-		return 0;
+	float           m_cost;         //screen space error added per point saved
+	size_t          m_entry;
+	std::uint8_t    m_lod;
+
+	bool operator <(const BudgetStep& rhs) const { return m_cost > rhs.m_cost; }    //cheapest step on top of the heap
+};
+
+static BudgetStep makeBudgetStep(const ScanContainerID& containerId, const AgVoxelContainer& container, size_t entry, std::uint8_t lod)
+{
+	//halving the splat density doubles the error of every view that wants at least 'lod'
+	float errorAdded = 0.0f;
+	for (const auto& lodRec : containerId.m_LODs)
+	{
+		if (lodRec.m_LOD >= lod)
+			errorAdded += std::ldexp(lodRec.m_screenSize, -(int)lod);
+	}
+	const std::uint32_t points = container.GetAmountOfLODPoints(lod);
+	const std::uint32_t pointsCoarser = container.GetAmountOfLODPoints(lod - 1);
+	const std::uint32_t pointsSaved = points > pointsCoarser ? points - pointsCoarser : 0;
+
+	BudgetStep step;
+	step.m_cost = errorAdded / (float)std::max(pointsSaved, 1u);
+	step.m_entry = entry;
+	step.m_lod = lod;
+	return step;
+}
+
+std::uint32_t AgPointCloudEngine::_ReducePointCloudLoad(std::vector<ScanContainerID>& voxelContainerListOut)
+{
+	URHO3D_PROFILE(ReducePointCloudLoad);
+
+	//a container is streamed once for all viewports, its cost is the finest LOD any view wants
+	std::vector<const AgVoxelContainer*> containers(voxelContainerListOut.size(), nullptr);
+	std::vector<std::uint8_t> lodCaps(voxelContainerListOut.size(), 0);
+	std::uint64_t totalPoints = 0;
+	for (size_t i = 0; i < voxelContainerListOut.size(); i++)
+	{
+		const ScanContainerID& contId = voxelContainerListOut[i];
+		const AgVoxelTreeRunTime* voxelTree = getScanAt(contId.m_scanId);
+		if (!voxelTree)
+			continue;
+		containers[i] = voxelTree->getVoxelContainerAt(contId.m_containerId);
+		if (!containers[i])
+			continue;
+
+		lodCaps[i] = std::min(findMaxLod(contId.m_LODs), (std::uint8_t)(32 - 1));
+		totalPoints += containers[i]->GetAmountOfLODPoints(lodCaps[i]);
+	}
 
-	auto totalVisiblePointsNew = amountOfPointsVisible;
-	//int reductionFactor = 0;                      //in LOD levels
-	auto amountOfPointsMax = mMaxPointsLoad * 1000000;
-	while (totalVisiblePointsNew > amountOfPointsMax)
+	//greedy descent: repeatedly take the LOD step that adds the least screen space
+	//error per point saved, until the project fits the budget. LOD 1 is kept so no
+	//visible container disappears completely
+	const std::uint64_t budget = mPointBudget;
+	if (budget > 0 && totalPoints > budget)
 	{
-		totalVisiblePointsNew = 0;
+		std::vector<BudgetStep> heap;
+		heap.reserve(voxelContainerListOut.size());
 		for (size_t i = 0; i < voxelContainerListOut.size(); i++)
 		{
-			ScanContainerID& contId = voxelContainerListOut[i];
-			const AgVoxelTreeRunTime* voxelTree = getScanAt(contId.m_scanId);
-			if (!voxelTree)
-				continue;
-			const AgVoxelContainer* containerPTr = voxelTree->getVoxelContainerAt(contId.m_containerId);
-			if (!containerPTr)
-				continue;
-
-			std::uint8_t& lodLevel = contId.m_LODs[viewId].m_LOD; //fetch lod
-			std::uint32_t& lodCount = contId.m_LODs[viewId].m_pointCount;
-			if (lodLevel > 0)
-				lodLevel--;
-
-			totalVisiblePointsNew += containerPTr->GetAmountOfLODPoints(lodLevel);
-
-			if (lodLevel <= containerPTr->m_currentLODLoaded)
-				lodCount = containerPTr->GetAmountOfLODPoints(lodLevel);
-			else if (containerPTr->m_currentLODLoaded > 0)
-				lodCount = containerPTr->GetAmountOfLODPoints(containerPTr->m_currentLODLoaded);
+			if (containers[i] && lodCaps[i] > 1)
+				heap.push_back(makeBudgetStep(voxelContainerListOut[i], *containers[i], i, lodCaps[i]));
+		}
+		std::make_heap(heap.begin(), heap.end());
+
+		while (totalPoints > budget && !heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			const BudgetStep step = heap.back();
+			heap.pop_back();
+
+			const AgVoxelContainer& container = *containers[step.m_entry];
+			std::uint8_t& lodCap = lodCaps[step.m_entry];
+			totalPoints -= container.GetAmountOfLODPoints(lodCap);
+			--lodCap;
+			totalPoints += container.GetAmountOfLODPoints(lodCap);
+
+			if (lodCap > 1)
+			{
+				heap.push_back(makeBudgetStep(voxelContainerListOut[step.m_entry], container, step.m_entry, lodCap));
+				std::push_heap(heap.begin(), heap.end());
+			}
+		}
+	}
+
+	for (size_t i = 0; i < voxelContainerListOut.size(); i++)
+	{
+		const AgVoxelContainer* containerPTr = containers[i];
+		if (!containerPTr)
+			continue;
+
+		//LOD files 0 .. loadedLODs - 1 are loaded
+		const unsigned loadedLODs = containerPTr->getNumLoadedLODs();
+		for (auto& lodRec : voxelContainerListOut[i].m_LODs)
+		{
+			lodRec.m_LOD = std::min(lodRec.m_LOD, lodCaps[i]);
+			lodRec.m_renderPointCount = containerPTr->GetAmountOfLODPoints(lodRec.m_LOD);
+
+			if (lodRec.m_LOD < loadedLODs)
+				lodRec.m_pointCount = containerPTr->GetAmountOfLODPoints(lodRec.m_LOD);
+			else if (loadedLODs > 0)
+				lodRec.m_pointCount = containerPTr->GetAmountOfLODPoints(loadedLODs - 1);
 			else
-				lodCount = 0;
+				lodRec.m_pointCount = 0;
+		}
+	}
+
+	return (std::uint32_t)std::min(totalPoints, (std::uint64_t)std::numeric_limits<std::uint32_t>::max());
+}
+
+void AgPointCloudEngine::_UpdatePointBudget()
+{
+	const std::uint64_t maxBudget = (std::uint64_t)mMaxPointsLoad * 1000000;
+	const Time* time = GetSubsystem<Time>();
+	if (mTargetFrameTime <= 0.0f || !time)
+	{
+		mPointBudget = maxBudget;
+		return;
+	}
+
+	//exponential average, so a single slow frame does not drop detail
+	const float frameTime = time->GetTimeStep() * 1000.0f;
+	mAverageFrameTime = mAverageFrameTime > 0.0f ? mAverageFrameTime + (frameTime - mAverageFrameTime) * 0.1f : frameTime;
+
+	double budget = (double)(mPointBudget ? mPointBudget : maxBudget);
+	if (mAverageFrameTime > mTargetFrameTime * 1.05f)
+		budget *= std::max(mTargetFrameTime / mAverageFrameTime, 0.75f);
+	else if (mAverageFrameTime < mTargetFrameTime * 0.9f)
+		budget *= 1.05;
+
+	const double minBudget = std::min((double)MIN_POINT_BUDGET, (double)maxBudget);
+	mPointBudget = (std::uint64_t)Clamp(budget, minBudget, (double)maxBudget);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Test the containers [begin, end) of a scan against a frustum in scan
+//         space, sets 'visibleOut[i - begin]' for every container that is not
+//         completely outside. Same test as Frustum::IsInsideFast
+//////////////////////////////////////////////////////////////////////////
+static void frustumCullContainers(const AgVoxelContainerArrays& arrays, unsigned begin, unsigned end, const Frustum& frustum,
+	std::uint8_t* visibleOut)
+{
+	unsigned i = begin;
+#ifdef URHO3D_SSE
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&arrays.m_centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&arrays.m_centerY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&arrays.m_centerZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&arrays.m_extentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&arrays.m_extentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&arrays.m_extentZ[i]);
+
+		__m128 outside = zero;
+		for (const auto& plane : frustum.planes_)
+		{
+			const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal_.x_), centerX),
+				_mm_mul_ps(_mm_set1_ps(plane.normal_.y_), centerY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal_.z_), centerZ), _mm_set1_ps(plane.d_)));
+			const __m128 absDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.absNormal_.x_), extentX),
+				_mm_mul_ps(_mm_set1_ps(plane.absNormal_.y_), extentY)),
+				_mm_mul_ps(_mm_set1_ps(plane.absNormal_.z_), extentZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_sub_ps(zero, absDist)));
+		}
+
+		const int outsideMask = _mm_movemask_ps(outside);
+		for (unsigned k = 0; k < 4; ++k)
+		{
+			if (!(outsideMask & (1 << k)))
+				visibleOut[i + k - begin] = 1;
 		}
 	}
-	return totalVisiblePointsNew;
+#endif
+	for (; i < end; ++i)
+	{
+		bool outside = false;
+		for (const auto& plane : frustum.planes_)
+		{
+			const float dist = plane.normal_.x_ * arrays.m_centerX[i] + plane.normal_.y_ * arrays.m_centerY[i] +
+				plane.normal_.z_ * arrays.m_centerZ[i] + plane.d_;
+			const float absDist = plane.absNormal_.x_ * arrays.m_extentX[i] + plane.absNormal_.y_ * arrays.m_extentY[i] +
+				plane.absNormal_.z_ * arrays.m_extentZ[i];
+			if (dist < -absDist)
+			{
+				outside = true;
+				break;
+			}
+		}
+		if (!outside)
+			visibleOut[i - begin] = 1;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Range of containers of one scan, culled by one work item
+//////////////////////////////////////////////////////////////////////////
+struct AgPointCloudEngine::VisibleNodesChunk
+{
+	AgPointCloudEngine*                     m_engine;
+	int                                     m_scanId;
+	unsigned                                m_begin;
+	unsigned                                m_end;
+	const std::vector<Frustum>*             m_frustums;
+	std::vector<ScanContainerID>            m_visibleNodes;
+};
+
+void AgPointCloudEngine::_GetVisibleNodesWork(const WorkItem* item, unsigned threadIndex)
+{
+	VisibleNodesChunk* chunk = reinterpret_cast<VisibleNodesChunk*>(item->start_);
+	chunk->m_engine->_GetVisibleNodesFromScan(chunk->m_scanId, chunk->m_begin, chunk->m_end, *chunk->m_frustums, chunk->m_visibleNodes);
 }
 
 //visible voxels after frustum culling
-void    AgPointCloudEngine::_GetVisibleNodesFromScan(int scan, std::vector<ScanContainerID>& voxelContainerListOut)
+void    AgPointCloudEngine::_GetVisibleNodesFromScan(int scan, unsigned begin, unsigned end, const std::vector<Frustum>& scanFrustums,
+	std::vector<ScanContainerID>& voxelContainerListOut)
 {
-	const double curTime = RealityComputing::Utility::Time::getTimeSinceEpochinMilliSec();
 	int treeIndex = scan;
 	AgVoxelTreeRunTime* curTreePtr = getScanAt(treeIndex);
 	if (!curTreePtr)
 		return;
 
-	PODVector<AgVoxelContainer*> containers;
-	curTreePtr->GetComponents<AgVoxelContainer>(containers);
+	const AgVoxelContainerArrays& containers = curTreePtr->getContainerArrays();
+	end = std::min(end, containers.size());
+	if (begin >= end)
+		return;
+
+	// Batched frustum test of the whole range, a container is kept if any view sees it.
+	// Without frustums every container goes on to the LOD test, which rejects off screen voxels
+	std::vector<std::uint8_t> visible(end - begin, scanFrustums.empty() ? 1 : 0);
+	for (const auto& frustum : scanFrustums)
+		frustumCullContainers(containers, begin, end, frustum, visible.data());
 
 	// Allocate an element into the list that will become the next working element.
-	voxelContainerListOut.reserve(voxelContainerListOut.size() + containers.Size() + 1);
 	voxelContainerListOut.resize(voxelContainerListOut.size() + 1);
 
+	const Renderer* renderer = GetSubsystem<Renderer>();
 	//for each voxel container
-	int j = 0;
-	for (PODVector<AgVoxelContainer*>::Iterator i = containers.Begin(); i != containers.End(); ++i, ++j)
+	for (unsigned j = begin; j < end; ++j)
 	{
-		AgVoxelContainer* renderLeaf = *i;
+		if (!visible[j - begin])
+			continue;
+
+		AgVoxelContainer* renderLeaf = containers.m_containers[j];
 
 		// If the voxel is clipped, skip it
 		if (!renderLeaf || renderLeaf->isClipFlag(ALL_CLIPPED))
 			continue;
 
 		// See if its LOD is not zero
-		const Renderer* renderer = GetSubsystem<Renderer>();
 		ScanContainerID& containerId = voxelContainerListOut.back();
 		if (calcVoxelLODs(renderer, mViewports, *renderLeaf, containerId.m_LODs, mPointSize))
 		{
 			// do not test for spatial filters here, which has been done by doCropFilterForScanAndVoxelLevel
 			if (!renderLeaf->isClipFlag(ALL_CLIPPED))
 			{
-				renderLeaf->m_lastTimeModified = curTime;
-				//renderLeaf->m_visibleListId = (int)voxelContainerListOut.size();
+				renderLeaf->touch();
 
 				containerId.m_scanId = treeIndex;
-				containerId.m_containerId = j;
+				containerId.m_containerId = (int)j;
 
 				//use flip flag on the voxel container to set spatial filter result
 				switch (renderLeaf->getClipFlag())
@@ -405,28 +608,23 @@ void    AgPointCloudEngine::_GetVisibleNodesFromScan(int scan, std::vector<ScanC
 					break;
 				}
 
-				//update num points
+				//update num points, LOD files 0 .. loadedLODs - 1 are loaded
+				const unsigned loadedLODs = renderLeaf->getNumLoadedLODs();
 				for (size_t k = 0; k != containerId.m_LODs.size(); ++k)
 				{
 					auto& lodLevel = containerId.m_LODs[k].m_LOD;
 					auto& lodCount = containerId.m_LODs[k].m_pointCount;
 
-					if (lodLevel <= renderLeaf->m_currentLODLoaded)
+					if (lodLevel < loadedLODs)
 						lodCount = renderLeaf->GetAmountOfLODPoints(lodLevel);
-					else if (renderLeaf->m_currentLODLoaded > 0)   //needs refinement reset to zero
-						lodCount = renderLeaf->GetAmountOfLODPoints(renderLeaf->m_currentLODLoaded);
+					else if (loadedLODs > 0)   //needs refinement, draws the finest loaded LOD meanwhile
+						lodCount = renderLeaf->GetAmountOfLODPoints((std::uint8_t)(loadedLODs - 1));
 					else
 						lodCount = 0;
 				}
 				//add this to result list by creating a new working scan ID
 				voxelContainerListOut.resize(voxelContainerListOut.size() + 1);
 			}
-			else
-				continue;
-		}
-		else
-		{
-			continue;
 		}
 	}
 	// remove the last element, since it was just a working value
@@ -434,51 +632,194 @@ void    AgPointCloudEngine::_GetVisibleNodesFromScan(int scan, std::vector<ScanC
 }
 
 int AgPointCloudEngine::_GetVisibleNodesFromScans(const std::vector<PointCloudInformation> &visibleScanList,
-	std::vector<ScanContainerID>& voxelContainerListOut)
+	std::vector<ScanContainerID>& voxelContainerListOut, bool frustumCull)
 {
-	//TODO: Consider if we can replace PointCloudInformation with int
-	int potentialVisiblenodes = 0;
+	URHO3D_PROFILE(GetVisibleVoxels);
+
+	const Renderer* renderer = GetSubsystem<Renderer>();
+	if (!renderer)
+		return 0;
+
+	std::vector<Frustum> worldFrustums;
+	for (unsigned i = 0; i < renderer->GetNumViewports(); ++i)
+	{
+		const Viewport* viewport = renderer->GetViewport(i);
+		const Camera* camera = viewport ? viewport->GetCamera() : nullptr;
+		if (camera)
+		{
+			// also refreshes the cached view matrix before calcLOD reads it on the worker threads
+			camera->GetView();
+			worldFrustums.push_back(camera->GetFrustum());
+		}
+	}
+	if (worldFrustums.empty())
+		return 0;
+
+	// Frustums are moved to scan space once, so the container bounds do not need transforming.
+	// The container arrays are rebuilt here if needed, worker threads only read them
+	std::vector<std::vector<Frustum> > scanFrustums(visibleScanList.size());
+	std::vector<VisibleNodesChunk> chunks;
 	for (size_t i = 0; i < visibleScanList.size(); i++)
 	{
-		int treeIndex = visibleScanList[i].m_scanId;
+		const int treeIndex = visibleScanList[i].m_scanId;
 		const AgVoxelTreeRunTime* curTreePtr = getScanAt(treeIndex);
 		if (!curTreePtr)
 			continue;
 
-		potentialVisiblenodes += curTreePtr->GetNumComponents();
+		const unsigned numContainers = curTreePtr->getContainerArrays().size();
+		const Matrix3x4 toScan = curTreePtr->GetWorldTransform().Inverse();
+		if (frustumCull)
+		{
+			for (const auto& frustum : worldFrustums)
+				scanFrustums[i].push_back(frustum.Transformed(toScan));
+		}
+
+		for (unsigned begin = 0; begin < numContainers; begin += CULL_CONTAINERS_PER_ITEM)
+		{
+			VisibleNodesChunk chunk;
+			chunk.m_engine = this;
+			chunk.m_scanId = treeIndex;
+			chunk.m_begin = begin;
+			chunk.m_end = std::min(begin + CULL_CONTAINERS_PER_ITEM, numContainers);
+			chunk.m_frustums = &scanFrustums[i];
+			chunks.push_back(chunk);
+		}
 	}
-	//reserve already space, for huge point clouds with many nodes, this reduces culling
-	//in about half of the time
-	if (potentialVisiblenodes)
-		voxelContainerListOut.reserve(potentialVisiblenodes);
 
-	for (size_t i = 0; i < visibleScanList.size(); i++)
+	auto* queue = GetSubsystem<WorkQueue>();
+	if (queue && chunks.size() > 1)
+	{
+		for (auto& chunk : chunks)
+		{
+			SharedPtr<WorkItem> item = queue->GetFreeItem();
+			item->priority_ = M_MAX_UNSIGNED;
+			item->workFunction_ = _GetVisibleNodesWork;
+			item->start_ = &chunk;
+			queue->AddWorkItem(item);
+		}
+		queue->Complete(M_MAX_UNSIGNED);
+	}
+	else
+	{
+		for (auto& chunk : chunks)
+			_GetVisibleNodesFromScan(chunk.m_scanId, chunk.m_begin, chunk.m_end, *chunk.m_frustums, chunk.m_visibleNodes);
+	}
+
+	// Merge in chunk order, the result does not depend on the thread timing
+	size_t numVisible = voxelContainerListOut.size();
+	for (const auto& chunk : chunks)
+		numVisible += chunk.m_visibleNodes.size();
+	voxelContainerListOut.reserve(numVisible);
+	for (auto& chunk : chunks)
+	{
+		for (auto& containerId : chunk.m_visibleNodes)
+			voxelContainerListOut.push_back(std::move(containerId));
+	}
+
+	return int(voxelContainerListOut.size());
+}
+
+int AgPointCloudEngine::_CullOccludedNodes(std::vector<ScanContainerID>& voxelContainerListOut)
+{
+	URHO3D_PROFILE(CullOccludedVoxels);
+
+	Renderer* renderer = GetSubsystem<Renderer>();
+	if (!renderer || voxelContainerListOut.empty())
+		return int(voxelContainerListOut.size());
+
+	const size_t numNodes = voxelContainerListOut.size();
+	std::vector<AgVoxelContainer*> containers(numNodes, nullptr);
+	for (size_t i = 0; i < numNodes; ++i)
 	{
-		_GetVisibleNodesFromScan(visibleScanList[i].m_scanId, voxelContainerListOut);
+		AgVoxelTreeRunTime* curTreePtr = getScanAt(voxelContainerListOut[i].m_scanId);
+		if (curTreePtr)
+			containers[i] = curTreePtr->getVoxelContainerAt(voxelContainerListOut[i].m_containerId);
 	}
 
-	//reduce amount of points needed to be loaded
-	if (mMaxPointsLoad > 0)
+	const unsigned numViewports = renderer->GetNumViewports();
+	if (mOcclusionBuffers.size() < numViewports)
+		mOcclusionBuffers.resize(numViewports);
+
+	// A container is kept when any viewport sees it, viewports without a buffer see everything
+	std::vector<std::uint8_t> visible(numNodes, 0);
+	std::vector<AgOcclusionTestItem> items(numNodes);
+	bool anyBuffer = false;
+	for (unsigned v = 0; v < numViewports; ++v)
 	{
-		for (const auto& viewport : mViewports)
+		Viewport* viewport = renderer->GetViewport(v);
+		Camera* camera = viewport ? viewport->GetCamera() : nullptr;
+		const View* view = viewport ? viewport->GetView() : nullptr;
+		if (!camera || !view)
+			continue;
+
+		SharedPtr<OcclusionBuffer>& buffer = mOcclusionBuffers[v];
+		if (!buffer)
+			buffer = new OcclusionBuffer(context_);
+		const int width = renderer->GetOcclusionBufferSize();
+		if (!buffer->SetSize(width, RoundToInt(width / camera->GetAspectRatio()), false))
 		{
-			if (!viewport)
-				continue;
-			std::uint32_t totalPoints = getTotalPointCount(viewport, voxelContainerListOut);
-			if (totalPoints > mMaxPointsLoad * 1000000)
+			std::fill(visible.begin(), visible.end(), 1);
+			break;
+		}
+		buffer->SetView(camera);
+		buffer->SetMaxTriangles((unsigned)renderer->GetMaxOccluderTriangles());
+		buffer->SetCullMode(CULL_NONE);
+		buffer->Clear();
+		anyBuffer = true;
+
+		// Containers without a LOD for this viewport are tested but never occlude
+		const IntVector2 viewSize = view->GetViewSize();
+		const float minOccluderSize = renderer->GetOccluderSizeThreshold() * (float)std::max(viewSize.x_, viewSize.y_);
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			items[i] = AgOcclusionTestItem();
+			if (containers[i])
 			{
-				_ReducePointCloudLoad(totalPoints, viewport, voxelContainerListOut);
+				const auto& lods = voxelContainerListOut[i].m_LODs;
+				AgVoxelOcclusion::makeTestItem(*containers[i], v < lods.size() ? lods[v].m_screenSize : 0.0f, items[i]);
 			}
 		}
+		mCullStats.m_occluders += AgVoxelOcclusion::cull(buffer, camera->GetNode()->GetWorldPosition(), items, minOccluderSize,
+			mPointSize, visible.data());
 	}
+	if (!anyBuffer)
+		return int(voxelContainerListOut.size());
 
-	return int(voxelContainerListOut.size());
+	size_t numVisible = 0;
+	for (size_t i = 0; i < numNodes; ++i)
+	{
+		if (visible[i])
+		{
+			if (numVisible != i)
+				voxelContainerListOut[numVisible] = std::move(voxelContainerListOut[i]);
+			++numVisible;
+			continue;
+		}
+
+		AgVoxelContainer* container = containers[i];
+		container->setOccluded(true);
+		mOccludedContainers.push_back(WeakPtr<AgVoxelContainer>(container));
+		++mCullStats.m_occludedContainers;
+		mCullStats.m_occludedPoints += container->getLODPointCount(findMaxLod(voxelContainerListOut[i].m_LODs));
+	}
+	voxelContainerListOut.resize(numVisible);
+
+	return int(numVisible);
 }
 
 void AgPointCloudEngine::_DoFrustumCullingAndLODDetermination(std::vector<ScanContainerID>& idsOut)
 {
 	std::vector<PointCloudInformation> visibleList;
 
+	// containers hidden last update are drawn again unless they are still occluded
+	for (auto& container : mOccludedContainers)
+	{
+		if (container)
+			container->setOccluded(false);
+	}
+	mOccludedContainers.clear();
+	mCullStats = AgCullStats();
+
 	if (_DoPerformFrustumCulling(visibleList))
 	{
 		//only perform frustum culling
@@ -488,13 +829,17 @@ void AgPointCloudEngine::_DoFrustumCullingAndLODDetermination(std::vector<ScanCo
 		}
 		else if (mCullMethod == kCullMethodOccludersOnly)
 		{
-			//assumes occluder target already has textures --> ( buildOccluders() )
-			/*if (mOccluderTargetPtr)
-			{
-			cullUsingOccluderData(visibleList, idsOut);
-			}*/
+			//containers are only rejected by their LOD (off screen) and the occluders
+			_GetVisibleNodesFromScans(visibleList, idsOut, false);
+			_CullOccludedNodes(idsOut);
+		}
+		else if (mCullMethod == kCullMethodHybrid)
+		{
+			_GetVisibleNodesFromScans(visibleList, idsOut);
+			_CullOccludedNodes(idsOut);
 		}
 	}
+	mCullStats.m_visibleContainers = (std::uint32_t)idsOut.size();
 }
 
 bool AgPointCloudEngine::_MustVisibleNodesBeFullyUpdated()
@@ -504,7 +849,6 @@ bool AgPointCloudEngine::_MustVisibleNodesBeFullyUpdated()
 
 void AgPointCloudEngine::_SetPointRequestsForVisibleNodes()
 {
-	// TODO:mutlithread
 	freeLRUCache();
 
 	refineVoxels(mVisibleNodes);
@@ -516,8 +860,9 @@ void AgPointCloudEngine::updateVisibleNodes(const Viewport* viewport)
 	{
 		mVisibleNodes.clear();
 		_DoFrustumCullingAndLODDetermination(mVisibleNodes);
-		std::uint32_t totalPointCount = getTotalPointCount(viewport, mVisibleNodes);
-		std::uint32_t totalPointCountAfterReduction = _ReducePointCloudLoad(totalPointCount, viewport, mVisibleNodes);
+		//one budget for all viewports, after culling so hidden containers cost nothing
+		_UpdatePointBudget();
+		mBudgetPointCount = _ReducePointCloudLoad(mVisibleNodes);
 		_SetPointRequestsForVisibleNodes();
 	}
 	else
@@ -734,67 +1079,81 @@ std::uint64_t AgPointCloudEngine::getAllocatedMemory() const
 	return totalMemory;
 }
 
-std::uint64_t AgPointCloudEngine::freeLRUCache()
+unsigned AgPointCloudEngine::pickPoints(const Camera* camera, const std::vector<Vector2>& screenPositions, float pixelRadius,
+	int viewHeight, std::vector<AgPointPickResult>& resultsOut, float maxDistance) const
 {
-	std::uint64_t currentMemUsage = getAllocatedMemory();
-	if (currentMemUsage < m_maxAllocatedMemory)
-		return 0ULL;
+	resultsOut.clear();
+	if (!camera || viewHeight <= 0)
+		return 0;
 
-	std::vector<AgVoxelContainer*> allCointainerList;
-	if (currentMemUsage > m_maxAllocatedMemory)
+	std::vector<Ray> rays(screenPositions.size());
+	for (size_t i = 0; i < screenPositions.size(); ++i)
+		rays[i] = camera->GetScreenRay(screenPositions[i].x_, screenPositions[i].y_);
+
+	// One pixel covers a constant world size in orthographic views, and grows with the distance in perspective ones.
+	// Screen rays start at the near plane
+	AgPointPickTolerance tolerance;
+	if (camera->IsOrthographic())
+		tolerance.m_radius = pixelRadius * camera->GetOrthoSize() / (camera->GetZoom() * viewHeight);
+	else
 	{
-		for (uint16_t i = 0; i < m_scanList.size(); i++)
-		{
-			AgVoxelTreeRunTime *curTreePtr = getScanAt(i);
-			PODVector<AgVoxelContainer*> containers;
-			curTreePtr->GetComponents<AgVoxelContainer>(containers);
-			for (PODVector<AgVoxelContainer*>::Iterator i = containers.Begin(); i != containers.End(); ++i)
-			{
-				if (!(*i)->isGeometryEmpty())
-				{
-					allCointainerList.push_back((*i));
-				}
-			}
-		}
+		tolerance.m_slope = pixelRadius * 2.0f * tanf(camera->GetFov() * M_DEGTORAD_2) / (camera->GetZoom() * viewHeight);
+		tolerance.m_radius = tolerance.m_slope * camera->GetNearClip();
 	}
 
-	std::uint64_t memCleared = 0ULL;
-	std::uint64_t memFreeInBytes = m_lruFreeMemory * 1024 * 1024;//currentMemUsage - m_maxAllocatedMemory;
+	return pickPoints(rays, tolerance, resultsOut, maxDistance);
+}
+
+unsigned AgPointCloudEngine::pickPoints(const std::vector<Ray>& rays, const AgPointPickTolerance& tolerance,
+	std::vector<AgPointPickResult>& resultsOut, float maxDistance) const
+{
+	URHO3D_PROFILE(PickPoints);
 
-																	//sort the containers LRU
-	std::sort(allCointainerList.begin(), allCointainerList.end(), VoxelTreeSorterLRU());
-	for (size_t i = 0; i < allCointainerList.size(); i++)
+	resultsOut.assign(rays.size(), AgPointPickResult());
+	for (auto& result : resultsOut)
+		result.m_distance = maxDistance;
+	if (rays.empty())
+		return 0;
+
+	// Every container traces the whole batch, the results keep the nearest hit so far and cut the rays short
+	for (const auto& s : m_scanList)
 	{
-		AgVoxelContainer *curContainerPtr = allCointainerList[i];
-		if(!curContainerPtr)
+		const AgVoxelTreeRunTime* curTreePtr = getScanAt(s);
+		if (!curTreePtr)
 			continue;
-		//RCScopedLock<RCMutex> locker(*(curContainerPtr->m_loadMutexPtr));
-		memCleared += curContainerPtr->clearGeometry();
 
-		curContainerPtr->m_currentDrawLOD = -1;
-		curContainerPtr->m_currentLODLoaded = -1;
-
-		//done
-		if (memCleared >= memFreeInBytes)
-			break;
+		const AgVoxelContainerArrays& containers = curTreePtr->getContainerArrays();
+		for (AgVoxelContainer* container : containers.m_containers)
+		{
+			if (container && !container->isGeometryEmpty() && !container->isClipFlag(ALL_CLIPPED))
+				container->raycastPoints(rays.data(), (unsigned)rays.size(), tolerance, resultsOut.data());
+		}
+	}
 
+	unsigned numHits = 0;
+	for (auto& result : resultsOut)
+	{
+		if (result.m_container)
+			++numHits;
+		else
+			result.m_distance = M_INFINITY;
 	}
-	return memCleared;
+	return numHits;
 }
 
-float AgPointCloudEngine::refineVoxels(std::vector<ScanContainerID>& visibleLeafNodes, int timeOutInMS, const bool& interupted, std::vector<bool>* updatedViewports)
+std::uint64_t AgPointCloudEngine::freeLRUCache()
 {
-	if (visibleLeafNodes.empty())
-	{
-		return 1.0f;
-	}
+	Scene* scene = GetScene();
+	AgPointCloudOptions* options = scene ? scene->GetComponent<AgPointCloudOptions>() : nullptr;
+	if (!options)
+		return 0ULL;
 
-	/*if (m_worldPtr->getCanDrawWorld() == false)
-		return 1.0f;*/
+	return options->getVoxelCache().trim();
+}
 
-	//stream in from disk
-	double startTime = RealityComputing::Utility::Time::getTimeSinceEpochinMilliSec();
-	AgVoxelTreeRunTime       *curVoxelTree = NULL;
+float AgPointCloudEngine::refineVoxels(std::vector<ScanContainerID>& visibleLeafNodes, int timeOutInMS, const bool& interupted, std::vector<bool>* updatedViewports)
+{
+	mStreamer->beginFrame(timeOutInMS);
 
 	// TODO: Actually determine which views have changed.
 	// For now, just mark them all as changed.
@@ -804,29 +1163,26 @@ float AgPointCloudEngine::refineVoxels(std::vector<ScanContainerID>& visibleLeaf
 		updatedViewports->assign(renderer->GetNumViewports(), false);
 	}
 
-	size_t nodesCompleted;
-	for (nodesCompleted = 0; nodesCompleted < visibleLeafNodes.size(); nodesCompleted++)
+	size_t nodesCompleted = 0;
+	for (size_t i = 0; i < visibleLeafNodes.size(); i++)
 	{
+		//requests made so far stay queued, the rest are renewed on the next call
 		if (interupted)
-		{
-			//DeletePtr(curMemMap);
-			return false;
-		}
-
-		/*if (m_worldPtr->getCanDrawWorld() == false)
-			break;*/
+			return 0.0f;
 
-		ScanContainerID& curInfo = visibleLeafNodes[nodesCompleted];
-		int treeIndex = curInfo.m_scanId;
-
-		int containerIndex = curInfo.m_containerId;
+		ScanContainerID& curInfo = visibleLeafNodes[i];
 		int wantedLOD = findMaxLod(curInfo.m_LODs);
 
-		AgVoxelTreeRunTime *curTreePtr = getScanAt(treeIndex);
-		AgVoxelContainer*   curContainerPtr = curTreePtr->getVoxelContainerAt(containerIndex);
+		AgVoxelTreeRunTime *curTreePtr = getScanAt(curInfo.m_scanId);
+		if (!curTreePtr)
+			continue;
+		AgVoxelContainer*   curContainerPtr = curTreePtr->getVoxelContainerAt(curInfo.m_containerId);
+		if (!curContainerPtr)
+			continue;
 
 		//already loaded
-		if (wantedLOD <= curContainerPtr->m_currentLODLoaded)
+		const int loadedLOD = (int)curContainerPtr->getNumLoadedLODs();
+		if (wantedLOD <= loadedLOD || loadedLOD >= curContainerPtr->GetMaxLOD())
 		{
 			for (size_t iLod = 0; iLod != curInfo.m_LODs.size(); ++iLod)
 			{
@@ -834,12 +1190,10 @@ float AgPointCloudEngine::refineVoxels(std::vector<ScanContainerID>& visibleLeaf
 				int lod = (wantedLOD <= lodRec.m_LOD) ? wantedLOD : lodRec.m_LOD;
 				lodRec.m_pointCount = curContainerPtr->GetAmountOfLODPoints(lod);
 			}
+			nodesCompleted++;
 			continue;
 		}
 
-		//new tree encountered
-		int oldLod = curContainerPtr->m_currentLODLoaded;
-
 		//for each view, set update to 'true' if the voxel is currently not complete, and this needs updating.
 		if (updatedViewports != NULL)
 		{
@@ -848,59 +1202,39 @@ float AgPointCloudEngine::refineVoxels(std::vector<ScanContainerID>& visibleLeaf
 			for (size_t j = 0; j < updatedViewports->size(); ++j)
 			{
 				const std::uint8_t lod = j < curInfo.m_LODs.size() ? curInfo.m_LODs[j].m_LOD : 0;
-
-				// Mark the viewport as needing updating if its desired LOD was greater than the old loaded LOD
-				// (we assume that the newly loaded LOD is at least as big as the desired one, or else wantedLOD above will be wrong)
-				if (lod > oldLod)
+				if (lod > loadedLOD)
 				{
 					(*updatedViewports)[j] = true;  //mark as need upate
 				}
 			}
 		}
 
-		/*if (m_worldPtr->getCanDrawWorld() == false)
-			break;*/
-		//acquire lock
+		//the streamer loads one LOD file per container at a time, the next one is
+		//requested again on a later frame as long as the voxel stays visible
+		mStreamer->request(curContainerPtr, curTreePtr->isLidarData(), calcScreenSpaceError(curInfo.m_LODs, loadedLOD));
+	}
 
-		//curContainerPtr->m_loadMutexPtr->lock();
-		curContainerPtr->loadLODInternal(curTreePtr->isLidarData(), wantedLOD, true);
+	//voxels that were not requested this frame left the frustum and are cancelled
+	mStreamer->endFrame();
 
-		/*if (m_worldPtr->getCanDrawWorld() == false)
-			break;*/
+	if (visibleLeafNodes.empty())
+		return 1.0f;
+	return float(nodesCompleted) / float(visibleLeafNodes.size());
+}
 
-		//update amount of points
-		int amountOfPoints = curContainerPtr->GetAmountOfLODPoints(wantedLOD);
-		if (amountOfPoints)
-		{
-			for (size_t iLod = 0; iLod != curInfo.m_LODs.size(); ++iLod)
-			{
-				LodRecord& lodRec = curInfo.m_LODs[iLod];
-				const int lodDiff = wantedLOD - lodRec.m_LOD;
-				if (lodDiff <= 0)
-				{
-					lodRec.m_pointCount = amountOfPoints;
-				}
-				else
-				{
-					lodRec.m_pointCount = curContainerPtr->GetAmountOfLODPoints(lodRec.m_LOD);
-				}
-			}
-		}
-		/////////////////////////////////////////////////////////////////////////////////////////////////////////
-		//unlock
-		//is there a timeout?
-		if (timeOutInMS > 0)
-		{
-			double currentTime = RealityComputing::Utility::Time::getTimeSinceEpochinMilliSec();
-			if (static_cast<int>(currentTime - startTime) > timeOutInMS)
-			{
-				//not done loading all points yet
-				return false;
-			}
-		}
-	}
+void AgPointCloudEngine::setMaxConcurrentLoads(unsigned count)
+{
+	mStreamer->setMaxInFlight(count);
+}
 
-	return float(nodesCompleted) / float(visibleLeafNodes.size());
+unsigned AgPointCloudEngine::getMaxConcurrentLoads() const
+{
+	return mStreamer->getMaxInFlight();
+}
+
+const AgStreamStats& AgPointCloudEngine::getStreamingStats() const
+{
+	return mStreamer->getStats();
 }
 
 //void AgPointCloudEngine::evaluate(std::vector<AgDrawInfo>& pointList, AgCameraView::Handle viewId, const std::vector<ScanContainerID>& visibleLeafNodes)
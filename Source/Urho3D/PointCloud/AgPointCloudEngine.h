@@ -4,11 +4,16 @@
 #include "../Math/StringHash.h"
 
 #include "AgVoxelTreeRunTime.h"
+#include "AgVoxelStreamer.h"
 
 #include <common/RCTransform.h>
 
 namespace Urho3D {
+	class Camera;
 	class Viewport;
+	class Frustum;
+	class OcclusionBuffer;
+	struct WorkItem;
 }
 
 namespace ambergris {
@@ -23,7 +28,8 @@ namespace ambergris {
 			std::uint32_t m_pointCount;
 			std::uint32_t m_renderPointCount;
 			std::uint32_t m_desiredPointCount;
-			LodRecord() : m_LOD(0), m_pointCount(0), m_renderPointCount(0), m_desiredPointCount(0) {}
+			float m_screenSize;                     //projected size of the voxel in pixels
+			LodRecord() : m_LOD(0), m_pointCount(0), m_renderPointCount(0), m_desiredPointCount(0), m_screenSize(0.0f) {}
 		};
 
 		//////////////////////////////////////////////////////////////////////////
@@ -46,6 +52,18 @@ namespace ambergris {
 			int                                     m_spatialFilterResult;
 		};
 
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgCullStats culling counters of the last visibility update
+		//////////////////////////////////////////////////////////////////////////
+		struct AgCullStats
+		{
+			std::uint32_t m_visibleContainers;      //containers left after culling
+			std::uint32_t m_occluders;              //containers rasterized as occluder proxies
+			std::uint32_t m_occludedContainers;     //containers hidden by the occluders
+			std::uint64_t m_occludedPoints;         //points of the wanted LODs of the occluded containers
+			AgCullStats() : m_visibleContainers(0), m_occluders(0), m_occludedContainers(0), m_occludedPoints(0) {}
+		};
+
 		struct PointCloudLoadOptions
 		{
 			bool useFileHeaderTransform;
@@ -53,24 +71,6 @@ namespace ambergris {
 			PointCloudLoadOptions() : useFileHeaderTransform(true) {}
 		};
 
-		namespace VoxelTreeRunTimeVars
-		{
-			static const Urho3D::StringHash VAR_SCANNERORIGIN("scannerOrigin");
-			static const Urho3D::StringHash VAR_OCTREEFLAGS("OctreeFlags");
-			static const Urho3D::StringHash VAR_TOTALPOINTS("TotalPoints");
-			static const Urho3D::StringHash VAR_HASRGB("HasRGB");
-			static const Urho3D::StringHash VAR_HASNORMALS("HasNormals");
-			static const Urho3D::StringHash VAR_HASINTENSITY("HasIntensity");
-			static const Urho3D::StringHash VAR_LIDARDATA("IsLidarData");
-			static const Urho3D::StringHash VAR_MATERIAL("Material");
-			static const Urho3D::StringHash VAR_POINTSIZE("PointSize");
-
-			static const Urho3D::StringHash VAR_SVOBOUNDSMIN("svoBoundsMin");
-			static const Urho3D::StringHash VAR_SVOBOUNDSMAX("svoBoundsMax");
-			static const Urho3D::StringHash VAR_SCANBOUNDSMIN("scanBoundsMin");
-			static const Urho3D::StringHash VAR_SCANBOUNDSMAX("scanBoundsMax");
-		};
-
 		class AgPointCloudEngine : public Urho3D::Component
 		{
 			URHO3D_OBJECT(AgPointCloudEngine, Urho3D::Component);
@@ -85,7 +85,7 @@ namespace ambergris {
 			{
 				kCullMethodFrustumCullingOnly = 0,
 				kCullMethodOccludersOnly = 1,
-				kCullMethodHybrid = 2       // TODO
+				kCullMethodHybrid = 2
 			};
 
 			enum POINTCLOUD_SELECTION_LEVEL
@@ -118,19 +118,85 @@ namespace ambergris {
 			std::uint32_t      getTotalPointCount(const Urho3D::Viewport* viewport, const std::vector<ScanContainerID>& voxelContainerListOut) const;
 
 			//////////////////////////////////////////////////////////////////////////
-			//\brief: Free's memory, returns the amount of memory freed
+			//\brief: Free's the least recently used voxels when the cache budget of
+			//        AgPointCloudOptions is exceeded, returns the amount of memory freed
 			//////////////////////////////////////////////////////////////////////////
 			std::uint64_t                           freeLRUCache();
 
 			//////////////////////////////////////////////////////////////////////////
-			//\ brief: Streams in new voxels from disk, will return the proportion of
-			//              voxels that are completely loaded.
+			//\ brief: Queues the voxels that need refinement on the streamer, highest
+			//              screen space error first, will return the proportion of
+			//              voxels that are completely loaded. Does not wait on disk, voxels
+			//              that are no longer visible are cancelled. A positive timeout
+			//              bounds the time spent finishing loaded voxels.
 			//////////////////////////////////////////////////////////////////////////
 			float                                   refineVoxels(std::vector<ScanContainerID>& visibleLeafNodes,
 				int timeOutInMS = -1,
 				const bool& interupted = false,
 				std::vector<bool>* updatedViewports = NULL);
 
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Set the maximum amount of voxel loads queued on or running in the loader threads
+			//////////////////////////////////////////////////////////////////////////
+			void                                    setMaxConcurrentLoads(unsigned count);
+			unsigned                                getMaxConcurrentLoads() const;
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Returns the streaming counters of the last frame
+			//////////////////////////////////////////////////////////////////////////
+			const AgStreamStats&                    getStreamingStats() const;
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Set how the voxel containers are culled. The occluder methods
+			//          rasterize nearby, densely loaded containers into an occlusion
+			//          buffer per viewport and drop the containers hidden behind them
+			//////////////////////////////////////////////////////////////////////////
+			void                                    setCullMethod(POINTCLOUD_CULL_METHOD method) { mCullMethod = method; }
+			POINTCLOUD_CULL_METHOD                  getCullMethod() const { return mCullMethod; }
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Maximum amount of points streamed in for all viewports, in millions
+			//////////////////////////////////////////////////////////////////////////
+			void                                    setMaxPointsLoad(std::uint32_t millions) { mMaxPointsLoad = millions; }
+			std::uint32_t                           getMaxPointsLoad() const { return mMaxPointsLoad; }
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Frame time in milliseconds the point budget adapts to, the budget
+			//          shrinks while frames are slower and grows back up to
+			//          'mMaxPointsLoad' when they are faster. Zero disables adaption
+			//////////////////////////////////////////////////////////////////////////
+			void                                    setTargetFrameTime(float milliseconds) { mTargetFrameTime = milliseconds; }
+			float                                   getTargetFrameTime() const { return mTargetFrameTime; }
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Returns the point budget of the last update and the amount of
+			//          points the visible containers were reduced to
+			//////////////////////////////////////////////////////////////////////////
+			std::uint64_t                           getPointBudget() const { return mPointBudget; }
+			std::uint32_t                           getBudgetPointCount() const { return mBudgetPointCount; }
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Returns the culling counters of the last visibility update
+			//////////////////////////////////////////////////////////////////////////
+			const AgCullStats&                      getCullingStats() const { return mCullStats; }
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Pick the nearest loaded point under each of 'screenPositions'
+			//          ( normalized viewport coordinates ) of 'camera', within
+			//          'pixelRadius' pixels of a view 'viewHeight' pixels high. All
+			//          rays are traced as one batch per container. 'resultsOut' gets
+			//          one entry per position, M_INFINITY distance for a miss
+			//////////////////////////////////////////////////////////////////////////
+			unsigned                                pickPoints(const Urho3D::Camera* camera, const std::vector<Urho3D::Vector2>& screenPositions,
+				float pixelRadius, int viewHeight, std::vector<AgPointPickResult>& resultsOut, float maxDistance = Urho3D::M_INFINITY) const;
+
+			//////////////////////////////////////////////////////////////////////////
+			//\ brief: Pick the nearest loaded point along each world space ray, the
+			//          tolerance around the rays is given in world units
+			//////////////////////////////////////////////////////////////////////////
+			unsigned                                pickPoints(const std::vector<Urho3D::Ray>& rays, const AgPointPickTolerance& tolerance,
+				std::vector<AgPointPickResult>& resultsOut, float maxDistance = Urho3D::M_INFINITY) const;
+
 			//////////////////////////////////////////////////////////////////////////
 			// \brief: Returns the allocated memory of this project file
 			//////////////////////////////////////////////////////////////////////////
@@ -199,25 +265,46 @@ namespace ambergris {
 			//////////////////////////////////////////////////////////////////////////
 			int			_DoPerformFrustumCulling(std::vector<PointCloudInformation> &visibleListOut) const;
 			//////////////////////////////////////////////////////////////////////////
-			// \brief: Returns the visible voxel containers from an individual scan
+			// \brief: Returns the visible voxel containers [begin, end) of an
+			//         individual scan, 'scanFrustums' are the view frustums in scan
+			//         space. May be called from a worker thread
 			//////////////////////////////////////////////////////////////////////////
-			void        _GetVisibleNodesFromScan(int scan, std::vector<ScanContainerID>& voxelContainerListOut);
+			void        _GetVisibleNodesFromScan(int scan, unsigned begin, unsigned end, const std::vector<Urho3D::Frustum>& scanFrustums,
+				std::vector<ScanContainerID>& voxelContainerListOut);
 			//////////////////////////////////////////////////////////////////////////
-			// \brief: Returns the visible voxel containers from the scan list
+			// \brief: Returns the visible voxel containers from the scan list, the
+			//         scans are split in ranges that are culled on the WorkQueue
 			//////////////////////////////////////////////////////////////////////////
 			int         _GetVisibleNodesFromScans(const std::vector<PointCloudInformation> &visibleScanList,
-				std::vector<ScanContainerID>& voxelContainerListOut);
+				std::vector<ScanContainerID>& voxelContainerListOut, bool frustumCull = true);
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Rasterize occluder proxies of the visible containers and remove
+			//         the containers that are occluded in every viewport, they are
+			//         neither streamed nor drawn. Returns the amount of containers left
+			//////////////////////////////////////////////////////////////////////////
+			int         _CullOccludedNodes(std::vector<ScanContainerID>& voxelContainerListOut);
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Lower the LODs of the visible containers of all viewports until
+			//         the points streamed in fit 'mPointBudget', adding the least
+			//         screen space error. Returns the new number of points that will
+			//         be streamed in
 			//////////////////////////////////////////////////////////////////////////
-			// \brief: Reduce the amount of points that are streamed in, until it
-			// falls below 'mMaxPointsLoad' returns the new number of
-			// points that will be streamed in
+			std::uint32_t _ReducePointCloudLoad(std::vector<ScanContainerID>& voxelContainerListOut);
 			//////////////////////////////////////////////////////////////////////////
-			int        _ReducePointCloudLoad(std::uint32_t amountOfPointsVisible, const Urho3D::Viewport* viewport, std::vector<ScanContainerID>& voxelContainerListOut);
+			// \brief: Adapt the point budget to the measured frame time
+			//////////////////////////////////////////////////////////////////////////
+			void        _UpdatePointBudget();
 
 			int			_GetViewIndex(const Urho3D::Viewport* viewport) const;
 			bool		_MustVisibleNodesBeFullyUpdated();
 			void		_SetPointRequestsForVisibleNodes();
 		private:
+			struct VisibleNodesChunk;
+			/// Amount of containers culled by one work item.
+			static const unsigned CULL_CONTAINERS_PER_ITEM = 1024;
+			/// WorkQueue function culling one VisibleNodesChunk.
+			static void _GetVisibleNodesWork(const Urho3D::WorkItem* item, unsigned threadIndex);
+
 			std::vector<unsigned>				m_scanList;
 			std::vector<ScanContainerID>		mVisibleNodes;
 
@@ -238,15 +325,25 @@ namespace ambergris {
 
 			//Maximum amount of points to be streamed in/ display at any given time, in millions
 			std::uint32_t                       mMaxPointsLoad;
-
-			std::uint64_t                       m_maxAllocatedMemory;       //default is 1024MB
-			std::uint64_t                       m_lruFreeMemory;            //default is 256MB
+			//Point budget of the current frame, at most mMaxPointsLoad, lowered when frames are slow
+			std::uint64_t                       mPointBudget;
+			std::uint32_t                       mBudgetPointCount;
+			float                               mTargetFrameTime;           //in milliseconds
+			float                               mAverageFrameTime;          //in milliseconds
+			/// Lowest point budget the frame time adaption goes down to.
+			static const std::uint32_t          MIN_POINT_BUDGET = 1000000;
 
 			RealityComputing::Common::RCTransform       mToGlobalFromWorld;
 
 			RealityComputing::Common::RCBox                   m_visibleProjectBounds;
 			RealityComputing::Common::RCBox                   m_projectBounds;
 
+			Urho3D::SharedPtr<AgVoxelStreamer>                mStreamer;
+
+			std::vector<Urho3D::SharedPtr<Urho3D::OcclusionBuffer> >   mOcclusionBuffers;     //one per viewport
+			std::vector<Urho3D::WeakPtr<AgVoxelContainer> >            mOccludedContainers;   //hidden by the last update
+			AgCullStats                                       mCullStats;
+
 		};
 	}
 }
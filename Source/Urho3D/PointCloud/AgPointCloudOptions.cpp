@@ -2,6 +2,7 @@
 
 #include "../Core/Context.h"
 #include "../Graphics/Graphics.h"
+#include "../Graphics/Technique.h"
 #include "../PointCloud/AgPointCloudNormalUtils.h"
 
 using namespace Urho3D;
@@ -13,6 +14,9 @@ void AgPointCloudOptions::RegisterObject(Context* context)
 
 	URHO3D_ACCESSOR_ATTRIBUTE("Point Size", getPointSize, setPointSize, float, 1.0f, AM_FILE);
 	URHO3D_ACCESSOR_ATTRIBUTE("Offset", getOffset, setOffset, Vector3, Vector3::ZERO, AM_FILE);
+	URHO3D_ACCESSOR_ATTRIBUTE("Max Cache Memory", getMaxCacheMemory, setMaxCacheMemory, unsigned, 1200, AM_FILE);
+	URHO3D_ACCESSOR_ATTRIBUTE("Cache Free Memory", getCacheFreeMemory, setCacheFreeMemory, unsigned, 400, AM_FILE);
+	URHO3D_ACCESSOR_ATTRIBUTE("Quantized Positions", getQuantizedPositions, setQuantizedPositions, bool, false, AM_FILE);
 }
 
 void AgPointCloudOptions::initNormalTexture()
@@ -38,6 +42,37 @@ Texture2D* AgPointCloudOptions::getNormalTable()
 	return normalTexture_;
 }
 
+Material* AgPointCloudOptions::getQuantizedMaterial(Material* material)
+{
+	if (!material)
+		return nullptr;
+
+	HashMap<Material*, QuantizedMaterial>::Iterator i = quantizedMaterials_.Find(material);
+	if (i != quantizedMaterials_.End() && i->second_.source_.Get() == material)
+		return i->second_.quantized_;
+
+	//drop the clones of released materials
+	for (i = quantizedMaterials_.Begin(); i != quantizedMaterials_.End();)
+	{
+		if (i->second_.source_.Expired())
+			i = quantizedMaterials_.Erase(i);
+		else
+			++i;
+	}
+
+	SharedPtr<Material> quantized = material->Clone(material->GetName() + "_Quantized");
+	for (unsigned j = 0; j < quantized->GetNumTechniques(); ++j)
+	{
+		const TechniqueEntry& entry = quantized->GetTechniqueEntry(j);
+		if (entry.technique_)
+			quantized->SetTechnique(j, entry.technique_->CloneWithDefines("QUANTIZED", String::EMPTY), entry.qualityLevel_, entry.lodDistance_);
+	}
+	QuantizedMaterial& entry = quantizedMaterials_[material];
+	entry.source_ = material;
+	entry.quantized_ = quantized;
+	return quantized;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //Class VoxelLeafNode
 //////////////////////////////////////////////////////////////////////////
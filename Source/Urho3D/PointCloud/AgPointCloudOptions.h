@@ -2,8 +2,10 @@
 
 #include "../Scene/Component.h"
 #include "../Graphics/Texture2D.h"
+#include "../Graphics/Material.h"
 
 #include "AgCompactColor.h"
+#include "AgVoxelCache.h"
 
 #ifndef ALIGNAS
 #ifndef _MSC_VER
@@ -138,6 +140,7 @@ namespace ambergris {
 			explicit AgPointCloudOptions(Urho3D::Context* context)
 				: Component(context)
 				, pointSize_(1.0f)
+				, quantizedPositions_(false)
 			{
 			}
 
@@ -153,10 +156,36 @@ namespace ambergris {
 			void initNormalTexture();
 			Urho3D::Texture2D* getNormalTable();
 
+			/// Set memory budget of the loaded voxels in megabytes, CPU and GPU memory combined.
+			void setMaxCacheMemory(unsigned megaBytes) { voxelCache_.setMaxMemory((std::uint64_t)megaBytes * 1024 * 1024); }
+			unsigned getMaxCacheMemory() const { return (unsigned)(voxelCache_.getMaxMemory() / (1024 * 1024)); }
+
+			/// Set memory in megabytes that is freed at once when the budget is exceeded.
+			void setCacheFreeMemory(unsigned megaBytes) { voxelCache_.setFreeMemory((std::uint64_t)megaBytes * 1024 * 1024); }
+			unsigned getCacheFreeMemory() const { return (unsigned)(voxelCache_.getFreeMemory() / (1024 * 1024)); }
+
+			AgVoxelCache& getVoxelCache() { return voxelCache_; }
+
+			/// Set whether lidar points are uploaded with 16 bit positions( AgQuantizedLidarPoint ), affects LODs loaded afterwards.
+			void setQuantizedPositions(bool enable) { quantizedPositions_ = enable; }
+			bool getQuantizedPositions() const { return quantizedPositions_; }
+
+			/// Return a copy of 'material' whose techniques dequantize AgQuantizedLidarPoint positions.
+			Urho3D::Material* getQuantizedMaterial(Urho3D::Material* material);
+
 		private:
 			float pointSize_;
 			Urho3D::Vector3 offset_;
 			Urho3D::SharedPtr<Urho3D::Texture2D> normalTexture_;
+			AgVoxelCache voxelCache_;
+			bool quantizedPositions_;
+			/// Clone of a material for quantized positions. The source is held weakly so a new material reusing its address is not matched.
+			struct QuantizedMaterial
+			{
+				Urho3D::WeakPtr<Urho3D::Material> source_;
+				Urho3D::SharedPtr<Urho3D::Material> quantized_;
+			};
+			Urho3D::HashMap<Urho3D::Material*, QuantizedMaterial> quantizedMaterials_;
 		};
 	}
 }
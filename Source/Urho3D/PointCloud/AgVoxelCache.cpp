@@ -0,0 +1,121 @@
+#include "AgVoxelCache.h"
+#include "AgVoxelContainer.h"
+
+#include "../Core/Profiler.h"
+
+using namespace ambergris::PointCloudEngine;
+
+AgVoxelCache::AgVoxelCache()
+	: m_hand(nullptr)
+	, m_count(0)
+	, m_allocatedMemory(0)
+	, m_maxMemory(1200ULL * 1024 * 1024)
+	, m_freeMemory(400ULL * 1024 * 1024)
+{
+}
+
+AgVoxelCache::~AgVoxelCache()
+{
+	while (m_hand)
+		_Unlink(m_hand);
+}
+
+void AgVoxelCache::insert(AgVoxelContainer* container, std::uint64_t bytes)
+{
+	if (!container)
+		return;
+
+	if (container->m_cache == this)
+	{
+		m_allocatedMemory = m_allocatedMemory - container->m_cachedMemory + bytes;
+		container->m_cachedMemory = bytes;
+		container->m_cacheReferenced = true;
+		return;
+	}
+	if (container->m_cache)
+		container->m_cache->remove(container);
+
+	//new entries go right behind the hand, so they are visited last
+	if (m_hand)
+	{
+		container->m_cacheNext = m_hand;
+		container->m_cachePrev = m_hand->m_cachePrev;
+		m_hand->m_cachePrev->m_cacheNext = container;
+		m_hand->m_cachePrev = container;
+	}
+	else
+	{
+		container->m_cacheNext = container;
+		container->m_cachePrev = container;
+		m_hand = container;
+	}
+
+	container->m_cache = this;
+	container->m_cachedMemory = bytes;
+	container->m_cacheReferenced = true;
+	m_allocatedMemory += bytes;
+	++m_count;
+}
+
+void AgVoxelCache::remove(AgVoxelContainer* container)
+{
+	if (!container || container->m_cache != this)
+		return;
+	_Unlink(container);
+}
+
+void AgVoxelCache::_Unlink(AgVoxelContainer* container)
+{
+	if (container->m_cacheNext == container)
+		m_hand = nullptr;
+	else
+	{
+		container->m_cachePrev->m_cacheNext = container->m_cacheNext;
+		container->m_cacheNext->m_cachePrev = container->m_cachePrev;
+		if (m_hand == container)
+			m_hand = container->m_cacheNext;
+	}
+
+	m_allocatedMemory -= container->m_cachedMemory;
+	--m_count;
+
+	container->m_cache = nullptr;
+	container->m_cacheNext = nullptr;
+	container->m_cachePrev = nullptr;
+	container->m_cachedMemory = 0;
+}
+
+std::uint64_t AgVoxelCache::evict(std::uint64_t bytesToFree)
+{
+	URHO3D_PROFILE(EvictVoxels);
+
+	std::uint64_t memCleared = 0ULL;
+	//every entry gets at most one second chance, so two turns of the hand always end
+	std::uint32_t steps = m_count * 2;
+	while (m_hand && memCleared < bytesToFree && steps--)
+	{
+		AgVoxelContainer* container = m_hand;
+		//a touch from a streaming thread between the test and the clear must not be lost
+		if (container->m_cacheReferenced.exchange(false))
+		{
+			m_hand = container->m_cacheNext;
+			continue;
+		}
+
+		memCleared += container->m_cachedMemory;
+		//clearGeometry unlinks the container and advances the hand
+		container->clearGeometry();
+		if (container->m_cache == this)
+			_Unlink(container);
+	}
+	return memCleared;
+}
+
+std::uint64_t AgVoxelCache::trim()
+{
+	if (m_allocatedMemory <= m_maxMemory)
+		return 0ULL;
+
+	const std::uint64_t overBudget = m_allocatedMemory - m_maxMemory;
+	return evict(overBudget + m_freeMemory);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		class AgVoxelContainer;
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgVoxelCache CLOCK replacement cache of the loaded voxel
+		//         containers. The containers are linked into a ring, touching
+		//         a container only sets its reference bit so it is safe from
+		//         the draw worker threads. Insertion, removal and accounting
+		//         happen on the main thread.
+		//////////////////////////////////////////////////////////////////////////
+		class AgVoxelCache
+		{
+		public:
+			AgVoxelCache();
+			~AgVoxelCache();
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Add a container to the ring or update its size if it is
+			//         already cached, 'bytes' is its CPU + GPU memory
+			//////////////////////////////////////////////////////////////////////////
+			void                                    insert(AgVoxelContainer* container, std::uint64_t bytes);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Remove a container from the ring, does not free its geometry
+			//////////////////////////////////////////////////////////////////////////
+			void                                    remove(AgVoxelContainer* container);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Free containers that were not touched since the clock hand
+			//         passed them, until 'bytesToFree' is reached. Returns the
+			//         amount of memory freed
+			//////////////////////////////////////////////////////////////////////////
+			std::uint64_t                           evict(std::uint64_t bytesToFree);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Free containers until the cache is below its budget, keeping
+			//         'freeMemory' bytes of headroom
+			//////////////////////////////////////////////////////////////////////////
+			std::uint64_t                           trim();
+
+			void                                    setMaxMemory(std::uint64_t bytes) { m_maxMemory = bytes; }
+			std::uint64_t                           getMaxMemory() const { return m_maxMemory; }
+			void                                    setFreeMemory(std::uint64_t bytes) { m_freeMemory = bytes; }
+			std::uint64_t                           getFreeMemory() const { return m_freeMemory; }
+
+			std::uint64_t                           getAllocatedMemory() const { return m_allocatedMemory; }
+			std::uint32_t                           getCount() const { return m_count; }
+
+		private:
+			AgVoxelCache(const AgVoxelCache&) = delete;
+			AgVoxelCache& operator =(const AgVoxelCache&) = delete;
+
+			void                                    _Unlink(AgVoxelContainer* container);
+
+			AgVoxelContainer*                       m_hand;                 //next candidate for eviction
+			std::uint32_t                           m_count;
+			std::uint64_t                           m_allocatedMemory;      //in bytes
+			std::uint64_t                           m_maxMemory;            //in bytes
+			std::uint64_t                           m_freeMemory;           //in bytes, freed at once when over budget
+		};
+	}
+}
@@ -2,7 +2,10 @@
 #include "AgVoxelLidarPoints.h"
 #include "AgVoxelTerrestialPoints.h"
 #include "AgPointCloudOptions.h"
+#include "AgVoxelCache.h"
+#include "AgVoxelTreeRunTime.h"
 
+#include "../IO/File.h"
 #include "../IO/Log.h"
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
@@ -11,6 +14,7 @@
 #include "../Graphics/Geometry.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OctreeQuery.h"
+#include "../Graphics/VertexBuffer.h"
 #include "../Resource/ResourceCache.h"
 #include "../Resource/ResourceEvents.h"
 
@@ -21,12 +25,21 @@ using namespace ambergris::PointCloudEngine;
 
 AgVoxelContainer::AgVoxelContainer(Context* context) :
 	Drawable(context, DRAWABLE_POINTCLOUD),
+	currentDrawLOD_(0),
+	maximumLOD_(0),
+	amountOfPoints_(0),
+	m_occluded(false),
 	m_clipFlag(NON_CLIPPED),
 	mExternalClipFlag(NON_CLIPPED),
 	mInternalClipFlag(NON_CLIPPED),
 	m_nClipIndex(0),
-	maximumLOD_(0),
-	currentDrawLOD_(0)
+	m_pickIndexLODs(0),
+	m_cache(nullptr),
+	m_cachePrev(nullptr),
+	m_cacheNext(nullptr),
+	m_cachedMemory(0),
+	m_tree(nullptr),
+	m_cacheReferenced(false)
 {
 	resourceName_.Clear();
 
@@ -34,7 +47,11 @@ AgVoxelContainer::AgVoxelContainer(Context* context) :
 	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(AgVoxelContainer, HandlePostRenderUpdate));
 }
 
-AgVoxelContainer::~AgVoxelContainer() = default;
+AgVoxelContainer::~AgVoxelContainer()
+{
+	if (m_cache)
+		m_cache->remove(this);
+}
 
 void AgVoxelContainer::RegisterObject(Context* context)
 {
@@ -66,27 +83,44 @@ void AgVoxelContainer::ProcessRayQuery(const RayOctreeQuery& query, PODVector<Ra
 		Ray localRay = query.ray_.Transformed(inverse);
 		float distance = localRay.HitDistance(boundingBox_);
 		Vector3 normal = -query.ray_.direction_;
-		Vector2 geometryUV;
-		unsigned hitBatch = M_MAX_UNSIGNED;
-
-		float pointSize = node_->GetVar(VoxelTreeRunTimeVars::VAR_POINTSIZE).GetFloat();
-		if (pointSize < 1.0f)
-			pointSize = 1.0f;
+		unsigned hitPoint = M_MAX_UNSIGNED;
 
 		if (level >= RAY_TRIANGLE && distance < query.maxDistance_)
 		{
+			std::shared_ptr<const AgVoxelPickIndex> pickIndex = GetPickIndex();
 			distance = M_INFINITY;
+			if (pickIndex)
+			{
+				// A ray passing between two points hits one of them within half the point spacing
+				const Vector3 worldScale = node_->GetWorldScale();
+				const AgPointPickTolerance tolerance(0.5f * pickIndex->getPointSpacing() * Max(worldScale.x_, Max(worldScale.y_, worldScale.z_)), 0.0f);
 
-			for (unsigned i = 0; i < batches_.Size(); ++i)
+				AgPointPickResult hit;
+				hit.m_distance = query.maxDistance_;
+				if (raycastPoints(&query.ray_, 1, tolerance, &hit))
+				{
+					distance = hit.m_distance;
+					hitPoint = hit.m_pointIndex;
+				}
+			}
+			else
 			{
-				Geometry* geometry = batches_[i].geometry_;
-				if (geometry)
+				// No index for terrestrial data, test the loaded points within the point size
+				float pointSize = node_->GetVar(VoxelTreeRunTimeVars::VAR_POINTSIZE).GetFloat();
+				if (pointSize < 1.0f)
+					pointSize = 1.0f;
+
+				for (unsigned i = 0; i < batches_.Size(); ++i)
 				{
-					float geometryDistance = geometry->GetPointHitDistance(localRay, pointSize);
-					if (geometryDistance < query.maxDistance_ && geometryDistance < distance)
+					Geometry* geometry = batches_[i].geometry_;
+					if (geometry)
 					{
-						distance = geometryDistance;
-						hitBatch = i;
+						float geometryDistance = geometry->GetPointHitDistance(localRay, pointSize);
+						if (geometryDistance < query.maxDistance_ && geometryDistance < distance)
+						{
+							distance = geometryDistance;
+							hitPoint = i;
+						}
 					}
 				}
 			}
@@ -96,16 +130,96 @@ void AgVoxelContainer::ProcessRayQuery(const RayOctreeQuery& query, PODVector<Ra
 		{
 			RayQueryResult result;
 			result.position_ = query.ray_.origin_ + distance * query.ray_.direction_;
+			result.normal_ = normal;
 			result.distance_ = distance;
 			result.drawable_ = this;
 			result.node_ = node_;
-			result.subObject_ = hitBatch;
+			result.subObject_ = hitPoint;
 			results.Push(result);
 		}
 		break;
 	}
 }
 
+unsigned AgVoxelContainer::raycastPoints(const Ray* rays, unsigned count, const AgPointPickTolerance& tolerance, AgPointPickResult* hits)
+{
+	if (!node_ || batches_.Empty() || !count)
+		return 0;
+
+	// Rays are traced in node space, the node scale is assumed to be uniform
+	const Matrix3x4& worldTransform = node_->GetWorldTransform();
+	const Matrix3x4 inverse(worldTransform.Inverse());
+	std::vector<Ray> localRays(count);
+	std::vector<float> localScales(count);
+	std::vector<unsigned> candidates;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Vector3 localDirection = inverse * Vector4(rays[i].direction_, 0.0f);
+		localScales[i] = localDirection.Length();
+		localRays[i] = Ray(inverse * rays[i].origin_, localDirection);
+
+		const AgPointPickTolerance localTolerance(tolerance.m_radius * localScales[i], tolerance.m_slope);
+		if (AgVoxelPickIndex::mayHit(boundingBox_, localRays[i], localTolerance, hits[i].m_distance * localScales[i]))
+			candidates.push_back(i);
+	}
+	// Rays that miss the container do not build the index
+	if (candidates.empty())
+		return 0;
+
+	std::shared_ptr<const AgVoxelPickIndex> pickIndex = GetPickIndex();
+	if (!pickIndex)
+		return 0;
+
+	unsigned numHits = 0;
+	for (unsigned i : candidates)
+	{
+		const AgPointPickTolerance localTolerance(tolerance.m_radius * localScales[i], tolerance.m_slope);
+		float localDistance;
+		std::uint32_t pointIndex;
+		Vector3 localPosition;
+		if (!pickIndex->raycast(localRays[i], localTolerance, hits[i].m_distance * localScales[i], localDistance, pointIndex, localPosition))
+			continue;
+
+		AgPointPickResult& hit = hits[i];
+		hit.m_position = worldTransform * localPosition;
+		hit.m_distance = localDistance / localScales[i];
+		hit.m_container = this;
+		hit.m_pointIndex = pointIndex;
+		++numHits;
+	}
+	return numHits;
+}
+
+std::shared_ptr<const AgVoxelPickIndex> AgVoxelContainer::GetPickIndex()
+{
+	MutexLock lock(m_pickIndexMutex);
+
+	const unsigned numLODs = getNumLoadedLODs();
+	if (m_pickIndex && m_pickIndexLODs == numLODs)
+		return m_pickIndex;
+
+	// The loaded points only live in the vertex buffers, read the positions back from the LOD files
+	// (terrestrial files carry no point payload)
+	if (!node_ || !node_->GetVar(VoxelTreeRunTimeVars::VAR_LIDARDATA).GetBool())
+		return nullptr;
+
+	auto* cache = GetSubsystem<ResourceCache>();
+	std::vector<Vector3> positions;
+	positions.reserve(amountOfPoints_);
+	for (unsigned i = 0; i < numLODs; ++i)
+	{
+		SharedPtr<File> file = cache->GetFile(resourceName_ + "_" + Urho3D::String(i) + ".vxl", false);
+		if (!file || !AgVoxelLidarPoints::readPositions(*file, positions))
+			return m_pickIndex;
+	}
+
+	std::shared_ptr<AgVoxelPickIndex> pickIndex = std::make_shared<AgVoxelPickIndex>();
+	pickIndex->build(positions);
+	m_pickIndex = pickIndex;
+	m_pickIndexLODs = numLODs;
+	return m_pickIndex;
+}
+
 uint8_t  AgVoxelContainer::CalcLOD(const FrameInfo& frame, float pointSize)
 {
 	const BoundingBox& worldBoundingBox = GetWorldBoundingBox();
@@ -197,6 +311,30 @@ void AgVoxelContainer::UpdateBatches(const FrameInfo& frame)
 		pointSize = 1.0f;
 	std::uint8_t currentLod = CalcLOD(frame, pointSize);
 	currentDrawLOD_ = std::max(currentLod, currentDrawLOD_);
+	//occluded containers draw nothing and are left to age out of the voxel cache
+	for (unsigned i = 0; i < batches_.Size(); ++i)
+		batches_[i].numWorldTransforms_ = m_occluded ? 0 : 1;
+	if (!m_occluded)
+		touch();
+	UpdateBatchTransforms();
+}
+
+void AgVoxelContainer::UpdateBatchTransforms()
+{
+	if (!node_)
+		return;
+
+	const Matrix3x4& worldTransform = node_->GetWorldTransform();
+	for (unsigned i = 0; i < batches_.Size(); ++i)
+	{
+		if (batchLocalTransforms_[i] == Matrix3x4::IDENTITY)
+			batches_[i].worldTransform_ = &worldTransform;
+		else
+		{
+			batchWorldTransforms_[i] = worldTransform * batchLocalTransforms_[i];
+			batches_[i].worldTransform_ = &batchWorldTransforms_[i];
+		}
+	}
 }
 
 void AgVoxelContainer::UpdateGeometry(const FrameInfo& frame)
@@ -237,26 +375,34 @@ void AgVoxelContainer::UpdateGeometry(const FrameInfo& frame)
 
 std::uint32_t	AgVoxelContainer::getLODPointCount(std::uint8_t lod) const
 {
-	//const bool isLidarData = node_->GetVar(VoxelTreeRunTimeVars::VAR_LIDARDATA).GetBool();
-	//auto* cache = GetSubsystem<ResourceCache>();
-	//String resourceName = resourceName_;
+	//LODs finer than the loaded ones draw the finest loaded LOD meanwhile
+	const unsigned loadedLODs = getNumLoadedLODs();
+	if (!loadedLODs)
+		return 0;
+	return GetAmountOfLODPoints((std::uint8_t)std::min(lod, (std::uint8_t)(loadedLODs - 1)));
+}
 
-	//if (lod <= m_currentLODLoaded)
-	//{
-	//	String fileName = resourceName + "_" + Urho3D::String(lod) + ".vxl";
-	//	AgVoxelPoints* res = isLidarData ? (AgVoxelPoints*)cache->GetExistingResource<AgVoxelLidarPoints>(fileName) :
-	//		cache->GetExistingResource<AgVoxelTerrestialPoints>(fileName);
-	//	return res ? res->getCount() : 0;
-	//}
-	//else if (m_currentLODLoaded > 0)   //needs refinement reset to zero
-	//{
-	//	String fileName = resourceName + "_" + Urho3D::String(m_currentLODLoaded) + ".vxl";
-	//	AgVoxelPoints* res = isLidarData ? (AgVoxelPoints*)cache->GetExistingResource<AgVoxelLidarPoints>(fileName) :
-	//		cache->GetExistingResource<AgVoxelTerrestialPoints>(fileName);
-	//	return res ? res->getCount() : 0;
-	//}
-	
-	return 0;
+std::uint32_t	AgVoxelContainer::GetAmountOfLODPoints(std::uint8_t lod) const
+{
+	std::uint32_t loadedPoints = 0;
+	const unsigned loadedLODs = getNumLoadedLODs();
+	for (unsigned i = 0; i < loadedLODs && i <= lod; ++i)
+	{
+		//the point geometries draw whole vertex buffers, their draw range is not set
+		const VertexBuffer* vertexBuffer = batches_[i].geometry_ ? batches_[i].geometry_->GetVertexBuffer(0) : nullptr;
+		if (vertexBuffer)
+			loadedPoints += vertexBuffer->GetVertexCount();
+	}
+	if (lod < loadedLODs)
+		return loadedPoints;
+
+	//every LOD doubles the grid resolution, so a surface gains about four times the points per LOD
+	const std::uint32_t totalPoints = amountOfPoints_;
+	if (lod + 1 >= maximumLOD_)
+		return std::max(loadedPoints, totalPoints);
+	const unsigned finerLODs = (unsigned)(maximumLOD_ - 1 - lod);
+	const std::uint32_t estimate = finerLODs < 16 ? totalPoints >> (2 * finerLODs) : 0;
+	return std::max(loadedPoints, estimate);
 }
 
 std::uint64_t	AgVoxelContainer::getAllocatedMemory() const
@@ -275,6 +421,9 @@ std::uint64_t	AgVoxelContainer::getAllocatedMemory() const
 		mem += res->getAllocatedMemory();
 	}
 
+	MutexLock lock(m_pickIndexMutex);
+	if (m_pickIndex)
+		mem += m_pickIndex->getAllocatedMemory();
 	return mem;
 }
 
@@ -292,11 +441,42 @@ std::uint64_t	AgVoxelContainer::clearGeometry()
 		if (!res)
 			continue;
 		mem += res->clear();
+		// Drop the resource as well, its vertex buffer is the bulk of the memory
+		if (isLidarData)
+			cache->ReleaseResource<AgVoxelLidarPoints>(fileName, /*force*/true);
+		else
+			cache->ReleaseResource<AgVoxelTerrestialPoints>(fileName, /*force*/true);
 	}
 	batches_.Clear();
+	batchLocalTransforms_.Clear();
+	batchWorldTransforms_.Clear();
+	{
+		MutexLock lock(m_pickIndexMutex);
+		if (m_pickIndex)
+			mem += m_pickIndex->getAllocatedMemory();
+		m_pickIndex.reset();
+		m_pickIndexLODs = 0;
+	}
+	if (m_cache)
+		m_cache->remove(this);
 	return mem;
 }
 
+void AgVoxelContainer::UpdateCacheEntry()
+{
+	if (batches_.Empty())
+	{
+		if (m_cache)
+			m_cache->remove(this);
+		return;
+	}
+
+	Scene* scene = GetScene();
+	AgPointCloudOptions* options = scene ? scene->GetComponent<AgPointCloudOptions>() : nullptr;
+	if (options)
+		options->getVoxelCache().insert(this, getAllocatedMemory());
+}
+
 bool AgVoxelContainer::isClipFlag(ClipFlag rhs) const
 {
 	return m_clipFlag == rhs;
@@ -331,6 +511,22 @@ void AgVoxelContainer::OnWorldBoundingBoxUpdate()
 	worldBoundingBox_ = boundingBox_.Transformed(node_->GetWorldTransform());
 }
 
+void AgVoxelContainer::OnNodeSet(Node* node)
+{
+	Drawable::OnNodeSet(node);
+
+	//the tree is still whole here, it removes its containers before destructing
+	MarkTreeDirty();
+	m_tree = dynamic_cast<AgVoxelTreeRunTime*>(node);
+	MarkTreeDirty();
+}
+
+void AgVoxelContainer::MarkTreeDirty()
+{
+	if (m_tree)
+		m_tree->markContainerArraysDirty();
+}
+
 void AgVoxelContainer::SetVoxelPoints(AgVoxelPoints* points)
 {
 	if (!points)
@@ -356,9 +552,16 @@ void AgVoxelContainer::SetVoxelPoints(AgVoxelPoints* points)
 	srcBatch.geometry_ = points->getGeometry();
 	srcBatch.worldTransform_ = node_ ? &node_->GetWorldTransform() : nullptr;
 
+	Scene* scene = GetScene();
+	AgPointCloudOptions* options = scene ? scene->GetComponent<AgPointCloudOptions>() : nullptr;
+
 	const ResourceRef& resRef = node_->GetVar(VoxelTreeRunTimeVars::VAR_MATERIAL).GetResourceRef();
 	auto* cache = GetSubsystem<ResourceCache>();
 	srcBatch.material_ = cache->GetResource<Material>(resRef.name_);
+	// Quantized points need the dequantizing shader variant
+	const Matrix3x4* localTransform = points->getLocalTransform();
+	if (localTransform && options)
+		srcBatch.material_ = options->getQuantizedMaterial(srcBatch.material_);
 	if (srcBatch.material_)
 	{
 		float pointSize = node_->GetVar(VoxelTreeRunTimeVars::VAR_POINTSIZE).GetFloat();
@@ -369,8 +572,6 @@ void AgVoxelContainer::SetVoxelPoints(AgVoxelPoints* points)
 		bool hasNormal = node_->GetVar(VoxelTreeRunTimeVars::VAR_HASNORMALS).GetBool();
 		if (hasNormal)
 		{
-			Scene* scene = GetScene();
-			AgPointCloudOptions* options = scene->GetComponent<AgPointCloudOptions>();
 			if (options)
 			{
 				Texture2D* normTable = options->getNormalTable();
@@ -387,12 +588,26 @@ void AgVoxelContainer::SetVoxelPoints(AgVoxelPoints* points)
 			const Vector3& scanBoundsMin = node_->GetVar(VoxelTreeRunTimeVars::VAR_SCANBOUNDSMIN).GetVector3();
 			if (scanBoundsMax.z_ > scanBoundsMin.z_)
 			{
-				srcBatch.material_->SetShaderParameter("HeightMax", scanBoundsMax.z_);
-				srcBatch.material_->SetShaderParameter("HeightMin", scanBoundsMin.z_);
+				if (localTransform)
+				{
+					//the quantized shader variant colors by world height
+					const BoundingBox worldBounds = BoundingBox(scanBoundsMin, scanBoundsMax).Transformed(node_->GetWorldTransform());
+					srcBatch.material_->SetShaderParameter("HeightMax", worldBounds.max_.z_);
+					srcBatch.material_->SetShaderParameter("HeightMin", worldBounds.min_.z_);
+				}
+				else
+				{
+					srcBatch.material_->SetShaderParameter("HeightMax", scanBoundsMax.z_);
+					srcBatch.material_->SetShaderParameter("HeightMin", scanBoundsMin.z_);
+				}
 			}
 		}
 	}
 	batches_.Push(srcBatch);
+	batchLocalTransforms_.Push(localTransform ? *localTransform : Matrix3x4::IDENTITY);
+	batchWorldTransforms_.Push(Matrix3x4::IDENTITY);
+	UpdateBatchTransforms();
+	UpdateCacheEntry();
 
 	//if (geometry)
 	//{
@@ -630,6 +845,8 @@ void AgVoxelContainer::HandleUpdate(StringHash eventType, VariantMap& eventData)
 		for (unsigned i = currentDrawLOD_; i < oldLod; i++)
 		{
 			batches_.Pop();
+			batchLocalTransforms_.Pop();
+			batchWorldTransforms_.Pop();
 			String fileName = resourceName_ + "_" + Urho3D::String(i) + ".vxl";
 			auto* cache = GetSubsystem<ResourceCache>();
 			if (isLidarData)
@@ -637,6 +854,8 @@ void AgVoxelContainer::HandleUpdate(StringHash eventType, VariantMap& eventData)
 			else
 				cache->ReleaseResource<AgVoxelTerrestialPoints>(fileName, /*force*/true);
 		}
+		if (oldLod > (int)batches_.Size())
+			UpdateCacheEntry();
 	}
 	//reset
 	currentDrawLOD_ = 0;
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "../Core/Mutex.h"
 #include "../Graphics/Drawable.h"
 #include "../Math/BoundingBox.h"
+#include "AgVoxelPickIndex.h"
 
+#include <atomic>
 #include <vector>
 #include <memory>
 
@@ -10,6 +13,8 @@ namespace ambergris {
 	namespace PointCloudEngine {
 
 		class AgVoxelPoints;
+		class AgVoxelCache;
+		class AgVoxelTreeRunTime;
 
 		enum ClipFlag
 		{
@@ -24,6 +29,7 @@ namespace ambergris {
 		class AgVoxelContainer : public Urho3D::Drawable
 		{
 			URHO3D_OBJECT(AgVoxelContainer, Urho3D::Drawable);
+			friend class AgVoxelCache;
 		public:
 			/// Construct.
 			explicit AgVoxelContainer(Urho3D::Context* context);
@@ -35,6 +41,16 @@ namespace ambergris {
 			/// Process octree raycast. May be called from a worker thread.
 			void ProcessRayQuery(const Urho3D::RayOctreeQuery& query, Urho3D::PODVector<Urho3D::RayQueryResult>& results) override;
 
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Trace world space rays against the loaded points. 'hits' has
+			//         one entry per ray, its distance limits the ray and it keeps the
+			//         nearest hit, so a batch of rays can be traced through several
+			//         containers. Builds the pick index on first use. May be called
+			//         from a worker thread. Returns the amount of rays that hit
+			//////////////////////////////////////////////////////////////////////////
+			unsigned                                raycastPoints(const Urho3D::Ray* rays, unsigned count, const AgPointPickTolerance& tolerance,
+				AgPointPickResult* hits);
+
 			/// Calculate distance and prepare batches for rendering. May be called from worker thread(s), possibly re-entrantly.
 			void UpdateBatches(const Urho3D::FrameInfo& frame) override;
 
@@ -44,18 +60,33 @@ namespace ambergris {
 			/// Return whether a geometry update is necessary, and if it can happen in a worker thread.
 			Urho3D::UpdateGeometryType GetUpdateGeometryType() override { return Urho3D::UPDATE_WORKER_THREAD; }
 
+			/// Return the amount of loaded points drawn at 'lod', 0 when no LOD is loaded.
 			std::uint32_t							getLODPointCount(std::uint8_t lod) const;
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Amount of points drawn at 'lod', that is LOD files 0 .. lod.
+			//         Loaded LODs count their vertices, finer LODs are estimated
+			//         from the total, the last LOD holds all points
+			//////////////////////////////////////////////////////////////////////////
+			std::uint32_t							GetAmountOfLODPoints(std::uint8_t lod) const;
 
 			bool									isGeometryEmpty() const {	return batches_.Empty();	}
 			std::uint64_t							clearGeometry();
 			std::uint64_t							getAllocatedMemory() const;
+			/// Mark as recently used for the voxel cache. May be called from worker threads.
+			void									touch() { m_cacheReferenced = true; }
 
 			//////////////////////////////////////////////////////////////////////////
 			// \brief: load a LIDAR LOD from disk this is a
 			//////////////////////////////////////////////////////////////////////////
 			void                                    loadLODInternal(bool isLidarData, std::uint8_t lodLevel);
 
+			/// Set whether the point cloud engine found this container occluded, occluded containers are not drawn.
+			void                                    setOccluded(bool occluded) { m_occluded = occluded; }
+			bool                                    isOccluded() const { return m_occluded; }
+
 			bool                                    isComplete(unsigned LOD) const;
+			/// Return number of LOD files currently attached as batches.
+			unsigned                                getNumLoadedLODs() const { return batches_.Size(); }
 
 			// \brief:  clip status function
 			bool                                    isClipFlag(ClipFlag rhs) const;
@@ -74,23 +105,23 @@ namespace ambergris {
 			/// Return layout spacing.
 			char GetMaxLOD() const { return maximumLOD_; }
 			/// Set layout spacing.
-			void SetMaxLOD(char num) { maximumLOD_ = num; }
+			void SetMaxLOD(char num) { maximumLOD_ = num; MarkTreeDirty(); }
 
 			/// Return layout spacing.
 			int GetAmountOfPoints() const { return amountOfPoints_; }
 			/// Set layout spacing.
-			void SetAmountOfPoints(int num) { amountOfPoints_ = num; }
+			void SetAmountOfPoints(int num) { amountOfPoints_ = num; MarkTreeDirty(); }
 
 			/// Set TransformBounds Min.
 			void SetSVOBoundsMin(const Urho3D::Vector3& value) {
-				boundingBox_.min_ = value; OnMarkedDirty(node_);
+				boundingBox_.min_ = value; OnMarkedDirty(node_); MarkTreeDirty();
 			}
 			/// Return position.
 			const Urho3D::Vector3& GetSVOBoundsMin() const { return boundingBox_.min_; }
 
 			/// Set TransformBounds Min.
 			void SetSVOBoundsMax(const Urho3D::Vector3& value) {
-				boundingBox_.max_ = value; OnMarkedDirty(node_);
+				boundingBox_.max_ = value; OnMarkedDirty(node_); MarkTreeDirty();
 			}
 			/// Return position.
 			const Urho3D::Vector3& GetSVOBoundsMax() const { return boundingBox_.max_; }
@@ -101,14 +132,29 @@ namespace ambergris {
 			void HandleResourceBackgroundLoaded(Urho3D::StringHash eventType, Urho3D::VariantMap& eventData);
 			/// Recalculate the world-space bounding box.
 			void OnWorldBoundingBoxUpdate() override;
+			/// Handle being assigned to a node, the voxel trees losing and gaining the container rebuild their container arrays.
+			void OnNodeSet(Urho3D::Node* node) override;
+			/// Make the voxel tree holding this container rebuild its container arrays.
+			void MarkTreeDirty();
 
 			void HandleUpdate(Urho3D::StringHash eventType, Urho3D::VariantMap& eventData);
 			void HandlePostRenderUpdate(Urho3D::StringHash eventType, Urho3D::VariantMap& eventData);
+			/// Update the size of this container in the voxel cache, or leave the cache when nothing is loaded.
+			void UpdateCacheEntry();
+			/// Point the batches at the node transform, combined with the dequantization of quantized LODs.
+			void UpdateBatchTransforms();
+			/// Return the pick index of the loaded LODs, rebuilt from the LOD files when more LODs were loaded since.
+			std::shared_ptr<const AgVoxelPickIndex> GetPickIndex();
 		private:
 			Urho3D::String								resourceName_;
+			/// Per batch transform from vertex positions to node space, identity for float positions.
+			Urho3D::PODVector<Urho3D::Matrix3x4>		batchLocalTransforms_;
+			/// Per batch world transform of quantized LODs.
+			Urho3D::PODVector<Urho3D::Matrix3x4>		batchWorldTransforms_;
 			std::uint8_t                                currentDrawLOD_;
 			std::uint8_t                                maximumLOD_;                   //maximum LOD stored in file
 			std::uint32_t                               amountOfPoints_;               //total amount of points
+			bool                                        m_occluded;                    //set by the engine occlusion culling
 												//TODO: we shall check if we are allowed to change the stack sequence of class members
 												//      and stack public/private member together.
 		
@@ -118,6 +164,20 @@ namespace ambergris {
 			ClipFlag                                mInternalClipFlag;
 			// \brief: the index which indicates the point number of valid clip flag
 			int                                     m_nClipIndex;
+
+			// \brief: ray picking acceleration of the loaded LODs, built lazily
+			std::shared_ptr<const AgVoxelPickIndex> m_pickIndex;
+			unsigned                                m_pickIndexLODs;
+			mutable Urho3D::Mutex                   m_pickIndexMutex;
+
+			// \brief: voxel cache ring links, owned by AgVoxelCache
+			AgVoxelCache*                           m_cache;
+			AgVoxelContainer*                       m_cachePrev;
+			AgVoxelContainer*                       m_cacheNext;
+			std::uint64_t                           m_cachedMemory;
+			// \brief: voxel tree the container belongs to, cleared when it is removed
+			AgVoxelTreeRunTime*                     m_tree;
+			std::atomic<bool>                       m_cacheReferenced;
 		};
 	}
 }
@@ -1,4 +1,5 @@
 #include "AgVoxelLidarPoints.h"
+#include "AgLidarPointDecoder.h"
 #include "AgPointCloudOptions.h"
 
 #include "../Core/Context.h"
@@ -6,14 +7,42 @@
 #include "../IO/File.h"
 #include "../Graphics/VertexBuffer.h"
 #include "../Graphics/Geometry.h"
+#include "../Graphics/GraphicsEvents.h"
+#include "../Core/Profiler.h"
+#include "../Resource/ResourceCache.h"
 
-#include <algorithm>
 
 using namespace Urho3D;
 using namespace ambergris::PointCloudEngine;
 
+static_assert(sizeof(AgLidarPoint) == 20, "sizeof(AgLidarPoint) is incorrect");
+static_assert(sizeof(AgQuantizedLidarPoint) == 16, "sizeof(AgQuantizedLidarPoint) is incorrect");
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Vertex layout of AgLidarPoint or AgQuantizedLidarPoint
+//////////////////////////////////////////////////////////////////////////
+static PODVector<VertexElement> getVertexElements(bool quantized)
+{
+	PODVector<VertexElement> elements;
+	if (quantized)
+	{
+		elements.Push(VertexElement(TYPE_UBYTE4, SEM_POSITION));
+		elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
+		elements.Push(VertexElement(TYPE_UBYTE4, SEM_BLENDINDICES));
+		elements.Push(VertexElement(TYPE_INT, SEM_OBJECTINDEX));
+	}
+	else
+	{
+		elements.Push(VertexElement(TYPE_VECTOR3, SEM_POSITION));
+		elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
+		elements.Push(VertexElement(TYPE_INT, SEM_OBJECTINDEX));
+	}
+	return elements;
+}
+
 AgVoxelLidarPoints::AgVoxelLidarPoints(Context* context) :
-	AgVoxelPoints(context)
+	AgVoxelPoints(context),
+	m_quantized(false)
 {
 }
 
@@ -34,29 +63,40 @@ bool AgVoxelLidarPoints::BeginLoad(Deserializer& source)
 	}
 
 	// Read offset
-	Vector3 offset = source.ReadVector3();
+	m_offset = source.ReadVector3();
 
 	const unsigned   amountOfPoints = source.ReadUInt();
+	const unsigned payloadSize = amountOfPoints * sizeof(AgVoxelLeafNode);
 
-	// Read voxel buffers
-	m_lidarPointList.resize(amountOfPoints);
-
-	for (unsigned i = 0; i < amountOfPoints; ++i)
+	// Loose files are mapped and decoded from the mapped pages, others are read at once( 2 ulongs per point ).
+	// Either way the decode runs here on the loader thread, EndLoad only uploads
+	std::vector<std::uint64_t> rawData;
+	const std::uint8_t* payload = amountOfPoints ? mapPayload(source, payloadSize) : nullptr;
+	if (!payload)
 	{
-		std::uint64_t data1 = source.ReadUInt64();
-		std::uint64_t data2 = source.ReadUInt64();
-		AgVoxelLeafNode rawPoint(data1, data2);
-		m_lidarPointList[i].setRawCoord(rawPoint.getRawOffsetFromBoundingBox() * 0.001f + Vector3(offset.x_, offset.y_, offset.z_));
-		m_lidarPointList[i].setRGBA(rawPoint.getRGBA());
-		m_lidarPointList[i].setNormalIndex(rawPoint.getNormal());
-		m_lidarPointList[i].setLidarClassification(rawPoint.getLidarClassification());
-
-		if (rawPoint.getDeleteFlag()) {
-			m_lidarPointList[i].setFiltered(true);
-			//hasDeletedPts = true;
+		rawData.resize(amountOfPoints * 2);
+		if (amountOfPoints && source.Read(rawData.data(), payloadSize) != payloadSize)
+		{
+			URHO3D_LOGERROR(source.GetName() + " is truncated");
+			return false;
 		}
+		payload = reinterpret_cast<const std::uint8_t*>(rawData.data());
 	}
 
+	if (m_quantized)
+	{
+		m_quantizedPointList.resize(amountOfPoints);
+		URHO3D_PROFILE(DecodeLidarPoints);
+		m_dequantize = AgLidarPointDecoder::decodeQuantized(payload, amountOfPoints, m_offset, m_quantizedPointList.data());
+	}
+	else
+	{
+		m_lidarPointList.resize(amountOfPoints);
+		URHO3D_PROFILE(DecodeLidarPoints);
+		AgLidarPointDecoder::decode(payload, amountOfPoints, m_offset, m_lidarPointList.data());
+	}
+	m_mappedFile.reset();
+
 	/*m_timeStampList.resize(amountOfPoints);
 	for (unsigned i = 0; i < amountOfPoints; ++i)
 	{
@@ -66,23 +106,54 @@ bool AgVoxelLidarPoints::BeginLoad(Deserializer& source)
 	return true;
 }
 
+const std::uint8_t* AgVoxelLidarPoints::mapPayload(Deserializer& source, unsigned payloadSize)
+{
+	File* file = dynamic_cast<File*>(&source);
+	if (!file || file->IsPackaged())
+		return nullptr;
+
+	String fileName = GetSubsystem<ResourceCache>()->GetResourceFileName(GetName());
+	if (fileName.Empty())
+		return nullptr;
+
+	std::unique_ptr<AgMemoryMapFile> mappedFile(new AgMemoryMapFile());
+	if (!mappedFile->open(fileName))
+		return nullptr;
+
+	const unsigned payloadStart = source.GetPosition();
+	//truncated files are reported by the regular read path
+	if (mappedFile->getSize() < (std::uint64_t)payloadStart + payloadSize)
+		return nullptr;
+
+	m_mappedFile = std::move(mappedFile);
+	return m_mappedFile->getData() + payloadStart;
+}
+
 bool AgVoxelLidarPoints::EndLoad()
 {
-	if (m_lidarPointList.empty())
+	if (m_lidarPointList.empty() && m_quantizedPointList.empty())
 		return true;
 
-	PODVector<VertexElement> elements;
-	elements.Push(VertexElement(TYPE_VECTOR3, SEM_POSITION));
-	elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
-	elements.Push(VertexElement(TYPE_INT, SEM_OBJECTINDEX));
+	const PODVector<VertexElement> elements = getVertexElements(m_quantized);
 
-	// Upload vertex buffer data
+	// Upload vertex buffer data. There is no CPU side copy, lost data is decoded from the file again on device reset
 	if(!vertexBuffers_)
+	{
 		vertexBuffers_ = new VertexBuffer(context_);
-	vertexBuffers_->SetShadowed(true);
-	vertexBuffers_->SetSize(m_lidarPointList.size(), elements);
-	vertexBuffers_->SetData(m_lidarPointList.data());
-	
+		SubscribeToEvent(E_DEVICERESET, URHO3D_HANDLER(AgVoxelLidarPoints, HandleDeviceReset));
+	}
+	vertexBuffers_->SetShadowed(false);
+	if (m_quantized)
+	{
+		vertexBuffers_->SetSize(m_quantizedPointList.size(), elements);
+		vertexBuffers_->SetData(m_quantizedPointList.data());
+	}
+	else
+	{
+		vertexBuffers_->SetSize(m_lidarPointList.size(), elements);
+		vertexBuffers_->SetData(m_lidarPointList.data());
+	}
+
 	if(!geometry_)
 		geometry_ = new Geometry(context_);
 	geometry_->SetPrimitiveType(POINT_LIST);
@@ -90,36 +161,102 @@ bool AgVoxelLidarPoints::EndLoad()
 
 	m_lidarPointList.clear();
 	std::vector<AgLidarPoint>().swap(m_lidarPointList);
+	std::vector<AgQuantizedLidarPoint>().swap(m_quantizedPointList);
 	m_timeStampList.clear();
 	std::vector<double>().swap(m_timeStampList);
 
+	SetMemoryUse((unsigned)getAllocatedMemory());
+	return true;
+}
+
+void AgVoxelLidarPoints::HandleDeviceReset(StringHash eventType, VariantMap& eventData)
+{
+	if (!vertexBuffers_ || !vertexBuffers_->IsDataLost())
+		return;
+
+	SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(GetName(), false);
+	if (!file || !BeginLoad(*file) || !EndLoad())
+	{
+		URHO3D_LOGERROR("Failed to restore " + GetName() + " after device loss");
+		return;
+	}
+	vertexBuffers_->ClearDataLost();
+}
+
+bool AgVoxelLidarPoints::readPositions(Deserializer& source, std::vector<Vector3>& positionsOut)
+{
+	if (source.ReadFileID() != "PCVL")
+	{
+		URHO3D_LOGERROR(source.GetName() + " is not a valid point cloud file");
+		return false;
+	}
+
+	const Vector3 offset = source.ReadVector3();
+	const unsigned amountOfPoints = source.ReadUInt();
+
+	//only the first ulong of each leaf node holds the position
+	std::vector<std::uint64_t> rawData(amountOfPoints * 2);
+	const unsigned payloadSize = amountOfPoints * sizeof(AgVoxelLeafNode);
+	if (amountOfPoints && source.Read(rawData.data(), payloadSize) != payloadSize)
+	{
+		URHO3D_LOGERROR(source.GetName() + " is truncated");
+		return false;
+	}
+
+	const size_t first = positionsOut.size();
+	positionsOut.resize(first + amountOfPoints);
+	for (unsigned i = 0; i < amountOfPoints; ++i)
+	{
+		const std::uint64_t data1 = rawData[i * 2];
+		positionsOut[first + i] = Vector3(float(std::uint32_t(data1 & 0x3FFFFULL)) * 0.001f + offset.x_,
+			float(std::uint32_t((data1 >> 18) & 0x3FFFFULL)) * 0.001f + offset.y_,
+			float(std::uint32_t((data1 >> 36) & 0x3FFFFULL)) * 0.001f + offset.z_);
+	}
 	return true;
 }
 
 bool AgVoxelLidarPoints::isEmpty() const
 {
-	return m_lidarPointList.empty();
+	return m_lidarPointList.empty() && m_quantizedPointList.empty();
 }
 
 std::uint64_t	AgVoxelLidarPoints::clear()
 {
 	std::uint64_t memCleared = 0ULL;
+	m_mappedFile.reset();
 	if (m_lidarPointList.size())
 	{
 		memCleared += sizeof(AgLidarPoint) * m_lidarPointList.size();
 		m_lidarPointList.clear();
 		std::vector<AgLidarPoint>().swap(m_lidarPointList);
 	}
+	if (m_quantizedPointList.size())
+	{
+		memCleared += sizeof(AgQuantizedLidarPoint) * m_quantizedPointList.size();
+		std::vector<AgQuantizedLidarPoint>().swap(m_quantizedPointList);
+	}
 	if (m_timeStampList.size())
 	{
-		memCleared += sizeof(double) * m_lidarPointList.size();
+		memCleared += sizeof(double) * m_timeStampList.size();
 		m_timeStampList.clear();
 		std::vector<double>().swap(m_timeStampList);
 	}
+	if (vertexBuffers_)
+	{
+		memCleared += (std::uint64_t)vertexBuffers_->GetVertexCount() * vertexBuffers_->GetVertexSize();
+		vertexBuffers_.Reset();
+		geometry_.Reset();
+	}
+	SetMemoryUse(0);
 	return memCleared;
 }
 
 std::uint64_t	AgVoxelLidarPoints::getAllocatedMemory() const
 {
-	return (sizeof(AgLidarPoint) * m_lidarPointList.size() + sizeof(double) * m_timeStampList.size());
+	std::uint64_t mem = sizeof(AgLidarPoint) * m_lidarPointList.size() + sizeof(AgQuantizedLidarPoint) * m_quantizedPointList.size()
+		+ sizeof(double) * m_timeStampList.size();
+	// after EndLoad the points only live in the vertex buffer, counted the same way clear() releases it
+	if (vertexBuffers_)
+		mem += (std::uint64_t)vertexBuffers_->GetVertexCount() * vertexBuffers_->GetVertexSize();
+	return mem;
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 #include "AgVoxelPoints.h"
 #include "AgLidarPoint.h"
+#include "AgMemoryMapFile.h"
+
+#include "../Math/Matrix3x4.h"
 
 #include <vector>
+#include <memory>
 
 namespace Urho3D
 {
@@ -39,11 +43,46 @@ namespace ambergris {
 			/// Return geometry by index and LOD level. The LOD level is clamped if out of range.
 			Urho3D::Geometry* getGeometry() const override { return geometry_; }
 
+			/// Return the dequantization transform of quantized points.
+			const Urho3D::Matrix3x4* getLocalTransform() const override { return m_quantized ? &m_dequantize : nullptr; }
+
+			/// Set whether positions are stored as 16 bit values( AgQuantizedLidarPoint ). Must be set before loading.
+			void setQuantized(bool enable) { m_quantized = enable; }
+			bool isQuantized() const { return m_quantized; }
+
 			bool hasTimestamp() const { return !m_timeStampList.empty(); }
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Append the node space positions of a PCVL file to
+			//         'positionsOut', in vertex order. Used to rebuild CPU side data
+			//         after the vertex data went to the GPU. May be called from a
+			//         worker thread
+			//////////////////////////////////////////////////////////////////////////
+			static bool readPositions(Urho3D::Deserializer& source, std::vector<Urho3D::Vector3>& positionsOut);
 		private:
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Memory map the file behind 'source', so BeginLoad can decode
+			//         the payload without reading it first. Returns the payload, or
+			//         null when the file is not a loose file on disk( e.g. packaged )
+			//////////////////////////////////////////////////////////////////////////
+			const std::uint8_t*                mapPayload(Urho3D::Deserializer& source, unsigned payloadSize);
+			/// Decode the file again when the vertex buffer lost its data.
+			void                               HandleDeviceReset(Urho3D::StringHash eventType, Urho3D::VariantMap& eventData);
+
 			std::vector<AgLidarPoint>          m_lidarPointList;
+			std::vector<AgQuantizedLidarPoint> m_quantizedPointList;
 			std::vector<double>                m_timeStampList;
 
+			/// Store positions quantized to 16 bits.
+			bool                               m_quantized;
+			/// Quantized position to node space.
+			Urho3D::Matrix3x4                  m_dequantize;
+
+			/// Mapped scan file, only alive during BeginLoad.
+			std::unique_ptr<AgMemoryMapFile>   m_mappedFile;
+			/// Offset of the voxel container.
+			Urho3D::Vector3                    m_offset;
+
 			/// Vertex buffers.
 			Urho3D::SharedPtr<Urho3D::VertexBuffer> vertexBuffers_;
 			/// Geometries.
@@ -0,0 +1,87 @@
+#include "AgVoxelOcclusion.h"
+#include "AgVoxelContainer.h"
+
+#include "../Graphics/OcclusionBuffer.h"
+#include "../Scene/Node.h"
+
+#include <algorithm>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+static const Vector3 occluderBoxVertices[8] =
+{
+	Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, -1.0f), Vector3(-1.0f, 1.0f, -1.0f),
+	Vector3(-1.0f, -1.0f, 1.0f), Vector3(1.0f, -1.0f, 1.0f), Vector3(1.0f, 1.0f, 1.0f), Vector3(-1.0f, 1.0f, 1.0f)
+};
+
+static const unsigned short occluderBoxIndices[36] =
+{
+	0, 1, 2, 0, 2, 3,
+	4, 6, 5, 4, 7, 6,
+	0, 4, 5, 0, 5, 1,
+	3, 2, 6, 3, 6, 7,
+	0, 3, 7, 0, 7, 4,
+	1, 5, 6, 1, 6, 2
+};
+
+// Occluder proxies are shrunk to the core of the container, points are not a closed surface
+static const float OCCLUDER_PROXY_SCALE = 0.5f;
+// Fraction of the projected container area the loaded splats must cover to act as an occluder
+static const float OCCLUDER_MIN_COVERAGE = 1.0f;
+
+void AgVoxelOcclusion::makeTestItem(AgVoxelContainer& container, float screenSize, AgOcclusionTestItem& itemOut)
+{
+	const Vector3 center = (container.GetSVOBoundsMin() + container.GetSVOBoundsMax()) * 0.5f;
+	const Vector3 halfSize = (container.GetSVOBoundsMax() - container.GetSVOBoundsMin()) * (0.5f * OCCLUDER_PROXY_SCALE);
+	const unsigned loadedLODs = container.getNumLoadedLODs();
+
+	itemOut.m_worldBounds = container.GetWorldBoundingBox();
+	itemOut.m_proxyTransform = container.GetNode()->GetWorldTransform() * Matrix3x4(center, Quaternion::IDENTITY, halfSize);
+	itemOut.m_screenSize = screenSize;
+	itemOut.m_loadedPoints = loadedLODs ? container.GetAmountOfLODPoints((std::uint8_t)(loadedLODs - 1)) : 0;
+}
+
+unsigned AgVoxelOcclusion::cull(OcclusionBuffer* buffer, const Vector3& cameraPos, const std::vector<AgOcclusionTestItem>& items,
+	float minOccluderSize, float pointSize, std::uint8_t* visibleOut)
+{
+	// Occluder candidates are containers that are large on screen and whose loaded
+	// splats already cover their footprint, nearest first
+	std::vector<std::pair<float, size_t> > occluders;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const AgOcclusionTestItem& item = items[i];
+		if (!item.m_worldBounds.Defined() || item.m_screenSize < minOccluderSize)
+			continue;
+		const float coverage = (float)item.m_loadedPoints * pointSize * pointSize;
+		if (coverage < item.m_screenSize * item.m_screenSize * OCCLUDER_MIN_COVERAGE)
+			continue;
+
+		occluders.push_back(std::make_pair(item.m_worldBounds.DistanceToPoint(cameraPos), i));
+	}
+	std::sort(occluders.begin(), occluders.end());
+
+	// Draw one by one like View::DrawOccluders, skipping occluders hidden by nearer ones
+	unsigned numDrawn = 0;
+	for (size_t k = 0; k < occluders.size(); ++k)
+	{
+		const AgOcclusionTestItem& item = items[occluders[k].second];
+		if (k > 0 && !buffer->IsVisible(item.m_worldBounds))
+			continue;
+
+		++numDrawn;
+		const bool success = buffer->AddTriangles(item.m_proxyTransform, occluderBoxVertices, sizeof(Vector3), occluderBoxIndices,
+			sizeof(unsigned short), 0, 36);
+		buffer->DrawTriangles();
+		if (!success)
+			break;
+	}
+	buffer->BuildDepthHierarchy();
+
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		if (!visibleOut[i] && (!items[i].m_worldBounds.Defined() || buffer->IsVisible(items[i].m_worldBounds)))
+			visibleOut[i] = 1;
+	}
+	return numDrawn;
+}
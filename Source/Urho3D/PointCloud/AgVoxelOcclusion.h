@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../Math/BoundingBox.h"
+#include "../Math/Matrix3x4.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace Urho3D
+{
+	class OcclusionBuffer;
+}
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		class AgVoxelContainer;
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgOcclusionTestItem voxel container as seen by one view
+		//////////////////////////////////////////////////////////////////////////
+		struct AgOcclusionTestItem
+		{
+			Urho3D::BoundingBox m_worldBounds;      //tested against the depth hierarchy, undefined is always visible
+			Urho3D::Matrix3x4 m_proxyTransform;     //unit box to world space, drawn when the container is an occluder
+			float m_screenSize;                     //projected size in pixels
+			std::uint32_t m_loadedPoints;           //points of the loaded LODs
+			AgOcclusionTestItem() : m_screenSize(0.0f), m_loadedPoints(0) {}
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// \brief: Software occlusion of voxel containers for one view. Containers
+		//         that are large on screen and whose loaded splats cover their
+		//         footprint are drawn as box proxies, nearest first, then every
+		//         container is tested against the depth hierarchy
+		//////////////////////////////////////////////////////////////////////////
+		class URHO3D_API AgVoxelOcclusion
+		{
+		public:
+			//fill the test item of 'container' for a view where it is 'screenSize' pixels large
+			static void                             makeTestItem(AgVoxelContainer& container, float screenSize, AgOcclusionTestItem& itemOut);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Draw the occluders among 'items' into 'buffer', which must be
+			//         cleared and set to the view, and set 'visibleOut[i]' for every
+			//         item the occluders do not hide. Returns the amount of
+			//         occluders drawn
+			//////////////////////////////////////////////////////////////////////////
+			static unsigned                         cull(Urho3D::OcclusionBuffer* buffer, const Urho3D::Vector3& cameraPos,
+				const std::vector<AgOcclusionTestItem>& items, float minOccluderSize, float pointSize, std::uint8_t* visibleOut);
+		};
+	}
+}
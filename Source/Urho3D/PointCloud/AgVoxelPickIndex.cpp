@@ -0,0 +1,261 @@
+#include "AgVoxelPickIndex.h"
+
+#include "../Core/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+static const std::uint32_t PICK_LEAF_SIZE = 8;
+//median splits keep the depth at log2( count / PICK_LEAF_SIZE ), so 64 entries cover any 32 bit count
+static const unsigned PICK_STACK_SIZE = 64;
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Slab test of a ray against a box grown by 'expand' on every side,
+//         returns the distance the ray enters the box( 0 when it starts inside )
+//////////////////////////////////////////////////////////////////////////
+static bool rayEnterDistance(const float* boxMin, const float* boxMax, float expand, const Ray& ray, float& enterOut)
+{
+	float tMin = 0.0f;
+	float tMax = M_INFINITY;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float origin = ray.origin_.Data()[axis];
+		const float direction = ray.direction_.Data()[axis];
+		const float low = boxMin[axis] - expand;
+		const float high = boxMax[axis] + expand;
+		if (Abs(direction) < M_EPSILON)
+		{
+			if (origin < low || origin > high)
+				return false;
+			continue;
+		}
+
+		const float invDirection = 1.0f / direction;
+		float t0 = (low - origin) * invDirection;
+		float t1 = (high - origin) * invDirection;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = Max(tMin, t0);
+		tMax = Min(tMax, t1);
+		if (tMin > tMax)
+			return false;
+	}
+	enterOut = tMin;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// \brief: Distance from the ray origin to the farthest corner of a box, no
+//         point inside the box can be hit further along the ray than this
+//////////////////////////////////////////////////////////////////////////
+static float farthestCornerDistance(const float* boxMin, const float* boxMax, const Ray& ray)
+{
+	float lengthSquared = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float origin = ray.origin_.Data()[axis];
+		const float delta = Max(Abs(origin - boxMin[axis]), Abs(boxMax[axis] - origin));
+		lengthSquared += delta * delta;
+	}
+	return sqrtf(lengthSquared);
+}
+
+AgVoxelPickIndex::AgVoxelPickIndex()
+	: m_pointSpacing(0.0f)
+{
+}
+
+void AgVoxelPickIndex::build(std::vector<Vector3>& positions)
+{
+	URHO3D_PROFILE(BuildVoxelPickIndex);
+
+	m_nodes.clear();
+	m_points.clear();
+	m_pointIndices.resize(positions.size());
+	for (std::uint32_t i = 0; i < (std::uint32_t)positions.size(); ++i)
+		m_pointIndices[i] = i;
+	m_points.swap(positions);
+	m_bounds.Clear();
+	m_pointSpacing = 0.0f;
+	if (m_points.empty())
+		return;
+
+	m_nodes.reserve(2 * (m_points.size() / PICK_LEAF_SIZE + 1));
+	_BuildNode(0, (std::uint32_t)m_points.size());
+
+	//store the points in leaf order, so a leaf reads one contiguous run
+	std::vector<Vector3> sorted(m_points.size());
+	for (std::uint32_t i = 0; i < (std::uint32_t)m_points.size(); ++i)
+		sorted[i] = m_points[m_pointIndices[i]];
+	m_points.swap(sorted);
+
+	const Node& root = m_nodes.front();
+	m_bounds.Define(Vector3(root.m_min[0], root.m_min[1], root.m_min[2]), Vector3(root.m_max[0], root.m_max[1], root.m_max[2]));
+
+	//a leaf of n points on a surface spans about sqrt( n ) point spacings
+	float spacingSum = 0.0f;
+	unsigned numLeaves = 0;
+	for (const Node& node : m_nodes)
+	{
+		if (!node.m_count)
+			continue;
+		const float extent = Max(node.m_max[0] - node.m_min[0], Max(node.m_max[1] - node.m_min[1], node.m_max[2] - node.m_min[2]));
+		spacingSum += extent / sqrtf((float)node.m_count);
+		++numLeaves;
+	}
+	m_pointSpacing = numLeaves ? spacingSum / numLeaves : 0.0f;
+}
+
+std::uint32_t AgVoxelPickIndex::_BuildNode(std::uint32_t begin, std::uint32_t end)
+{
+	const std::uint32_t nodeIndex = (std::uint32_t)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	float boxMin[3] = { M_INFINITY, M_INFINITY, M_INFINITY };
+	float boxMax[3] = { -M_INFINITY, -M_INFINITY, -M_INFINITY };
+	for (std::uint32_t i = begin; i < end; ++i)
+	{
+		const float* position = m_points[m_pointIndices[i]].Data();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boxMin[axis] = Min(boxMin[axis], position[axis]);
+			boxMax[axis] = Max(boxMax[axis], position[axis]);
+		}
+	}
+
+	Node& node = m_nodes[nodeIndex];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		node.m_min[axis] = boxMin[axis];
+		node.m_max[axis] = boxMax[axis];
+	}
+
+	if (end - begin <= PICK_LEAF_SIZE)
+	{
+		node.m_first = begin;
+		node.m_count = end - begin;
+		return nodeIndex;
+	}
+
+	int splitAxis = 0;
+	for (int axis = 1; axis < 3; ++axis)
+	{
+		if (boxMax[axis] - boxMin[axis] > boxMax[splitAxis] - boxMin[splitAxis])
+			splitAxis = axis;
+	}
+
+	const std::uint32_t middle = begin + (end - begin) / 2;
+	const std::vector<Vector3>& points = m_points;
+	std::nth_element(m_pointIndices.begin() + begin, m_pointIndices.begin() + middle, m_pointIndices.begin() + end,
+		[&points, splitAxis](std::uint32_t lhs, std::uint32_t rhs)
+	{
+		return points[lhs].Data()[splitAxis] < points[rhs].Data()[splitAxis];
+	});
+
+	//the first child directly follows its parent, push_back may move 'node'
+	_BuildNode(begin, middle);
+	const std::uint32_t secondChild = _BuildNode(middle, end);
+	m_nodes[nodeIndex].m_first = secondChild;
+	m_nodes[nodeIndex].m_count = 0;
+	return nodeIndex;
+}
+
+bool AgVoxelPickIndex::raycast(const Ray& ray, const AgPointPickTolerance& tolerance, float maxDistance,
+	float& distanceOut, std::uint32_t& pointIndexOut, Vector3& positionOut) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	const Node& root = m_nodes.front();
+	//the tolerance grows along the ray, bound it by the farthest point that can be hit
+	const float reach = Min(maxDistance, farthestCornerDistance(root.m_min, root.m_max, ray));
+	float best = maxDistance;
+	bool hit = false;
+
+	std::uint32_t stackNodes[PICK_STACK_SIZE];
+	float stackEnter[PICK_STACK_SIZE];
+	unsigned stackSize = 0;
+
+	float enter;
+	if (!rayEnterDistance(root.m_min, root.m_max, tolerance.at(reach), ray, enter))
+		return false;
+	stackNodes[stackSize] = 0;
+	stackEnter[stackSize++] = enter;
+
+	while (stackSize)
+	{
+		--stackSize;
+		if (stackEnter[stackSize] > best)
+			continue;
+
+		const Node& node = m_nodes[stackNodes[stackSize]];
+		//a point hit at distance t lies within tolerance( t ) of the ray, so the
+		//ray enters the box grown by tolerance( best ) before t
+		const float expand = tolerance.at(Min(best, reach));
+		if (node.m_count)
+		{
+			for (std::uint32_t i = node.m_first; i < node.m_first + node.m_count; ++i)
+			{
+				const Vector3 delta = m_points[i] - ray.origin_;
+				const float t = delta.DotProduct(ray.direction_);
+				if (t < 0.0f || t >= best)
+					continue;
+				const float radius = tolerance.at(t);
+				if (delta.LengthSquared() - t * t <= radius * radius)
+				{
+					best = t;
+					pointIndexOut = m_pointIndices[i];
+					positionOut = m_points[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		const std::uint32_t children[2] = { (std::uint32_t)(&node - m_nodes.data()) + 1, node.m_first };
+		float childEnter[2];
+		bool childHit[2];
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node& child = m_nodes[children[c]];
+			childHit[c] = rayEnterDistance(child.m_min, child.m_max, expand, ray, childEnter[c]) && childEnter[c] <= best;
+		}
+
+		//push the far child first, so the near one is visited first and tightens 'best'
+		const int nearChild = (childHit[0] && childHit[1] && childEnter[1] < childEnter[0]) ? 1 : 0;
+		const int farChild = 1 - nearChild;
+		if (childHit[farChild] && stackSize < PICK_STACK_SIZE)
+		{
+			stackNodes[stackSize] = children[farChild];
+			stackEnter[stackSize++] = childEnter[farChild];
+		}
+		if (childHit[nearChild] && stackSize < PICK_STACK_SIZE)
+		{
+			stackNodes[stackSize] = children[nearChild];
+			stackEnter[stackSize++] = childEnter[nearChild];
+		}
+	}
+
+	if (hit)
+		distanceOut = best;
+	return hit;
+}
+
+bool AgVoxelPickIndex::mayHit(const BoundingBox& box, const Ray& ray, const AgPointPickTolerance& tolerance, float maxDistance)
+{
+	if (!box.Defined())
+		return false;
+
+	const float reach = Min(maxDistance, farthestCornerDistance(box.min_.Data(), box.max_.Data(), ray));
+	float enter;
+	return rayEnterDistance(box.min_.Data(), box.max_.Data(), tolerance.at(reach), ray, enter) && enter <= maxDistance;
+}
+
+std::uint64_t AgVoxelPickIndex::getAllocatedMemory() const
+{
+	return (std::uint64_t)m_nodes.capacity() * sizeof(Node) + (std::uint64_t)m_points.capacity() * sizeof(Vector3) +
+		(std::uint64_t)m_pointIndices.capacity() * sizeof(std::uint32_t);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../Math/BoundingBox.h"
+#include "../Math/Ray.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		class AgVoxelContainer;
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgPointPickTolerance pick radius around a ray, it grows with
+		//         the distance along the ray so a constant pixel radius of a
+		//         perspective camera can be expressed
+		//////////////////////////////////////////////////////////////////////////
+		struct AgPointPickTolerance
+		{
+			float m_radius;                 //radius at the ray origin
+			float m_slope;                  //radius added per unit of distance along the ray
+			AgPointPickTolerance() : m_radius(0.0f), m_slope(0.0f) {}
+			AgPointPickTolerance(float radius, float slope) : m_radius(radius), m_slope(slope) {}
+			float at(float distance) const { return m_radius + m_slope * distance; }
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgPointPickResult nearest point picked by a ray, in world space
+		//////////////////////////////////////////////////////////////////////////
+		struct AgPointPickResult
+		{
+			Urho3D::Vector3 m_position;
+			float m_distance;               //distance along the ray, M_INFINITY when nothing was hit
+			AgVoxelContainer* m_container;
+			std::uint32_t m_pointIndex;     //index into the loaded LODs of the container, in LOD order
+			AgPointPickResult() : m_position(Urho3D::Vector3::ZERO), m_distance(Urho3D::M_INFINITY), m_container(nullptr), m_pointIndex(0) {}
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgVoxelPickIndex bounding volume hierarchy over the points of
+		//         a voxel container, in node space. Nodes are split at the median
+		//         of their longest axis, so ray queries visit O(log n) nodes.
+		//         Immutable after build, queries may run on any thread
+		//////////////////////////////////////////////////////////////////////////
+		class AgVoxelPickIndex
+		{
+		public:
+			AgVoxelPickIndex();
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Build the hierarchy, takes the positions over
+			//////////////////////////////////////////////////////////////////////////
+			void                                    build(std::vector<Urho3D::Vector3>& positions);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Find the point nearest to the ray origin whose distance from
+			//         the ray is within 'tolerance', only points closer than
+			//         'maxDistance' are considered. 'ray' must be normalized.
+			//         Returns false when no point is hit
+			//////////////////////////////////////////////////////////////////////////
+			bool                                    raycast(const Urho3D::Ray& ray, const AgPointPickTolerance& tolerance, float maxDistance,
+				float& distanceOut, std::uint32_t& pointIndexOut, Urho3D::Vector3& positionOut) const;
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Return whether 'ray' can hit a point inside 'box' that is
+			//         closer than 'maxDistance'
+			//////////////////////////////////////////////////////////////////////////
+			static bool                             mayHit(const Urho3D::BoundingBox& box, const Urho3D::Ray& ray, const AgPointPickTolerance& tolerance,
+				float maxDistance);
+
+			std::uint32_t                           getCount() const { return (std::uint32_t)m_points.size(); }
+			const Urho3D::BoundingBox&              getBounds() const { return m_bounds; }
+			/// Return the average distance between neighbouring points, estimated from the leaf sizes.
+			float                                   getPointSpacing() const { return m_pointSpacing; }
+			std::uint64_t                           getAllocatedMemory() const;
+
+		private:
+			struct Node
+			{
+				float         m_min[3];
+				float         m_max[3];
+				std::uint32_t m_first;      //first point of a leaf, second child of an inner node
+				std::uint32_t m_count;      //amount of points of a leaf, 0 for inner nodes whose first child follows
+			};
+
+			std::uint32_t                           _BuildNode(std::uint32_t begin, std::uint32_t end);
+
+			std::vector<Node>                       m_nodes;
+			std::vector<Urho3D::Vector3>            m_points;               //in leaf order
+			std::vector<std::uint32_t>              m_pointIndices;         //leaf order to the index passed to build
+			Urho3D::BoundingBox                     m_bounds;
+			float                                   m_pointSpacing;
+		};
+	}
+}
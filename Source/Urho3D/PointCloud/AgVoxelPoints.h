@@ -5,6 +5,7 @@
 namespace Urho3D
 {
 	class Geometry;
+	class Matrix3x4;
 }
 
 namespace ambergris {
@@ -23,6 +24,8 @@ namespace ambergris {
 			virtual std::uint32_t	getCount() const = 0;
 			virtual std::uint64_t	getAllocatedMemory() const = 0;
 			virtual Urho3D::Geometry* getGeometry() const = 0;
+			/// Return the transform from vertex positions to node space, null when positions are stored in node space.
+			virtual const Urho3D::Matrix3x4* getLocalTransform() const { return nullptr; }
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "AgVoxelStreamer.h"
+#include "AgVoxelContainer.h"
+#include "AgVoxelLidarPoints.h"
+#include "AgVoxelTerrestialPoints.h"
+#include "AgPointCloudOptions.h"
+
+#include "../Core/Condition.h"
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
+#include "../IO/File.h"
+#include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
+#include "../Scene/Scene.h"
+
+#include <algorithm>
+
+using namespace Urho3D;
+using namespace ambergris::PointCloudEngine;
+
+//loads are disk bound, a few threads keep the disk busy
+static const unsigned AG_STREAMER_THREADS = 2;
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgVoxelLoadThread runs the loads dispatched by an AgVoxelStreamer,
+		//         sleeping while there is nothing to load
+		//////////////////////////////////////////////////////////////////////////
+		class AgVoxelLoadThread : public Thread, public RefCounted
+		{
+		public:
+			explicit AgVoxelLoadThread(AgVoxelStreamer* owner) : m_owner(owner) {}
+
+			void ThreadFunction() override
+			{
+				while (shouldRun_)
+				{
+					if (!m_owner->_LoadNext())
+						m_wakeUp.Wait();
+				}
+			}
+
+			void                                    wakeUp() { m_wakeUp.Set(); }
+			void                                    requestStop() { shouldRun_ = false; m_wakeUp.Set(); }
+
+		private:
+			AgVoxelStreamer*                        m_owner;
+			Condition                               m_wakeUp;
+		};
+	}
+}
+
+AgVoxelStreamer::AgVoxelStreamer(Context* context)
+	: Object(context)
+	, m_cache(context->GetSubsystem<ResourceCache>())
+	, m_maxInFlight(4)
+	, m_frameNumber(0)
+{
+}
+
+AgVoxelStreamer::~AgVoxelStreamer()
+{
+	cancelAll();
+
+	//Stop returns once the thread has finished its current load
+	for (auto& thread : m_threads)
+		thread->requestStop();
+	for (auto& thread : m_threads)
+		thread->Stop();
+	m_threads.clear();
+
+	for (StreamRequest* request : m_inFlight)
+		delete request;
+	m_inFlight.clear();
+	m_loaded.clear();
+}
+
+void AgVoxelStreamer::beginFrame(int timeOutInMS)
+{
+	++m_frameNumber;
+	m_stats.m_completed = 0;
+	m_stats.m_cancelled = 0;
+
+	std::vector<StreamRequest*> loaded;
+	{
+		MutexLock lock(m_mutex);
+		loaded.swap(m_loaded);
+	}
+	if (loaded.empty())
+		return;
+
+	URHO3D_PROFILE(FinishVoxelLoads);
+	HiresTimer timer;
+	size_t finished = 0;
+	while (finished < loaded.size())
+	{
+		_Finish(loaded[finished++]);
+		if (timeOutInMS > 0 && timer.GetUSec(false) > timeOutInMS * 1000LL)
+			break;
+	}
+
+	//the rest is finished first on the next frame
+	if (finished < loaded.size())
+	{
+		MutexLock lock(m_mutex);
+		m_loaded.insert(m_loaded.begin(), loaded.begin() + finished, loaded.end());
+	}
+}
+
+void AgVoxelStreamer::request(AgVoxelContainer* container, bool isLidarData, float priority)
+{
+	if (!container || container->GetResourceName().Empty())
+		return;
+
+	const unsigned lod = container->getNumLoadedLODs();
+	if (lod >= (unsigned)container->GetMaxLOD())
+		return;
+
+	for (StreamRequest* request : m_inFlight)
+	{
+		if (request->m_container == container && !request->m_cancelled)
+		{
+			request->m_lastRequestFrame = m_frameNumber;
+			return;
+		}
+	}
+
+	for (StreamRequest* request : m_pending)
+	{
+		if (request->m_container == container)
+		{
+			request->m_lastRequestFrame = m_frameNumber;
+			request->m_priority = std::max(request->m_priority, priority);
+			return;
+		}
+	}
+
+	StreamRequest* request = new StreamRequest();
+	request->m_container = container;
+	request->m_lod = lod;
+	request->m_priority = priority;
+	request->m_lastRequestFrame = m_frameNumber;
+	request->m_isLidarData = isLidarData;
+	request->m_cancelled = false;
+	request->m_success = false;
+	m_pending.push_back(request);
+}
+
+void AgVoxelStreamer::endFrame()
+{
+	URHO3D_PROFILE(StreamVoxels);
+
+	//voxels that were not requested again have left the frustum
+	for (size_t i = 0; i < m_pending.size();)
+	{
+		StreamRequest* request = m_pending[i];
+		if (request->m_lastRequestFrame != m_frameNumber || !request->m_container)
+		{
+			m_pending[i] = m_pending.back();
+			m_pending.pop_back();
+			++m_stats.m_cancelled;
+			delete request;
+		}
+		else
+			++i;
+	}
+	std::vector<StreamRequest*> inFlight(m_inFlight);
+	for (StreamRequest* request : inFlight)
+	{
+		if (!request->m_cancelled && (request->m_lastRequestFrame != m_frameNumber || !request->m_container))
+		{
+			++m_stats.m_cancelled;
+			_Cancel(request);
+		}
+	}
+
+	//largest screen space error first
+	std::sort(m_pending.begin(), m_pending.end(), [](const StreamRequest* lhs, const StreamRequest* rhs)
+	{
+		return lhs->m_priority > rhs->m_priority;
+	});
+
+	size_t dispatched = 0;
+	unsigned activeLoads = 0;
+	for (StreamRequest* request : m_inFlight)
+	{
+		if (!request->m_cancelled)
+			++activeLoads;
+	}
+	while (dispatched < m_pending.size() && activeLoads < m_maxInFlight)
+	{
+		_Dispatch(m_pending[dispatched++]);
+		++activeLoads;
+	}
+	m_pending.erase(m_pending.begin(), m_pending.begin() + dispatched);
+
+	m_stats.m_queued = (std::uint32_t)m_pending.size();
+	m_stats.m_inFlight = activeLoads;
+}
+
+void AgVoxelStreamer::cancelAll()
+{
+	m_stats.m_cancelled += (std::uint32_t)m_pending.size();
+	for (StreamRequest* request : m_pending)
+		delete request;
+	m_pending.clear();
+
+	std::vector<StreamRequest*> inFlight(m_inFlight);
+	for (StreamRequest* request : inFlight)
+	{
+		if (!request->m_cancelled)
+		{
+			++m_stats.m_cancelled;
+			_Cancel(request);
+		}
+	}
+
+	m_stats.m_queued = 0;
+	m_stats.m_inFlight = 0;
+}
+
+bool AgVoxelStreamer::_LoadNext()
+{
+	StreamRequest* request;
+	{
+		MutexLock lock(m_mutex);
+		if (m_loadQueue.empty())
+			return false;
+		request = m_loadQueue.front();
+		m_loadQueue.erase(m_loadQueue.begin());
+	}
+
+	SharedPtr<File> file = m_cache->GetFile(request->m_points->GetName(), false);
+	request->m_success = file && request->m_points->BeginLoad(*file);
+
+	MutexLock lock(m_mutex);
+	m_loaded.push_back(request);
+	return true;
+}
+
+void AgVoxelStreamer::_Dispatch(StreamRequest* request)
+{
+	AgVoxelContainer* container = request->m_container;
+	String fileName = container->GetResourceName() + "_" + String(request->m_lod) + ".vxl";
+	if (request->m_isLidarData)
+	{
+		AgVoxelLidarPoints* lidarPoints = new AgVoxelLidarPoints(context_);
+		Scene* scene = container->GetScene();
+		AgPointCloudOptions* options = scene ? scene->GetComponent<AgPointCloudOptions>() : nullptr;
+		lidarPoints->setQuantized(options && options->getQuantizedPositions());
+		request->m_points = lidarPoints;
+	}
+	else
+		request->m_points = new AgVoxelTerrestialPoints(context_);
+	request->m_points->SetName(fileName);
+	m_inFlight.push_back(request);
+
+	if (m_threads.empty())
+	{
+		for (unsigned i = 0; i < AG_STREAMER_THREADS; ++i)
+		{
+			SharedPtr<AgVoxelLoadThread> thread(new AgVoxelLoadThread(this));
+			thread->Run();
+			m_threads.push_back(thread);
+		}
+	}
+
+	{
+		MutexLock lock(m_mutex);
+		m_loadQueue.push_back(request);
+	}
+	for (auto& thread : m_threads)
+		thread->wakeUp();
+}
+
+void AgVoxelStreamer::_Cancel(StreamRequest* request)
+{
+	bool started;
+	{
+		MutexLock lock(m_mutex);
+		std::vector<StreamRequest*>::iterator it = std::find(m_loadQueue.begin(), m_loadQueue.end(), request);
+		started = it == m_loadQueue.end();
+		if (!started)
+			m_loadQueue.erase(it);
+	}
+	if (!started)
+	{
+		_ReleaseRequest(request);
+		return;
+	}
+
+	//already loading or loaded, the result is thrown away when it is finished
+	request->m_cancelled = true;
+}
+
+void AgVoxelStreamer::_ReleaseRequest(StreamRequest* request)
+{
+	std::vector<StreamRequest*>::iterator it = std::find(m_inFlight.begin(), m_inFlight.end(), request);
+	if (it != m_inFlight.end())
+		m_inFlight.erase(it);
+	delete request;
+}
+
+void AgVoxelStreamer::_Finish(StreamRequest* request)
+{
+	AgVoxelContainer* container = request->m_container;
+	//the container may have been refined or freed while the file was loading
+	if (!request->m_cancelled && container && container->getNumLoadedLODs() == request->m_lod)
+	{
+		if (request->m_success && request->m_points->EndLoad())
+		{
+			auto* cache = GetSubsystem<ResourceCache>();
+			cache->AddManualResource(request->m_points);
+			container->SetVoxelPoints(request->m_points);
+			++m_stats.m_completed;
+		}
+		else
+			URHO3D_LOGERROR("Failed to stream " + request->m_points->GetName());
+	}
+
+	_ReleaseRequest(request);
+}
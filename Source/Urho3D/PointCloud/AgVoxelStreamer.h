@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../Core/Mutex.h"
+#include "../Core/Object.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace Urho3D
+{
+	class ResourceCache;
+}
+
+namespace ambergris {
+	namespace PointCloudEngine {
+
+		class AgVoxelContainer;
+		class AgVoxelLoadThread;
+		class AgVoxelPoints;
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgStreamStats streaming counters of the last frame
+		//////////////////////////////////////////////////////////////////////////
+		struct AgStreamStats
+		{
+			std::uint32_t m_queued;         //requests waiting for a free load slot
+			std::uint32_t m_inFlight;       //loads queued on or running in the loader threads
+			std::uint32_t m_completed;      //loads finished this frame
+			std::uint32_t m_cancelled;      //requests dropped this frame, voxel left the frustum
+			AgStreamStats() : m_queued(0), m_inFlight(0), m_completed(0), m_cancelled(0) {}
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgVoxelStreamer loads voxel container LODs on its own loader
+		//         threads, highest screen space error first, with a bounded amount
+		//         of loads in flight. Disk reads never occupy the WorkQueue threads
+		//////////////////////////////////////////////////////////////////////////
+		class AgVoxelStreamer : public Urho3D::Object
+		{
+			URHO3D_OBJECT(AgVoxelStreamer, Urho3D::Object);
+			friend class AgVoxelLoadThread;
+		public:
+			explicit AgVoxelStreamer(Urho3D::Context* context);
+			~AgVoxelStreamer() override;
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Finish the loads that completed since the last frame and start
+			//         collecting the requests of a new frame. A positive timeout
+			//         bounds the time spent finishing loads, the rest is finished
+			//         on later frames
+			//////////////////////////////////////////////////////////////////////////
+			void                                    beginFrame(int timeOutInMS = -1);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Request the next LOD of 'container', requests of the same
+			//         container are merged and keep the highest priority
+			//////////////////////////////////////////////////////////////////////////
+			void                                    request(AgVoxelContainer* container, bool isLidarData, float priority);
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Cancel the requests that were not renewed this frame and
+			//         dispatch the most important ones to the loader threads
+			//////////////////////////////////////////////////////////////////////////
+			void                                    endFrame();
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Drop all requests, loads in flight are discarded on completion
+			//////////////////////////////////////////////////////////////////////////
+			void                                    cancelAll();
+
+			void                                    setMaxInFlight(unsigned count) { m_maxInFlight = count ? count : 1; }
+			unsigned                                getMaxInFlight() const { return m_maxInFlight; }
+
+			const AgStreamStats&                    getStats() const { return m_stats; }
+
+		private:
+			struct StreamRequest
+			{
+				Urho3D::WeakPtr<AgVoxelContainer>     m_container;
+				Urho3D::SharedPtr<AgVoxelPoints>      m_points;
+				unsigned                              m_lod;
+				float                                 m_priority;
+				unsigned                              m_lastRequestFrame;
+				bool                                  m_isLidarData;
+				bool                                  m_cancelled;
+				bool                                  m_success;              //written by the loader thread
+			};
+
+			//////////////////////////////////////////////////////////////////////////
+			// \brief: Run BeginLoad of the oldest dispatched request, called from the
+			//         loader threads. Returns false if nothing was dispatched
+			//////////////////////////////////////////////////////////////////////////
+			bool                                    _LoadNext();
+
+			void                                    _Dispatch(StreamRequest* request);
+			void                                    _Cancel(StreamRequest* request);
+			void                                    _Finish(StreamRequest* request);
+			void                                    _ReleaseRequest(StreamRequest* request);
+
+			std::vector<StreamRequest*>             m_pending;
+			std::vector<StreamRequest*>             m_inFlight;             //dispatched and not finished yet, owns the requests
+			std::vector<StreamRequest*>             m_loadQueue;            //dispatched and not started, guarded by m_mutex
+			std::vector<StreamRequest*>             m_loaded;               //waiting for EndLoad, guarded by m_mutex
+			std::vector<Urho3D::SharedPtr<AgVoxelLoadThread> > m_threads;
+			Urho3D::Mutex                           m_mutex;
+			Urho3D::ResourceCache*                  m_cache;
+			unsigned                                m_maxInFlight;
+			unsigned                                m_frameNumber;
+			AgStreamStats                           m_stats;
+		};
+	}
+}
@@ -33,11 +33,14 @@ AgVoxelTreeRunTime::AgVoxelTreeRunTime(Context* context)
 	, mHasNormals(false)
 	, mHasIntensity(false)
 	, m_totalAmountOfPoints(0)
+	, mContainerArraysDirty(true)
 {
 }
 
 AgVoxelTreeRunTime::~AgVoxelTreeRunTime()
 {
+	//containers forget the tree when removed, which Node would only do after this part is destroyed
+	RemoveAllComponents();
 }
 
 void AgVoxelTreeRunTime::RegisterObject(Context* context)
@@ -249,16 +252,55 @@ void AgVoxelTreeRunTime::updateAll()
 
 const AgVoxelContainer*   AgVoxelTreeRunTime::getVoxelContainerAt(int index) const
 {
-	const Vector<SharedPtr<Component> >& components = GetComponents();
-	if (index >= components.Size())
+	const AgVoxelContainerArrays& arrays = getContainerArrays();
+	if (index < 0 || (unsigned)index >= arrays.size())
 		return nullptr;
-	return dynamic_cast<const AgVoxelContainer*>(components[index].Get());
+	return arrays.m_containers[index];
 }
 
 AgVoxelContainer*   AgVoxelTreeRunTime::getVoxelContainerAt(int index)
 {
-	const Vector<SharedPtr<Component> >& components = GetComponents();
-	if (index >= components.Size())
+	const AgVoxelContainerArrays& arrays = getContainerArrays();
+	if (index < 0 || (unsigned)index >= arrays.size())
 		return nullptr;
-	return dynamic_cast<AgVoxelContainer*>(components[index].Get());
+	return arrays.m_containers[index];
+}
+
+const AgVoxelContainerArrays& AgVoxelTreeRunTime::getContainerArrays() const
+{
+	if (!mContainerArraysDirty)
+		return mContainerArrays;
+
+	PODVector<AgVoxelContainer*> containers;
+	GetComponents<AgVoxelContainer>(containers);
+
+	const unsigned count = containers.Size();
+	mContainerArrays.m_centerX.resize(count);
+	mContainerArrays.m_centerY.resize(count);
+	mContainerArrays.m_centerZ.resize(count);
+	mContainerArrays.m_extentX.resize(count);
+	mContainerArrays.m_extentY.resize(count);
+	mContainerArrays.m_extentZ.resize(count);
+	mContainerArrays.m_pointCount.resize(count);
+	mContainerArrays.m_maxLOD.resize(count);
+	mContainerArrays.m_containers.assign(containers.Begin(), containers.End());
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const AgVoxelContainer* container = containers[i];
+		const BoundingBox bounds(container->GetSVOBoundsMin(), container->GetSVOBoundsMax());
+		const Vector3 center = bounds.Center();
+		const Vector3 extent = bounds.HalfSize();
+		mContainerArrays.m_centerX[i] = center.x_;
+		mContainerArrays.m_centerY[i] = center.y_;
+		mContainerArrays.m_centerZ[i] = center.z_;
+		mContainerArrays.m_extentX[i] = extent.x_;
+		mContainerArrays.m_extentY[i] = extent.y_;
+		mContainerArrays.m_extentZ[i] = extent.z_;
+		mContainerArrays.m_pointCount[i] = (std::uint32_t)container->GetAmountOfPoints();
+		mContainerArrays.m_maxLOD[i] = (std::uint8_t)container->GetMaxLOD();
+	}
+
+	mContainerArraysDirty = false;
+	return mContainerArrays;
 }
@@ -11,6 +11,26 @@ namespace ambergris {
 
 		struct AgVoxelTreeNode;
 
+		//////////////////////////////////////////////////////////////////////////
+		//\brief:  AgVoxelContainerArrays flat( SoA ) copy of the container data
+		//         of a scan that culling and LOD selection touch, bounds are in
+		//         scan space as center and half extent
+		//////////////////////////////////////////////////////////////////////////
+		struct AgVoxelContainerArrays
+		{
+			std::vector<float>                      m_centerX;
+			std::vector<float>                      m_centerY;
+			std::vector<float>                      m_centerZ;
+			std::vector<float>                      m_extentX;
+			std::vector<float>                      m_extentY;
+			std::vector<float>                      m_extentZ;
+			std::vector<std::uint32_t>              m_pointCount;
+			std::vector<std::uint8_t>               m_maxLOD;
+			std::vector<AgVoxelContainer*>          m_containers;
+
+			unsigned                                size() const { return (unsigned)m_containers.size(); }
+		};
+
 		class AgVoxelTreeRunTime : public Urho3D::Node
 		{
 			URHO3D_OBJECT(AgVoxelTreeRunTime, Urho3D::Node);
@@ -30,6 +50,18 @@ namespace ambergris {
 			const AgVoxelContainer*                   getVoxelContainerAt(int index) const;
 			AgVoxelContainer*                   getVoxelContainerAt(int index);
 
+			//////////////////////////////////////////////////////////////////////////
+			//\brief: Returns the flat container arrays, rebuilt on the main thread
+			//        when containers were added, removed or changed their bounds,
+			//        point count or LOD count. Indices match getVoxelContainerAt
+			//////////////////////////////////////////////////////////////////////////
+			const AgVoxelContainerArrays&           getContainerArrays() const;
+
+			//////////////////////////////////////////////////////////////////////////
+			//\brief: Force a rebuild of the container arrays, called by the containers
+			//////////////////////////////////////////////////////////////////////////
+			void                                    markContainerArraysDirty() { mContainerArraysDirty = true; }
+
 			//////////////////////////////////////////////////////////////////////////
 			//\brief: Returns the SVO bounding box
 			//////////////////////////////////////////////////////////////////////////
@@ -114,6 +146,9 @@ namespace ambergris {
 			*/
 			unsigned short                          m_regionFlag;
 
+			mutable AgVoxelContainerArrays          mContainerArrays;
+			mutable bool                            mContainerArraysDirty;
+
 			//RealityComputing::Common::RCVector4f              m_nodeColor;
 		};
 	}
@@ -31,85 +31,181 @@
 #include "../Resource/ResourceCache.h"
 #include "../Resource/ResourceEvents.h"
 
+#include <algorithm>
+
 #include "../DebugNew.h"
 
 namespace Urho3D
 {
 
+/// Loader thread managed by the background loader.
+class BackgroundLoaderThread : public Thread, public RefCounted
+{
+public:
+    /// Construct.
+    explicit BackgroundLoaderThread(BackgroundLoader* owner) :
+        owner_(owner)
+    {
+    }
+
+    /// Load queued resources until stopped.
+    void ThreadFunction() override
+    {
+        while (shouldRun_)
+        {
+            if (!owner_->LoadNextResource())
+                Time::Sleep(5);
+        }
+    }
+
+    /// Ask the thread to stop after the current resource without waiting for it.
+    void RequestStop() { shouldRun_ = false; }
+
+private:
+    /// Background loader.
+    BackgroundLoader* owner_;
+};
+
 BackgroundLoader::BackgroundLoader(ResourceCache* owner) :
-    owner_(owner)
+    owner_(owner),
+    numThreads_(1),
+    nextSequence_(0)
 {
 }
 
 BackgroundLoader::~BackgroundLoader()
 {
+    StopThreads();
+
     MutexLock lock(backgroundLoadMutex_);
 
     backgroundLoadQueue_.Clear();
+    priorityQueue_.Clear();
 }
 
-void BackgroundLoader::ThreadFunction()
+bool BackgroundLoader::LoadsAfter(const QueueEntry& lhs, const QueueEntry& rhs)
 {
-    while (shouldRun_)
-    {
-        backgroundLoadMutex_.Acquire();
+    if (lhs.priority_ != rhs.priority_)
+        return lhs.priority_ < rhs.priority_;
+    return lhs.sequence_ > rhs.sequence_;
+}
 
-        // Search for a queued resource that has not been loaded yet
-        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Begin();
-        while (i != backgroundLoadQueue_.End())
+void BackgroundLoader::PushEntry(const Pair<StringHash, StringHash>& key, const BackgroundLoadItem& item)
+{
+    // When stale entries of reprioritized or cancelled items dominate the heap, rebuild it from the queued items
+    if (priorityQueue_.Size() >= 64 && priorityQueue_.Size() > 4 * backgroundLoadQueue_.Size())
+    {
+        priorityQueue_.Clear();
+        for (HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::ConstIterator i = backgroundLoadQueue_.Begin();
+             i != backgroundLoadQueue_.End(); ++i)
         {
-            if (i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
-                break;
-            else
-                ++i;
+            if (i->second_.resource_->GetAsyncLoadState() != ASYNC_QUEUED)
+                continue;
+            QueueEntry entry;
+            entry.priority_ = i->second_.priority_;
+            entry.sequence_ = i->second_.sequence_;
+            entry.key_ = i->first_;
+            priorityQueue_.Push(entry);
         }
+        std::make_heap(priorityQueue_.Buffer(), priorityQueue_.Buffer() + priorityQueue_.Size(), LoadsAfter);
+        return;
+    }
 
-        if (i == backgroundLoadQueue_.End())
+    QueueEntry entry;
+    entry.priority_ = item.priority_;
+    entry.sequence_ = item.sequence_;
+    entry.key_ = key;
+    priorityQueue_.Push(entry);
+    std::push_heap(priorityQueue_.Buffer(), priorityQueue_.Buffer() + priorityQueue_.Size(), LoadsAfter);
+}
+
+bool BackgroundLoader::LoadNextResource()
+{
+    backgroundLoadMutex_.Acquire();
+
+    // Pop entries until one refers to a queued resource at its current priority
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.End();
+    while (!priorityQueue_.Empty())
+    {
+        QueueEntry entry = priorityQueue_.Front();
+        std::pop_heap(priorityQueue_.Buffer(), priorityQueue_.Buffer() + priorityQueue_.Size(), LoadsAfter);
+        priorityQueue_.Pop();
+
+        i = backgroundLoadQueue_.Find(entry.key_);
+        if (i != backgroundLoadQueue_.End() && i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED &&
+            i->second_.priority_ == entry.priority_)
+            break;
+        i = backgroundLoadQueue_.End();
+    }
+
+    if (i == backgroundLoadQueue_.End())
+    {
+        // No resources to load found
+        backgroundLoadMutex_.Release();
+        return false;
+    }
+
+    BackgroundLoadItem& item = i->second_;
+    Resource* resource = item.resource_;
+    // Mark as loading before releasing the mutex so that no other thread takes the item and it can not be cancelled.
+    // We can be sure that the item is not removed from the queue as long as it is in the "queued" or "loading" state
+    resource->SetAsyncLoadState(ASYNC_LOADING);
+    item.waitTime_ = clock_.GetUSec(false) - item.queueTime_;
+    BackgroundLoadStats& stats = stats_[resource->GetType()];
+    --stats.queued_;
+    ++stats.loading_;
+    backgroundLoadMutex_.Release();
+
+    bool success = false;
+    SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
+    if (file)
+        success = resource->BeginLoad(*file);
+
+    // Process dependencies now
+    // Need to lock the queue again when manipulating other entries
+    Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
+    backgroundLoadMutex_.Acquire();
+    if (item.dependents_.Size())
+    {
+        for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin();
+             i != item.dependents_.End(); ++i)
         {
-            // No resources to load found
-            backgroundLoadMutex_.Release();
-            Time::Sleep(5);
+            HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
+            if (j != backgroundLoadQueue_.End())
+                j->second_.dependencies_.Erase(key);
         }
-        else
-        {
-            BackgroundLoadItem& item = i->second_;
-            Resource* resource = item.resource_;
-            // We can be sure that the item is not removed from the queue as long as it is in the
-            // "queued" or "loading" state
-            backgroundLoadMutex_.Release();
-
-            bool success = false;
-            SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
-            if (file)
-            {
-                resource->SetAsyncLoadState(ASYNC_LOADING);
-                success = resource->BeginLoad(*file);
-            }
 
-            // Process dependencies now
-            // Need to lock the queue again when manipulating other entries
-            Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
-            backgroundLoadMutex_.Acquire();
-            if (item.dependents_.Size())
-            {
-                for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin();
-                     i != item.dependents_.End(); ++i)
-                {
-                    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
-                    if (j != backgroundLoadQueue_.End())
-                        j->second_.dependencies_.Erase(key);
-                }
+        item.dependents_.Clear();
+    }
 
-                item.dependents_.Clear();
-            }
+    resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
+    --stats_[resource->GetType()].loading_;
+    backgroundLoadMutex_.Release();
 
-            resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
-            backgroundLoadMutex_.Release();
-        }
+    return true;
+}
+
+void BackgroundLoader::StartThreads()
+{
+    for (unsigned i = 0; i < numThreads_; ++i)
+    {
+        SharedPtr<BackgroundLoaderThread> thread(new BackgroundLoaderThread(this));
+        thread->Run();
+        threads_.Push(thread);
     }
 }
 
-bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller)
+void BackgroundLoader::StopThreads()
+{
+    // Let all threads see the request before waiting on any of them
+    for (unsigned i = 0; i < threads_.Size(); ++i)
+        threads_[i]->RequestStop();
+    for (unsigned i = 0; i < threads_.Size(); ++i)
+        threads_[i]->Stop();
+    threads_.Clear();
+}
+
+bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority)
 {
     StringHash nameHash(name);
     Pair<StringHash, StringHash> key = MakePair(type, nameHash);
@@ -146,6 +242,10 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
 
     item.resource_->SetName(name);
     item.resource_->SetAsyncLoadState(ASYNC_QUEUED);
+    item.priority_ = priority;
+    item.sequence_ = nextSequence_++;
+    item.queueTime_ = clock_.GetUSec(false);
+    item.waitTime_ = 0;
 
     // If this is a resource calling for the background load of more resources, mark the dependency as necessary
     if (caller)
@@ -157,19 +257,60 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
             BackgroundLoadItem& callerItem = j->second_;
             item.dependents_.Insert(callerKey);
             callerItem.dependencies_.Insert(key);
+            // The caller can not finish before its dependencies, so they load at least at its priority
+            item.priority_ = Max(item.priority_, callerItem.priority_);
         }
         else
             URHO3D_LOGWARNING("Resource " + caller->GetName() +
                        " requested for a background loaded resource but was not in the background load queue");
     }
 
-    // Start the background loader thread now
-    if (!IsStarted())
-        Run();
+    ++stats_[type].queued_;
+    PushEntry(key, item);
+
+    // Start the background loader threads now
+    if (threads_.Empty())
+        StartThreads();
 
     return true;
 }
 
+bool BackgroundLoader::SetPriority(StringHash type, StringHash nameHash, int priority)
+{
+    MutexLock lock(backgroundLoadMutex_);
+
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(MakePair(type, nameHash));
+    if (i == backgroundLoadQueue_.End() || i->second_.resource_->GetAsyncLoadState() != ASYNC_QUEUED)
+        return false;
+
+    // The entry with the old priority goes stale and is skipped when popped
+    if (i->second_.priority_ != priority)
+    {
+        i->second_.priority_ = priority;
+        PushEntry(i->first_, i->second_);
+    }
+    return true;
+}
+
+bool BackgroundLoader::CancelResource(StringHash type, StringHash nameHash)
+{
+    MutexLock lock(backgroundLoadMutex_);
+
+    // A resource requested by a loading resource is needed to finish that one
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(MakePair(type, nameHash));
+    if (i == backgroundLoadQueue_.End() || i->second_.resource_->GetAsyncLoadState() != ASYNC_QUEUED ||
+        !i->second_.dependents_.Empty())
+        return false;
+
+    URHO3D_LOGDEBUG("Cancelled background loading resource " + i->second_.resource_->GetName());
+
+    BackgroundLoadStats& stats = stats_[type];
+    --stats.queued_;
+    ++stats.cancelled_;
+    backgroundLoadQueue_.Erase(i);
+    return true;
+}
+
 void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
 {
     backgroundLoadMutex_.Acquire();
@@ -179,6 +320,12 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
     if (i != backgroundLoadQueue_.End())
     {
+        // Needed right now, so take it before anything else still queued
+        if (i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED && i->second_.priority_ != M_MAX_INT)
+        {
+            i->second_.priority_ = M_MAX_INT;
+            PushEntry(i->first_, i->second_);
+        }
         backgroundLoadMutex_.Release();
 
         {
@@ -217,7 +364,7 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
 
 void BackgroundLoader::FinishResources(int maxMs)
 {
-    if (IsStarted())
+    if (!threads_.Empty())
     {
         HiresTimer timer;
 
@@ -250,12 +397,48 @@ void BackgroundLoader::FinishResources(int maxMs)
     }
 }
 
+void BackgroundLoader::SetNumThreads(unsigned num)
+{
+    num = Max(num, 1U);
+    if (num == numThreads_)
+        return;
+
+    numThreads_ = num;
+    // Running threads finish their current resource and are replaced
+    if (!threads_.Empty())
+    {
+        StopThreads();
+        StartThreads();
+    }
+}
+
+void BackgroundLoader::ResetStats()
+{
+    MutexLock lock(backgroundLoadMutex_);
+
+    // Queue depths describe the present, keep them
+    for (HashMap<StringHash, BackgroundLoadStats>::Iterator i = stats_.Begin(); i != stats_.End(); ++i)
+    {
+        BackgroundLoadStats stats;
+        stats.queued_ = i->second_.queued_;
+        stats.loading_ = i->second_.loading_;
+        i->second_ = stats;
+    }
+}
+
 unsigned BackgroundLoader::GetNumQueuedResources() const
 {
     MutexLock lock(backgroundLoadMutex_);
     return backgroundLoadQueue_.Size();
 }
 
+BackgroundLoadStats BackgroundLoader::GetStats(StringHash type) const
+{
+    MutexLock lock(backgroundLoadMutex_);
+    HashMap<StringHash, BackgroundLoadStats>::ConstIterator i = stats_.Find(type);
+    return i != stats_.End() ? i->second_ : BackgroundLoadStats();
+}
+
 void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
 {
     Resource* resource = item.resource_;
@@ -281,6 +464,18 @@ void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
     }
     resource->SetAsyncLoadState(ASYNC_DONE);
 
+    {
+        MutexLock lock(backgroundLoadMutex_);
+        BackgroundLoadStats& stats = stats_[resource->GetType()];
+        long long latency = clock_.GetUSec(false) - item.queueTime_;
+        ++stats.finished_;
+        if (!success)
+            ++stats.failed_;
+        stats.totalWaitUSec_ += item.waitTime_;
+        stats.totalLatencyUSec_ += latency;
+        stats.maxLatencyUSec_ = Max(stats.maxLatencyUSec_, latency);
+    }
+
     if (!success && item.sendEventOnFailure_)
     {
         using namespace LoadFailed;
@@ -28,11 +28,14 @@
 #include "../Container/Ptr.h"
 #include "../Container/RefCounted.h"
 #include "../Core/Thread.h"
+#include "../Core/Timer.h"
 #include "../Math/StringHash.h"
+#include "../Resource/ResourceCache.h"
 
 namespace Urho3D
 {
 
+class BackgroundLoaderThread;
 class Resource;
 class ResourceCache;
 
@@ -47,32 +50,72 @@ struct BackgroundLoadItem
     HashSet<Pair<StringHash, StringHash> > dependents_;
     /// Whether to send failure event.
     bool sendEventOnFailure_;
+    /// Load priority, higher loads first.
+    int priority_;
+    /// Queueing order, earlier loads first on equal priority.
+    unsigned sequence_;
+    /// Loader clock time when queued, in microseconds.
+    long long queueTime_;
+    /// Time waited for a loader thread, in microseconds.
+    long long waitTime_;
 };
 
-/// Background loader of resources. Owned by the ResourceCache.
-class BackgroundLoader : public RefCounted, public Thread
+/// Background loader of resources. Owned by the ResourceCache. Loads on a pool of threads, highest priority first.
+class BackgroundLoader : public RefCounted
 {
+    friend class BackgroundLoaderThread;
+
 public:
     /// Construct.
     explicit BackgroundLoader(ResourceCache* owner);
 
-    /// Destruct. Forcibly clear the load queue.
+    /// Destruct. Stop the loader threads and forcibly clear the load queue.
     ~BackgroundLoader() override;
 
-    /// Resource background loading loop.
-    void ThreadFunction() override;
-
     /// Queue loading of a resource. The name must be sanitated to ensure consistent format. Return true if queued (not a duplicate and resource was a known type).
-    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller);
+    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority = 0);
+    /// Change the priority of a resource that has not started loading. Return true if it was found in the queue.
+    bool SetPriority(StringHash type, StringHash nameHash, int priority);
+    /// Remove a resource that has not started loading from the queue. Resources requested by other loading resources can not be cancelled. Return true if removed. Call only from the main thread.
+    bool CancelResource(StringHash type, StringHash nameHash);
     /// Wait and finish possible loading of a resource when being requested from the cache.
     void WaitForResource(StringHash type, StringHash nameHash);
     /// Process resources that are ready to finish.
     void FinishResources(int maxMs);
+    /// Set number of loader threads. Threads are started on the first background request. Call only from the main thread.
+    void SetNumThreads(unsigned num);
+    /// Reset the statistics.
+    void ResetStats();
 
     /// Return amount of resources in the load queue.
     unsigned GetNumQueuedResources() const;
+    /// Return number of loader threads.
+    unsigned GetNumThreads() const { return numThreads_; }
+    /// Return statistics of a resource type.
+    BackgroundLoadStats GetStats(StringHash type) const;
 
 private:
+    /// Priority queue entry. Entries are not removed when their item is cancelled or reprioritized, but skipped when popped.
+    struct QueueEntry
+    {
+        /// Item priority when the entry was pushed.
+        int priority_;
+        /// Item queueing order.
+        unsigned sequence_;
+        /// Item key.
+        Pair<StringHash, StringHash> key_;
+    };
+
+    /// Return whether an entry loads after another one. Orders the priority queue heap.
+    static bool LoadsAfter(const QueueEntry& lhs, const QueueEntry& rhs);
+    /// Push an entry for an item to the priority queue. Mutex must be held.
+    void PushEntry(const Pair<StringHash, StringHash>& key, const BackgroundLoadItem& item);
+    /// Load the highest priority queued resource. Called from the loader threads. Return false if nothing was queued.
+    bool LoadNextResource();
+    /// Start the loader threads.
+    void StartThreads();
+    /// Stop the loader threads.
+    void StopThreads();
     /// Finish one background loaded resource.
     void FinishBackgroundLoading(BackgroundLoadItem& item);
 
@@ -82,6 +125,18 @@ private:
     mutable Mutex backgroundLoadMutex_;
     /// Resources that are queued for background loading.
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem> backgroundLoadQueue_;
+    /// Binary heap of queued resources by priority.
+    PODVector<QueueEntry> priorityQueue_;
+    /// Statistics by resource type.
+    HashMap<StringHash, BackgroundLoadStats> stats_;
+    /// Loader threads.
+    Vector<SharedPtr<BackgroundLoaderThread> > threads_;
+    /// Clock for queueing and latency times.
+    HiresTimer clock_;
+    /// Number of loader threads.
+    unsigned numThreads_;
+    /// Next queueing order.
+    unsigned nextSequence_;
 };
 
 }
@@ -635,7 +635,7 @@ Resource* ResourceCache::GetResource(StringHash type, const String& name, bool s
     return resource;
 }
 
-bool ResourceCache::BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller)
+bool ResourceCache::BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority)
 {
 #ifdef URHO3D_THREADING
     // If empty name, fail immediately
@@ -648,13 +648,38 @@ bool ResourceCache::BackgroundLoadResource(StringHash type, const String& name,
     if (FindResource(type, nameHash) != noResource)
         return false;
 
-    return backgroundLoader_->QueueResource(type, sanitatedName, sendEventOnFailure, caller);
+    return backgroundLoader_->QueueResource(type, sanitatedName, sendEventOnFailure, caller, priority);
 #else
     // When threading not supported, fall back to synchronous loading
     return GetResource(type, name, sendEventOnFailure);
 #endif
 }
 
+bool ResourceCache::SetBackgroundLoadPriority(StringHash type, const String& name, int priority)
+{
+#ifdef URHO3D_THREADING
+    return backgroundLoader_->SetPriority(type, StringHash(SanitateResourceName(name)), priority);
+#else
+    return false;
+#endif
+}
+
+bool ResourceCache::CancelBackgroundLoad(StringHash type, const String& name)
+{
+#ifdef URHO3D_THREADING
+    return backgroundLoader_->CancelResource(type, StringHash(SanitateResourceName(name)));
+#else
+    return false;
+#endif
+}
+
+void ResourceCache::SetNumBackgroundLoadThreads(unsigned num)
+{
+#ifdef URHO3D_THREADING
+    backgroundLoader_->SetNumThreads(num);
+#endif
+}
+
 SharedPtr<Resource> ResourceCache::GetTempResource(StringHash type, const String& name, bool sendEventOnFailure)
 {
     String sanitatedName = SanitateResourceName(name);
@@ -717,6 +742,31 @@ unsigned ResourceCache::GetNumBackgroundLoadResources() const
 #endif
 }
 
+unsigned ResourceCache::GetNumBackgroundLoadThreads() const
+{
+#ifdef URHO3D_THREADING
+    return backgroundLoader_->GetNumThreads();
+#else
+    return 0;
+#endif
+}
+
+BackgroundLoadStats ResourceCache::GetBackgroundLoadStats(StringHash type) const
+{
+#ifdef URHO3D_THREADING
+    return backgroundLoader_->GetStats(type);
+#else
+    return BackgroundLoadStats();
+#endif
+}
+
+void ResourceCache::ResetBackgroundLoadStats()
+{
+#ifdef URHO3D_THREADING
+    backgroundLoader_->ResetStats();
+#endif
+}
+
 void ResourceCache::GetResources(PODVector<Resource*>& result, StringHash type) const
 {
     result.Clear();
@@ -56,6 +56,32 @@ struct ResourceGroup
     HashMap<StringHash, SharedPtr<Resource> > resources_;
 };
 
+/// Background loading statistics of one resource type.
+struct BackgroundLoadStats
+{
+    /// Resources waiting for a loader thread.
+    unsigned queued_{};
+    /// Resources being loaded by a loader thread.
+    unsigned loading_{};
+    /// Resources finished since the statistics were reset, including failed ones.
+    unsigned finished_{};
+    /// Finished resources that failed to load.
+    unsigned failed_{};
+    /// Resources cancelled before loading since the statistics were reset.
+    unsigned cancelled_{};
+    /// Total time finished resources waited for a loader thread, in microseconds.
+    long long totalWaitUSec_{};
+    /// Total time from queueing to finishing of finished resources, in microseconds.
+    long long totalLatencyUSec_{};
+    /// Longest time from queueing to finishing, in microseconds.
+    long long maxLatencyUSec_{};
+
+    /// Return average time waited for a loader thread in milliseconds.
+    float GetAverageWaitMs() const { return finished_ ? totalWaitUSec_ / (finished_ * 1000.0f) : 0.0f; }
+    /// Return average time from queueing to finishing in milliseconds.
+    float GetAverageLatencyMs() const { return finished_ ? totalLatencyUSec_ / (finished_ * 1000.0f) : 0.0f; }
+};
+
 /// Resource request types.
 enum ResourceRequest
 {
@@ -128,6 +154,8 @@ public:
 
     /// Set how many milliseconds maximum per frame to spend on finishing background loaded resources.
     void SetFinishBackgroundResourcesMs(int ms) { finishBackgroundResourcesMs_ = Max(ms, 1); }
+    /// Set number of background loader threads. Default 1.
+    void SetNumBackgroundLoadThreads(unsigned num);
 
     /// Add a resource router object. By default there is none, so the routing process is skipped.
     void AddResourceRouter(ResourceRouter* router, bool addAsFirst = false);
@@ -140,10 +168,18 @@ public:
     Resource* GetResource(StringHash type, const String& name, bool sendEventOnFailure = true);
     /// Load a resource without storing it in the resource cache. Return null if not found or if fails. Can be called from outside the main thread if the resource itself is safe to load completely (it does not possess for example GPU data.)
     SharedPtr<Resource> GetTempResource(StringHash type, const String& name, bool sendEventOnFailure = true);
-    /// Background load a resource. An event will be sent when complete. Return true if successfully stored to the load queue, false if eg. already exists. Can be called from outside the main thread.
-    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = nullptr);
+    /// Background load a resource. An event will be sent when complete. Return true if successfully stored to the load queue, false if eg. already exists. Can be called from outside the main thread. Resources with higher priority are loaded first.
+    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = nullptr, int priority = 0);
+    /// Change the priority of a background loaded resource that has not started loading yet. Return true if it was found in the queue.
+    bool SetBackgroundLoadPriority(StringHash type, const String& name, int priority);
+    /// Cancel background loading of a resource that has not started loading yet. No event is sent for it. Return true if cancelled.
+    bool CancelBackgroundLoad(StringHash type, const String& name);
     /// Return number of pending background-loaded resources.
     unsigned GetNumBackgroundLoadResources() const;
+    /// Return background loading statistics of a resource type.
+    BackgroundLoadStats GetBackgroundLoadStats(StringHash type) const;
+    /// Reset background loading statistics.
+    void ResetBackgroundLoadStats();
     /// Return all loaded resources of a specific type.
     void GetResources(PODVector<Resource*>& result, StringHash type) const;
     /// Return an already loaded resource of specific type & name, or null if not found. Will not load if does not exist.
@@ -167,7 +203,11 @@ public:
     /// Template version of releasing a resource by name.
     template <class T> void ReleaseResource(const String& name, bool force = false);
     /// Template version of queueing a resource background load.
-    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = nullptr);
+    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = nullptr, int priority = 0);
+    /// Template version of changing the priority of a resource background load.
+    template <class T> bool SetBackgroundLoadPriority(const String& name, int priority);
+    /// Template version of cancelling a resource background load.
+    template <class T> bool CancelBackgroundLoad(const String& name);
     /// Template version of returning loaded resources of a specific type.
     template <class T> void GetResources(PODVector<T*>& result) const;
     /// Return whether a file exists in the resource directories or package files. Does not check manually added in-memory resources.
@@ -192,6 +232,8 @@ public:
 
     /// Return how many milliseconds maximum to spend on finishing background loaded resources.
     int GetFinishBackgroundResourcesMs() const { return finishBackgroundResourcesMs_; }
+    /// Return number of background loader threads.
+    unsigned GetNumBackgroundLoadThreads() const;
 
     /// Return a resource router by index.
     ResourceRouter* GetResourceRouter(unsigned index) const;
@@ -278,10 +320,22 @@ template <class T> SharedPtr<T> ResourceCache::GetTempResource(const String& nam
     return StaticCast<T>(GetTempResource(type, name, sendEventOnFailure));
 }
 
-template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller)
+template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller, int priority)
+{
+    StringHash type = T::GetTypeStatic();
+    return BackgroundLoadResource(type, name, sendEventOnFailure, caller, priority);
+}
+
+template <class T> bool ResourceCache::SetBackgroundLoadPriority(const String& name, int priority)
+{
+    StringHash type = T::GetTypeStatic();
+    return SetBackgroundLoadPriority(type, name, priority);
+}
+
+template <class T> bool ResourceCache::CancelBackgroundLoad(const String& name)
 {
     StringHash type = T::GetTypeStatic();
-    return BackgroundLoadResource(type, name, sendEventOnFailure, caller);
+    return CancelBackgroundLoad(type, name);
 }
 
 template <class T> void ResourceCache::GetResources(PODVector<T*>& result) const
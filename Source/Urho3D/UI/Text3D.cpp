@@ -62,6 +62,8 @@ Text3D::Text3D(Context* context) :
     fontDataLost_(false)
 {
     text_.SetEffectDepthBias(DEFAULT_EFFECT_DEPTH_BIAS);
+    // Face camera and fixed screen size change the bounding box when updating batches
+    volatileWorldBoundingBox_ = true;
 }
 
 Text3D::~Text3D() = default;
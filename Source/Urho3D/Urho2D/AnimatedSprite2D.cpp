@@ -62,6 +62,8 @@ AnimatedSprite2D::AnimatedSprite2D(Context* context) :
     speed_(1.0f),
     loopMode_(LM_DEFAULT)
 {
+    // Animation changes the bounding box without marking the drawable dirty
+    volatileWorldBoundingBox_ = true;
 }
 
 AnimatedSprite2D::~AnimatedSprite2D()
@@ -13,6 +13,9 @@
 #endif
 varying vec3 vNormal;
 varying vec4 vWorldPos;
+#ifdef INSTANCED
+    varying vec4 vInstanceDiffColor;
+#endif
 #ifdef VERTEXCOLOR
     varying vec4 vColor;
 #endif
@@ -52,6 +55,9 @@ void VS()
     gl_Position = GetClipPos(worldPos);
     vNormal = GetWorldNormal(modelMatrix);
     vWorldPos = vec4(worldPos, GetDepth(gl_Position));
+    #ifdef INSTANCED
+        vInstanceDiffColor = iInstanceDiffColor;
+    #endif
 
 #ifdef LOGDEPTH
 	positionW = gl_Position.w;
@@ -125,9 +131,9 @@ void PS()
             if (diffInput.a < 0.5)
                 discard;
         #endif
-        vec4 diffColor = cMatDiffColor * diffInput;
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor) * diffInput;
     #else
-        vec4 diffColor = cMatDiffColor;
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor);
     #endif
 
     #ifdef VERTEXCOLOR
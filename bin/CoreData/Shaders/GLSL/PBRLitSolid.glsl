@@ -18,6 +18,9 @@
 #endif
 varying vec3 vNormal;
 varying vec4 vWorldPos;
+#ifdef INSTANCED
+    varying vec4 vInstanceDiffColor;
+#endif
 varying float snowFactor;
 #ifdef LOGDEPTH
 varying float positionW;
@@ -80,6 +83,9 @@ void VS()
 //	worldPos = worldPos + radius*vNormal;
 	gl_Position = GetClipPos(worldPos);
     vWorldPos = vec4(worldPos, GetDepth(gl_Position));
+    #ifdef INSTANCED
+        vInstanceDiffColor = iInstanceDiffColor;
+    #endif
 #ifdef LOGDEPTH
 	positionW = gl_Position.w;
 #endif
@@ -162,9 +168,9 @@ void PS()
             if (diffInput.a < 0.5)
                 discard;
         #endif
-        vec4 diffColor = cMatDiffColor * diffInput;
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor) * diffInput;
     #else
-        vec4 diffColor = cMatDiffColor;
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor);
     #endif
 
     #ifdef VERTEXCOLOR
@@ -27,7 +27,14 @@
 	
 void VS()
 {
-    vec3 worldPos = (vec4(iPos.xyz, 1.0) * iModelMatrix).xyz;
+	#ifdef QUANTIZED
+		// AgQuantizedLidarPoint: x, y in iPos and z in iBlendIndices as pairs of bytes,
+		// the model matrix includes the dequantization to node space
+		vec3 localPos = vec3(iPos.x + iPos.y * 256.0, iPos.z + iPos.w * 256.0, iBlendIndices.x + iBlendIndices.y * 256.0);
+	#else
+		vec3 localPos = iPos.xyz;
+	#endif
+    vec3 worldPos = (vec4(localPos, 1.0) * iModelMatrix).xyz;
     gl_Position = GetClipPos(worldPos);
 	
 	#ifdef ADAPTIVESIZE
@@ -46,7 +53,12 @@ void VS()
 	#elif defined(DEPTHTARGET)
 		vColor.x = GetDepth(gl_Position);
 	#elif defined(FALSECOLOR)
-		float a = (iPos.z - cHeightMin) / (cHeightMax - cHeightMin);
+		#ifdef QUANTIZED
+			// quantized positions are only meaningful after the model matrix, so color by world height
+			float a = (worldPos.z - cHeightMin) / (cHeightMax - cHeightMin);
+		#else
+			float a = (iPos.z - cHeightMin) / (cHeightMax - cHeightMin);
+		#endif
 		if(a < 0.333)
 			vColor = vec4(1.0 * a * 3, 1.0, 1.0, 1.0);
 		else if(a < 0.666)
@@ -20,6 +20,7 @@ attribute vec4 iCubeTexCoord1;
     attribute vec4 iTexCoord4;
     attribute vec4 iTexCoord5;
     attribute vec4 iTexCoord6;
+    attribute vec4 iTexCoord11;
 #endif
 attribute float iObjectIndex;
 
@@ -169,6 +170,10 @@ vec3 GetTrailNormal(vec4 iPos, vec3 iParentPos, vec3 iForward)
     #define iModelMatrix cModel
 #endif
 
+#ifdef INSTANCED
+    #define iInstanceDiffColor iTexCoord11
+#endif
+
 vec3 GetWorldPos(mat4 modelMatrix)
 {
     #if defined(BILLBOARD)
@@ -212,6 +217,14 @@ vec4 GetWorldTangent(mat4 modelMatrix)
 
 #else
 
+// Diffuse color override of an instance, a negative alpha selects the material color. Only instanced
+// pixel shaders receive the override, the others ignore the argument
+#ifdef INSTANCED
+    #define GetMatDiffColor(instanceDiffColor) ((instanceDiffColor).a < 0.0 ? cMatDiffColor : (instanceDiffColor))
+#else
+    #define GetMatDiffColor(instanceDiffColor) cMatDiffColor
+#endif
+
 // Silence GLSL 150 deprecation warnings
 #ifdef GL3
 #define varying in
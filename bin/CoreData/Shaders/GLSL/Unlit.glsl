@@ -6,6 +6,9 @@
 
 varying vec2 vTexCoord;
 varying vec4 vWorldPos;
+#ifdef INSTANCED
+    varying vec4 vInstanceDiffColor;
+#endif
 #ifdef VERTEXCOLOR
     varying vec4 vColor;
 #endif
@@ -20,6 +23,9 @@ void VS()
     gl_Position = GetClipPos(worldPos);
     vTexCoord = GetTexCoord(iTexCoord);
     vWorldPos = vec4(worldPos, GetDepth(gl_Position));
+    #ifdef INSTANCED
+        vInstanceDiffColor = iInstanceDiffColor;
+    #endif
 #ifdef LOGDEPTH
 	positionW = gl_Position.w;
 #endif	
@@ -36,13 +42,13 @@ void PS()
 #endif
     // Get material diffuse albedo
     #ifdef DIFFMAP
-        vec4 diffColor = cMatDiffColor * texture2D(sDiffMap, vTexCoord);
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor) * texture2D(sDiffMap, vTexCoord);
         #ifdef ALPHAMASK
             if (diffColor.a < 0.5)
                 discard;
         #endif
     #else
-        vec4 diffColor = cMatDiffColor;
+        vec4 diffColor = GetMatDiffColor(vInstanceDiffColor);
     #endif
 
     #ifdef VERTEXCOLOR
@@ -27,6 +27,7 @@ void VS(float4 iPos : POSITION,
     #endif
     #ifdef INSTANCED
         float4x3 iModelInstance : TEXCOORD4,
+        float4 iInstanceDiffColor : TEXCOORD11,
     #endif
     #if defined(BILLBOARD) || defined(DIRBILLBOARD)
         float2 iSize : TEXCOORD1,
@@ -39,6 +40,9 @@ void VS(float4 iPos : POSITION,
     #endif
     out float3 oNormal : TEXCOORD1,
     out float4 oWorldPos : TEXCOORD2,
+    #ifdef INSTANCED
+        out float4 oInstanceDiffColor : TEXCOORD8,
+    #endif
     #ifdef PERPIXEL
         #ifdef SHADOW
             out float4 oShadowPos[NUMCASCADES] : TEXCOORD4,
@@ -77,6 +81,9 @@ void VS(float4 iPos : POSITION,
     oPos = GetClipPos(worldPos);
     oNormal = GetWorldNormal(modelMatrix);
     oWorldPos = float4(worldPos, GetDepth(oPos));
+    #ifdef INSTANCED
+        oInstanceDiffColor = iInstanceDiffColor;
+    #endif
 
     #if defined(D3D11) && defined(CLIPPLANE)
         oClip = dot(oPos, cClipPlane);
@@ -145,6 +152,9 @@ void PS(
     #endif
     float3 iNormal : TEXCOORD1,
     float4 iWorldPos : TEXCOORD2,
+    #ifdef INSTANCED
+        float4 iInstanceDiffColor : TEXCOORD8,
+    #endif
     #ifdef PERPIXEL
         #ifdef SHADOW
             float4 iShadowPos[NUMCASCADES] : TEXCOORD4,
@@ -188,9 +198,9 @@ void PS(
             if (diffInput.a < 0.5)
                 discard;
         #endif
-        float4 diffColor = cMatDiffColor * diffInput;
+        float4 diffColor = GetMatDiffColor(iInstanceDiffColor) * diffInput;
     #else
-        float4 diffColor = cMatDiffColor;
+        float4 diffColor = GetMatDiffColor(iInstanceDiffColor);
     #endif
 
     #ifdef VERTEXCOLOR
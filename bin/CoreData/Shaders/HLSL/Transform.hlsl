@@ -149,6 +149,14 @@ float3 GetTrailNormal(float4 iPos, float3 iParentPos, float3 iForward)
 
 #ifdef COMPILEPS
 
+// Diffuse color override of an instance, a negative alpha selects the material color. Only instanced
+// pixel shaders receive the override, the others ignore the argument
+#ifdef INSTANCED
+    #define GetMatDiffColor(instanceDiffColor) ((instanceDiffColor).a < 0.0 ? cMatDiffColor : (instanceDiffColor))
+#else
+    #define GetMatDiffColor(instanceDiffColor) cMatDiffColor
+#endif
+
 #ifdef D3D11
 #define OUTCOLOR0 SV_TARGET
 #define OUTCOLOR1 SV_TARGET1
@@ -16,6 +16,7 @@ void VS(float4 iPos : POSITION,
     #endif
     #ifdef INSTANCED
         float4x3 iModelInstance : TEXCOORD4,
+        float4 iInstanceDiffColor : TEXCOORD11,
     #endif
     #if defined(BILLBOARD) || defined(DIRBILLBOARD)
         float2 iSize : TEXCOORD1,
@@ -28,6 +29,9 @@ void VS(float4 iPos : POSITION,
     #endif
     out float2 oTexCoord : TEXCOORD0,
     out float4 oWorldPos : TEXCOORD2,
+    #ifdef INSTANCED
+        out float4 oInstanceDiffColor : TEXCOORD8,
+    #endif
     #ifdef VERTEXCOLOR
         out float4 oColor : COLOR0,
     #endif
@@ -46,6 +50,9 @@ void VS(float4 iPos : POSITION,
     oPos = GetClipPos(worldPos);
     oTexCoord = GetTexCoord(iTexCoord);
     oWorldPos = float4(worldPos, GetDepth(oPos));
+    #ifdef INSTANCED
+        oInstanceDiffColor = iInstanceDiffColor;
+    #endif
 
     #if defined(D3D11) && defined(CLIPPLANE)
         oClip = dot(oPos, cClipPlane);
@@ -58,6 +65,9 @@ void VS(float4 iPos : POSITION,
 
 void PS(float2 iTexCoord : TEXCOORD0,
     float4 iWorldPos: TEXCOORD2,
+    #ifdef INSTANCED
+        float4 iInstanceDiffColor : TEXCOORD8,
+    #endif
     #ifdef VERTEXCOLOR
         float4 iColor : COLOR0,
     #endif
@@ -76,13 +86,13 @@ void PS(float2 iTexCoord : TEXCOORD0,
 {
     // Get material diffuse albedo
     #ifdef DIFFMAP
-        float4 diffColor = cMatDiffColor * Sample2D(DiffMap, iTexCoord);
+        float4 diffColor = GetMatDiffColor(iInstanceDiffColor) * Sample2D(DiffMap, iTexCoord);
         #ifdef ALPHAMASK
             if (diffColor.a < 0.5)
                 discard;
         #endif
     #else
-        float4 diffColor = cMatDiffColor;
+        float4 diffColor = GetMatDiffColor(iInstanceDiffColor);
     #endif
 
     #ifdef VERTEXCOLOR